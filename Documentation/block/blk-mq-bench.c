@@ -0,0 +1,178 @@
+/*
+ * blk-mq-bench.c - random read IOPS of a block device over a number of CPUs
+ *
+ * Runs one thread on each of the first given number of CPUs, doing random
+ * O_DIRECT reads of the block size from the device for some seconds, and
+ * reports the reads per second in total and per CPU. Made to compare the
+ * request_fn and multi-queue paths of the block layer on null_blk, see
+ * Documentation/block/null_blk.txt:
+ *
+ *	modprobe null_blk queue_mode=1 nr_devices=1
+ *	for n in 1 2 4; do blk-mq-bench -c $n /dev/nullb0; done
+ *	rmmod null_blk
+ *	modprobe null_blk queue_mode=2 nr_devices=1
+ *	for n in 1 2 4; do blk-mq-bench -c $n /dev/nullb0; done
+ *
+ *	gcc -O2 -pthread -o blk-mq-bench blk-mq-bench.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+
+#define NSEC_PER_SEC	1000000000ULL
+
+static unsigned int nr_cpus = 1;
+static unsigned int seconds = 10;
+static unsigned int block_size = 4096;
+static const char *dev;
+static uint64_t nr_blocks;
+static volatile int stop;
+
+struct worker {
+	pthread_t thread;
+	unsigned int cpu;
+	unsigned long ios;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void die(const char *what, const char *name)
+{
+	fprintf(stderr, "%s %s: %s\n", what, name, strerror(errno));
+	exit(1);
+}
+
+static void *worker_thread(void *arg)
+{
+	struct worker *w = arg;
+	unsigned int seed = w->cpu + 1;
+	cpu_set_t set;
+	void *buf;
+	off_t off;
+	int fd;
+
+	CPU_ZERO(&set);
+	CPU_SET(w->cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		die("cannot run on cpu of", dev);
+
+	if (posix_memalign(&buf, block_size, block_size))
+		die("cannot allocate buffer for", dev);
+
+	fd = open(dev, O_RDONLY | O_DIRECT);
+	if (fd < 0)
+		die("cannot open", dev);
+
+	while (!stop) {
+		off = (((uint64_t)rand_r(&seed) << 31 | rand_r(&seed)) %
+		       nr_blocks) * block_size;
+		if (pread(fd, buf, block_size, off) != block_size)
+			die("cannot read", dev);
+		w->ios++;
+	}
+
+	close(fd);
+	free(buf);
+	return NULL;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-c cpus] [-s seconds] [-b bytes] device\n"
+		"  -c  CPUs reading, from cpu 0 up, default %u\n"
+		"  -s  run time, default %u seconds\n"
+		"  -b  read size, default %u bytes\n",
+		prog, nr_cpus, seconds, block_size);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct worker *workers;
+	unsigned long ios = 0;
+	uint64_t start, end, size;
+	unsigned int i;
+	double secs;
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "c:s:b:")) != -1) {
+		switch (opt) {
+		case 'c':
+			nr_cpus = atoi(optarg);
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'b':
+			block_size = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !nr_cpus || !seconds || !block_size)
+		usage(argv[0]);
+	dev = argv[optind];
+
+	fd = open(dev, O_RDONLY);
+	if (fd < 0)
+		die("cannot open", dev);
+	if (ioctl(fd, BLKGETSIZE64, &size))
+		die("cannot get size of", dev);
+	close(fd);
+
+	nr_blocks = size / block_size;
+	if (!nr_blocks) {
+		fprintf(stderr, "%s is smaller than a block\n", dev);
+		return 1;
+	}
+
+	workers = calloc(nr_cpus, sizeof(*workers));
+	if (!workers)
+		die("cannot allocate", "workers");
+
+	start = now_ns();
+	for (i = 0; i < nr_cpus; i++) {
+		workers[i].cpu = i;
+		if (pthread_create(&workers[i].thread, NULL, worker_thread,
+				   &workers[i]))
+			die("cannot start worker for", dev);
+	}
+	sleep(seconds);
+	stop = 1;
+	for (i = 0; i < nr_cpus; i++) {
+		pthread_join(workers[i].thread, NULL);
+		ios += workers[i].ios;
+	}
+	end = now_ns();
+
+	secs = (double)(end - start) / NSEC_PER_SEC;
+	printf("%s, %u cpus, %u byte random reads\n", dev, nr_cpus,
+	       block_size);
+	printf("iops      %10.0f\n", ios / secs);
+	printf("iops/cpu  %10.0f\n", ios / secs / nr_cpus);
+	return 0;
+}
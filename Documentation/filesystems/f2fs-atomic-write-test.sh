@@ -0,0 +1,76 @@
+#!/bin/sh
+# f2fs-atomic-write-test.sh - power cut test of f2fs atomic writes
+#
+# Runs f2fs-atomic-write on an f2fs image stacked on a loop device and
+# dm-flakey, and cuts the power at a random point of its transactions by
+# switching dm-flakey to drop all writes. The file system is then mounted
+# again, which rolls forward the fsync'ed dnodes, and the file is checked
+# to hold whole transactions only.
+#
+# usage: f2fs-atomic-write-test.sh [rounds]
+#
+# Needs root, mkfs.f2fs, dmsetup and f2fs-atomic-write built from
+# f2fs-atomic-write.c in the same directory.
+
+rounds=${1:-20}
+dir=$(cd "$(dirname "$0")" && pwd)
+tool=$dir/f2fs-atomic-write
+tmp=$(mktemp -d)
+img=$tmp/f2fs.img
+mnt=$tmp/mnt
+log=$tmp/committed
+dm=f2fs-atomic-test
+
+cleanup() {
+	umount "$mnt" 2>/dev/null
+	dmsetup remove $dm 2>/dev/null
+	[ -n "$loop" ] && losetup -d "$loop"
+	rm -rf "$tmp"
+}
+trap cleanup EXIT
+
+[ -x "$tool" ] || { echo "build $tool first" >&2; exit 1; }
+
+mkdir "$mnt"
+dd if=/dev/zero of="$img" bs=1M count=256 2>/dev/null
+loop=$(losetup -f --show "$img") || exit 1
+sectors=$(blockdev --getsz "$loop")
+
+# up forever, or down with every write dropped
+table_up="0 $sectors flakey $loop 0 1000 0"
+table_cut="0 $sectors flakey $loop 0 0 1000 1 drop_writes"
+
+fail=0
+i=1
+while [ $i -le "$rounds" ]; do
+	mkfs.f2fs "$loop" >/dev/null || exit 1
+	echo "$table_up" | dmsetup create $dm || exit 1
+	mount -t f2fs /dev/mapper/$dm "$mnt" || exit 1
+
+	"$tool" write "$mnt/db" "$log" &
+	pid=$!
+	sleep "$(awk "BEGIN { srand($i); print 1 + rand() * 3 }")"
+
+	# power cut: nothing reaches the disk from now on
+	echo "$table_cut" | dmsetup load $dm
+	dmsetup suspend --nolockfs $dm
+	dmsetup resume $dm
+	kill $pid
+	wait $pid 2>/dev/null
+	umount "$mnt"
+	echo 3 > /proc/sys/vm/drop_caches
+
+	echo "$table_up" | dmsetup load $dm
+	dmsetup suspend $dm
+	dmsetup resume $dm
+	mount -t f2fs /dev/mapper/$dm "$mnt" || exit 1
+
+	printf "round %d: " $i
+	"$tool" check "$mnt/db" "$log" || fail=1
+
+	umount "$mnt"
+	dmsetup remove $dm
+	i=$((i + 1))
+done
+
+exit $fail
@@ -0,0 +1,231 @@
+/*
+ * f2fs-atomic-write.c - writer and checker for f2fs atomic writes
+ *
+ * The file is made of NR_PAGES pages. Transaction n rewrites page 0 and a
+ * pseudo random set of the other pages, derived from n, with records of n
+ * between F2FS_IOC_START_ATOMIC_WRITE and F2FS_IOC_COMMIT_ATOMIC_WRITE:
+ *
+ *	f2fs-atomic-write write FILE LOG	run transactions until killed
+ *	f2fs-atomic-write check FILE LOG	verify FILE after a power cut
+ *
+ * Every 16th transaction is aborted instead, after which the writer checks
+ * that its pages read back the committed data.
+ *
+ * The number of each committed transaction is appended to LOG, which lives
+ * on another file system. After a power cut, page 0 tells the transaction
+ * n that survived; it must be the last logged one or the one after it, and
+ * every page must hold what transaction n or the last committed one before
+ * it that touched the page wrote. f2fs-atomic-write-test.sh drives both
+ * modes.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+
+#define F2FS_IOCTL_MAGIC		0xf5
+#define F2FS_IOC_START_ATOMIC_WRITE	_IO(F2FS_IOCTL_MAGIC, 1)
+#define F2FS_IOC_COMMIT_ATOMIC_WRITE	_IO(F2FS_IOCTL_MAGIC, 2)
+#define F2FS_IOC_ABORT_ATOMIC_WRITE	_IO(F2FS_IOCTL_MAGIC, 5)
+
+#define PAGE_SIZE	4096
+#define NR_PAGES	256
+#define RECORDS		(PAGE_SIZE / sizeof(uint64_t))
+
+static uint64_t buf[RECORDS];
+
+static int aborted(uint64_t txn)
+{
+	return txn && (txn & 15) == 15;
+}
+
+/* whether transaction @txn rewrites @page; transaction 0 writes all */
+static int touches(uint64_t txn, unsigned int page)
+{
+	uint64_t x;
+
+	if (!txn || !page)
+		return 1;
+
+	x = txn * 0x9e3779b97f4a7c15ULL ^ page * 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 31;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 29;
+	return (x & 7) == 0;
+}
+
+/* the transaction whose data page @page holds once @txn is committed */
+static uint64_t last_writer(uint64_t txn, unsigned int page)
+{
+	while (aborted(txn) || !touches(txn, page))
+		txn--;
+	return txn;
+}
+
+static void fill(uint64_t txn, unsigned int page)
+{
+	unsigned int i;
+
+	for (i = 0; i < RECORDS; i++)
+		buf[i] = txn << 16 | page;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void write_page(int fd, uint64_t txn, unsigned int page)
+{
+	fill(txn, page);
+	if (pwrite(fd, buf, PAGE_SIZE, (off_t)page * PAGE_SIZE) != PAGE_SIZE)
+		die("pwrite");
+}
+
+/* returns the first record of @page which is not of transaction @txn */
+static int check_page(int fd, uint64_t txn, unsigned int page,
+		      uint64_t *found)
+{
+	unsigned int i;
+
+	if (pread(fd, buf, PAGE_SIZE, (off_t)page * PAGE_SIZE) != PAGE_SIZE)
+		die("pread");
+
+	for (i = 0; i < RECORDS; i++) {
+		if (buf[i] != (txn << 16 | page)) {
+			*found = buf[i];
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int do_write(const char *file, const char *log)
+{
+	uint64_t txn;
+	unsigned int page;
+	int fd, log_fd;
+	char line[32];
+
+	fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	log_fd = open(log, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (fd < 0 || log_fd < 0)
+		die("open");
+
+	for (page = 0; page < NR_PAGES; page++)
+		write_page(fd, 0, page);
+	if (fsync(fd))
+		die("fsync");
+
+	for (txn = 1; ; txn++) {
+		if (ioctl(fd, F2FS_IOC_START_ATOMIC_WRITE))
+			die("F2FS_IOC_START_ATOMIC_WRITE");
+
+		/* write page 0 last, as SQLite does with its header */
+		for (page = NR_PAGES - 1; page < NR_PAGES; page--)
+			if (touches(txn, page))
+				write_page(fd, txn, page);
+
+		if (aborted(txn)) {
+			if (ioctl(fd, F2FS_IOC_ABORT_ATOMIC_WRITE))
+				die("F2FS_IOC_ABORT_ATOMIC_WRITE");
+
+			for (page = 0; page < NR_PAGES; page++) {
+				uint64_t found;
+
+				if (check_page(fd, last_writer(txn, page),
+					       page, &found)) {
+					printf("FAIL: page %u holds %llx after"
+					       " abort of transaction %llu\n",
+					       page, (unsigned long long)found,
+					       (unsigned long long)txn);
+					return 1;
+				}
+			}
+			continue;
+		}
+
+		if (ioctl(fd, F2FS_IOC_COMMIT_ATOMIC_WRITE))
+			die("F2FS_IOC_COMMIT_ATOMIC_WRITE");
+
+		snprintf(line, sizeof(line), "%llu\n", (unsigned long long)txn);
+		if (write(log_fd, line, strlen(line)) < 0 || fsync(log_fd))
+			die("log");
+	}
+	return 0;
+}
+
+static int do_check(const char *file, const char *log)
+{
+	unsigned long long logged = 0, n;
+	uint64_t txn, next, found;
+	unsigned int page;
+	int fd, bad = 0;
+	FILE *f;
+
+	f = fopen(log, "r");
+	if (!f)
+		die("open log");
+	while (fscanf(f, "%llu", &n) == 1)
+		logged = n;
+	fclose(f);
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+		die("open");
+
+	if (pread(fd, buf, PAGE_SIZE, 0) != PAGE_SIZE)
+		die("pread");
+	txn = buf[0] >> 16;
+
+	/* the commit of the next transaction may have made it to disk */
+	next = logged + 1;
+	if (aborted(next))
+		next++;
+	if (txn != logged && txn != next) {
+		printf("FAIL: transaction %llu found, %llu was committed\n",
+		       (unsigned long long)txn, logged);
+		return 1;
+	}
+
+	for (page = 0; page < NR_PAGES; page++) {
+		if (check_page(fd, last_writer(txn, page), page, &found)) {
+			printf("FAIL: page %u holds %llx in transaction %llu\n",
+			       page, (unsigned long long)found,
+			       (unsigned long long)txn);
+			bad = 1;
+		}
+	}
+
+	if (!bad)
+		printf("OK: transaction %llu, %llu logged\n",
+		       (unsigned long long)txn, logged);
+	return bad;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 4) {
+		fprintf(stderr, "usage: %s write|check FILE LOG\n", argv[0]);
+		return 1;
+	}
+
+	if (!strcmp(argv[1], "write"))
+		return do_write(argv[2], argv[3]);
+	if (!strcmp(argv[1], "check"))
+		return do_check(argv[2], argv[3]);
+
+	fprintf(stderr, "unknown mode '%s'\n", argv[1]);
+	return 1;
+}
@@ -0,0 +1,131 @@
+/*
+ * fuse-append-bench.c - throughput of small appends to a file
+ *
+ * Appends records of the given size to a new file, the way apps write
+ * logs and databases write journals, and reports the appends per second,
+ * including the time of the final fsync and close. With -f the file is
+ * fsync'ed every given number of records as well.
+ *
+ * Without the writeback cache every append to a FUSE file is a WRITE
+ * request to the daemon. With it the appends fill the page cache and go
+ * to the daemon as large WRITEs at writeback. Compare the two with the
+ * daemon of fuse-passthrough-test.c, without passthrough:
+ *
+ *	fuse-passthrough-test -n /data/lower /mnt/fuse &
+ *	fuse-append-bench /mnt/fuse/log
+ *	umount /mnt/fuse
+ *	fuse-passthrough-test -n -w /data/lower /mnt/fuse &
+ *	fuse-append-bench /mnt/fuse/log
+ *	umount /mnt/fuse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <stdint.h>
+
+#define NSEC_PER_SEC	1000000000ULL
+
+static unsigned int record_size = 64;
+static unsigned int nr_records = 100000;
+static unsigned int fsync_every;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void die(const char *what, const char *name)
+{
+	fprintf(stderr, "%s %s: %s\n", what, name, strerror(errno));
+	exit(1);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-s bytes] [-n records] [-f records] file\n"
+		"  -s  record size, default %u bytes\n"
+		"  -n  number of records, default %u\n"
+		"  -f  fsync every that many records, default only at the end\n",
+		prog, record_size, nr_records);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t start, appended, end;
+	const char *path;
+	unsigned int i;
+	char *record;
+	double secs;
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "s:n:f:")) != -1) {
+		switch (opt) {
+		case 's':
+			record_size = atoi(optarg);
+			break;
+		case 'n':
+			nr_records = atoi(optarg);
+			break;
+		case 'f':
+			fsync_every = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind != argc - 1 || !record_size || !nr_records)
+		usage(argv[0]);
+	path = argv[optind];
+
+	record = malloc(record_size);
+	if (!record)
+		die("cannot allocate", "record");
+	memset(record, 'r', record_size);
+	record[record_size - 1] = '\n';
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (fd < 0)
+		die("cannot create", path);
+
+	start = now_ns();
+	for (i = 1; i <= nr_records; i++) {
+		if (write(fd, record, record_size) != record_size)
+			die("cannot append to", path);
+		if (fsync_every && !(i % fsync_every) && fsync(fd))
+			die("cannot fsync", path);
+	}
+	appended = now_ns();
+
+	if (fsync(fd))
+		die("cannot fsync", path);
+	if (close(fd))
+		die("cannot close", path);
+	end = now_ns();
+
+	secs = (double)(end - start) / NSEC_PER_SEC;
+	printf("file %s, %u records of %u bytes\n", path, nr_records,
+	       record_size);
+	printf("appends  %10.0f /s (%.2f MB/s)\n", nr_records / secs,
+	       (double)nr_records * record_size / (1024 * 1024) / secs);
+	printf("append   %10.2f s\n",
+	       (double)(appended - start) / NSEC_PER_SEC);
+	printf("sync     %10.2f s\n", (double)(end - appended) / NSEC_PER_SEC);
+	return 0;
+}
@@ -0,0 +1,391 @@
+/*
+ * fuse-channel-test.c - scaling of a multithreaded FUSE daemon
+ *
+ * Mounts a FUSE filesystem with a few small files, served from memory by
+ * the given number of daemon threads, and runs client threads doing stat
+ * and read on the files for some seconds, then reports the operations per
+ * second and unmounts. Attributes and data are never cached, so that every
+ * stat and read is a request to the daemon.
+ *
+ * Each daemon thread reads requests from its own channel, a /dev/fuse
+ * descriptor attached to the connection with FUSE_DEV_IOC_CLONE. With -1
+ * all the threads share the descriptor passed to mount instead, the way
+ * daemons worked before channels. Compare the two with 1 to N threads:
+ *
+ *	for t in 1 2 4 8; do
+ *		fuse-channel-test -t $t /mnt/fuse
+ *		fuse-channel-test -1 -t $t /mnt/fuse
+ *	done
+ *
+ * Mounting needs root, and the program is built against the headers of
+ * this kernel:
+ *
+ *	make headers_install INSTALL_HDR_PATH=/tmp/hdr
+ *	gcc -I/tmp/hdr/include -pthread -o fuse-channel-test \
+ *		fuse-channel-test.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <linux/fuse.h>
+
+#define NSEC_PER_SEC	1000000000ULL
+#define MAX_WRITE	(128 * 1024)
+#define NR_FILES	64
+#define FILE_SIZE	(64 * 1024)
+#define READ_SIZE	4096
+#define FIRST_NODEID	(FUSE_ROOT_ID + 1)
+
+static unsigned int nr_daemons = 4;
+static unsigned int nr_clients = 8;
+static unsigned int seconds = 5;
+static int clone_channels = 1;
+static const char *mnt;
+static int mount_fd;
+static volatile int stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+struct daemon {
+	pthread_t thread;
+	int fd;
+	char buf[MAX_WRITE + 4096];
+	char reply[MAX_WRITE + 4096];
+};
+
+struct client {
+	pthread_t thread;
+	unsigned int seed;
+	unsigned long ops;
+};
+
+static void send_reply(struct daemon *d, struct fuse_in_header *in, int error,
+		       const void *arg, size_t size)
+{
+	struct fuse_out_header *out = (struct fuse_out_header *)d->reply;
+
+	out->len = sizeof(*out) + size;
+	out->error = error;
+	out->unique = in->unique;
+	if (size)
+		memcpy(d->reply + sizeof(*out), arg, size);
+
+	/* ENOENT: the request was interrupted and is gone */
+	if (write(d->fd, d->reply, out->len) < 0 && errno != ENOENT)
+		die("write reply");
+}
+
+/* nodes are the root and the files f0 to f63, all made up */
+static void fill_attr(struct fuse_attr *attr, __u64 nodeid)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->ino = nodeid;
+	attr->nlink = 1;
+	attr->blksize = 4096;
+	if (nodeid == FUSE_ROOT_ID) {
+		attr->mode = S_IFDIR | 0755;
+	} else {
+		attr->mode = S_IFREG | 0444;
+		attr->size = FILE_SIZE;
+		attr->blocks = FILE_SIZE / 512;
+	}
+}
+
+static int valid_node(__u64 nodeid)
+{
+	return nodeid == FUSE_ROOT_ID ||
+	       (nodeid >= FIRST_NODEID && nodeid < FIRST_NODEID + NR_FILES);
+}
+
+static void do_init(struct daemon *d, struct fuse_in_header *in, void *arg)
+{
+	struct fuse_init_in *init_in = arg;
+	struct fuse_init_out init_out;
+
+	if (init_in->major != FUSE_KERNEL_VERSION) {
+		fprintf(stderr, "unsupported protocol %u.%u\n",
+			init_in->major, init_in->minor);
+		exit(1);
+	}
+
+	memset(&init_out, 0, sizeof(init_out));
+	init_out.major = FUSE_KERNEL_VERSION;
+	init_out.minor = FUSE_KERNEL_MINOR_VERSION;
+	init_out.max_readahead = init_in->max_readahead;
+	init_out.flags = FUSE_ASYNC_READ | FUSE_BIG_WRITES;
+	init_out.max_background = 12;
+	init_out.congestion_threshold = 9;
+	init_out.max_write = MAX_WRITE;
+	send_reply(d, in, 0, &init_out, sizeof(init_out));
+}
+
+static void do_request(struct daemon *d, struct fuse_in_header *in, void *arg)
+{
+	switch (in->opcode) {
+	case FUSE_INIT:
+		do_init(d, in, arg);
+		break;
+
+	case FUSE_FORGET:
+	case FUSE_BATCH_FORGET:
+	case FUSE_INTERRUPT:
+		/* these take no reply */
+		break;
+
+	case FUSE_LOOKUP: {
+		struct fuse_entry_out entry;
+		unsigned int i;
+
+		if (in->nodeid != FUSE_ROOT_ID ||
+		    sscanf(arg, "f%u", &i) != 1 || i >= NR_FILES) {
+			send_reply(d, in, -ENOENT, NULL, 0);
+			break;
+		}
+		memset(&entry, 0, sizeof(entry));
+		entry.nodeid = FIRST_NODEID + i;
+		fill_attr(&entry.attr, entry.nodeid);
+		send_reply(d, in, 0, &entry, sizeof(entry));
+		break;
+	}
+
+	case FUSE_GETATTR: {
+		struct fuse_attr_out attr_out;
+
+		if (!valid_node(in->nodeid)) {
+			send_reply(d, in, -ENOENT, NULL, 0);
+			break;
+		}
+		memset(&attr_out, 0, sizeof(attr_out));
+		fill_attr(&attr_out.attr, in->nodeid);
+		send_reply(d, in, 0, &attr_out, sizeof(attr_out));
+		break;
+	}
+
+	case FUSE_OPEN:
+	case FUSE_OPENDIR: {
+		struct fuse_open_out open_out;
+
+		memset(&open_out, 0, sizeof(open_out));
+		if (in->opcode == FUSE_OPEN)
+			open_out.open_flags = FOPEN_DIRECT_IO;
+		send_reply(d, in, 0, &open_out, sizeof(open_out));
+		break;
+	}
+
+	case FUSE_READ: {
+		struct fuse_read_in *read_in = arg;
+		size_t size = read_in->size;
+		char *data = d->reply + sizeof(struct fuse_out_header);
+
+		if (read_in->offset >= FILE_SIZE)
+			size = 0;
+		else if (read_in->offset + size > FILE_SIZE)
+			size = FILE_SIZE - read_in->offset;
+		memset(data, 'a' + in->nodeid % 26, size);
+		send_reply(d, in, 0, data, size);
+		break;
+	}
+
+	case FUSE_FLUSH:
+	case FUSE_RELEASE:
+	case FUSE_RELEASEDIR:
+		send_reply(d, in, 0, NULL, 0);
+		break;
+
+	default:
+		send_reply(d, in, -ENOSYS, NULL, 0);
+	}
+}
+
+static void *daemon_thread(void *arg)
+{
+	struct daemon *d = arg;
+	ssize_t ret;
+
+	for (;;) {
+		ret = read(d->fd, d->buf, sizeof(d->buf));
+		if (ret < 0) {
+			/* ENODEV: unmounted */
+			if (errno == ENODEV)
+				break;
+			if (errno == ENOENT || errno == EINTR)
+				continue;
+			die("read request");
+		}
+		do_request(d, (struct fuse_in_header *)d->buf,
+			   d->buf + sizeof(struct fuse_in_header));
+	}
+	return NULL;
+}
+
+static int clone_channel(void)
+{
+	__u32 oldfd = mount_fd;
+	int fd;
+
+	fd = open("/dev/fuse", O_RDWR);
+	if (fd < 0)
+		die("/dev/fuse");
+	if (ioctl(fd, FUSE_DEV_IOC_CLONE, &oldfd))
+		die("FUSE_DEV_IOC_CLONE");
+	return fd;
+}
+
+static void *client_thread(void *arg)
+{
+	struct client *c = arg;
+	char path[PATH_MAX];
+	char buf[READ_SIZE];
+	int fds[NR_FILES];
+	struct stat st;
+	unsigned int i;
+	off_t off;
+
+	for (i = 0; i < NR_FILES; i++) {
+		snprintf(path, sizeof(path), "%s/f%u", mnt, i);
+		fds[i] = open(path, O_RDONLY);
+		if (fds[i] < 0)
+			die(path);
+	}
+
+	while (!stop) {
+		i = rand_r(&c->seed) % NR_FILES;
+		snprintf(path, sizeof(path), "%s/f%u", mnt, i);
+		if (stat(path, &st))
+			die(path);
+
+		off = (rand_r(&c->seed) % (FILE_SIZE / READ_SIZE)) * READ_SIZE;
+		if (pread(fds[i], buf, sizeof(buf), off) != sizeof(buf))
+			die(path);
+		c->ops++;
+	}
+
+	for (i = 0; i < NR_FILES; i++)
+		close(fds[i]);
+	return NULL;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-t threads] [-c clients] [-s seconds] [-1] "
+		"mountpoint\n"
+		"  -t  daemon threads, default %u\n"
+		"  -c  client threads doing stat and read, default %u\n"
+		"  -s  run time, default %u seconds\n"
+		"  -1  daemon threads share one channel\n",
+		prog, nr_daemons, nr_clients, seconds);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct daemon *daemons;
+	struct client *clients;
+	unsigned long ops = 0;
+	uint64_t start, end;
+	char opts[128];
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:c:s:1")) != -1) {
+		switch (opt) {
+		case 't':
+			nr_daemons = atoi(optarg);
+			break;
+		case 'c':
+			nr_clients = atoi(optarg);
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case '1':
+			clone_channels = 0;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !nr_daemons || !nr_clients || !seconds)
+		usage(argv[0]);
+	mnt = argv[optind];
+
+	daemons = calloc(nr_daemons, sizeof(*daemons));
+	clients = calloc(nr_clients, sizeof(*clients));
+	if (!daemons || !clients)
+		die("calloc");
+
+	mount_fd = open("/dev/fuse", O_RDWR);
+	if (mount_fd < 0)
+		die("/dev/fuse");
+
+	snprintf(opts, sizeof(opts),
+		 "fd=%d,rootmode=%o,user_id=%u,group_id=%u",
+		 mount_fd, S_IFDIR, getuid(), getgid());
+	if (mount("fuse-channel-test", mnt, "fuse", MS_NOSUID | MS_NODEV,
+		  opts))
+		die("mount");
+
+	for (i = 0; i < nr_daemons; i++) {
+		daemons[i].fd = i && clone_channels ? clone_channel() : mount_fd;
+		if (pthread_create(&daemons[i].thread, NULL, daemon_thread,
+				   &daemons[i]))
+			die("pthread_create");
+	}
+
+	start = now_ns();
+	for (i = 0; i < nr_clients; i++) {
+		clients[i].seed = i + 1;
+		if (pthread_create(&clients[i].thread, NULL, client_thread,
+				   &clients[i]))
+			die("pthread_create");
+	}
+	sleep(seconds);
+	stop = 1;
+	for (i = 0; i < nr_clients; i++) {
+		pthread_join(clients[i].thread, NULL);
+		ops += clients[i].ops;
+	}
+	end = now_ns();
+
+	if (umount(mnt))
+		die("umount");
+	for (i = 0; i < nr_daemons; i++)
+		pthread_join(daemons[i].thread, NULL);
+
+	printf("daemon threads %u on %s, clients %u\n", nr_daemons,
+	       clone_channels ? "own channels" : "one channel", nr_clients);
+	printf("stat+read  %10.0f /s\n",
+	       ops / ((double)(end - start) / NSEC_PER_SEC));
+	return 0;
+}
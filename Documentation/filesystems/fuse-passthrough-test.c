@@ -0,0 +1,545 @@
+/*
+ * fuse-passthrough-test.c - mirror a directory through a minimal FUSE daemon
+ *
+ * Mounts a FUSE filesystem on the mount point that shows the regular
+ * files directly under the lower directory, and serves it until it is
+ * unmounted. Opened files are handed to the kernel with FOPEN_PASSTHROUGH,
+ * so that their reads, writes and mmaps go to the lower file without the
+ * daemon; with -n the daemon reads and writes the lower files itself, like
+ * a FUSE filesystem without passthrough does. With -w the kernel is asked
+ * to keep buffered writes in its writeback cache.
+ *
+ * Subdirectories are not shown and directories cannot be listed, which is
+ * all that is needed to time I/O on a few files:
+ *
+ *	fuse-passthrough-test /data/lower /mnt/fuse &
+ *	dd if=/dev/zero of=/mnt/fuse/file bs=1M count=256 conv=fsync
+ *	echo 3 > /proc/sys/vm/drop_caches
+ *	dd if=/mnt/fuse/file of=/dev/null bs=1M
+ *	umount /mnt/fuse
+ *
+ * fuse-passthrough-test.sh runs this with and without -n, and
+ * fuse-append-bench.c times small appends with -n and -n -w. Mounting
+ * needs root, and the program is built against the headers of this kernel:
+ *
+ *	make headers_install INSTALL_HDR_PATH=/tmp/hdr
+ *	gcc -I/tmp/hdr/include -o fuse-passthrough-test fuse-passthrough-test.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/types.h>
+#include <linux/fuse.h>
+
+#define MAX_WRITE	(128 * 1024)
+#define MAX_NODES	1024
+#define FIRST_NODEID	(FUSE_ROOT_ID + 1)
+
+static char buf[MAX_WRITE + 4096];
+static char reply[MAX_WRITE + 4096];
+static char names[MAX_NODES][NAME_MAX + 1];
+static int nr_nodes;
+static int lower_dir;
+static int passthrough = 1;
+static int writeback_cache;
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void send_reply(int fd, struct fuse_in_header *in, int error,
+		       const void *arg, size_t size)
+{
+	struct fuse_out_header *out = (struct fuse_out_header *)reply;
+
+	out->len = sizeof(*out) + size;
+	out->error = error;
+	out->unique = in->unique;
+	if (size && arg != reply + sizeof(*out))
+		memcpy(reply + sizeof(*out), arg, size);
+
+	/* ENOENT: the request was interrupted and is gone */
+	if (write(fd, reply, out->len) < 0 && errno != ENOENT)
+		die("write reply");
+}
+
+static const char *node_name(__u64 nodeid)
+{
+	if (nodeid == FUSE_ROOT_ID)
+		return ".";
+	if (nodeid < FIRST_NODEID || nodeid >= FIRST_NODEID + nr_nodes)
+		return NULL;
+	return names[nodeid - FIRST_NODEID];
+}
+
+static __u64 node_lookup(const char *name)
+{
+	int i;
+
+	for (i = 0; i < nr_nodes; i++)
+		if (!strcmp(names[i], name))
+			return FIRST_NODEID + i;
+	if (nr_nodes == MAX_NODES || strlen(name) > NAME_MAX)
+		return 0;
+	strcpy(names[nr_nodes], name);
+	return FIRST_NODEID + nr_nodes++;
+}
+
+static void fill_attr(struct fuse_attr *attr, const struct stat *st,
+		      __u64 nodeid)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->ino = nodeid;
+	attr->size = st->st_size;
+	attr->blocks = st->st_blocks;
+	attr->atime = st->st_atim.tv_sec;
+	attr->mtime = st->st_mtim.tv_sec;
+	attr->ctime = st->st_ctim.tv_sec;
+	attr->atimensec = st->st_atim.tv_nsec;
+	attr->mtimensec = st->st_mtim.tv_nsec;
+	attr->ctimensec = st->st_ctim.tv_nsec;
+	attr->mode = st->st_mode;
+	attr->nlink = st->st_nlink;
+	attr->uid = st->st_uid;
+	attr->gid = st->st_gid;
+	attr->blksize = st->st_blksize;
+}
+
+/* a node is the lower directory itself or a regular file in it */
+static int stat_node(__u64 nodeid, struct stat *st)
+{
+	const char *name = node_name(nodeid);
+
+	if (!name)
+		return -ENOENT;
+	if (fstatat(lower_dir, name, st, AT_SYMLINK_NOFOLLOW))
+		return -errno;
+	if (nodeid != FUSE_ROOT_ID && !S_ISREG(st->st_mode))
+		return -ENOENT;
+	return 0;
+}
+
+static int fill_entry(struct fuse_entry_out *entry, const char *name)
+{
+	struct stat st;
+	__u64 nodeid;
+	int err;
+
+	nodeid = node_lookup(name);
+	if (!nodeid)
+		return -ENFILE;
+	err = stat_node(nodeid, &st);
+	if (err)
+		return err;
+
+	memset(entry, 0, sizeof(*entry));
+	entry->nodeid = nodeid;
+	entry->entry_valid = 1;
+	entry->attr_valid = 1;
+	fill_attr(&entry->attr, &st, nodeid);
+	return 0;
+}
+
+/*
+ * The lower file is registered with the device for the reply, and the
+ * id is dropped again once the reply is sent: the opened file keeps its
+ * own reference to the lower file.
+ */
+static void fill_open(int fd, struct fuse_open_out *open_out, int lower)
+{
+	__u32 arg = lower;
+	int id;
+
+	memset(open_out, 0, sizeof(*open_out));
+	open_out->fh = lower;
+	if (passthrough) {
+		id = ioctl(fd, FUSE_DEV_IOC_PASSTHROUGH_OPEN, &arg);
+		if (id < 0)
+			die("FUSE_DEV_IOC_PASSTHROUGH_OPEN");
+		open_out->open_flags = FOPEN_PASSTHROUGH;
+		open_out->passthrough_id = id;
+	}
+}
+
+static void put_open(int fd, struct fuse_open_out *open_out)
+{
+	__u32 arg = open_out->passthrough_id;
+
+	if ((open_out->open_flags & FOPEN_PASSTHROUGH) &&
+	    ioctl(fd, FUSE_DEV_IOC_PASSTHROUGH_CLOSE, &arg))
+		die("FUSE_DEV_IOC_PASSTHROUGH_CLOSE");
+}
+
+/*
+ * With the writeback cache the kernel reads pages of files opened for
+ * writing only, and places appends itself.
+ */
+static int lower_flags(int flags)
+{
+	if (!writeback_cache)
+		return flags;
+	if ((flags & O_ACCMODE) == O_WRONLY)
+		flags = (flags & ~O_ACCMODE) | O_RDWR;
+	return flags & ~O_APPEND;
+}
+
+static void do_init(int fd, struct fuse_in_header *in, void *arg)
+{
+	struct fuse_init_in *init_in = arg;
+	struct fuse_init_out init_out;
+
+	if (init_in->major != FUSE_KERNEL_VERSION) {
+		fprintf(stderr, "unsupported protocol %u.%u\n",
+			init_in->major, init_in->minor);
+		exit(1);
+	}
+	if (passthrough && !(init_in->flags & FUSE_PASSTHROUGH)) {
+		fprintf(stderr, "the kernel does not support passthrough\n");
+		exit(1);
+	}
+	if (writeback_cache && !(init_in->flags & FUSE_WRITEBACK_CACHE)) {
+		fprintf(stderr, "the kernel does not support writeback cache\n");
+		exit(1);
+	}
+
+	memset(&init_out, 0, sizeof(init_out));
+	init_out.major = FUSE_KERNEL_VERSION;
+	init_out.minor = FUSE_KERNEL_MINOR_VERSION;
+	init_out.max_readahead = init_in->max_readahead;
+	init_out.flags = FUSE_ASYNC_READ | FUSE_BIG_WRITES;
+	if (passthrough)
+		init_out.flags |= FUSE_PASSTHROUGH;
+	if (writeback_cache)
+		init_out.flags |= FUSE_WRITEBACK_CACHE;
+	init_out.max_background = 12;
+	init_out.congestion_threshold = 9;
+	init_out.max_write = MAX_WRITE;
+	send_reply(fd, in, 0, &init_out, sizeof(init_out));
+}
+
+static void set_time(struct timespec *ts, __u32 valid, __u32 set,
+		     __u32 now, __u64 sec, __u32 nsec)
+{
+	if (!(valid & set)) {
+		ts->tv_nsec = UTIME_OMIT;
+	} else if (valid & now) {
+		ts->tv_nsec = UTIME_NOW;
+	} else {
+		ts->tv_sec = sec;
+		ts->tv_nsec = nsec;
+	}
+}
+
+static void do_setattr(int fd, struct fuse_in_header *in, void *arg)
+{
+	struct fuse_setattr_in *setattr_in = arg;
+	const char *name = node_name(in->nodeid);
+	struct fuse_attr_out attr_out;
+	struct timespec ts[2];
+	struct stat st;
+	int err;
+
+	if (!name) {
+		send_reply(fd, in, -ENOENT, NULL, 0);
+		return;
+	}
+	if ((setattr_in->valid & FATTR_SIZE) &&
+	    (setattr_in->valid & FATTR_FH ?
+	     ftruncate(setattr_in->fh, setattr_in->size) :
+	     truncate(name, setattr_in->size))) {
+		send_reply(fd, in, -errno, NULL, 0);
+		return;
+	}
+	if ((setattr_in->valid & FATTR_MODE) &&
+	    fchmodat(lower_dir, name, setattr_in->mode & 07777, 0)) {
+		send_reply(fd, in, -errno, NULL, 0);
+		return;
+	}
+
+	/* the writeback cache sends the mtime of cached writes here */
+	set_time(&ts[0], setattr_in->valid, FATTR_ATIME, FATTR_ATIME_NOW,
+		 setattr_in->atime, setattr_in->atimensec);
+	set_time(&ts[1], setattr_in->valid, FATTR_MTIME, FATTR_MTIME_NOW,
+		 setattr_in->mtime, setattr_in->mtimensec);
+	if ((setattr_in->valid & (FATTR_ATIME | FATTR_MTIME)) &&
+	    utimensat(lower_dir, name, ts, 0)) {
+		send_reply(fd, in, -errno, NULL, 0);
+		return;
+	}
+
+	err = stat_node(in->nodeid, &st);
+	if (err) {
+		send_reply(fd, in, err, NULL, 0);
+		return;
+	}
+	memset(&attr_out, 0, sizeof(attr_out));
+	attr_out.attr_valid = 1;
+	fill_attr(&attr_out.attr, &st, in->nodeid);
+	send_reply(fd, in, 0, &attr_out, sizeof(attr_out));
+}
+
+static void do_request(int fd, struct fuse_in_header *in, void *arg)
+{
+	const char *name = node_name(in->nodeid);
+	struct stat st;
+	int err, lower;
+
+	switch (in->opcode) {
+	case FUSE_INIT:
+		do_init(fd, in, arg);
+		break;
+
+	case FUSE_FORGET:
+	case FUSE_BATCH_FORGET:
+		/* nodes are never freed, and forget takes no reply */
+		break;
+
+	case FUSE_LOOKUP: {
+		struct fuse_entry_out entry;
+
+		if (in->nodeid != FUSE_ROOT_ID) {
+			send_reply(fd, in, -ENOENT, NULL, 0);
+			break;
+		}
+		err = fill_entry(&entry, arg);
+		send_reply(fd, in, err, &entry, err ? 0 : sizeof(entry));
+		break;
+	}
+
+	case FUSE_GETATTR: {
+		struct fuse_attr_out attr_out;
+
+		err = stat_node(in->nodeid, &st);
+		if (err) {
+			send_reply(fd, in, err, NULL, 0);
+			break;
+		}
+		memset(&attr_out, 0, sizeof(attr_out));
+		attr_out.attr_valid = 1;
+		fill_attr(&attr_out.attr, &st, in->nodeid);
+		send_reply(fd, in, 0, &attr_out, sizeof(attr_out));
+		break;
+	}
+
+	case FUSE_SETATTR:
+		do_setattr(fd, in, arg);
+		break;
+
+	case FUSE_OPEN: {
+		struct fuse_open_in *open_in = arg;
+		struct fuse_open_out open_out;
+
+		if (!name || in->nodeid == FUSE_ROOT_ID) {
+			send_reply(fd, in, -ENOENT, NULL, 0);
+			break;
+		}
+		lower = openat(lower_dir, name,
+			       lower_flags(open_in->flags) & ~O_CREAT);
+		if (lower < 0) {
+			send_reply(fd, in, -errno, NULL, 0);
+			break;
+		}
+		fill_open(fd, &open_out, lower);
+		send_reply(fd, in, 0, &open_out, sizeof(open_out));
+		put_open(fd, &open_out);
+		break;
+	}
+
+	case FUSE_CREATE: {
+		struct fuse_create_in *create_in = arg;
+		const char *new_name = (char *)(create_in + 1);
+		struct {
+			struct fuse_entry_out entry;
+			struct fuse_open_out open;
+		} out;
+
+		if (in->nodeid != FUSE_ROOT_ID) {
+			send_reply(fd, in, -ENOENT, NULL, 0);
+			break;
+		}
+		lower = openat(lower_dir, new_name,
+			       lower_flags(create_in->flags),
+			       create_in->mode & ~create_in->umask);
+		if (lower < 0) {
+			send_reply(fd, in, -errno, NULL, 0);
+			break;
+		}
+		err = fill_entry(&out.entry, new_name);
+		if (err) {
+			close(lower);
+			send_reply(fd, in, err, NULL, 0);
+			break;
+		}
+		fill_open(fd, &out.open, lower);
+		send_reply(fd, in, 0, &out, sizeof(out));
+		put_open(fd, &out.open);
+		break;
+	}
+
+	case FUSE_READ: {
+		struct fuse_read_in *read_in = arg;
+		char *data = reply + sizeof(struct fuse_out_header);
+		ssize_t ret;
+
+		if (read_in->size > MAX_WRITE)
+			read_in->size = MAX_WRITE;
+		ret = pread(read_in->fh, data, read_in->size, read_in->offset);
+		if (ret < 0)
+			send_reply(fd, in, -errno, NULL, 0);
+		else
+			send_reply(fd, in, 0, data, ret);
+		break;
+	}
+
+	case FUSE_WRITE: {
+		struct fuse_write_in *write_in = arg;
+		struct fuse_write_out write_out;
+		ssize_t ret;
+
+		ret = pwrite(write_in->fh, write_in + 1, write_in->size,
+			     write_in->offset);
+		if (ret < 0) {
+			send_reply(fd, in, -errno, NULL, 0);
+			break;
+		}
+		memset(&write_out, 0, sizeof(write_out));
+		write_out.size = ret;
+		send_reply(fd, in, 0, &write_out, sizeof(write_out));
+		break;
+	}
+
+	case FUSE_FLUSH:
+		send_reply(fd, in, 0, NULL, 0);
+		break;
+
+	case FUSE_FSYNC: {
+		struct fuse_fsync_in *fsync_in = arg;
+
+		err = fsync(fsync_in->fh) ? -errno : 0;
+		send_reply(fd, in, err, NULL, 0);
+		break;
+	}
+
+	case FUSE_RELEASE: {
+		struct fuse_release_in *release_in = arg;
+
+		close(release_in->fh);
+		send_reply(fd, in, 0, NULL, 0);
+		break;
+	}
+
+	case FUSE_UNLINK:
+		if (in->nodeid != FUSE_ROOT_ID) {
+			send_reply(fd, in, -ENOENT, NULL, 0);
+			break;
+		}
+		err = unlinkat(lower_dir, arg, 0) ? -errno : 0;
+		send_reply(fd, in, err, NULL, 0);
+		break;
+
+	case FUSE_STATFS: {
+		struct fuse_statfs_out statfs_out;
+		struct statvfs sv;
+
+		if (fstatvfs(lower_dir, &sv)) {
+			send_reply(fd, in, -errno, NULL, 0);
+			break;
+		}
+		memset(&statfs_out, 0, sizeof(statfs_out));
+		statfs_out.st.blocks = sv.f_blocks;
+		statfs_out.st.bfree = sv.f_bfree;
+		statfs_out.st.bavail = sv.f_bavail;
+		statfs_out.st.files = sv.f_files;
+		statfs_out.st.ffree = sv.f_ffree;
+		statfs_out.st.bsize = sv.f_bsize;
+		statfs_out.st.namelen = sv.f_namemax;
+		statfs_out.st.frsize = sv.f_frsize;
+		send_reply(fd, in, 0, &statfs_out, sizeof(statfs_out));
+		break;
+	}
+
+	default:
+		send_reply(fd, in, -ENOSYS, NULL, 0);
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n] [-w] lowerdir mountpoint\n"
+		"  -n  serve reads and writes in the daemon, no passthrough\n"
+		"  -w  use the writeback cache\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	char opts[128];
+	struct stat st;
+	ssize_t ret;
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "nw")) != -1) {
+		switch (opt) {
+		case 'n':
+			passthrough = 0;
+			break;
+		case 'w':
+			writeback_cache = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 2)
+		usage(argv[0]);
+
+	lower_dir = open(argv[optind], O_RDONLY | O_DIRECTORY);
+	if (lower_dir < 0 || fchdir(lower_dir))
+		die(argv[optind]);
+
+	fd = open("/dev/fuse", O_RDWR);
+	if (fd < 0)
+		die("/dev/fuse");
+
+	if (fstat(lower_dir, &st))
+		die(argv[optind]);
+	snprintf(opts, sizeof(opts),
+		 "fd=%d,rootmode=%o,user_id=%u,group_id=%u,allow_other",
+		 fd, st.st_mode & S_IFMT, getuid(), getgid());
+	if (mount("fuse-passthrough-test", argv[optind + 1], "fuse",
+		  MS_NOSUID | MS_NODEV, opts))
+		die("mount");
+
+	for (;;) {
+		ret = read(fd, buf, sizeof(buf));
+		if (ret < 0) {
+			/* ENODEV: unmounted */
+			if (errno == ENODEV)
+				break;
+			if (errno == ENOENT || errno == EINTR)
+				continue;
+			die("read request");
+		}
+		do_request(fd, (struct fuse_in_header *)buf,
+			   buf + sizeof(struct fuse_in_header));
+	}
+	return 0;
+}
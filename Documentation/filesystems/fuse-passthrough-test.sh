@@ -0,0 +1,68 @@
+#!/bin/sh
+# fuse-passthrough-test.sh - dd throughput of FUSE with and without passthrough
+#
+# Mounts a directory of the lower filesystem through fuse-passthrough-test,
+# once with the daemon serving reads and writes and once with the I/O
+# passed through to the lower files, and times a dd write and a cold
+# cache dd read of the same file through each mount. The lower
+# filesystem itself is timed too, as the upper bound.
+#
+# usage: fuse-passthrough-test.sh lowerdir [MB]
+#
+# Needs root and fuse-passthrough-test built from fuse-passthrough-test.c
+# in the same directory.
+
+lower=$1
+mb=${2:-256}
+dir=$(cd "$(dirname "$0")" && pwd)
+daemon=$dir/fuse-passthrough-test
+mnt=$(mktemp -d)
+
+cleanup() {
+	umount "$mnt" 2>/dev/null
+	rmdir "$mnt"
+}
+trap cleanup EXIT
+
+[ -d "$lower" ] || { echo "usage: $0 lowerdir [MB]" >&2; exit 1; }
+[ -x "$daemon" ] || { echo "build $daemon first" >&2; exit 1; }
+
+# the MB/s figure on the last line of dd's report
+rate() {
+	tail -n 1 | sed 's/.*, //'
+}
+
+run() {
+	name=$1
+	target=$2
+
+	write=$(dd if=/dev/zero of="$target/fuse-passthrough-test.dat" \
+		bs=1M count="$mb" conv=fsync 2>&1 | rate)
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+	read=$(dd if="$target/fuse-passthrough-test.dat" of=/dev/null \
+		bs=1M 2>&1 | rate)
+	rm -f "$target/fuse-passthrough-test.dat"
+	printf "%-12s write %12s   read %12s\n" "$name" "$write" "$read"
+}
+
+mount_fuse() {
+	"$daemon" "$@" "$lower" "$mnt" &
+	while ! grep -q " $mnt fuse" /proc/mounts; do
+		kill -0 $! 2>/dev/null || exit 1
+		sleep 0.1
+	done
+}
+
+echo "$mb MB through $lower"
+run lower "$lower"
+
+mount_fuse -n
+run fuse "$mnt"
+umount "$mnt"
+wait
+
+mount_fuse
+run passthrough "$mnt"
+umount "$mnt"
+wait
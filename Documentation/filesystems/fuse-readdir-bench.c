@@ -0,0 +1,459 @@
+/*
+ * fuse-readdir-bench.c - ls -l of a large directory over FUSE
+ *
+ * Mounts a FUSE filesystem with one directory of the given number of
+ * files, served from memory, and lists it the way ls -l does, reading all
+ * the entries and then doing an lstat of each, a few times over. Before
+ * each run the dentries are dropped, as if the directory was scanned for
+ * the first time. For each run the time is reported, and the requests it
+ * took: with READDIR one LOOKUP per entry, with READDIRPLUS none.
+ *
+ * The -m option picks what the filesystem offers at INIT: none for READDIR
+ * only, plus for READDIRPLUS always, auto for READDIRPLUS with the kernel
+ * deciding when to use it. Compare the three on 10000 entries:
+ *
+ *	fuse-readdir-bench -m none /mnt/fuse
+ *	fuse-readdir-bench -m plus /mnt/fuse
+ *	fuse-readdir-bench -m auto /mnt/fuse
+ *
+ * With -s the entries are not stat'ed, as with plain ls, which shows what
+ * READDIRPLUS costs when the attributes are not wanted.
+ *
+ * Mounting and dropping the dentries need root, and the program is built
+ * against the headers of this kernel:
+ *
+ *	make headers_install INSTALL_HDR_PATH=/tmp/hdr
+ *	gcc -I/tmp/hdr/include -pthread -o fuse-readdir-bench \
+ *		fuse-readdir-bench.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <linux/fuse.h>
+
+#define NSEC_PER_SEC	1000000000ULL
+#define MAX_WRITE	(128 * 1024)
+#define FIRST_NODEID	(FUSE_ROOT_ID + 1)
+/* "." and ".." come first in the listing */
+#define NR_DOTS		2
+
+static unsigned int nr_files = 10000;
+static unsigned int nr_runs = 3;
+static unsigned int timeout = 60;
+static const char *mode = "auto";
+static int do_stat = 1;
+static const char *mnt;
+static int mount_fd;
+
+/* requests of the current run, only the daemon thread counts */
+static volatile unsigned long nr_lookup, nr_getattr, nr_readdir,
+	nr_readdirplus;
+
+static char buf[MAX_WRITE + 4096];
+static char reply[MAX_WRITE + 4096];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void send_reply(struct fuse_in_header *in, int error, const void *arg,
+		       size_t size)
+{
+	struct fuse_out_header *out = (struct fuse_out_header *)reply;
+
+	out->len = sizeof(*out) + size;
+	out->error = error;
+	out->unique = in->unique;
+	if (size && arg != reply + sizeof(*out))
+		memcpy(reply + sizeof(*out), arg, size);
+
+	/* ENOENT: the request was interrupted and is gone */
+	if (write(mount_fd, reply, out->len) < 0 && errno != ENOENT)
+		die("write reply");
+}
+
+/* nodes are the root and the files IMG_00000.jpg and on, all made up */
+static void file_name(char *name, unsigned int i)
+{
+	sprintf(name, "IMG_%05u.jpg", i);
+}
+
+static void fill_attr(struct fuse_attr *attr, __u64 nodeid)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->ino = nodeid;
+	attr->nlink = 1;
+	attr->blksize = 4096;
+	if (nodeid == FUSE_ROOT_ID) {
+		attr->mode = S_IFDIR | 0755;
+		attr->nlink = 2;
+	} else {
+		attr->mode = S_IFREG | 0644;
+		attr->size = 1024 * 1024 + nodeid;
+		attr->blocks = (attr->size + 511) / 512;
+	}
+}
+
+static void fill_entry(struct fuse_entry_out *entry, __u64 nodeid)
+{
+	memset(entry, 0, sizeof(*entry));
+	entry->nodeid = nodeid;
+	entry->entry_valid = timeout;
+	entry->attr_valid = timeout;
+	fill_attr(&entry->attr, nodeid);
+}
+
+static int valid_node(__u64 nodeid)
+{
+	return nodeid == FUSE_ROOT_ID ||
+	       (nodeid >= FIRST_NODEID && nodeid < FIRST_NODEID + nr_files);
+}
+
+static void do_init(struct fuse_in_header *in, void *arg)
+{
+	struct fuse_init_in *init_in = arg;
+	struct fuse_init_out init_out;
+
+	if (init_in->major != FUSE_KERNEL_VERSION) {
+		fprintf(stderr, "unsupported protocol %u.%u\n",
+			init_in->major, init_in->minor);
+		exit(1);
+	}
+	if (strcmp(mode, "none") && !(init_in->flags & FUSE_DO_READDIRPLUS)) {
+		fprintf(stderr, "kernel does not offer readdirplus\n");
+		exit(1);
+	}
+
+	memset(&init_out, 0, sizeof(init_out));
+	init_out.major = FUSE_KERNEL_VERSION;
+	init_out.minor = FUSE_KERNEL_MINOR_VERSION;
+	init_out.max_readahead = init_in->max_readahead;
+	init_out.flags = FUSE_ASYNC_READ | FUSE_BIG_WRITES;
+	if (!strcmp(mode, "plus"))
+		init_out.flags |= FUSE_DO_READDIRPLUS;
+	else if (!strcmp(mode, "auto"))
+		init_out.flags |= FUSE_DO_READDIRPLUS | FUSE_READDIRPLUS_AUTO;
+	init_out.max_background = 12;
+	init_out.congestion_threshold = 9;
+	init_out.max_write = MAX_WRITE;
+	send_reply(in, 0, &init_out, sizeof(init_out));
+}
+
+/*
+ * Entry at offset off of the listing: "." and "..", then the files.  The
+ * offset of an entry in the reply is that of the one after it.
+ */
+static void do_readdir(struct fuse_in_header *in, struct fuse_read_in *read_in,
+		       int plus)
+{
+	char *data = reply + sizeof(struct fuse_out_header);
+	size_t size = 0, reclen;
+	__u64 off;
+
+	for (off = read_in->offset; off < NR_DOTS + nr_files; off++) {
+		struct fuse_direntplus *direntplus = (void *)(data + size);
+		struct fuse_dirent *dirent;
+		__u64 nodeid;
+
+		dirent = plus ? &direntplus->dirent : (void *)(data + size);
+		if (off < NR_DOTS) {
+			nodeid = FUSE_ROOT_ID;
+			dirent->namelen = off + 1;
+			memcpy(dirent->name, "..", dirent->namelen);
+		} else {
+			nodeid = FIRST_NODEID + off - NR_DOTS;
+			dirent->namelen = 13;
+		}
+
+		reclen = plus ? FUSE_DIRENTPLUS_SIZE(direntplus) :
+				FUSE_DIRENT_SIZE(dirent);
+		if (size + reclen > read_in->size)
+			break;
+
+		if (off >= NR_DOTS) {
+			char name[32];
+
+			file_name(name, off - NR_DOTS);
+			memcpy(dirent->name, name, dirent->namelen);
+		}
+		dirent->ino = nodeid;
+		dirent->off = off + 1;
+		dirent->type = off < NR_DOTS ? DT_DIR : DT_REG;
+		if (plus) {
+			/* no lookup is counted for "." and ".." */
+			if (off < NR_DOTS)
+				memset(&direntplus->entry_out, 0,
+				       sizeof(direntplus->entry_out));
+			else
+				fill_entry(&direntplus->entry_out, nodeid);
+		}
+		/* zero the padding */
+		memset(dirent->name + dirent->namelen, 0,
+		       reclen - (dirent->name + dirent->namelen -
+				 (data + size)));
+		size += reclen;
+	}
+	send_reply(in, 0, data, size);
+}
+
+static void do_request(struct fuse_in_header *in, void *arg)
+{
+	switch (in->opcode) {
+	case FUSE_INIT:
+		do_init(in, arg);
+		break;
+
+	case FUSE_FORGET:
+	case FUSE_BATCH_FORGET:
+	case FUSE_INTERRUPT:
+		/* these take no reply */
+		break;
+
+	case FUSE_LOOKUP: {
+		struct fuse_entry_out entry;
+		char name[32];
+		unsigned int i;
+
+		nr_lookup++;
+		if (in->nodeid != FUSE_ROOT_ID ||
+		    sscanf(arg, "IMG_%u.jpg", &i) != 1 || i >= nr_files) {
+			send_reply(in, -ENOENT, NULL, 0);
+			break;
+		}
+		file_name(name, i);
+		if (strcmp(arg, name)) {
+			send_reply(in, -ENOENT, NULL, 0);
+			break;
+		}
+		fill_entry(&entry, FIRST_NODEID + i);
+		send_reply(in, 0, &entry, sizeof(entry));
+		break;
+	}
+
+	case FUSE_GETATTR: {
+		struct fuse_attr_out attr_out;
+
+		nr_getattr++;
+		if (!valid_node(in->nodeid)) {
+			send_reply(in, -ENOENT, NULL, 0);
+			break;
+		}
+		memset(&attr_out, 0, sizeof(attr_out));
+		attr_out.attr_valid = timeout;
+		fill_attr(&attr_out.attr, in->nodeid);
+		send_reply(in, 0, &attr_out, sizeof(attr_out));
+		break;
+	}
+
+	case FUSE_OPENDIR: {
+		struct fuse_open_out open_out;
+
+		if (in->nodeid != FUSE_ROOT_ID) {
+			send_reply(in, -ENOTDIR, NULL, 0);
+			break;
+		}
+		memset(&open_out, 0, sizeof(open_out));
+		send_reply(in, 0, &open_out, sizeof(open_out));
+		break;
+	}
+
+	case FUSE_READDIR:
+		nr_readdir++;
+		do_readdir(in, arg, 0);
+		break;
+
+	case FUSE_READDIRPLUS:
+		nr_readdirplus++;
+		do_readdir(in, arg, 1);
+		break;
+
+	case FUSE_RELEASEDIR:
+		send_reply(in, 0, NULL, 0);
+		break;
+
+	default:
+		send_reply(in, -ENOSYS, NULL, 0);
+	}
+}
+
+static void *daemon_thread(void *arg)
+{
+	ssize_t ret;
+
+	for (;;) {
+		ret = read(mount_fd, buf, sizeof(buf));
+		if (ret < 0) {
+			/* ENODEV: unmounted */
+			if (errno == ENODEV)
+				break;
+			if (errno == ENOENT || errno == EINTR)
+				continue;
+			die("read request");
+		}
+		do_request((struct fuse_in_header *)buf,
+			   buf + sizeof(struct fuse_in_header));
+	}
+	return NULL;
+}
+
+static void drop_dentries(void)
+{
+	int fd;
+
+	fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if (fd < 0 || write(fd, "2", 1) != 1)
+		die("/proc/sys/vm/drop_caches");
+	close(fd);
+}
+
+/* read the whole directory, then lstat every entry, like ls -l */
+static unsigned int list(void)
+{
+	static char (*names)[NAME_MAX + 1];
+	unsigned int nr = 0, i;
+	struct dirent *de;
+	struct stat st;
+	DIR *dir;
+
+	if (!names)
+		names = malloc((NR_DOTS + nr_files) * sizeof(*names));
+	if (!names)
+		die("malloc");
+
+	dir = opendir(mnt);
+	if (!dir)
+		die(mnt);
+	while ((de = readdir(dir))) {
+		if (nr == NR_DOTS + nr_files) {
+			fprintf(stderr, "%s: too many entries\n", mnt);
+			exit(1);
+		}
+		strcpy(names[nr++], de->d_name);
+	}
+
+	if (do_stat) {
+		for (i = 0; i < nr; i++)
+			if (fstatat(dirfd(dir), names[i], &st,
+				    AT_SYMLINK_NOFOLLOW))
+				die(names[i]);
+	}
+	closedir(dir);
+	return nr;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n files] [-r runs] [-m none|plus|auto] [-t secs] "
+		"[-s] mountpoint\n"
+		"  -n  files in the directory, default %u\n"
+		"  -r  number of listings, default %u\n"
+		"  -m  readdirplus offered at INIT, default %s\n"
+		"  -t  entry and attribute timeout, default %u seconds\n"
+		"  -s  only list, don't stat the entries\n",
+		prog, nr_files, nr_runs, mode, timeout);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t daemon;
+	uint64_t start, end;
+	unsigned int i, nr;
+	char opts[128];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:m:t:s")) != -1) {
+		switch (opt) {
+		case 'n':
+			nr_files = atoi(optarg);
+			break;
+		case 'r':
+			nr_runs = atoi(optarg);
+			break;
+		case 'm':
+			mode = optarg;
+			break;
+		case 't':
+			timeout = atoi(optarg);
+			break;
+		case 's':
+			do_stat = 0;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !nr_files || nr_files > 100000 ||
+	    !nr_runs || (strcmp(mode, "none") && strcmp(mode, "plus") &&
+			 strcmp(mode, "auto")))
+		usage(argv[0]);
+	mnt = argv[optind];
+
+	mount_fd = open("/dev/fuse", O_RDWR);
+	if (mount_fd < 0)
+		die("/dev/fuse");
+
+	snprintf(opts, sizeof(opts),
+		 "fd=%d,rootmode=%o,user_id=%u,group_id=%u",
+		 mount_fd, S_IFDIR, getuid(), getgid());
+	if (mount("fuse-readdir-bench", mnt, "fuse", MS_NOSUID | MS_NODEV,
+		  opts))
+		die("mount");
+
+	if (pthread_create(&daemon, NULL, daemon_thread, NULL))
+		die("pthread_create");
+
+	printf("%u files, readdirplus %s, %s\n", nr_files, mode,
+	       do_stat ? "ls -l" : "ls");
+	for (i = 1; i <= nr_runs; i++) {
+		drop_dentries();
+		nr_lookup = nr_getattr = nr_readdir = nr_readdirplus = 0;
+
+		start = now_ns();
+		nr = list();
+		end = now_ns();
+
+		if (nr != NR_DOTS + nr_files) {
+			fprintf(stderr, "%s: %u entries listed\n", mnt, nr);
+			exit(1);
+		}
+		printf("run %u  %8.3f s  readdir %5lu  readdirplus %5lu  "
+		       "lookup %6lu  getattr %6lu\n", i,
+		       (double)(end - start) / NSEC_PER_SEC, nr_readdir,
+		       nr_readdirplus, nr_lookup, nr_getattr);
+	}
+
+	if (umount(mnt))
+		die("umount");
+	pthread_join(daemon, NULL);
+	return 0;
+}
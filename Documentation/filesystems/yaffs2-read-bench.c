@@ -0,0 +1,205 @@
+/*
+ * yaffs2-read-bench.c - sequential and random read throughput of a file
+ *
+ * Writes a test file of the given size, unless it already has that size,
+ * then times with a cold page cache between them:
+ *
+ *	seq	read the whole file in order, 64 KB at a time
+ *	random	read 4 KB pages at random offsets
+ *
+ * Large files on yaffs2 have deep tnode trees, so this shows the cost of
+ * mapping file chunks to NAND chunks. On nandsim, as a 128 MB device with
+ * 2 KB pages, compare a mount with the tnode cache and one without:
+ *
+ *	modprobe nandsim first_id_byte=0x20 second_id_byte=0xaa \
+ *		third_id_byte=0x00 fourth_id_byte=0x15
+ *	mount -t yaffs2 /dev/mtdblock0 /mnt/yaffs
+ *	yaffs2-read-bench -s 64 /mnt/yaffs/bench
+ *	umount /mnt/yaffs
+ *	mount -t yaffs2 -o no-tnode-cache /dev/mtdblock0 /mnt/yaffs
+ *	yaffs2-read-bench -s 64 /mnt/yaffs/bench
+ *
+ * The tnode_cache_hits and tnode_cache_misses counters in /proc/yaffs show
+ * how many lookups were served without walking the tree.
+ *
+ * Dropping the caches needs root; with -n the caches are left warm.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define NSEC_PER_SEC	1000000000ULL
+#define SEQ_BUF_SIZE	(64 * 1024)
+#define RAND_BUF_SIZE	4096
+
+static unsigned int size_mb = 32;
+static unsigned int nr_random = 2000;
+static int drop_caches = 1;
+static const char *path;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void die(const char *what, const char *name)
+{
+	fprintf(stderr, "%s %s: %s\n", what, name, strerror(errno));
+	exit(1);
+}
+
+static void cold_cache(void)
+{
+	int fd;
+
+	sync();
+	if (!drop_caches)
+		return;
+
+	fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if (fd < 0 || write(fd, "3", 1) != 1)
+		die("cannot drop caches via", "/proc/sys/vm/drop_caches");
+	close(fd);
+}
+
+static void create_file(off_t size)
+{
+	static char buf[SEQ_BUF_SIZE];
+	struct stat st;
+	off_t done;
+	int fd;
+
+	if (!stat(path, &st) && st.st_size == size)
+		return;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		die("cannot create", path);
+
+	for (done = 0; done < size; done += sizeof(buf)) {
+		memset(buf, (int)(done / sizeof(buf)), sizeof(buf));
+		if (write(fd, buf, sizeof(buf)) != sizeof(buf))
+			die("cannot write", path);
+	}
+	if (fsync(fd))
+		die("cannot fsync", path);
+	close(fd);
+}
+
+static double seq_read(off_t size)
+{
+	static char buf[SEQ_BUF_SIZE];
+	uint64_t start;
+	ssize_t ret;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		die("cannot open", path);
+
+	start = now_ns();
+	while ((ret = read(fd, buf, sizeof(buf))) > 0)
+		;
+	if (ret < 0)
+		die("cannot read", path);
+	close(fd);
+
+	return (double)size / (1024 * 1024) /
+	       ((double)(now_ns() - start) / NSEC_PER_SEC);
+}
+
+static double random_read(off_t size)
+{
+	static char buf[RAND_BUF_SIZE];
+	off_t nr_pages = size / RAND_BUF_SIZE;
+	uint64_t start;
+	unsigned int i;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		die("cannot open", path);
+
+	/* the same offsets on every run, so that runs compare */
+	srandom(1);
+	start = now_ns();
+	for (i = 0; i < nr_random; i++) {
+		off_t off = (random() % nr_pages) * RAND_BUF_SIZE;
+
+		if (pread(fd, buf, sizeof(buf), off) != sizeof(buf))
+			die("cannot read", path);
+	}
+	close(fd);
+
+	return nr_random / ((double)(now_ns() - start) / NSEC_PER_SEC);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-s MB] [-r reads] [-n] file\n"
+		"  -s  file size, default %u MB\n"
+		"  -r  number of random 4 KB reads, default %u\n"
+		"  -n  do not drop the caches between phases\n",
+		prog, size_mb, nr_random);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	off_t size;
+	double seq, rnd;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:r:n")) != -1) {
+		switch (opt) {
+		case 's':
+			size_mb = atoi(optarg);
+			break;
+		case 'r':
+			nr_random = atoi(optarg);
+			break;
+		case 'n':
+			drop_caches = 0;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind != argc - 1 || !size_mb || !nr_random)
+		usage(argv[0]);
+	path = argv[optind];
+	size = (off_t)size_mb * 1024 * 1024;
+
+	create_file(size);
+
+	cold_cache();
+	seq = seq_read(size);
+
+	cold_cache();
+	rnd = random_read(size);
+
+	printf("file %s, %u MB\n", path, size_mb);
+	printf("seq     %8.2f MB/s\n", seq);
+	printf("random  %8.0f reads/s (%.2f MB/s)\n", rnd,
+	       rnd * RAND_BUF_SIZE / (1024 * 1024));
+	return 0;
+}
@@ -0,0 +1,275 @@
+/*
+ * sched-deadline-test.c - competing periodic tasks under SCHED_DEADLINE
+ *
+ * Runs one thread per task given on the command line. Each thread
+ * releases a job every period, burns the job's execution time of cpu,
+ * and counts the jobs that complete after their release plus deadline.
+ * The threads are SCHED_DEADLINE with the runtime, deadline and period
+ * given, or with -f SCHED_FIFO with priorities in command line order,
+ * to compare how one task that overruns affects the others.
+ *
+ * Task format, all times in us, exec defaults to 90% of the runtime:
+ *
+ *	runtime:deadline:period[:exec]
+ *
+ * For example, three media threads, the last of which overruns its
+ * reservation; with SCHED_DEADLINE only that one misses deadlines:
+ *
+ *	sched-deadline-test -d 10 2000:10000:10000 5000:16666:16666 \
+ *		8000:33333:33333:20000
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE	6
+#endif
+
+/* fallback syscall numbers for C libraries that predate sched_setattr */
+#ifndef __NR_sched_setattr
+#if defined(__arm__)
+#define __NR_sched_setattr	380
+#define __NR_sched_getattr	381
+#elif defined(__x86_64__)
+#define __NR_sched_setattr	314
+#define __NR_sched_getattr	315
+#elif defined(__i386__)
+#define __NR_sched_setattr	351
+#define __NR_sched_getattr	352
+#else
+#error "sched_setattr syscall number unknown for this architecture"
+#endif
+#endif
+
+struct sched_attr {
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+};
+
+#define MAX_TASKS	16
+#define NSEC_PER_USEC	1000ULL
+#define NSEC_PER_SEC	1000000000ULL
+
+struct task {
+	int id;
+	uint64_t runtime, deadline, period, exec;	/* ns */
+	int fifo_prio;
+
+	unsigned long jobs, misses;
+	uint64_t max_lateness;				/* ns */
+	int error;
+};
+
+static struct task tasks[MAX_TASKS];
+static int nr_tasks;
+static int use_fifo;
+static unsigned int duration = 5;
+static volatile int done;
+
+static uint64_t ts_to_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static void ns_to_ts(uint64_t ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / NSEC_PER_SEC;
+	ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+static uint64_t now_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts_to_ns(&ts);
+}
+
+/* busy loop until this thread consumed @ns more cpu time */
+static void burn(uint64_t ns)
+{
+	uint64_t end = now_ns(CLOCK_THREAD_CPUTIME_ID) + ns;
+
+	while (now_ns(CLOCK_THREAD_CPUTIME_ID) < end)
+		;
+}
+
+static int set_policy(struct task *t)
+{
+	struct sched_attr attr;
+
+	if (use_fifo) {
+		struct sched_param param = { .sched_priority = t->fifo_prio };
+
+		return pthread_setschedparam(pthread_self(), SCHED_FIFO,
+					     &param);
+	}
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.sched_policy = SCHED_DEADLINE;
+	attr.sched_runtime = t->runtime;
+	attr.sched_deadline = t->deadline;
+	attr.sched_period = t->period;
+
+	if (syscall(__NR_sched_setattr, 0, &attr, 0))
+		return errno;
+	return 0;
+}
+
+static void *task_thread(void *arg)
+{
+	struct task *t = arg;
+	struct timespec ts;
+	uint64_t release, finish;
+
+	t->error = set_policy(t);
+	if (t->error)
+		return NULL;
+
+	release = now_ns(CLOCK_MONOTONIC);
+	while (!done) {
+		burn(t->exec);
+
+		finish = now_ns(CLOCK_MONOTONIC);
+		t->jobs++;
+		if (finish > release + t->deadline) {
+			t->misses++;
+			if (finish - release - t->deadline > t->max_lateness)
+				t->max_lateness = finish - release - t->deadline;
+		}
+
+		/* skip the releases that a late job already overlapped */
+		do {
+			release += t->period;
+		} while (release < finish);
+
+		ns_to_ts(release, &ts);
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+
+	return NULL;
+}
+
+static int parse_task(const char *arg, struct task *t)
+{
+	unsigned long long runtime, deadline, period, exec = 0;
+	int n;
+
+	n = sscanf(arg, "%llu:%llu:%llu:%llu", &runtime, &deadline, &period,
+		   &exec);
+	if (n < 3 || !runtime || runtime > deadline || deadline > period)
+		return -1;
+	if (n == 3)
+		exec = runtime * 9 / 10;
+
+	t->runtime = runtime * NSEC_PER_USEC;
+	t->deadline = deadline * NSEC_PER_USEC;
+	t->period = period * NSEC_PER_USEC;
+	t->exec = exec * NSEC_PER_USEC;
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-d seconds] [-f] runtime:deadline:period[:exec] ...\n"
+		"  times in us, exec defaults to 90%% of runtime\n"
+		"  -d  test duration, default %u s\n"
+		"  -f  use SCHED_FIFO, priorities in command line order\n",
+		prog, duration);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t threads[MAX_TASKS];
+	unsigned long total_misses = 0;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "d:f")) != -1) {
+		switch (opt) {
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'f':
+			use_fifo = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind == argc || argc - optind > MAX_TASKS)
+		usage(argv[0]);
+
+	for (i = optind; i < argc; i++) {
+		struct task *t = &tasks[nr_tasks];
+
+		if (parse_task(argv[i], t)) {
+			fprintf(stderr, "bad task '%s'\n", argv[i]);
+			usage(argv[0]);
+		}
+		t->id = nr_tasks;
+		t->fifo_prio = 90 - nr_tasks;
+		nr_tasks++;
+	}
+
+	for (i = 0; i < nr_tasks; i++) {
+		if (pthread_create(&threads[i], NULL, task_thread, &tasks[i])) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+
+	sleep(duration);
+	done = 1;
+
+	for (i = 0; i < nr_tasks; i++)
+		pthread_join(threads[i], NULL);
+
+	printf("policy %s, %u s\n", use_fifo ? "SCHED_FIFO" : "SCHED_DEADLINE",
+	       duration);
+	printf("task  runtime deadline   period     exec     jobs   misses"
+	       "  max late\n");
+	for (i = 0; i < nr_tasks; i++) {
+		struct task *t = &tasks[i];
+
+		if (t->error) {
+			printf("%4d  cannot set policy: %s\n", t->id,
+			       strerror(t->error));
+			continue;
+		}
+		printf("%4d %8llu %8llu %8llu %8llu %8lu %8lu %9llu\n", t->id,
+		       (unsigned long long)(t->runtime / NSEC_PER_USEC),
+		       (unsigned long long)(t->deadline / NSEC_PER_USEC),
+		       (unsigned long long)(t->period / NSEC_PER_USEC),
+		       (unsigned long long)(t->exec / NSEC_PER_USEC),
+		       t->jobs, t->misses,
+		       (unsigned long long)(t->max_lateness / NSEC_PER_USEC));
+		total_misses += t->misses;
+	}
+
+	return total_misses ? 2 : 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * OMAP4 load based DVFS for the IVA, DSP and GPU
+ *
+ * The load of each device is the share of time it spent enabled through
+ * omap_device_enable() since the previous devfreq poll. The frequency
+ * chosen by the devfreq governor is requested with omap_device_scale(),
+ * on behalf of the devfreq device, so that it is arbitrated with the
+ * requests the device drivers make themselves.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/err.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/opp.h>
+#include <linux/devfreq.h>
+#include <linux/platform_device.h>
+
+#include <plat/cpu.h>
+#include <plat/omap_hwmod.h>
+#include <plat/omap_device.h>
+
+#include <mach/omap4-common.h>
+
+#include "dvfs.h"
+
+#define OMAP4_DEVFREQ_POLLING_MS	100
+
+struct omap4_devfreq {
+	const char		*oh_name;
+	struct device		*dev;
+	struct devfreq		*devfreq;
+	struct devfreq_dev_profile profile;
+	unsigned long		cur_freq;
+	unsigned long		min_freq;
+	bool			cascade_blocked;
+	u64			last_enabled_ns;
+	ktime_t			last_stamp;
+};
+
+static struct omap4_devfreq omap4_devfreqs[] = {
+	{ .oh_name = "iva" },
+	{ .oh_name = "dsp_c0" },
+	{ .oh_name = "gpu" },
+};
+
+static struct omap4_devfreq *omap4_devfreq_find(struct device *dev)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(omap4_devfreqs); i++)
+		if (omap4_devfreqs[i].dev == dev)
+			return &omap4_devfreqs[i];
+	return NULL;
+}
+
+/*
+ * DVFS is locked out while the DPLLs are in the low power cascade, so
+ * like cpufreq, keep them out of it while running above the lowest OPP.
+ */
+static void omap4_devfreq_block_cascade(struct omap4_devfreq *odf, bool block)
+{
+#ifdef CONFIG_OMAP4_DPLL_CASCADING
+	if (block == odf->cascade_blocked)
+		return;
+
+	if (block)
+		omap4_dpll_cascading_blocker_hold(odf->dev);
+	else
+		omap4_dpll_cascading_blocker_release(odf->dev);
+	odf->cascade_blocked = block;
+#endif
+}
+
+static int omap4_devfreq_target(struct device *dev, unsigned long *freq)
+{
+	struct omap4_devfreq *odf = omap4_devfreq_find(dev);
+	struct opp *opp;
+	unsigned long rate;
+	int ret;
+
+	/* polling may start before devfreq_add_device() has returned */
+	if (!odf || IS_ERR_OR_NULL(odf->devfreq))
+		return -EAGAIN;
+
+	rcu_read_lock();
+	opp = devfreq_recommended_opp(dev, freq);
+	if (IS_ERR(opp)) {
+		rcu_read_unlock();
+		return PTR_ERR(opp);
+	}
+	rate = opp_get_freq(opp);
+	rcu_read_unlock();
+
+	ret = 0;
+	if (rate != odf->cur_freq) {
+		omap4_devfreq_block_cascade(odf, rate > odf->min_freq);
+		ret = omap_device_scale(&odf->devfreq->dev, dev, rate);
+		if (ret) {
+			rate = odf->cur_freq;
+			omap4_devfreq_block_cascade(odf, rate > odf->min_freq);
+		}
+		/* PM is not ready yet, retry at next poll */
+		if (ret == -EBUSY) {
+			dev_dbg(dev, "%s: DVFS busy\n", __func__);
+			ret = 0;
+		}
+	}
+	if (ret)
+		return ret;
+
+	odf->cur_freq = rate;
+	*freq = rate;
+	return 0;
+}
+
+static int omap4_devfreq_get_dev_status(struct device *dev,
+					struct devfreq_dev_status *stat)
+{
+	struct omap4_devfreq *odf = omap4_devfreq_find(dev);
+	u64 enabled_ns, busy_ns, total_ns;
+	ktime_t now;
+
+	if (!odf)
+		return -ENODEV;
+
+	now = ktime_get();
+	enabled_ns = omap_device_get_enabled_time(to_platform_device(dev));
+	total_ns = ktime_to_ns(ktime_sub(now, odf->last_stamp));
+	busy_ns = min(enabled_ns - odf->last_enabled_ns, total_ns);
+	odf->last_stamp = now;
+	odf->last_enabled_ns = enabled_ns;
+
+	stat->total_time = div_u64(total_ns, NSEC_PER_USEC);
+	stat->busy_time = div_u64(busy_ns, NSEC_PER_USEC);
+	stat->current_frequency = odf->cur_freq;
+	return 0;
+}
+
+static int __init omap4_devfreq_register(struct omap4_devfreq *odf)
+{
+	struct device *dev;
+	unsigned long freq = 0;
+	struct opp *opp;
+
+	dev = omap_hwmod_name_get_dev(odf->oh_name);
+	if (IS_ERR_OR_NULL(dev))
+		return -ENODEV;
+
+	/* the driver's own requests keep the rate at or above the lowest OPP */
+	rcu_read_lock();
+	opp = opp_find_freq_ceil(dev, &freq);
+	rcu_read_unlock();
+	if (IS_ERR(opp))
+		return PTR_ERR(opp);
+
+	odf->dev = dev;
+	odf->cur_freq = freq;
+	odf->min_freq = freq;
+	odf->last_stamp = ktime_get();
+	odf->last_enabled_ns =
+		omap_device_get_enabled_time(to_platform_device(dev));
+
+	odf->profile.initial_freq = freq;
+	odf->profile.polling_ms = OMAP4_DEVFREQ_POLLING_MS;
+	odf->profile.target = omap4_devfreq_target;
+	odf->profile.get_dev_status = omap4_devfreq_get_dev_status;
+
+	odf->devfreq = devfreq_add_device(dev, &odf->profile,
+					  "simple_ondemand", NULL);
+	if (IS_ERR(odf->devfreq))
+		return PTR_ERR(odf->devfreq);
+
+	return 0;
+}
+
+static int __init omap4_devfreq_init(void)
+{
+	int i, ret;
+
+	if (!cpu_is_omap44xx())
+		return -ENODEV;
+
+	for (i = 0; i < ARRAY_SIZE(omap4_devfreqs); i++) {
+		ret = omap4_devfreq_register(&omap4_devfreqs[i]);
+		if (ret)
+			pr_warn("%s: no devfreq for %s: %d\n", __func__,
+				omap4_devfreqs[i].oh_name, ret);
+	}
+	return 0;
+}
+late_initcall(omap4_devfreq_init);
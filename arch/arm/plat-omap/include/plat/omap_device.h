@@ -33,6 +33,7 @@
 
 #include <linux/kernel.h>
 #include <linux/platform_device.h>
+#include <linux/ktime.h>
 
 #include <plat/omap_hwmod.h>
 
@@ -73,6 +74,8 @@ struct omap_device {
 	s8				pm_lat_level;
 	u8				hwmods_cnt;
 	u8				_state;
+	ktime_t				_enabled_stamp;
+	u64				_enabled_ns;
 };
 
 /* Device driver interface (call via platform_data fn ptrs) */
@@ -80,6 +83,7 @@ struct omap_device {
 int omap_device_enable(struct platform_device *pdev);
 int omap_device_idle(struct platform_device *pdev);
 int omap_device_shutdown(struct platform_device *pdev);
+u64 omap_device_get_enabled_time(struct platform_device *pdev);
 
 /* Core code interface */
 
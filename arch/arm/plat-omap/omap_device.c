@@ -455,6 +455,7 @@ struct omap_device *omap_device_build_ss(const char *pdev_name, int pdev_id,
 		return ERR_PTR(-ENOMEM);
 
 	od->hwmods_cnt = oh_cnt;
+	od->_enabled_stamp = ktime_get();
 
 	hwmods = kzalloc(sizeof(struct omap_hwmod *) * oh_cnt,
 			 GFP_KERNEL);
@@ -593,6 +594,13 @@ int omap_device_register(struct omap_device *od)
 
 /* Public functions for use by device drivers through struct platform_data */
 
+/* Account the enabled period of @od which ends now */
+static void _omap_device_account_enabled(struct omap_device *od)
+{
+	od->_enabled_ns += ktime_to_ns(ktime_sub(ktime_get(),
+						 od->_enabled_stamp));
+}
+
 /**
  * omap_device_enable - fully activate an omap_device
  * @od: struct omap_device * to activate
@@ -627,6 +635,7 @@ int omap_device_enable(struct platform_device *pdev)
 
 	od->dev_wakeup_lat = 0;
 	od->_dev_wakeup_lat_limit = UINT_MAX;
+	od->_enabled_stamp = ktime_get();
 	od->_state = OMAP_DEVICE_STATE_ENABLED;
 
 	return ret;
@@ -660,6 +669,7 @@ int omap_device_idle(struct platform_device *pdev)
 
 	ret = _omap_device_deactivate(od, USE_WAKEUP_LAT);
 
+	_omap_device_account_enabled(od);
 	od->_state = OMAP_DEVICE_STATE_IDLE;
 
 	return ret;
@@ -695,11 +705,33 @@ int omap_device_shutdown(struct platform_device *pdev)
 	for (i = 0; i < od->hwmods_cnt; i++)
 		omap_hwmod_shutdown(od->hwmods[i]);
 
+	if (od->_state == OMAP_DEVICE_STATE_ENABLED)
+		_omap_device_account_enabled(od);
 	od->_state = OMAP_DEVICE_STATE_SHUTDOWN;
 
 	return ret;
 }
 
+/**
+ * omap_device_get_enabled_time - time an omap_device has spent enabled
+ * @pdev: struct platform_device * of the omap_device
+ *
+ * Returns the cumulative time in ns during which the omap_device was
+ * enabled through omap_device_enable(), including the current enabled
+ * period if any.  Meant for utilization estimates: the value is read
+ * without any locking against concurrent enable/idle calls.
+ */
+u64 omap_device_get_enabled_time(struct platform_device *pdev)
+{
+	struct omap_device *od = _find_by_pdev(pdev);
+	u64 enabled_ns = od->_enabled_ns;
+
+	if (od->_state == OMAP_DEVICE_STATE_ENABLED)
+		enabled_ns += ktime_to_ns(ktime_sub(ktime_get(),
+						    od->_enabled_stamp));
+	return enabled_ns;
+}
+
 /**
  * omap_device_align_pm_lat - activate/deactivate device to match wakeup lat lim
  * @od: struct omap_device *
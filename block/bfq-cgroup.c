@@ -135,6 +135,7 @@ static struct bfq_group *bfq_group_chain_alloc(struct bfq_data *bfqd,
 
 		bfq_group_init_entity(bgrp, bfqg);
 		bfqg->my_entity = &bfqg->entity;
+		bfqg->latency_target = bgrp->latency_target;
 
 		if (leaf == NULL) {
 			leaf = bfqg;
@@ -622,6 +623,7 @@ static struct bfq_group *bfq_alloc_root_group(struct bfq_data *bfqd, int node)
 
 	bgrp = &bfqio_root_cgroup;
 	spin_lock_irq(&bgrp->lock);
+	bfqg->latency_target = bgrp->latency_target;
 	rcu_assign_pointer(bfqg->bfqd, bfqd);
 	hlist_add_head_rcu(&bfqg->group_node, &bgrp->group_data);
 	spin_unlock_irq(&bgrp->lock);
@@ -713,6 +715,106 @@ STORE_FUNCTION(ioprio, 0, IOPRIO_BE_NR - 1);
 STORE_FUNCTION(ioprio_class, IOPRIO_CLASS_RT, IOPRIO_CLASS_IDLE);
 #undef STORE_FUNCTION
 
+static u64 bfqio_cgroup_latency_target_read(struct cgroup *cgroup,
+					    struct cftype *cftype)
+{
+	struct bfqio_cgroup *bgrp;
+	u64 ret;
+
+	if (!cgroup_lock_live_group(cgroup))
+		return -ENODEV;
+
+	bgrp = cgroup_to_bfqio(cgroup);
+	spin_lock_irq(&bgrp->lock);
+	ret = bgrp->latency_target;
+	spin_unlock_irq(&bgrp->lock);
+
+	cgroup_unlock();
+
+	return ret;
+}
+
+static int bfqio_cgroup_latency_target_write(struct cgroup *cgroup,
+					     struct cftype *cftype,
+					     u64 val)
+{
+	struct bfqio_cgroup *bgrp;
+	struct bfq_group *bfqg;
+	struct hlist_node *n;
+
+	if (val > BFQ_MAX_LAT_TARGET)
+		return -EINVAL;
+
+	if (!cgroup_lock_live_group(cgroup))
+		return -ENODEV;
+
+	bgrp = cgroup_to_bfqio(cgroup);
+
+	spin_lock_irq(&bgrp->lock);
+	bgrp->latency_target = (unsigned int)val;
+	/*
+	 * The groups read their copy under the queue lock of their
+	 * device; a stale value only matters for the requests already
+	 * in flight.
+	 */
+	hlist_for_each_entry(bfqg, n, &bgrp->group_data, group_node)
+		bfqg->latency_target = (unsigned int)val;
+	spin_unlock_irq(&bgrp->lock);
+
+	cgroup_unlock();
+
+	return 0;
+}
+
+static const char *bfq_lat_bucket_names[BFQ_LAT_BUCKETS] = {
+	"<1ms", "<2ms", "<4ms", "<8ms", "<16ms", "<32ms", "<64ms",
+	"<128ms", "<256ms", "<512ms", ">=512ms",
+};
+
+/*
+ * Print, for each device the cgroup has done I/O on, the latency
+ * histogram of its requests and how many missed the latency target.
+ */
+static int bfqio_cgroup_latency_histogram_read(struct cgroup *cgroup,
+					       struct cftype *cftype,
+					       struct seq_file *m)
+{
+	struct bfqio_cgroup *bgrp = cgroup_to_bfqio(cgroup);
+	unsigned long hist[BFQ_LAT_BUCKETS], completed, missed;
+	unsigned long uninitialized_var(flags);
+	struct bfq_group *bfqg;
+	struct bfq_data *bfqd;
+	struct hlist_node *n;
+	char name[16];
+	int i;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(bfqg, n, &bgrp->group_data, group_node) {
+		bfqd = bfq_get_bfqd_locked(&bfqg->bfqd, &flags);
+		if (bfqd == NULL)
+			continue;
+		if (bfqd->queue->backing_dev_info.dev == NULL) {
+			bfq_put_bfqd_unlock(bfqd, &flags);
+			continue;
+		}
+		strlcpy(name, dev_name(bfqd->queue->backing_dev_info.dev),
+			sizeof(name));
+		memcpy(hist, bfqg->lat_hist, sizeof(hist));
+		completed = bfqg->lat_completed;
+		missed = bfqg->lat_missed;
+		bfq_put_bfqd_unlock(bfqd, &flags);
+
+		for (i = 0; i < BFQ_LAT_BUCKETS; i++)
+			seq_printf(m, "%s %s %lu\n", name,
+				   bfq_lat_bucket_names[i], hist[i]);
+		seq_printf(m, "%s missed %lu\n", name, missed);
+		seq_printf(m, "%s total %lu\n", name, completed);
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
 static struct cftype bfqio_files[] = {
 	{
 		.name = "weight",
@@ -729,6 +831,15 @@ static struct cftype bfqio_files[] = {
 		.read_u64 = bfqio_cgroup_ioprio_class_read,
 		.write_u64 = bfqio_cgroup_ioprio_class_write,
 	},
+	{
+		.name = "latency_target",
+		.read_u64 = bfqio_cgroup_latency_target_read,
+		.write_u64 = bfqio_cgroup_latency_target_write,
+	},
+	{
+		.name = "latency_histogram",
+		.read_seq_string = bfqio_cgroup_latency_histogram_read,
+	},
 };
 
 static int bfqio_populate(struct cgroup_subsys *subsys, struct cgroup *cgroup)
@@ -845,6 +956,61 @@ static void bfqio_destroy(struct cgroup_subsys *subsys, struct cgroup *cgroup)
 	kfree(bgrp);
 }
 
+static inline struct bfq_group *bfqq_group(struct bfq_queue *bfqq)
+{
+	return container_of(bfqq->entity.sched_data, struct bfq_group,
+			    sched_data);
+}
+
+/*
+ * Account the latency of @rq, from its insertion to its completion, to
+ * the group of @bfqq.  If the group has a latency target and a sync
+ * request of it missed the target, throttle the groups without one for
+ * the next BFQ_LAT_THROTTLE_TIME.  Async requests are only accounted:
+ * their latency is not what the tasks of the group wait for.
+ */
+static void bfq_group_account_latency(struct bfq_data *bfqd,
+				      struct bfq_queue *bfqq,
+				      struct request *rq)
+{
+	struct bfq_group *bfqg = bfqq_group(bfqq);
+	unsigned long lat = bfq_rq_latency_us(rq);
+	int bucket = min(fls(lat / USEC_PER_MSEC), BFQ_LAT_BUCKETS - 1);
+
+	bfqg->lat_hist[bucket]++;
+	bfqg->lat_completed++;
+
+	if (bfqg->latency_target == 0 || !rq_is_sync(rq) ||
+	    lat <= bfqg->latency_target)
+		return;
+
+	bfqg->lat_missed++;
+	bfqd->lat_throttling = true;
+	bfqd->lat_throttle_until = jiffies + BFQ_LAT_THROTTLE_TIME;
+	bfq_log_bfqq(bfqd, bfqq, "latency %lu us over target %u us", lat,
+		     bfqg->latency_target);
+}
+
+/*
+ * Return true if @bfqq belongs to a group without a latency target, and
+ * some group is missing its target on the device: then @bfqq gets short
+ * budgets and no idling (see bfq_set_budget_timeout(), bfq_bfqq_expire()
+ * and bfq_bfqq_must_idle()).
+ */
+static bool bfq_bfqq_lat_throttled(struct bfq_data *bfqd,
+				   struct bfq_queue *bfqq)
+{
+	if (!bfqd->lat_throttling)
+		return false;
+
+	if (!time_before(jiffies, bfqd->lat_throttle_until)) {
+		bfqd->lat_throttling = false;
+		return false;
+	}
+
+	return bfqq_group(bfqq)->latency_target == 0;
+}
+
 struct cgroup_subsys bfqio_subsys = {
 	.name = "bfqio",
 	.create = bfqio_create,
@@ -879,6 +1045,18 @@ static inline void bfq_bfqq_move(struct bfq_data *bfqd,
 {
 }
 
+static inline void bfq_group_account_latency(struct bfq_data *bfqd,
+					     struct bfq_queue *bfqq,
+					     struct request *rq)
+{
+}
+
+static inline bool bfq_bfqq_lat_throttled(struct bfq_data *bfqd,
+					  struct bfq_queue *bfqq)
+{
+	return false;
+}
+
 static void bfq_end_wr_async(struct bfq_data *bfqd)
 {
 	bfq_end_wr_async_queues(bfqd, bfqd->root_group);
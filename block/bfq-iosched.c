@@ -66,6 +66,7 @@
 #include <linux/elevator.h>
 #include <linux/jiffies.h>
 #include <linux/rbtree.h>
+#include <linux/seq_file.h>
 #include <linux/ioprio.h>
 #include "bfq.h"
 #include "blk.h"
@@ -160,8 +161,25 @@ static int device_speed_thresh[2];
 #define BFQ_SERVICE_TREE_INIT	((struct bfq_service_tree)		\
 				{ RB_ROOT, RB_ROOT, NULL, NULL, 0, 0 })
 
-#define RQ_BIC(rq)		((struct bfq_io_cq *) (rq)->elv.priv[0])
+#define RQ_BIC(rq)		icq_to_bic((rq)->elv.icq)
 #define RQ_BFQQ(rq)		((rq)->elv.priv[1])
+/* Insertion time of a request, in usecs, see bfq_rq_latency_us(). */
+#define RQ_START_US(rq)		((unsigned long)(rq)->elv.priv[0])
+
+static inline unsigned long bfq_now_us(void)
+{
+	return (unsigned long)ktime_to_us(ktime_get());
+}
+
+/*
+ * Time elapsed since the insertion of @rq, in usecs.  The timestamp is
+ * truncated to an unsigned long, the difference is still right as long
+ * as the request does not stay with us for more than an hour.
+ */
+static inline unsigned long bfq_rq_latency_us(struct request *rq)
+{
+	return bfq_now_us() - RQ_START_US(rq);
+}
 
 static inline void bfq_schedule_dispatch(struct bfq_data *bfqd);
 
@@ -1740,7 +1758,7 @@ static void bfq_arm_slice_timer(struct bfq_data *bfqd)
 static void bfq_set_budget_timeout(struct bfq_data *bfqd)
 {
 	struct bfq_queue *bfqq = bfqd->in_service_queue;
-	unsigned int timeout_coeff;
+	unsigned int timeout_coeff, timeout;
 	if (bfqq->wr_cur_max_time == bfqd->bfq_wr_rt_max_time)
 		timeout_coeff = 1;
 	else
@@ -1748,13 +1766,20 @@ static void bfq_set_budget_timeout(struct bfq_data *bfqd)
 
 	bfqd->last_budget_start = ktime_get();
 
+	timeout = bfqd->bfq_timeout[bfq_bfqq_sync(bfqq)] * timeout_coeff;
+	/*
+	 * While a group is missing its latency target, give the queues
+	 * of the other groups a fraction of the usual time to use their
+	 * budget, so that they hand the device back sooner.
+	 */
+	if (bfq_bfqq_lat_throttled(bfqd, bfqq))
+		timeout = max(timeout / 4, 1U);
+
 	bfq_clear_bfqq_budget_new(bfqq);
-	bfqq->budget_timeout = jiffies +
-		bfqd->bfq_timeout[bfq_bfqq_sync(bfqq)] * timeout_coeff;
+	bfqq->budget_timeout = jiffies + timeout;
 
 	bfq_log_bfqq(bfqd, bfqq, "set budget_timeout %u",
-		jiffies_to_msecs(bfqd->bfq_timeout[bfq_bfqq_sync(bfqq)] *
-		timeout_coeff));
+		jiffies_to_msecs(timeout));
 }
 
 /*
@@ -1975,6 +2000,32 @@ static void __bfq_bfqq_recalc_budget(struct bfq_data *bfqd,
 			bfqq->entity.budget);
 }
 
+/*
+ * Cap the next budget of @bfqq, which belongs to a group without a
+ * latency target, while another group is missing its own: the queues
+ * of the groups with a target then get the device back after shorter
+ * rounds of service.  The budget grows back as usual afterwards.
+ */
+static void bfq_bfqq_lat_throttle_budget(struct bfq_data *bfqd,
+					 struct bfq_queue *bfqq)
+{
+	unsigned long budget = 4 * bfq_min_budget(bfqd);
+	struct request *next_rq = bfqq->next_rq;
+
+	if (bfqq->max_budget <= budget)
+		return;
+
+	bfqq->max_budget = budget;
+	if (next_rq != NULL)
+		bfqq->entity.budget = max_t(unsigned long, budget,
+					    bfq_serv_to_charge(next_rq, bfqq));
+	else
+		bfqq->entity.budget = budget;
+
+	bfq_log_bfqq(bfqd, bfqq, "lat throttled, new budget %lu",
+		     bfqq->entity.budget);
+}
+
 static unsigned long bfq_calc_max_budget(u64 peak_rate, u64 timeout)
 {
 	unsigned long max_budget;
@@ -2308,6 +2359,8 @@ static void bfq_bfqq_expire(struct bfq_data *bfqd,
 	 * reason.
 	 */
 	__bfq_bfqq_recalc_budget(bfqd, bfqq, reason);
+	if (bfq_bfqq_lat_throttled(bfqd, bfqq))
+		bfq_bfqq_lat_throttle_budget(bfqd, bfqq);
 	__bfq_bfqq_expire(bfqd, bfqq);
 }
 
@@ -2523,6 +2576,7 @@ static inline bool bfq_bfqq_must_idle(struct bfq_queue *bfqq)
 	struct bfq_data *bfqd = bfqq->bfqd;
 
 	return RB_EMPTY_ROOT(&bfqq->sort_list) && bfqd->bfq_slice_idle != 0 &&
+	       !bfq_bfqq_lat_throttled(bfqd, bfqq) &&
 	       bfq_bfqq_must_not_expire(bfqq);
 }
 
@@ -3374,6 +3428,7 @@ static void bfq_insert_request(struct request_queue *q, struct request *rq)
 		bfqq->bic->wr_time_left = 0;
 	rq_set_fifo_time(rq, jiffies + bfqd->bfq_fifo_expire[rq_is_sync(rq)]);
 	list_add_tail(&rq->queuelist, &bfqq->fifo);
+	rq->elv.priv[0] = (void *)bfq_now_us();
 
 	bfq_rq_enqueued(bfqd, bfqq, rq);
 }
@@ -3413,6 +3468,7 @@ static void bfq_completed_request(struct request_queue *q, struct request *rq)
 		     blk_rq_sectors(rq), sync);
 
 	bfq_update_hw_tag(bfqd);
+	bfq_group_account_latency(bfqd, bfqq, rq);
 
 	BUG_ON(!bfqd->rq_in_driver);
 	BUG_ON(!bfqq->dispatched);
@@ -3624,7 +3680,6 @@ new_queue:
 	bfq_log_bfqq(bfqd, bfqq, "set_request: bfqq %p, %d", bfqq,
 		     atomic_read(&bfqq->ref));
 
-	rq->elv.priv[0] = bic;
 	rq->elv.priv[1] = bfqq;
 
 	/*
@@ -30,6 +30,13 @@
 #define BFQ_DEFAULT_GRP_IOPRIO	0
 #define BFQ_DEFAULT_GRP_CLASS	IOPRIO_CLASS_BE
 
+/* Max latency target of a group, in usecs. */
+#define BFQ_MAX_LAT_TARGET	(10 * USEC_PER_SEC)
+/* Latency histogram buckets of a group: <1ms, <2ms, <4ms ... >=512ms. */
+#define BFQ_LAT_BUCKETS		11
+/* How long the other groups are throttled after a target is missed. */
+#define BFQ_LAT_THROTTLE_TIME	(HZ/10)
+
 struct bfq_entity;
 
 /**
@@ -354,6 +361,11 @@ enum bfq_device_speed {
  *               requests (see bfq_close_cooperator()).
  * @active_numerous_groups: number of bfq_groups containing more than one
  *                          active @bfq_entity.
+ * @lat_throttling: set when a request of a group with a latency target
+ *                  missed it, until @lat_throttle_until; meanwhile the
+ *                  queues of the groups without a target are throttled
+ *                  (see bfq_bfqq_lat_throttled()).
+ * @lat_throttle_until: end of the current throttling period (jiffies).
  * @queue_weights_tree: rbtree of weight counters of @bfq_queues, sorted by
  *                      weight. Used to keep track of whether all @bfq_queues
  *                     have the same weight. The tree contains one counter
@@ -489,6 +501,8 @@ struct bfq_data {
 
 #ifdef CONFIG_CGROUP_BFQIO
 	int active_numerous_groups;
+	bool lat_throttling;
+	unsigned long lat_throttle_until;
 #endif
 
 	struct rb_root queue_weights_tree;
@@ -663,6 +677,13 @@ enum bfqq_expiration {
  *                   are groups with more than one active @bfq_entity
  *                   (see the comments to the function
  *                   bfq_bfqq_must_not_expire()).
+ * @latency_target: copy of the latency target of the cgroup (usecs), 0 if
+ *                  the group has none.
+ * @lat_hist: histogram of the latencies of the requests of the group, from
+ *            their insertion to their completion, in BFQ_LAT_BUCKETS
+ *            buckets of powers of two milliseconds.
+ * @lat_completed: number of requests accounted in @lat_hist.
+ * @lat_missed: number of sync requests that missed @latency_target.
  *
  * Each (device, cgroup) pair has its own bfq_group, i.e., for each cgroup
  * there is a set of bfq_groups, each one collecting the lower-level
@@ -690,6 +711,10 @@ struct bfq_group {
 	struct bfq_entity *my_entity;
 
 	int active_entities;
+
+	unsigned int latency_target;
+	unsigned long lat_hist[BFQ_LAT_BUCKETS];
+	unsigned long lat_completed, lat_missed;
 };
 
 /**
@@ -698,16 +723,20 @@ struct bfq_group {
  * @weight: cgroup weight.
  * @ioprio: cgroup ioprio.
  * @ioprio_class: cgroup ioprio_class.
- * @lock: spinlock that protects @ioprio, @ioprio_class and @group_data.
+ * @latency_target: target latency of the sync requests of the cgroup, in
+ *                  usecs, 0 for none.
+ * @lock: spinlock that protects @ioprio, @ioprio_class, @latency_target
+ *        and @group_data.
  * @group_data: list containing the bfq_group belonging to this cgroup.
  *
  * @group_data is accessed using RCU, with @lock protecting the updates,
- * @ioprio and @ioprio_class are protected by @lock.
+ * @ioprio, @ioprio_class and @latency_target are protected by @lock.
  */
 struct bfqio_cgroup {
 	struct cgroup_subsys_state css;
 
 	unsigned short weight, ioprio, ioprio_class;
+	unsigned int latency_target;
 
 	spinlock_t lock;
 	struct hlist_head group_data;
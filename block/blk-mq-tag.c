@@ -0,0 +1,194 @@
+/*
+ * Tag allocation for blk-mq hardware queues
+ *
+ * A tag is a bit in a bitmap, the reserved tags first.  Each CPU starts
+ * looking for a free tag where it found the last one, so that CPUs
+ * sharing a hardware queue mostly work on different words of the map.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+
+#include <linux/blk-mq.h>
+#include "blk-mq-tag.h"
+
+struct blk_mq_tags {
+	unsigned int nr_tags;
+	unsigned int nr_reserved_tags;
+
+	unsigned long *map;			/* busy tags */
+	unsigned int __percpu *hint;		/* where to look first */
+
+	wait_queue_head_t wait;
+	wait_queue_head_t reserved_wait;
+};
+
+static int blk_mq_find_tag(unsigned long *map, unsigned int start,
+			   unsigned int end, unsigned int hint)
+{
+	unsigned int tag;
+
+	/* from the hint to the end, then from the start to the hint */
+	for (tag = hint; (tag = find_next_zero_bit(map, end, tag)) < end; tag++)
+		if (!test_and_set_bit(tag, map))
+			return tag;
+	for (tag = start; (tag = find_next_zero_bit(map, hint, tag)) < hint;
+	     tag++)
+		if (!test_and_set_bit(tag, map))
+			return tag;
+	return -1;
+}
+
+static int __blk_mq_get_tag(struct blk_mq_tags *tags, unsigned int start,
+			    unsigned int end)
+{
+	unsigned int *hint = per_cpu_ptr(tags->hint, raw_smp_processor_id());
+	unsigned int first = *hint;
+	int tag;
+
+	if (first < start || first >= end)
+		first = start;
+	tag = blk_mq_find_tag(tags->map, start, end, first);
+	if (tag >= 0)
+		*hint = tag + 1 < end ? tag + 1 : start;
+	return tag;
+}
+
+unsigned int blk_mq_get_tag(struct blk_mq_tags *tags, gfp_t gfp,
+			    bool reserved)
+{
+	unsigned int start, end;
+	wait_queue_head_t *wq;
+	DEFINE_WAIT(wait);
+	int tag;
+
+	if (reserved) {
+		start = 0;
+		end = tags->nr_reserved_tags;
+		wq = &tags->reserved_wait;
+	} else {
+		start = tags->nr_reserved_tags;
+		end = tags->nr_tags;
+		wq = &tags->wait;
+	}
+	if (WARN_ON_ONCE(start == end))
+		return BLK_MQ_TAG_FAIL;
+
+	tag = __blk_mq_get_tag(tags, start, end);
+	if (tag >= 0 || !(gfp & __GFP_WAIT))
+		goto out;
+
+	for (;;) {
+		prepare_to_wait_exclusive(wq, &wait, TASK_UNINTERRUPTIBLE);
+		tag = __blk_mq_get_tag(tags, start, end);
+		if (tag >= 0)
+			break;
+		io_schedule();
+	}
+	finish_wait(wq, &wait);
+out:
+	return tag < 0 ? BLK_MQ_TAG_FAIL : tag;
+}
+
+/*
+ * Wait until a tag is free, without keeping it
+ */
+void blk_mq_wait_for_tags(struct blk_mq_tags *tags, bool reserved)
+{
+	unsigned int tag = blk_mq_get_tag(tags, __GFP_WAIT, reserved);
+
+	if (tag != BLK_MQ_TAG_FAIL)
+		blk_mq_put_tag(tags, tag);
+}
+
+void blk_mq_put_tag(struct blk_mq_tags *tags, unsigned int tag)
+{
+	wait_queue_head_t *wq;
+
+	BUG_ON(tag >= tags->nr_tags);
+
+	clear_bit(tag, tags->map);
+	smp_mb__after_clear_bit();
+
+	wq = tag < tags->nr_reserved_tags ? &tags->reserved_wait : &tags->wait;
+	if (waitqueue_active(wq))
+		wake_up(wq);
+}
+
+bool blk_mq_tags_busy(struct blk_mq_tags *tags)
+{
+	return find_first_bit(tags->map, tags->nr_tags) < tags->nr_tags;
+}
+
+void blk_mq_tag_busy_iter(struct blk_mq_tags *tags,
+			  void (*fn)(void *data, unsigned int tag), void *data)
+{
+	unsigned int tag;
+
+	for_each_set_bit(tag, tags->map, tags->nr_tags)
+		fn(data, tag);
+}
+
+struct blk_mq_tags *blk_mq_init_tags(unsigned int nr_tags,
+				     unsigned int reserved_tags, int node)
+{
+	struct blk_mq_tags *tags;
+	unsigned int cpu, i = 0;
+
+	if (nr_tags > BLK_MQ_MAX_DEPTH || reserved_tags >= nr_tags) {
+		pr_err("blk-mq: tag depth %u, %u reserved, is invalid\n",
+		       nr_tags, reserved_tags);
+		return NULL;
+	}
+
+	tags = kzalloc_node(sizeof(*tags), GFP_KERNEL, node);
+	if (!tags)
+		return NULL;
+
+	tags->map = kzalloc_node(BITS_TO_LONGS(nr_tags) * sizeof(long),
+				 GFP_KERNEL, node);
+	tags->hint = alloc_percpu(unsigned int);
+	if (!tags->map || !tags->hint) {
+		free_percpu(tags->hint);
+		kfree(tags->map);
+		kfree(tags);
+		return NULL;
+	}
+
+	tags->nr_tags = nr_tags;
+	tags->nr_reserved_tags = reserved_tags;
+	init_waitqueue_head(&tags->wait);
+	init_waitqueue_head(&tags->reserved_wait);
+
+	/* spread the CPUs over the map */
+	for_each_possible_cpu(cpu)
+		*per_cpu_ptr(tags->hint, cpu) = reserved_tags +
+			(i++ * (nr_tags - reserved_tags)) / num_possible_cpus();
+
+	return tags;
+}
+
+void blk_mq_free_tags(struct blk_mq_tags *tags)
+{
+	free_percpu(tags->hint);
+	kfree(tags->map);
+	kfree(tags);
+}
+
+ssize_t blk_mq_tag_sysfs_show(struct blk_mq_tags *tags, char *page)
+{
+	unsigned int busy, reserved_busy;
+
+	if (!tags)
+		return 0;
+
+	busy = bitmap_weight(tags->map, tags->nr_tags);
+	reserved_busy = bitmap_weight(tags->map, tags->nr_reserved_tags);
+
+	return sprintf(page, "nr_tags=%u, reserved_tags=%u, busy=%u, "
+		       "reserved_busy=%u\n", tags->nr_tags,
+		       tags->nr_reserved_tags, busy, reserved_busy);
+}
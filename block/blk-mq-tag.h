@@ -0,0 +1,23 @@
+#ifndef INT_BLK_MQ_TAG_H
+#define INT_BLK_MQ_TAG_H
+
+struct blk_mq_tags;
+
+#define BLK_MQ_TAG_FAIL		((unsigned int) -1)
+
+extern struct blk_mq_tags *blk_mq_init_tags(unsigned int nr_tags,
+					    unsigned int reserved_tags,
+					    int node);
+extern void blk_mq_free_tags(struct blk_mq_tags *tags);
+
+extern unsigned int blk_mq_get_tag(struct blk_mq_tags *tags, gfp_t gfp,
+				   bool reserved);
+extern void blk_mq_wait_for_tags(struct blk_mq_tags *tags, bool reserved);
+extern void blk_mq_put_tag(struct blk_mq_tags *tags, unsigned int tag);
+extern bool blk_mq_tags_busy(struct blk_mq_tags *tags);
+extern void blk_mq_tag_busy_iter(struct blk_mq_tags *tags,
+				 void (*fn)(void *data, unsigned int tag),
+				 void *data);
+extern ssize_t blk_mq_tag_sysfs_show(struct blk_mq_tags *tags, char *page);
+
+#endif
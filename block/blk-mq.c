@@ -0,0 +1,1175 @@
+/*
+ * Block multiqueue core code
+ *
+ * Requests are staged in a software queue per CPU, with a lock of its own,
+ * and handed to the driver from the hardware queue the CPU maps to.  The
+ * requests of a hardware queue are allocated up front and indexed by tag,
+ * each with room for the driver's command after it.  There is no I/O
+ * scheduler: a bio is only merged into a request still staged on the CPU
+ * or held in the plug of the task.
+ *
+ * Flush and FUA requests are not sequenced as they are by blk-flush.c for
+ * the request_fn queues, they go to the driver as they are.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/backing-dev.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/mm.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/smp.h>
+#include <linux/delay.h>
+#include <linux/log2.h>
+#include <linux/sched.h>
+#include <linux/hrtimer.h>
+#include <linux/blk-mq.h>
+
+#include <trace/events/block.h>
+
+#include "blk.h"
+#include "blk-mq.h"
+#include "blk-mq-tag.h"
+
+/* staged requests looked at for a merge, newest first */
+#define BLK_MQ_MERGE_CHECKS	8
+
+static struct blk_mq_ctx *__blk_mq_get_ctx(struct request_queue *q,
+					   unsigned int cpu)
+{
+	return per_cpu_ptr(q->queue_ctx, cpu);
+}
+
+/*
+ * The task stays on the CPU of the software queue until blk_mq_put_ctx()
+ */
+static struct blk_mq_ctx *blk_mq_get_ctx(struct request_queue *q)
+{
+	return __blk_mq_get_ctx(q, get_cpu());
+}
+
+static void blk_mq_put_ctx(struct blk_mq_ctx *ctx)
+{
+	put_cpu();
+}
+
+static bool blk_mq_hctx_has_pending(struct blk_mq_hw_ctx *hctx)
+{
+	return find_first_bit(hctx->ctx_map, hctx->nr_ctx) < hctx->nr_ctx ||
+	       !list_empty_careful(&hctx->dispatch);
+}
+
+static void blk_mq_hctx_mark_pending(struct blk_mq_hw_ctx *hctx,
+				     struct blk_mq_ctx *ctx)
+{
+	if (!test_bit(ctx->index_hw, hctx->ctx_map))
+		set_bit(ctx->index_hw, hctx->ctx_map);
+}
+
+static struct request *__blk_mq_alloc_request(struct blk_mq_hw_ctx *hctx,
+					      gfp_t gfp, bool reserved)
+{
+	struct request *rq;
+	unsigned int tag;
+
+	tag = blk_mq_get_tag(hctx->tags, gfp, reserved);
+	if (tag == BLK_MQ_TAG_FAIL)
+		return NULL;
+
+	rq = hctx->rqs[tag];
+	blk_rq_init(hctx->queue, rq);
+	rq->tag = tag;
+	return rq;
+}
+
+static void blk_mq_rq_ctx_init(struct request_queue *q, struct blk_mq_ctx *ctx,
+			       struct request *rq, unsigned int rw_flags)
+{
+	rq->mq_ctx = ctx;
+	rq->cpu = ctx->cpu;
+	rq->cmd_flags = rw_flags;
+	if (blk_queue_io_stat(q))
+		rq->cmd_flags |= REQ_IO_STAT;
+}
+
+/*
+ * Allocate from the hardware queue of the CPU we run on.  If it has no
+ * free request and @gfp allows to wait, run it and wait for one, then try
+ * again on the CPU we have been woken up on.
+ */
+static struct request *blk_mq_alloc_request_pinned(struct request_queue *q,
+						   int rw_flags, gfp_t gfp,
+						   bool reserved)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+
+	for (;;) {
+		ctx = blk_mq_get_ctx(q);
+		hctx = q->mq_ops->map_queue(q, ctx->cpu);
+
+		rq = __blk_mq_alloc_request(hctx, gfp & ~__GFP_WAIT, reserved);
+		if (rq) {
+			blk_mq_rq_ctx_init(q, ctx, rq, rw_flags);
+			blk_mq_put_ctx(ctx);
+			return rq;
+		}
+		blk_mq_put_ctx(ctx);
+
+		if (!(gfp & __GFP_WAIT))
+			return NULL;
+
+		blk_mq_run_hw_queue(hctx, false);
+		blk_mq_wait_for_tags(hctx->tags, reserved);
+	}
+}
+
+struct request *blk_mq_alloc_request(struct request_queue *q, int rw,
+				     gfp_t gfp, bool reserved)
+{
+	if (unlikely(blk_queue_dead(q)))
+		return NULL;
+
+	return blk_mq_alloc_request_pinned(q, rw, gfp, reserved);
+}
+EXPORT_SYMBOL(blk_mq_alloc_request);
+
+void blk_mq_free_request(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	struct blk_mq_hw_ctx *hctx = q->mq_ops->map_queue(q, rq->mq_ctx->cpu);
+
+	wbt_done(rq);
+	rq->atomic_flags = 0;
+	blk_mq_put_tag(hctx->tags, rq->tag);
+}
+EXPORT_SYMBOL(blk_mq_free_request);
+
+/*
+ * Account the service time of a sync request of a polled queue, for the
+ * sleep of blk_poll()
+ */
+static void blk_mq_poll_stat_add(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	struct blk_poll_stat *stat = &q->poll_stat[rq_data_dir(rq)];
+	u64 now = ktime_to_ns(ktime_get());
+	unsigned long flags;
+	u64 mean;
+
+	spin_lock_irqsave(&q->poll_stat_lock, flags);
+	stat->sum_ns += now - rq->poll_issue_ns;
+	stat->samples++;
+	if (++stat->nr == BLK_POLL_STAT_WINDOW) {
+		mean = div_u64(stat->sum_ns, BLK_POLL_STAT_WINDOW);
+		if (stat->mean_ns)
+			mean = (stat->mean_ns + mean) >> 1;
+		stat->mean_ns = mean;
+		stat->sum_ns = 0;
+		stat->nr = 0;
+	}
+	spin_unlock_irqrestore(&q->poll_stat_lock, flags);
+}
+
+/**
+ * blk_mq_end_io - end all of a request
+ * @rq:		the request
+ * @error:	0 for success, < 0 for error
+ *
+ * Description:
+ *     Ends all the bios of @rq, then calls its end_io handler or frees it.
+ *     A driver that has a timeout handler should end its requests with
+ *     blk_mq_complete_request() instead, which keeps the two apart.
+ */
+void blk_mq_end_io(struct request *rq, int error)
+{
+	if (rq->poll_issue_ns)
+		blk_mq_poll_stat_add(rq);
+
+	if (blk_update_request(rq, error, blk_rq_bytes(rq)))
+		BUG();
+
+	blk_account_io_done(rq);
+
+	/* the owner may free it later, the timer must not see it till then */
+	clear_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
+
+	if (rq->end_io)
+		rq->end_io(rq, error);
+	else
+		blk_mq_free_request(rq);
+}
+EXPORT_SYMBOL(blk_mq_end_io);
+
+static void blk_mq_softirq_done(struct request *rq)
+{
+	blk_mq_end_io(rq, rq->errors);
+}
+
+/**
+ * blk_mq_complete_request - end a request from the completion interrupt
+ * @rq:		the request, with rq->errors set
+ *
+ * Description:
+ *     Ends @rq in softirq context on the CPU that submitted it, through
+ *     the ->complete() handler of the driver, unless the timeout handler
+ *     got it first.
+ */
+void blk_mq_complete_request(struct request *rq)
+{
+	if (unlikely(blk_should_fake_timeout(rq->q)))
+		return;
+
+	if (!blk_mark_rq_complete(rq))
+		__blk_complete_request(rq);
+}
+EXPORT_SYMBOL(blk_mq_complete_request);
+
+static void blk_mq_add_timer(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	unsigned long expiry;
+
+	if (!rq->timeout)
+		rq->timeout = q->rq_timeout;
+
+	rq->deadline = jiffies + rq->timeout;
+	expiry = round_jiffies_up(rq->deadline);
+
+	if (!timer_pending(&q->timeout) ||
+	    time_before(expiry, q->timeout.expires))
+		mod_timer(&q->timeout, expiry);
+}
+
+static void blk_mq_start_request(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	trace_block_rq_issue(q, rq);
+
+	if (q->mq_ops->timeout)
+		blk_mq_add_timer(rq);
+
+	if (blk_queue_poll(q) && rq_is_sync(rq))
+		rq->poll_issue_ns = ktime_to_ns(ktime_get());
+
+	/* the timer must see the deadline of a started request */
+	smp_wmb();
+	set_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
+}
+
+static void blk_mq_requeue_request(struct request *rq)
+{
+	trace_block_rq_requeue(rq->q, rq);
+	clear_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
+}
+
+struct blk_mq_timeout_data {
+	struct blk_mq_hw_ctx *hctx;
+	unsigned long next;
+	bool next_set;
+};
+
+static void blk_mq_rq_timed_out(struct request *rq)
+{
+	enum blk_eh_timer_return ret;
+
+	ret = rq->q->mq_ops->timeout(rq);
+	switch (ret) {
+	case BLK_EH_HANDLED:
+		__blk_complete_request(rq);
+		break;
+	case BLK_EH_RESET_TIMER:
+		blk_mq_add_timer(rq);
+		blk_clear_rq_complete(rq);
+		break;
+	case BLK_EH_NOT_HANDLED:
+		/* the driver ends the request itself */
+		break;
+	default:
+		printk(KERN_ERR "block: bad eh return: %d\n", ret);
+		break;
+	}
+}
+
+static void blk_mq_check_expired(void *__data, unsigned int tag)
+{
+	struct blk_mq_timeout_data *data = __data;
+	struct request *rq = data->hctx->rqs[tag];
+
+	if (!test_bit(REQ_ATOM_STARTED, &rq->atomic_flags))
+		return;
+	smp_rmb();
+
+	if (time_after_eq(jiffies, rq->deadline)) {
+		if (!blk_mark_rq_complete(rq))
+			blk_mq_rq_timed_out(rq);
+	} else if (!data->next_set || time_after(data->next, rq->deadline)) {
+		data->next = rq->deadline;
+		data->next_set = true;
+	}
+}
+
+static void blk_mq_rq_timer(unsigned long data)
+{
+	struct request_queue *q = (struct request_queue *) data;
+	struct blk_mq_timeout_data td = { .next_set = false, };
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		td.hctx = hctx;
+		blk_mq_tag_busy_iter(hctx->tags, blk_mq_check_expired, &td);
+	}
+
+	if (td.next_set)
+		mod_timer(&q->timeout, round_jiffies_up(td.next));
+}
+
+/*
+ * Try to merge @bio into @rq, a request staged on a software queue or in
+ * the plug of the task.
+ */
+static bool blk_mq_bio_merge(struct request_queue *q, struct request *rq,
+			     struct bio *bio)
+{
+	if (rq->q != q || !blk_rq_merge_ok(rq, bio))
+		return false;
+
+	switch (blk_try_merge(rq, bio)) {
+	case ELEVATOR_BACK_MERGE:
+		return bio_attempt_back_merge(q, rq, bio);
+	case ELEVATOR_FRONT_MERGE:
+		return bio_attempt_front_merge(q, rq, bio);
+	}
+	return false;
+}
+
+static bool blk_mq_attempt_merge(struct request_queue *q,
+				 struct blk_mq_ctx *ctx, struct bio *bio)
+{
+	int checked = BLK_MQ_MERGE_CHECKS;
+	struct request *rq;
+
+	list_for_each_entry_reverse(rq, &ctx->rq_list, queuelist) {
+		if (!checked--)
+			break;
+		if (blk_mq_bio_merge(q, rq, bio))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Merge with the requests of the plug, and count those of @q to know
+ * when to flush it.
+ */
+static bool blk_mq_attempt_plug_merge(struct request_queue *q,
+				      struct blk_plug *plug, struct bio *bio,
+				      unsigned int *request_count)
+{
+	struct request *rq;
+
+	list_for_each_entry_reverse(rq, &plug->mq_list, queuelist) {
+		if (rq->q != q)
+			continue;
+		(*request_count)++;
+		if (blk_mq_bio_merge(q, rq, bio))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Count the requests of @q in the plug, when the bio was not offered to
+ * them for merging
+ */
+static unsigned int blk_mq_plug_queued_count(struct request_queue *q,
+					     struct blk_plug *plug)
+{
+	struct request *rq;
+	unsigned int count = 0;
+
+	list_for_each_entry(rq, &plug->mq_list, queuelist) {
+		if (rq->q == q)
+			count++;
+	}
+	return count;
+}
+
+/*
+ * Called with the lock of the software queue of @rq held
+ */
+static void __blk_mq_insert_request(struct blk_mq_hw_ctx *hctx,
+				    struct request *rq, bool at_head)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+
+	trace_block_rq_insert(hctx->queue, rq);
+
+	if (at_head)
+		list_add(&rq->queuelist, &ctx->rq_list);
+	else
+		list_add_tail(&rq->queuelist, &ctx->rq_list);
+	blk_mq_hctx_mark_pending(hctx, ctx);
+}
+
+void blk_mq_insert_request(struct request_queue *q, struct request *rq,
+			   bool at_head, bool run_queue)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+	struct blk_mq_hw_ctx *hctx = q->mq_ops->map_queue(q, ctx->cpu);
+
+	spin_lock(&ctx->lock);
+	__blk_mq_insert_request(hctx, rq, at_head);
+	spin_unlock(&ctx->lock);
+
+	if (run_queue)
+		blk_mq_run_hw_queue(hctx, false);
+}
+EXPORT_SYMBOL(blk_mq_insert_request);
+
+/*
+ * Hand the requests of the software queues and those the driver could not
+ * take last time to ->queue_rq(), until it has no more room.  Must be
+ * called in process context, with interrupts enabled.
+ */
+static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	struct request_queue *q = hctx->queue;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+	LIST_HEAD(rq_list);
+	unsigned int queued, bit;
+
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	hctx->run++;
+
+	for_each_set_bit(bit, hctx->ctx_map, hctx->nr_ctx) {
+		clear_bit(bit, hctx->ctx_map);
+		ctx = hctx->ctxs[bit];
+
+		spin_lock(&ctx->lock);
+		list_splice_tail_init(&ctx->rq_list, &rq_list);
+		spin_unlock(&ctx->lock);
+	}
+
+	/* requests the driver was busy for go first */
+	if (!list_empty_careful(&hctx->dispatch)) {
+		spin_lock(&hctx->lock);
+		list_splice_init(&hctx->dispatch, &rq_list);
+		spin_unlock(&hctx->lock);
+	}
+
+	queued = 0;
+	while (!list_empty(&rq_list)) {
+		int ret;
+
+		rq = list_first_entry(&rq_list, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+
+		blk_mq_start_request(rq);
+
+		ret = q->mq_ops->queue_rq(hctx, rq);
+		if (ret == BLK_MQ_RQ_QUEUE_OK) {
+			queued++;
+			continue;
+		}
+
+		if (ret == BLK_MQ_RQ_QUEUE_BUSY) {
+			blk_mq_requeue_request(rq);
+			list_add(&rq->queuelist, &rq_list);
+			break;
+		}
+
+		WARN_ON_ONCE(ret != BLK_MQ_RQ_QUEUE_ERROR);
+		rq->errors = -EIO;
+		blk_mq_end_io(rq, rq->errors);
+	}
+
+	if (!queued)
+		hctx->dispatched[0]++;
+	else
+		hctx->dispatched[min_t(unsigned int, ilog2(queued) + 1,
+				       BLK_MQ_MAX_DISPATCH_ORDER - 1)]++;
+	hctx->queued += queued;
+
+	/*
+	 * The driver stops the queue when it is busy and starts it again
+	 * once it has room, which runs it.
+	 */
+	if (!list_empty(&rq_list)) {
+		spin_lock(&hctx->lock);
+		list_splice(&rq_list, &hctx->dispatch);
+		spin_unlock(&hctx->lock);
+	}
+}
+
+void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx, bool async)
+{
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	if (!async)
+		__blk_mq_run_hw_queue(hctx);
+	else
+		kblockd_schedule_work(hctx->queue, &hctx->run_work);
+}
+EXPORT_SYMBOL(blk_mq_run_hw_queue);
+
+void blk_mq_run_queues(struct request_queue *q, bool async)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!blk_mq_hctx_has_pending(hctx))
+			continue;
+		blk_mq_run_hw_queue(hctx, async);
+	}
+}
+EXPORT_SYMBOL(blk_mq_run_queues);
+
+void blk_mq_stop_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	cancel_delayed_work(&hctx->delay_work);
+	set_bit(BLK_MQ_S_STOPPED, &hctx->state);
+}
+EXPORT_SYMBOL(blk_mq_stop_hw_queue);
+
+/*
+ * Queues are started again from the completion interrupt, so they are
+ * run from kblockd.
+ */
+void blk_mq_start_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	clear_bit(BLK_MQ_S_STOPPED, &hctx->state);
+	blk_mq_run_hw_queue(hctx, true);
+}
+EXPORT_SYMBOL(blk_mq_start_hw_queue);
+
+void blk_mq_stop_hw_queues(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		blk_mq_stop_hw_queue(hctx);
+}
+EXPORT_SYMBOL(blk_mq_stop_hw_queues);
+
+void blk_mq_start_stopped_hw_queues(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!test_bit(BLK_MQ_S_STOPPED, &hctx->state))
+			continue;
+		blk_mq_start_hw_queue(hctx);
+	}
+}
+EXPORT_SYMBOL(blk_mq_start_stopped_hw_queues);
+
+static void blk_mq_run_work_fn(struct work_struct *work)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	hctx = container_of(work, struct blk_mq_hw_ctx, run_work);
+	__blk_mq_run_hw_queue(hctx);
+}
+
+static void blk_mq_delay_work_fn(struct work_struct *work)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	hctx = container_of(work, struct blk_mq_hw_ctx, delay_work.work);
+	__blk_mq_run_hw_queue(hctx);
+}
+
+void blk_mq_delay_queue(struct blk_mq_hw_ctx *hctx, unsigned long msecs)
+{
+	kblockd_schedule_delayed_work(hctx->queue, &hctx->delay_work,
+				      msecs_to_jiffies(msecs));
+}
+EXPORT_SYMBOL(blk_mq_delay_queue);
+
+void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule)
+{
+	struct blk_mq_hw_ctx *hctx = NULL;
+	struct blk_mq_ctx *ctx = NULL;
+	struct request *rq;
+	LIST_HEAD(list);
+
+	list_splice_init(&plug->mq_list, &list);
+
+	while (!list_empty(&list)) {
+		rq = list_first_entry(&list, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+
+		if (rq->mq_ctx != ctx) {
+			if (ctx) {
+				spin_unlock(&ctx->lock);
+				trace_block_unplug(hctx->queue, 0, !from_schedule);
+				blk_mq_run_hw_queue(hctx, from_schedule);
+			}
+			ctx = rq->mq_ctx;
+			hctx = rq->q->mq_ops->map_queue(rq->q, ctx->cpu);
+			spin_lock(&ctx->lock);
+		}
+		__blk_mq_insert_request(hctx, rq, false);
+	}
+
+	if (ctx) {
+		spin_unlock(&ctx->lock);
+		trace_block_unplug(hctx->queue, 0, !from_schedule);
+		blk_mq_run_hw_queue(hctx, from_schedule);
+	}
+}
+
+static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
+{
+	const int is_sync = rw_is_sync(bio->bi_rw);
+	const int is_flush_fua = bio->bi_rw & (REQ_FLUSH | REQ_FUA);
+	struct blk_plug *plug = current->plug;
+	unsigned int request_count = 0;
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+	unsigned int wb_acct;
+	int rw_flags;
+	bool merge;
+
+	blk_queue_bounce(q, &bio);
+
+	if (unlikely(blk_queue_dead(q))) {
+		bio_endio(bio, -ENODEV);
+		return;
+	}
+
+	merge = !is_flush_fua && !blk_queue_nomerges(q);
+
+	if (merge && plug &&
+	    blk_mq_attempt_plug_merge(q, plug, bio, &request_count))
+		return;
+
+	rw_flags = bio_data_dir(bio);
+	if (is_sync)
+		rw_flags |= REQ_SYNC;
+
+	/* may sleep, so before the software queue pins us to the CPU */
+	wb_acct = wbt_wait(q, bio, NULL);
+
+	ctx = blk_mq_get_ctx(q);
+	hctx = q->mq_ops->map_queue(q, ctx->cpu);
+
+	if (merge && (hctx->flags & BLK_MQ_F_SHOULD_MERGE)) {
+		spin_lock(&ctx->lock);
+		if (blk_mq_attempt_merge(q, ctx, bio)) {
+			spin_unlock(&ctx->lock);
+			blk_mq_put_ctx(ctx);
+			__wbt_done(q, wb_acct);
+			return;
+		}
+		spin_unlock(&ctx->lock);
+	}
+
+	trace_block_getrq(q, bio, rw_flags & 1);
+	rq = __blk_mq_alloc_request(hctx, GFP_ATOMIC, false);
+	if (likely(rq))
+		blk_mq_rq_ctx_init(q, ctx, rq, rw_flags);
+	blk_mq_put_ctx(ctx);
+
+	if (unlikely(!rq)) {
+		trace_block_sleeprq(q, bio, rw_flags & 1);
+		rq = blk_mq_alloc_request_pinned(q, rw_flags, GFP_NOIO, false);
+		ctx = rq->mq_ctx;
+		hctx = q->mq_ops->map_queue(q, ctx->cpu);
+	}
+
+	wbt_track(rq, wb_acct);
+	init_request_from_bio(rq, bio);
+	drive_stat_acct(rq, 1);
+	bio->bi_cookie = blk_tag_to_qc_t(rq->tag, hctx->queue_num);
+
+	if (plug && !is_flush_fua) {
+		if (!merge)
+			request_count = blk_mq_plug_queued_count(q, plug);
+		if (list_empty(&plug->mq_list))
+			trace_block_plug(q);
+		else if (request_count >= BLK_MAX_REQUEST_COUNT) {
+			blk_flush_plug_list(plug, false);
+			trace_block_plug(q);
+		}
+		list_add_tail(&rq->queuelist, &plug->mq_list);
+		return;
+	}
+
+	spin_lock(&ctx->lock);
+	__blk_mq_insert_request(hctx, rq, false);
+	spin_unlock(&ctx->lock);
+
+	/* sync I/O is dispatched by the submitter, the rest by kblockd */
+	blk_mq_run_hw_queue(hctx, !is_sync || is_flush_fua);
+}
+
+/*
+ * How long to sleep before polling for @rq: the time set in io_poll_delay,
+ * or until half the mean service time of the queue has passed since @rq
+ * was issued.  Zero to poll right away.
+ */
+static u64 blk_mq_poll_nsecs(struct request_queue *q, struct request *rq)
+{
+	u64 mean, issued, now;
+	unsigned long flags;
+
+	if (q->poll_nsec)
+		return q->poll_nsec > 0 ? q->poll_nsec : 0;
+
+	spin_lock_irqsave(&q->poll_stat_lock, flags);
+	mean = q->poll_stat[rq_data_dir(rq)].mean_ns;
+	spin_unlock_irqrestore(&q->poll_stat_lock, flags);
+
+	issued = rq->poll_issue_ns;
+	now = ktime_to_ns(ktime_get());
+	if (!mean || !issued || now >= issued + (mean >> 1))
+		return 0;
+
+	return issued + (mean >> 1) - now;
+}
+
+/*
+ * Sleep once per request before spinning on it, so that a request that
+ * takes tens of usecs does not cost as much CPU time.  Returns true if it
+ * slept: the caller then checks whether the request ended meanwhile.
+ */
+static bool blk_mq_poll_hybrid_sleep(struct request_queue *q,
+				     struct blk_mq_hw_ctx *hctx,
+				     struct request *rq)
+{
+	struct hrtimer_sleeper hs;
+	u64 nsecs;
+
+	if (!test_bit(REQ_ATOM_STARTED, &rq->atomic_flags) ||
+	    test_and_set_bit(REQ_ATOM_POLL_SLEPT, &rq->atomic_flags))
+		return false;
+
+	nsecs = blk_mq_poll_nsecs(q, rq);
+	if (!nsecs)
+		return false;
+
+	hctx->poll_slept++;
+
+	hrtimer_init_on_stack(&hs.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	hrtimer_set_expires(&hs.timer, ns_to_ktime(nsecs));
+	hrtimer_init_sleeper(&hs, current);
+
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	hrtimer_start_expires(&hs.timer, HRTIMER_MODE_REL);
+	if (hs.task)
+		io_schedule();
+	hrtimer_cancel(&hs.timer);
+	__set_current_state(TASK_RUNNING);
+
+	destroy_hrtimer_on_stack(&hs.timer);
+	return true;
+}
+
+/**
+ * blk_poll - poll for the completion of a request
+ * @q:		the queue of the request
+ * @cookie:	bio->bi_cookie of a bio of the request
+ *
+ * Description:
+ *     For a task that waits for its own I/O, in TASK_UNINTERRUPTIBLE or
+ *     TASK_INTERRUPTIBLE, and is woken up by its completion.  Instead of
+ *     sleeping until the interrupt, reap completions from the driver's
+ *     ->poll() until the task is woken up, a signal is pending or the CPU
+ *     is wanted by another task.  The first call for a request may sleep
+ *     a part of its expected service time first, see io_poll_delay.
+ *
+ *     Returns true if the task should check again whether its I/O is
+ *     done, false if it should go to sleep as usual.
+ */
+bool blk_poll(struct request_queue *q, blk_qc_t cookie)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_plug *plug;
+	struct request *rq;
+	unsigned int tag;
+	long state;
+
+	if (!q->mq_ops || !q->mq_ops->poll || !blk_queue_poll(q) ||
+	    !blk_qc_t_valid(cookie) ||
+	    blk_qc_t_to_queue_num(cookie) >= q->nr_hw_queues)
+		return false;
+
+	hctx = q->queue_hw_ctx[blk_qc_t_to_queue_num(cookie)];
+	tag = blk_qc_t_to_tag(cookie);
+	if (tag >= hctx->queue_depth)
+		return false;
+	rq = hctx->rqs[tag];
+
+	/* the request may still be waiting in our plug */
+	plug = current->plug;
+	if (plug)
+		blk_flush_plug_list(plug, false);
+	if (current->state == TASK_RUNNING)
+		return true;
+
+	hctx->poll_considered++;
+
+	if (blk_mq_poll_hybrid_sleep(q, hctx, rq))
+		return true;
+
+	state = current->state;
+	while (!need_resched()) {
+		int ret;
+
+		hctx->poll_invoked++;
+
+		ret = q->mq_ops->poll(hctx, tag);
+		if (ret > 0) {
+			hctx->poll_success++;
+			set_current_state(TASK_RUNNING);
+			return true;
+		}
+
+		if (signal_pending_state(state, current))
+			set_current_state(TASK_RUNNING);
+
+		if (current->state == TASK_RUNNING)
+			return true;
+		if (ret < 0)
+			break;
+		cpu_relax();
+	}
+
+	return false;
+}
+EXPORT_SYMBOL_GPL(blk_poll);
+
+/*
+ * CPUs are spread evenly over the hardware queues, neighbours sharing one
+ */
+static unsigned int *blk_mq_make_queue_map(struct blk_mq_reg *reg)
+{
+	unsigned int *map, cpu, i = 0;
+
+	map = kzalloc_node(sizeof(*map) * nr_cpu_ids, GFP_KERNEL,
+			   reg->numa_node);
+	if (!map)
+		return NULL;
+
+	for_each_possible_cpu(cpu)
+		map[cpu] = i++ * reg->nr_hw_queues / num_possible_cpus();
+
+	return map;
+}
+
+struct blk_mq_hw_ctx *blk_mq_map_queue(struct request_queue *q, const int cpu)
+{
+	return q->queue_hw_ctx[q->mq_map[cpu]];
+}
+EXPORT_SYMBOL(blk_mq_map_queue);
+
+struct blk_mq_hw_ctx *blk_mq_alloc_single_hw_queue(struct blk_mq_reg *reg,
+						   unsigned int hctx_index)
+{
+	return kzalloc_node(sizeof(struct blk_mq_hw_ctx), GFP_KERNEL,
+			    reg->numa_node);
+}
+EXPORT_SYMBOL(blk_mq_alloc_single_hw_queue);
+
+void blk_mq_free_single_hw_queue(struct blk_mq_hw_ctx *hctx,
+				 unsigned int hctx_index)
+{
+	kfree(hctx);
+}
+EXPORT_SYMBOL(blk_mq_free_single_hw_queue);
+
+static void blk_mq_free_rq_map(struct blk_mq_hw_ctx *hctx)
+{
+	unsigned int i;
+
+	if (hctx->tags)
+		blk_mq_free_tags(hctx->tags);
+
+	if (hctx->rqs) {
+		for (i = 0; i < hctx->queue_depth; i++)
+			kfree(hctx->rqs[i]);
+		kfree(hctx->rqs);
+	}
+}
+
+/*
+ * The requests are allocated one by one, rounded up to whole cache lines
+ * so that two CPUs working on neighbouring tags do not share a line.
+ */
+static int blk_mq_init_rq_map(struct blk_mq_hw_ctx *hctx,
+			      struct blk_mq_reg *reg)
+{
+	size_t rq_size = ALIGN(sizeof(struct request) + reg->cmd_size,
+			       cache_line_size());
+	unsigned int i;
+
+	hctx->queue_depth = reg->queue_depth;
+	hctx->rqs = kzalloc_node(reg->queue_depth * sizeof(struct request *),
+				 GFP_KERNEL, hctx->numa_node);
+	if (!hctx->rqs)
+		return -ENOMEM;
+
+	for (i = 0; i < reg->queue_depth; i++) {
+		hctx->rqs[i] = kzalloc_node(rq_size, GFP_KERNEL,
+					    hctx->numa_node);
+		if (!hctx->rqs[i])
+			goto fail;
+	}
+
+	hctx->tags = blk_mq_init_tags(reg->queue_depth, reg->reserved_tags,
+				      hctx->numa_node);
+	if (!hctx->tags)
+		goto fail;
+
+	return 0;
+fail:
+	blk_mq_free_rq_map(hctx);
+	return -ENOMEM;
+}
+
+static void blk_mq_free_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	blk_mq_free_rq_map(hctx);
+	kfree(hctx->ctx_map);
+	kfree(hctx->ctxs);
+	free_cpumask_var(hctx->cpumask);
+}
+
+static int blk_mq_init_hw_queue(struct request_queue *q,
+				struct blk_mq_hw_ctx *hctx,
+				struct blk_mq_reg *reg, void *driver_data,
+				unsigned int hctx_index)
+{
+	int node = hctx->numa_node;
+
+	spin_lock_init(&hctx->lock);
+	INIT_LIST_HEAD(&hctx->dispatch);
+	INIT_WORK(&hctx->run_work, blk_mq_run_work_fn);
+	INIT_DELAYED_WORK(&hctx->delay_work, blk_mq_delay_work_fn);
+	hctx->queue = q;
+	hctx->queue_num = hctx_index;
+	hctx->flags = reg->flags;
+
+	if (!zalloc_cpumask_var(&hctx->cpumask, GFP_KERNEL))
+		goto fail;
+
+	hctx->ctxs = kmalloc_node(nr_cpu_ids * sizeof(void *), GFP_KERNEL,
+				  node);
+	hctx->ctx_map = kzalloc_node(BITS_TO_LONGS(nr_cpu_ids) *
+				     sizeof(unsigned long), GFP_KERNEL, node);
+	if (!hctx->ctxs || !hctx->ctx_map)
+		goto fail;
+
+	if (blk_mq_init_rq_map(hctx, reg))
+		goto fail;
+
+	if (reg->ops->init_hctx &&
+	    reg->ops->init_hctx(hctx, driver_data, hctx_index))
+		goto fail;
+
+	return 0;
+fail:
+	blk_mq_free_hw_queue(hctx);
+	return -ENOMEM;
+}
+
+static void blk_mq_map_swqueue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ctx = __blk_mq_get_ctx(q, cpu);
+		ctx->cpu = cpu;
+		ctx->queue = q;
+		spin_lock_init(&ctx->lock);
+		INIT_LIST_HEAD(&ctx->rq_list);
+
+		hctx = q->mq_ops->map_queue(q, cpu);
+		cpumask_set_cpu(cpu, hctx->cpumask);
+		ctx->index_hw = hctx->nr_ctx;
+		hctx->ctxs[hctx->nr_ctx++] = ctx;
+	}
+}
+
+/**
+ * blk_mq_init_queue - allocate a multi-queue request queue
+ * @reg:	the queues and the operations of the driver
+ * @driver_data: passed to ->init_hctx()
+ *
+ * Description:
+ *     Sets up a software queue for each possible CPU and @reg->nr_hw_queues
+ *     hardware queues of @reg->queue_depth requests each.  Requests are
+ *     staged on the software queue of the submitting CPU and all go
+ *     through ->queue_rq(); there is no request_fn and no elevator.
+ *
+ *     Returns the queue or an ERR_PTR().
+ */
+struct request_queue *blk_mq_init_queue(struct blk_mq_reg *reg,
+					void *driver_data)
+{
+	struct blk_mq_hw_ctx **hctxs;
+	struct blk_mq_ctx __percpu *ctx;
+	struct request_queue *q;
+	unsigned int i, j;
+
+	if (!reg->nr_hw_queues || !reg->ops->queue_rq ||
+	    !reg->ops->map_queue || !reg->ops->alloc_hctx ||
+	    !reg->ops->free_hctx)
+		return ERR_PTR(-EINVAL);
+
+	if (!reg->queue_depth)
+		reg->queue_depth = BLK_MQ_MAX_DEPTH;
+	else if (reg->queue_depth > BLK_MQ_MAX_DEPTH) {
+		printk(KERN_ERR "blk-mq: queue depth too large (%u)\n",
+		       reg->queue_depth);
+		reg->queue_depth = BLK_MQ_MAX_DEPTH;
+	}
+	if (reg->queue_depth <= reg->reserved_tags)
+		return ERR_PTR(-EINVAL);
+
+	/* more hardware queues than CPUs would never be used */
+	reg->nr_hw_queues = min_t(unsigned int, reg->nr_hw_queues, nr_cpu_ids);
+
+	ctx = alloc_percpu(struct blk_mq_ctx);
+	if (!ctx)
+		return ERR_PTR(-ENOMEM);
+
+	hctxs = kzalloc_node(reg->nr_hw_queues * sizeof(*hctxs), GFP_KERNEL,
+			     reg->numa_node);
+	if (!hctxs)
+		goto err_percpu;
+
+	for (i = 0; i < reg->nr_hw_queues; i++) {
+		hctxs[i] = reg->ops->alloc_hctx(reg, i);
+		if (!hctxs[i])
+			goto err_hctxs;
+		hctxs[i]->numa_node = reg->numa_node;
+	}
+
+	q = blk_alloc_queue_node(GFP_KERNEL, reg->numa_node);
+	if (!q)
+		goto err_hctxs;
+
+	q->mq_map = blk_mq_make_queue_map(reg);
+	if (!q->mq_map)
+		goto err_queue;
+
+	setup_timer(&q->timeout, blk_mq_rq_timer, (unsigned long) q);
+	blk_queue_rq_timeout(q, reg->timeout ? reg->timeout : 30 * HZ);
+
+	q->nr_queues = nr_cpu_ids;
+	q->nr_hw_queues = reg->nr_hw_queues;
+	q->queue_ctx = ctx;
+	q->queue_hw_ctx = hctxs;
+	q->mq_ops = reg->ops;
+	q->queue_flags |= QUEUE_FLAG_MQ_DEFAULT;
+	if (reg->ops->poll)
+		q->queue_flags |= 1 << QUEUE_FLAG_POLL;
+
+	blk_queue_make_request(q, blk_mq_make_request);
+	q->nr_requests = reg->queue_depth;
+
+	if (reg->ops->complete)
+		blk_queue_softirq_done(q, reg->ops->complete);
+	else
+		blk_queue_softirq_done(q, blk_mq_softirq_done);
+
+	for (i = 0; i < reg->nr_hw_queues; i++) {
+		if (blk_mq_init_hw_queue(q, hctxs[i], reg, driver_data, i))
+			goto err_init;
+	}
+
+	blk_mq_map_swqueue(q);
+	return q;
+
+err_init:
+	for (j = 0; j < i; j++) {
+		if (reg->ops->exit_hctx)
+			reg->ops->exit_hctx(hctxs[j], j);
+		blk_mq_free_hw_queue(hctxs[j]);
+	}
+	kfree(q->mq_map);
+err_queue:
+	/* the hardware queues are freed here, not by the queue release */
+	q->mq_ops = NULL;
+	q->queue_hw_ctx = NULL;
+	q->queue_ctx = NULL;
+	blk_cleanup_queue(q);
+err_hctxs:
+	for (i = 0; i < reg->nr_hw_queues; i++) {
+		if (!hctxs[i])
+			break;
+		reg->ops->free_hctx(hctxs[i], i);
+	}
+	kfree(hctxs);
+err_percpu:
+	free_percpu(ctx);
+	return ERR_PTR(-ENOMEM);
+}
+EXPORT_SYMBOL(blk_mq_init_queue);
+
+/*
+ * Called by blk_cleanup_queue() with @q marked dead, once it is drained
+ */
+void blk_mq_free_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		cancel_work_sync(&hctx->run_work);
+		cancel_delayed_work_sync(&hctx->delay_work);
+		if (q->mq_ops->exit_hctx)
+			q->mq_ops->exit_hctx(hctx, i);
+		blk_mq_free_hw_queue(hctx);
+		q->mq_ops->free_hctx(hctx, i);
+	}
+
+	kfree(q->queue_hw_ctx);
+	kfree(q->mq_map);
+	free_percpu(q->queue_ctx);
+
+	q->queue_hw_ctx = NULL;
+	q->mq_map = NULL;
+	q->queue_ctx = NULL;
+	q->nr_hw_queues = 0;
+}
+
+/*
+ * Run the queues until the driver has ended all the requests in flight
+ */
+void blk_mq_drain_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+	bool busy;
+
+	for (;;) {
+		blk_mq_run_queues(q, false);
+
+		busy = false;
+		queue_for_each_hw_ctx(q, hctx, i)
+			busy |= blk_mq_tags_busy(hctx->tags);
+		if (!busy)
+			break;
+
+		msleep(10);
+	}
+}
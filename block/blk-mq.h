@@ -0,0 +1,30 @@
+#ifndef INT_BLK_MQ_H
+#define INT_BLK_MQ_H
+
+/*
+ * A software queue, one per CPU.  Requests submitted on the CPU are staged
+ * here until the hardware queue it maps to is run.
+ */
+struct blk_mq_ctx {
+	struct {
+		spinlock_t		lock;
+		struct list_head	rq_list;
+	} ____cacheline_aligned_in_smp;
+
+	unsigned int		cpu;
+	unsigned int		index_hw;	/* bit in hctx->ctx_map */
+
+	struct request_queue	*queue;
+} ____cacheline_aligned_in_smp;
+
+void blk_mq_drain_queue(struct request_queue *q);
+void blk_mq_free_queue(struct request_queue *q);
+void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule);
+
+/*
+ * sysfs helpers
+ */
+int blk_mq_register_disk(struct gendisk *disk);
+void blk_mq_unregister_disk(struct gendisk *disk);
+
+#endif
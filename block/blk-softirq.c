@@ -36,30 +36,63 @@ static void blk_done_softirq(struct softirq_action *h)
 }
 
 #if defined(CONFIG_SMP) && defined(CONFIG_USE_GENERIC_SMP_HELPERS)
+/*
+ * Requests completed for another CPU while an IPI to it is on its way.
+ * Only the first request of a batch sends an IPI, the others are queued
+ * here and moved to blk_cpu_done with it.
+ */
+struct blk_cpu_remote {
+	spinlock_t		lock;
+	struct list_head	list;
+	bool			ipi_pending;
+};
+
+static DEFINE_PER_CPU(struct blk_cpu_remote, blk_cpu_remote);
+
 static void trigger_softirq(void *data)
 {
 	struct request *rq = data;
+	struct blk_cpu_remote *remote;
 	unsigned long flags;
 	struct list_head *list;
+	bool was_empty;
 
 	local_irq_save(flags);
 	list = &__get_cpu_var(blk_cpu_done);
+	was_empty = list_empty(list);
 	list_add_tail(&rq->csd.list, list);
 
-	if (list->next == &rq->csd.list)
+	remote = &__get_cpu_var(blk_cpu_remote);
+	spin_lock(&remote->lock);
+	list_splice_tail_init(&remote->list, list);
+	remote->ipi_pending = false;
+	spin_unlock(&remote->lock);
+
+	if (was_empty)
 		raise_softirq_irqoff(BLOCK_SOFTIRQ);
 
 	local_irq_restore(flags);
 }
 
 /*
- * Setup and invoke a run of 'trigger_softirq' on the given cpu.
+ * Setup and invoke a run of 'trigger_softirq' on the given cpu, unless
+ * one is already pending there.  Called with interrupts off.
  */
 static int raise_blk_irq(int cpu, struct request *rq)
 {
 	if (cpu_online(cpu)) {
+		struct blk_cpu_remote *remote = &per_cpu(blk_cpu_remote, cpu);
 		struct call_single_data *data = &rq->csd;
 
+		spin_lock(&remote->lock);
+		if (remote->ipi_pending) {
+			list_add_tail(&rq->csd.list, &remote->list);
+			spin_unlock(&remote->lock);
+			return 0;
+		}
+		remote->ipi_pending = true;
+		spin_unlock(&remote->lock);
+
 		data->func = trigger_softirq;
 		data->info = rq;
 		data->flags = 0;
@@ -70,11 +103,40 @@ static int raise_blk_irq(int cpu, struct request *rq)
 
 	return 1;
 }
+
+static void blk_cpu_remote_init(int cpu)
+{
+	struct blk_cpu_remote *remote = &per_cpu(blk_cpu_remote, cpu);
+
+	spin_lock_init(&remote->lock);
+	INIT_LIST_HEAD(&remote->list);
+}
+
+/*
+ * Called with interrupts off, for a CPU that is gone with its IPIs
+ */
+static void blk_cpu_remote_splice(int cpu, struct list_head *list)
+{
+	struct blk_cpu_remote *remote = &per_cpu(blk_cpu_remote, cpu);
+
+	spin_lock(&remote->lock);
+	list_splice_tail_init(&remote->list, list);
+	remote->ipi_pending = false;
+	spin_unlock(&remote->lock);
+}
 #else /* CONFIG_SMP && CONFIG_USE_GENERIC_SMP_HELPERS */
 static int raise_blk_irq(int cpu, struct request *rq)
 {
 	return 1;
 }
+
+static void blk_cpu_remote_init(int cpu)
+{
+}
+
+static void blk_cpu_remote_splice(int cpu, struct list_head *list)
+{
+}
 #endif
 
 static int __cpuinit blk_cpu_notify(struct notifier_block *self,
@@ -90,6 +152,7 @@ static int __cpuinit blk_cpu_notify(struct notifier_block *self,
 		local_irq_disable();
 		list_splice_init(&per_cpu(blk_cpu_done, cpu),
 				 &__get_cpu_var(blk_cpu_done));
+		blk_cpu_remote_splice(cpu, &__get_cpu_var(blk_cpu_done));
 		raise_softirq_irqoff(BLOCK_SOFTIRQ);
 		local_irq_enable();
 	}
@@ -168,8 +231,10 @@ static __init int blk_softirq_init(void)
 {
 	int i;
 
-	for_each_possible_cpu(i)
+	for_each_possible_cpu(i) {
 		INIT_LIST_HEAD(&per_cpu(blk_cpu_done, i));
+		blk_cpu_remote_init(i);
+	}
 
 	open_softirq(BLOCK_SOFTIRQ, blk_done_softirq);
 	register_hotcpu_notifier(&blk_cpu_notifier);
@@ -0,0 +1,400 @@
+/*
+ * Writeback throttling, by the latency of reads
+ *
+ * Background writeback queues writes as fast as the VM finds dirty pages,
+ * and on a device that serves one request at a time, like eMMC, a burst
+ * of it puts hundreds of writes ahead of every read.  This limits the
+ * requests background writeback has on a queue at a time: when the reads
+ * of a window take longer than a target latency while writes are going
+ * on, the limit is halved, down to one request, and it is doubled again
+ * when the reads are fast, or after a few windows without reads to tell.
+ *
+ * The latency of a read is taken from the allocation of its request to
+ * its end, so the time it waits behind writes in the queue counts.
+ *
+ * See Documentation/block/writeback-throttling.txt.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/slab.h>
+#include <linux/swap.h>
+#include <linux/math64.h>
+
+#include "blk.h"
+
+/* most requests background writeback has on a request_fn queue */
+#define RWB_DEF_DEPTH		16
+
+/* default target of the read latency */
+#define RWB_DEF_LAT_NONROT	(2ULL * NSEC_PER_MSEC)
+#define RWB_DEF_LAT_ROT		(75ULL * NSEC_PER_MSEC)
+
+/* how long the reads are looked at before the limit changes */
+#define RWB_WINDOW_MSECS	100
+
+/* windows without reads after which the limit is raised anyway */
+#define RWB_UNKNOWN_BUMP	5
+
+enum {
+	WBT_TRACKED	= 1,	/* a write counted in ->inflight */
+	WBT_READ	= 2,	/* a read whose latency is sampled */
+};
+
+struct rq_wb {
+	/*
+	 * The limit is 1 + ((max_depth - 1) >> scale_step), changed by the
+	 * window timer and sysfs under ->lock.
+	 */
+	unsigned int max_depth;
+	unsigned int scale_step;
+	unsigned int limit;
+	unsigned int unknown_cnt;
+
+	atomic_t inflight;
+	wait_queue_head_t wait;
+
+	u64 min_lat_nsec;		/* target, 0 if off */
+	struct timer_list window_timer;
+
+	spinlock_t lock;
+
+	/* the window going on */
+	u64 win_min_lat;
+	unsigned int win_reads;
+	unsigned int win_writes;
+
+	/* for wbt_stat */
+	u64 last_min_lat;
+	unsigned long reads;
+	unsigned long windows_slow;
+	unsigned long windows_ok;
+	unsigned long windows_unknown;
+	unsigned long throttled;
+};
+
+static inline bool rwb_enabled(struct rq_wb *rwb)
+{
+	return rwb && rwb->min_lat_nsec;
+}
+
+static void rwb_calc_limit(struct rq_wb *rwb)
+{
+	rwb->limit = 1 + ((rwb->max_depth - 1) >> rwb->scale_step);
+}
+
+static void rwb_scale_down(struct rq_wb *rwb)
+{
+	if (rwb->limit == 1)
+		return;
+
+	rwb->scale_step++;
+	rwb_calc_limit(rwb);
+}
+
+static void rwb_scale_up(struct rq_wb *rwb)
+{
+	if (!rwb->scale_step)
+		return;
+
+	rwb->scale_step--;
+	rwb_calc_limit(rwb);
+	wake_up_all(&rwb->wait);
+}
+
+static void rwb_arm_timer(struct rq_wb *rwb)
+{
+	if (!timer_pending(&rwb->window_timer))
+		mod_timer(&rwb->window_timer,
+			  jiffies + msecs_to_jiffies(RWB_WINDOW_MSECS));
+}
+
+/*
+ * Once a window: lower the limit if the fastest read of the window was
+ * slower than the target while writes were going on, raise it if it was
+ * fast enough.  Reads that are slow without writes are no business of
+ * ours, and are counted as unknown like windows without reads.
+ */
+static void wbt_window_timer(unsigned long data)
+{
+	struct rq_wb *rwb = (struct rq_wb *)data;
+	unsigned int reads, writes, inflight;
+	u64 min_lat;
+
+	inflight = atomic_read(&rwb->inflight);
+
+	spin_lock_irq(&rwb->lock);
+	reads = rwb->win_reads;
+	writes = rwb->win_writes;
+	min_lat = rwb->win_min_lat;
+	rwb->win_reads = 0;
+	rwb->win_writes = 0;
+
+	if (reads)
+		rwb->last_min_lat = min_lat;
+
+	if (!rwb->min_lat_nsec) {
+		/* off: sysfs has reset the limit */
+	} else if (reads && min_lat <= rwb->min_lat_nsec) {
+		rwb->windows_ok++;
+		rwb->unknown_cnt = 0;
+		rwb_scale_up(rwb);
+	} else if (reads && (writes || inflight)) {
+		rwb->windows_slow++;
+		rwb->unknown_cnt = 0;
+		rwb_scale_down(rwb);
+	} else {
+		rwb->windows_unknown++;
+		if (++rwb->unknown_cnt >= RWB_UNKNOWN_BUMP) {
+			rwb->unknown_cnt = 0;
+			rwb_scale_up(rwb);
+		}
+	}
+
+	if (rwb->scale_step || inflight)
+		rwb_arm_timer(rwb);
+	spin_unlock_irq(&rwb->lock);
+}
+
+static bool wbt_should_throttle(struct bio *bio)
+{
+	if (bio_data_dir(bio) != WRITE)
+		return false;
+
+	/* only writeback nobody waits for, not fsync or direct I/O */
+	if (bio->bi_rw & (REQ_SYNC | REQ_META | REQ_FLUSH | REQ_FUA |
+			  REQ_DISCARD))
+		return false;
+
+	/* kswapd writes pages out to free memory, don't hold it up */
+	return !current_is_kswapd();
+}
+
+static bool atomic_inc_below(atomic_t *v, int below)
+{
+	int cur = atomic_read(v);
+
+	for (;;) {
+		int old;
+
+		if (cur >= below)
+			return false;
+		old = atomic_cmpxchg(v, cur, cur + 1);
+		if (old == cur)
+			break;
+		cur = old;
+	}
+
+	return true;
+}
+
+/**
+ * wbt_wait - wait for room for the request of a bio
+ * @q:		the queue
+ * @bio:	the bio a request is allocated for
+ * @lock:	held on entry, dropped while sleeping, or %NULL
+ *
+ * Background writes wait here until the queue has less than the limit of
+ * them.  Returns what is to be accounted for the request, for wbt_track(),
+ * or for __wbt_done() if no request is allocated after all.
+ */
+unsigned int wbt_wait(struct request_queue *q, struct bio *bio,
+		      spinlock_t *lock)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	DEFINE_WAIT(wait);
+
+	if (!rwb_enabled(rwb))
+		return 0;
+	if (bio_data_dir(bio) == READ)
+		return WBT_READ;
+	if (!wbt_should_throttle(bio))
+		return 0;
+
+	if (!atomic_inc_below(&rwb->inflight, ACCESS_ONCE(rwb->limit))) {
+		rwb->throttled++;
+		do {
+			prepare_to_wait_exclusive(&rwb->wait, &wait,
+						  TASK_UNINTERRUPTIBLE);
+			if (atomic_inc_below(&rwb->inflight,
+					     ACCESS_ONCE(rwb->limit)))
+				break;
+
+			if (lock)
+				spin_unlock_irq(lock);
+			io_schedule();
+			if (lock)
+				spin_lock_irq(lock);
+		} while (1);
+		finish_wait(&rwb->wait, &wait);
+	}
+
+	rwb_arm_timer(rwb);
+	return WBT_TRACKED;
+}
+
+void wbt_track(struct request *rq, unsigned int wb_acct)
+{
+	rq->wbt_flags = wb_acct;
+	if (wb_acct & WBT_READ)
+		rq->wbt_start_ns = ktime_to_ns(ktime_get());
+}
+
+/*
+ * Give back the room of a write, of a request that ended or of one that
+ * was not allocated after wbt_wait()
+ */
+void __wbt_done(struct request_queue *q, unsigned int wb_acct)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	int inflight;
+
+	if (!(wb_acct & WBT_TRACKED))
+		return;
+
+	inflight = atomic_dec_return(&rwb->inflight);
+	if (inflight < (int)ACCESS_ONCE(rwb->limit) &&
+	    waitqueue_active(&rwb->wait))
+		wake_up(&rwb->wait);
+}
+
+/*
+ * Called when @rq is freed, from any context
+ */
+void wbt_done(struct request *rq)
+{
+	struct rq_wb *rwb = rq->q->rq_wb;
+	unsigned int wb_acct = rq->wbt_flags;
+	unsigned long flags;
+	u64 lat;
+
+	if (!wb_acct)
+		return;
+	rq->wbt_flags = 0;
+
+	spin_lock_irqsave(&rwb->lock, flags);
+	if (wb_acct & WBT_READ) {
+		lat = ktime_to_ns(ktime_get()) - rq->wbt_start_ns;
+		if (!rwb->win_reads || lat < rwb->win_min_lat)
+			rwb->win_min_lat = lat;
+		rwb->win_reads++;
+		rwb->reads++;
+	} else {
+		rwb->win_writes++;
+	}
+	spin_unlock_irqrestore(&rwb->lock, flags);
+
+	__wbt_done(rq->q, wb_acct);
+}
+
+/*
+ * Set up throttling of a request_fn or multi-queue queue, on by default
+ * with a target for flash or for disks.  Bio-based queues have no
+ * requests to limit, and a queue shared by disks is set up once.
+ */
+int wbt_init(struct request_queue *q)
+{
+	struct rq_wb *rwb;
+
+	if ((!q->request_fn && !q->mq_ops) || q->rq_wb)
+		return 0;
+
+	rwb = kzalloc_node(sizeof(*rwb), GFP_KERNEL, q->node);
+	if (!rwb)
+		return -ENOMEM;
+
+	if (q->mq_ops)
+		rwb->max_depth = q->queue_hw_ctx[0]->queue_depth;
+	else
+		rwb->max_depth = min_t(unsigned long, q->nr_requests,
+				       RWB_DEF_DEPTH);
+	rwb_calc_limit(rwb);
+
+	atomic_set(&rwb->inflight, 0);
+	init_waitqueue_head(&rwb->wait);
+	spin_lock_init(&rwb->lock);
+	setup_timer(&rwb->window_timer, wbt_window_timer, (unsigned long)rwb);
+
+	if (blk_queue_nonrot(q))
+		rwb->min_lat_nsec = RWB_DEF_LAT_NONROT;
+	else
+		rwb->min_lat_nsec = RWB_DEF_LAT_ROT;
+
+	q->rq_wb = rwb;
+	return 0;
+}
+
+void wbt_exit(struct request_queue *q)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (!rwb)
+		return;
+
+	del_timer_sync(&rwb->window_timer);
+	q->rq_wb = NULL;
+	kfree(rwb);
+}
+
+ssize_t wbt_lat_show(struct request_queue *q, char *page)
+{
+	u64 lat = 0;
+
+	if (q->rq_wb)
+		lat = div_u64(q->rq_wb->min_lat_nsec, NSEC_PER_USEC);
+
+	return sprintf(page, "%llu\n", (unsigned long long)lat);
+}
+
+/*
+ * A new target, in usecs, or 0 to stop throttling
+ */
+ssize_t wbt_lat_store(struct request_queue *q, const char *page, size_t count)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	unsigned long val;
+
+	if (!rwb)
+		return -EINVAL;
+
+	if (strict_strtoul(page, 10, &val))
+		return -EINVAL;
+
+	spin_lock_irq(&rwb->lock);
+	rwb->min_lat_nsec = (u64)val * NSEC_PER_USEC;
+	if (!val) {
+		rwb->scale_step = 0;
+		rwb->unknown_cnt = 0;
+		rwb_calc_limit(rwb);
+		wake_up_all(&rwb->wait);
+	}
+	spin_unlock_irq(&rwb->lock);
+
+	return count;
+}
+
+ssize_t wbt_stat_show(struct request_queue *q, char *page)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	ssize_t ret;
+
+	if (!rwb)
+		return -EINVAL;
+
+	spin_lock_irq(&rwb->lock);
+	ret = sprintf(page, "limit %u/%u scale_step %u inflight %d\n"
+			    "last_min_lat_usec %llu reads %lu\n"
+			    "windows slow %lu ok %lu unknown %lu\n"
+			    "throttled %lu\n",
+		      rwb->limit, rwb->max_depth, rwb->scale_step,
+		      atomic_read(&rwb->inflight),
+		      (unsigned long long)div_u64(rwb->last_min_lat,
+						  NSEC_PER_USEC),
+		      rwb->reads, rwb->windows_slow, rwb->windows_ok,
+		      rwb->windows_unknown, rwb->throttled);
+	spin_unlock_irq(&rwb->lock);
+
+	return ret;
+}
@@ -19,6 +19,12 @@ static inline void __blk_get_queue(struct request_queue *q)
 }
 
 void init_request_from_bio(struct request *req, struct bio *bio);
+void drive_stat_acct(struct request *rq, int new_io);
+bool bio_attempt_back_merge(struct request_queue *q, struct request *req,
+			    struct bio *bio);
+bool bio_attempt_front_merge(struct request_queue *q, struct request *req,
+			     struct bio *bio);
+void blk_account_io_done(struct request *req);
 void blk_rq_bio_prep(struct request_queue *q, struct request *rq,
 			struct bio *bio);
 int blk_rq_append_bio(struct request_queue *q, struct request *rq,
@@ -39,6 +45,8 @@ void __generic_unplug_device(struct request_queue *);
  */
 enum rq_atomic_flags {
 	REQ_ATOM_COMPLETE = 0,
+	REQ_ATOM_STARTED,	/* blk-mq: handed to the driver */
+	REQ_ATOM_POLL_SLEPT,	/* blk-mq: blk_poll() slept for it once */
 };
 
 /*
@@ -250,4 +258,33 @@ static inline void blk_throtl_exit(struct request_queue *q) { }
 static inline void blk_throtl_release(struct request_queue *q) { }
 #endif /* CONFIG_BLK_DEV_THROTTLING */
 
+/*
+ * Writeback throttling, blk-wbt.c
+ */
+#ifdef CONFIG_BLK_WBT
+extern unsigned int wbt_wait(struct request_queue *q, struct bio *bio,
+			     spinlock_t *lock);
+extern void wbt_track(struct request *rq, unsigned int wb_acct);
+extern void __wbt_done(struct request_queue *q, unsigned int wb_acct);
+extern void wbt_done(struct request *rq);
+extern int wbt_init(struct request_queue *q);
+extern void wbt_exit(struct request_queue *q);
+extern ssize_t wbt_lat_show(struct request_queue *q, char *page);
+extern ssize_t wbt_lat_store(struct request_queue *q, const char *page,
+			     size_t count);
+extern ssize_t wbt_stat_show(struct request_queue *q, char *page);
+#else /* CONFIG_BLK_WBT */
+static inline unsigned int wbt_wait(struct request_queue *q, struct bio *bio,
+				    spinlock_t *lock)
+{
+	return 0;
+}
+static inline void wbt_track(struct request *rq, unsigned int wb_acct) { }
+static inline void __wbt_done(struct request_queue *q,
+			      unsigned int wb_acct) { }
+static inline void wbt_done(struct request *rq) { }
+static inline int wbt_init(struct request_queue *q) { return 0; }
+static inline void wbt_exit(struct request_queue *q) { }
+#endif /* CONFIG_BLK_WBT */
+
 #endif /* BLK_INTERNAL_H */
@@ -0,0 +1,785 @@
+/*
+ * null_blk - a block device that does no I/O
+ *
+ * Requests complete right away, from softirq, or from a timer after a set
+ * time, without any data being moved.  This measures the overhead of the
+ * block layer itself, and the device can be set up with each of the three
+ * ways of queueing: bio-based, request_fn with the queue lock and the
+ * elevator, and multi-queue.  Optionally the data is kept in memory, like
+ * a ramdisk, and timer completions can be polled for with blk_poll().
+ * See Documentation/block/null_blk.txt.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/bio.h>
+#include <linux/hrtimer.h>
+#include <linux/highmem.h>
+#include <linux/radix-tree.h>
+#include <linux/log2.h>
+#include <linux/blk-mq.h>
+
+struct nullb_cmd {
+	struct list_head list;
+	unsigned int tag;
+	struct request *rq;
+	struct bio *bio;
+	struct nullb_queue *nq;
+	int error;
+	u64 deadline;		/* ns, of a timer completion */
+};
+
+/*
+ * Commands of the bio-based and request_fn modes, indexed by tag.  The
+ * multi-queue mode keeps its command after the request instead.
+ */
+struct nullb_queue {
+	struct nullb *nullb;
+	unsigned long *tag_map;
+	wait_queue_head_t wait;
+	unsigned int queue_depth;
+	struct nullb_cmd *cmds;
+};
+
+struct nullb {
+	struct list_head list;
+	unsigned int index;
+	struct request_queue *q;
+	struct gendisk *disk;
+	spinlock_t lock;
+
+	struct nullb_queue *queues;
+	unsigned int nr_queues;
+
+	/* the data of memory_backed devices, a page per index */
+	spinlock_t pages_lock;
+	struct radix_tree_root pages;
+};
+
+static LIST_HEAD(nullb_list);
+static struct mutex lock;
+static int null_major;
+static int nullb_indexes;
+
+/* commands to be ended by the timer of the CPU they were queued on */
+struct completion_queue {
+	struct list_head list;
+	struct hrtimer timer;
+};
+
+static DEFINE_PER_CPU(struct completion_queue, completion_queues);
+
+enum {
+	NULL_IRQ_NONE		= 0,
+	NULL_IRQ_SOFTIRQ	= 1,
+	NULL_IRQ_TIMER		= 2,
+
+	NULL_Q_BIO		= 0,
+	NULL_Q_RQ		= 1,
+	NULL_Q_MQ		= 2,
+};
+
+static int submit_queues = 1;
+module_param(submit_queues, int, S_IRUGO);
+MODULE_PARM_DESC(submit_queues, "Number of submission queues");
+
+static int home_node = NUMA_NO_NODE;
+module_param(home_node, int, S_IRUGO);
+MODULE_PARM_DESC(home_node, "Home node for the device");
+
+static int queue_mode = NULL_Q_MQ;
+module_param(queue_mode, int, S_IRUGO);
+MODULE_PARM_DESC(queue_mode, "Block interface to use (0=bio,1=rq,2=multiqueue)");
+
+static int gb = 250;
+module_param(gb, int, S_IRUGO);
+MODULE_PARM_DESC(gb, "Size in GB");
+
+static int bs = 512;
+module_param(bs, int, S_IRUGO);
+MODULE_PARM_DESC(bs, "Block size (in bytes)");
+
+static int nr_devices = 2;
+module_param(nr_devices, int, S_IRUGO);
+MODULE_PARM_DESC(nr_devices, "Number of devices to register");
+
+static int irqmode = NULL_IRQ_SOFTIRQ;
+module_param(irqmode, int, S_IRUGO);
+MODULE_PARM_DESC(irqmode, "IRQ completion handler. 0-none, 1-softirq, 2-timer");
+
+static int completion_nsec = 10000;
+module_param(completion_nsec, int, S_IRUGO);
+MODULE_PARM_DESC(completion_nsec, "Time in ns to complete a request in hardware. Default: 10,000ns");
+
+static int hw_queue_depth = 64;
+module_param(hw_queue_depth, int, S_IRUGO);
+MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each hardware queue. Default: 64");
+
+static bool memory_backed;
+module_param(memory_backed, bool, S_IRUGO);
+MODULE_PARM_DESC(memory_backed, "Keep the data written, like a ramdisk. Default: false");
+
+static void put_tag(struct nullb_queue *nq, unsigned int tag)
+{
+	clear_bit_unlock(tag, nq->tag_map);
+
+	if (waitqueue_active(&nq->wait))
+		wake_up(&nq->wait);
+}
+
+static unsigned int get_tag(struct nullb_queue *nq)
+{
+	unsigned int tag;
+
+	do {
+		tag = find_first_zero_bit(nq->tag_map, nq->queue_depth);
+		if (tag >= nq->queue_depth)
+			return -1U;
+	} while (test_and_set_bit_lock(tag, nq->tag_map));
+
+	return tag;
+}
+
+static void free_cmd(struct nullb_cmd *cmd)
+{
+	put_tag(cmd->nq, cmd->tag);
+}
+
+static struct nullb_cmd *__alloc_cmd(struct nullb_queue *nq)
+{
+	struct nullb_cmd *cmd;
+	unsigned int tag;
+
+	tag = get_tag(nq);
+	if (tag != -1U) {
+		cmd = &nq->cmds[tag];
+		cmd->tag = tag;
+		cmd->nq = nq;
+		return cmd;
+	}
+
+	return NULL;
+}
+
+static struct nullb_cmd *alloc_cmd(struct nullb_queue *nq, int can_wait)
+{
+	struct nullb_cmd *cmd;
+	DEFINE_WAIT(wait);
+
+	cmd = __alloc_cmd(nq);
+	if (cmd || !can_wait)
+		return cmd;
+
+	do {
+		prepare_to_wait(&nq->wait, &wait, TASK_UNINTERRUPTIBLE);
+		cmd = __alloc_cmd(nq);
+		if (cmd)
+			break;
+
+		io_schedule();
+	} while (1);
+
+	finish_wait(&nq->wait, &wait);
+	return cmd;
+}
+
+static void end_cmd(struct nullb_cmd *cmd)
+{
+	struct request_queue *q;
+	unsigned long flags;
+
+	switch (queue_mode) {
+	case NULL_Q_MQ:
+		blk_mq_end_io(cmd->rq, cmd->error);
+		return;
+	case NULL_Q_RQ:
+		q = cmd->rq->q;
+		blk_end_request_all(cmd->rq, cmd->error);
+		free_cmd(cmd);
+
+		/* the queue was stopped when it ran out of commands */
+		spin_lock_irqsave(q->queue_lock, flags);
+		if (blk_queue_stopped(q)) {
+			queue_flag_clear(QUEUE_FLAG_STOPPED, q);
+			blk_run_queue_async(q);
+		}
+		spin_unlock_irqrestore(q->queue_lock, flags);
+		return;
+	case NULL_Q_BIO:
+		bio_endio(cmd->bio, cmd->error);
+		free_cmd(cmd);
+		return;
+	}
+}
+
+static enum hrtimer_restart null_cmd_timer_expired(struct hrtimer *timer)
+{
+	struct completion_queue *cq;
+	struct nullb_cmd *cmd;
+	LIST_HEAD(list);
+
+	cq = &per_cpu(completion_queues, smp_processor_id());
+
+	/* interrupts are off, nothing is added to the list meanwhile */
+	list_splice_init(&cq->list, &list);
+	while (!list_empty(&list)) {
+		cmd = list_first_entry(&list, struct nullb_cmd, list);
+		list_del(&cmd->list);
+		end_cmd(cmd);
+	}
+
+	return HRTIMER_NORESTART;
+}
+
+static void null_cmd_end_timer(struct nullb_cmd *cmd)
+{
+	struct completion_queue *cq;
+	unsigned long flags;
+
+	cmd->deadline = ktime_to_ns(ktime_get()) + completion_nsec;
+
+	local_irq_save(flags);
+	cq = &__get_cpu_var(completion_queues);
+	if (list_empty(&cq->list))
+		hrtimer_start(&cq->timer, ktime_set(0, completion_nsec),
+			      HRTIMER_MODE_REL_PINNED);
+	list_add_tail(&cmd->list, &cq->list);
+	local_irq_restore(flags);
+}
+
+/*
+ * Reap the timer completions of this CPU that are due, as the timer
+ * would.  The list is in the order of the deadlines, which all are
+ * completion_nsec after queueing.  Returns 1 if the command of @tag
+ * was among them.
+ */
+static int null_poll(struct blk_mq_hw_ctx *hctx, unsigned int tag)
+{
+	struct completion_queue *cq;
+	struct nullb_cmd *cmd, *next;
+	unsigned long flags;
+	LIST_HEAD(list);
+	int found = 0;
+	u64 now;
+
+	now = ktime_to_ns(ktime_get());
+
+	local_irq_save(flags);
+	cq = &__get_cpu_var(completion_queues);
+	list_for_each_entry_safe(cmd, next, &cq->list, list) {
+		if (cmd->deadline > now)
+			break;
+		list_move_tail(&cmd->list, &list);
+	}
+	local_irq_restore(flags);
+
+	while (!list_empty(&list)) {
+		cmd = list_first_entry(&list, struct nullb_cmd, list);
+		list_del(&cmd->list);
+		if (cmd->nq == hctx->driver_data && cmd->rq->tag == tag)
+			found = 1;
+		end_cmd(cmd);
+	}
+
+	return found;
+}
+
+static struct page *null_lookup_page(struct nullb *nullb, pgoff_t idx,
+				     bool alloc)
+{
+	struct page *page;
+
+	spin_lock(&nullb->pages_lock);
+	page = radix_tree_lookup(&nullb->pages, idx);
+	if (!page && alloc) {
+		/* may be called with preemption off, from ->queue_rq() */
+		page = alloc_page(GFP_ATOMIC | __GFP_HIGHMEM | __GFP_ZERO);
+		if (page && radix_tree_insert(&nullb->pages, idx, page)) {
+			__free_page(page);
+			page = NULL;
+		} else if (page) {
+			page->index = idx;
+		}
+	}
+	spin_unlock(&nullb->pages_lock);
+
+	return page;
+}
+
+static void null_free_pages(struct nullb *nullb)
+{
+	struct page *pages[16];
+	unsigned long pos = 0;
+	int nr, i;
+
+	do {
+		nr = radix_tree_gang_lookup(&nullb->pages, (void **)pages,
+					    pos, ARRAY_SIZE(pages));
+		for (i = 0; i < nr; i++) {
+			pos = pages[i]->index;
+			radix_tree_delete(&nullb->pages, pos);
+			__free_page(pages[i]);
+		}
+		pos++;
+	} while (nr == ARRAY_SIZE(pages));
+}
+
+/*
+ * Copy a segment from or to the pages of a memory_backed device.  Sectors
+ * never written read as zeroes.
+ */
+static int null_transfer(struct nullb *nullb, struct page *page,
+			 unsigned int len, unsigned int off, bool is_write,
+			 sector_t sector)
+{
+	while (len) {
+		pgoff_t idx = sector >> (PAGE_SHIFT - 9);
+		unsigned int poff = (sector & ((PAGE_SIZE >> 9) - 1)) << 9;
+		unsigned int n = min_t(unsigned int, len, PAGE_SIZE - poff);
+		struct page *store;
+		void *mem, *data;
+
+		store = null_lookup_page(nullb, idx, is_write);
+		if (is_write && !store)
+			return -ENOMEM;
+
+		mem = kmap_atomic(page, KM_USER0);
+		if (store) {
+			data = kmap_atomic(store, KM_USER1);
+			if (is_write)
+				memcpy(data + poff, mem + off, n);
+			else
+				memcpy(mem + off, data + poff, n);
+			kunmap_atomic(data, KM_USER1);
+		} else {
+			memset(mem + off, 0, n);
+		}
+		kunmap_atomic(mem, KM_USER0);
+
+		if (!is_write)
+			flush_dcache_page(page);
+
+		len -= n;
+		off += n;
+		sector += n >> 9;
+	}
+
+	return 0;
+}
+
+static int null_transfer_cmd(struct nullb *nullb, struct nullb_cmd *cmd)
+{
+	struct bio_vec *bvec;
+	sector_t sector;
+	int err = 0;
+
+	if (queue_mode == NULL_Q_BIO) {
+		struct bio *bio = cmd->bio;
+		bool is_write = bio_data_dir(bio) == WRITE;
+		int i;
+
+		sector = bio->bi_sector;
+		bio_for_each_segment(bvec, bio, i) {
+			err = null_transfer(nullb, bvec->bv_page, bvec->bv_len,
+					    bvec->bv_offset, is_write, sector);
+			if (err)
+				break;
+			sector += bvec->bv_len >> 9;
+		}
+	} else {
+		struct request *rq = cmd->rq;
+		bool is_write = rq_data_dir(rq) == WRITE;
+		struct req_iterator iter;
+
+		sector = blk_rq_pos(rq);
+		rq_for_each_segment(bvec, rq, iter) {
+			err = null_transfer(nullb, bvec->bv_page, bvec->bv_len,
+					    bvec->bv_offset, is_write, sector);
+			if (err)
+				break;
+			sector += bvec->bv_len >> 9;
+		}
+	}
+
+	return err;
+}
+
+static void null_softirq_done_fn(struct request *rq)
+{
+	if (queue_mode == NULL_Q_MQ)
+		end_cmd(blk_mq_rq_to_pdu(rq));
+	else
+		end_cmd(rq->special);
+}
+
+static inline void null_handle_cmd(struct nullb_cmd *cmd)
+{
+	cmd->error = 0;
+	if (memory_backed)
+		cmd->error = null_transfer_cmd(cmd->nq->nullb, cmd);
+
+	/* complete IO by inline, softirq or timer */
+	switch (irqmode) {
+	case NULL_IRQ_SOFTIRQ:
+		switch (queue_mode) {
+		case NULL_Q_MQ:
+			blk_mq_complete_request(cmd->rq);
+			break;
+		case NULL_Q_RQ:
+			blk_complete_request(cmd->rq);
+			break;
+		case NULL_Q_BIO:
+			/* a bio has no softirq completion, end it inline */
+			end_cmd(cmd);
+			break;
+		}
+		break;
+	case NULL_IRQ_NONE:
+		end_cmd(cmd);
+		break;
+	case NULL_IRQ_TIMER:
+		null_cmd_end_timer(cmd);
+		break;
+	}
+}
+
+static struct nullb_queue *nullb_to_queue(struct nullb *nullb)
+{
+	int index = 0;
+
+	if (nullb->nr_queues != 1)
+		index = raw_smp_processor_id() /
+			((nr_cpu_ids + nullb->nr_queues - 1) / nullb->nr_queues);
+
+	return &nullb->queues[index];
+}
+
+static void null_queue_bio(struct request_queue *q, struct bio *bio)
+{
+	struct nullb *nullb = q->queuedata;
+	struct nullb_queue *nq = nullb_to_queue(nullb);
+	struct nullb_cmd *cmd;
+
+	cmd = alloc_cmd(nq, 1);
+	cmd->bio = bio;
+
+	null_handle_cmd(cmd);
+}
+
+static int null_rq_prep_fn(struct request_queue *q, struct request *req)
+{
+	struct nullb *nullb = q->queuedata;
+	struct nullb_queue *nq = nullb_to_queue(nullb);
+	struct nullb_cmd *cmd;
+
+	cmd = alloc_cmd(nq, 0);
+	if (cmd) {
+		cmd->rq = req;
+		req->special = cmd;
+		return BLKPREP_OK;
+	}
+
+	blk_stop_queue(q);
+	return BLKPREP_DEFER;
+}
+
+static void null_request_fn(struct request_queue *q)
+{
+	struct request *rq;
+
+	while ((rq = blk_fetch_request(q)) != NULL) {
+		struct nullb_cmd *cmd = rq->special;
+
+		spin_unlock_irq(q->queue_lock);
+		null_handle_cmd(cmd);
+		spin_lock_irq(q->queue_lock);
+	}
+}
+
+static int null_queue_rq(struct blk_mq_hw_ctx *hctx, struct request *rq)
+{
+	struct nullb_cmd *cmd = blk_mq_rq_to_pdu(rq);
+
+	cmd->rq = rq;
+	cmd->nq = hctx->driver_data;
+
+	null_handle_cmd(cmd);
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+static int null_init_hctx(struct blk_mq_hw_ctx *hctx, void *data,
+			  unsigned int index)
+{
+	struct nullb *nullb = data;
+
+	hctx->driver_data = &nullb->queues[index];
+	return 0;
+}
+
+static struct blk_mq_ops null_mq_ops = {
+	.queue_rq	= null_queue_rq,
+	.map_queue	= blk_mq_map_queue,
+	.init_hctx	= null_init_hctx,
+	.complete	= null_softirq_done_fn,
+	.alloc_hctx	= blk_mq_alloc_single_hw_queue,
+	.free_hctx	= blk_mq_free_single_hw_queue,
+};
+
+static struct blk_mq_reg null_mq_reg = {
+	.ops		= &null_mq_ops,
+	.queue_depth	= 64,
+	.cmd_size	= sizeof(struct nullb_cmd),
+	.flags		= BLK_MQ_F_SHOULD_MERGE,
+};
+
+static void null_del_dev(struct nullb *nullb)
+{
+	list_del_init(&nullb->list);
+
+	del_gendisk(nullb->disk);
+	blk_cleanup_queue(nullb->q);
+	put_disk(nullb->disk);
+	null_free_pages(nullb);
+}
+
+static const struct block_device_operations null_fops = {
+	.owner		= THIS_MODULE,
+};
+
+static int setup_commands(struct nullb_queue *nq)
+{
+	unsigned int i;
+
+	nq->cmds = kzalloc(nq->queue_depth * sizeof(*nq->cmds), GFP_KERNEL);
+	if (!nq->cmds)
+		return -ENOMEM;
+
+	nq->tag_map = kzalloc(BITS_TO_LONGS(nq->queue_depth) *
+			      sizeof(unsigned long), GFP_KERNEL);
+	if (!nq->tag_map) {
+		kfree(nq->cmds);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < nq->queue_depth; i++)
+		INIT_LIST_HEAD(&nq->cmds[i].list);
+
+	return 0;
+}
+
+static void cleanup_queues(struct nullb *nullb)
+{
+	unsigned int i;
+
+	for (i = 0; i < nullb->nr_queues; i++) {
+		kfree(nullb->queues[i].cmds);
+		kfree(nullb->queues[i].tag_map);
+	}
+
+	kfree(nullb->queues);
+}
+
+/*
+ * One queue of commands per submission queue, only used for their tags
+ * in the bio-based and request_fn modes.  The request_fn mode has a
+ * single queue, as requests are fetched under the queue lock anyway.
+ */
+static int setup_queues(struct nullb *nullb)
+{
+	unsigned int i;
+
+	nullb->nr_queues = queue_mode == NULL_Q_RQ ? 1 : submit_queues;
+	nullb->queues = kzalloc(nullb->nr_queues * sizeof(struct nullb_queue),
+				GFP_KERNEL);
+	if (!nullb->queues)
+		return -ENOMEM;
+
+	for (i = 0; i < nullb->nr_queues; i++) {
+		struct nullb_queue *nq = &nullb->queues[i];
+
+		init_waitqueue_head(&nq->wait);
+		nq->nullb = nullb;
+		nq->queue_depth = hw_queue_depth;
+
+		if (queue_mode == NULL_Q_MQ)
+			continue;
+
+		if (setup_commands(nq)) {
+			cleanup_queues(nullb);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static int null_add_dev(void)
+{
+	struct gendisk *disk;
+	struct nullb *nullb;
+	sector_t size;
+
+	nullb = kzalloc_node(sizeof(*nullb), GFP_KERNEL, home_node);
+	if (!nullb)
+		return -ENOMEM;
+
+	spin_lock_init(&nullb->lock);
+	spin_lock_init(&nullb->pages_lock);
+	INIT_RADIX_TREE(&nullb->pages, GFP_ATOMIC);
+
+	if (setup_queues(nullb))
+		goto err;
+
+	if (queue_mode == NULL_Q_MQ) {
+		null_mq_reg.numa_node = home_node;
+		null_mq_reg.queue_depth = hw_queue_depth;
+		null_mq_reg.nr_hw_queues = submit_queues;
+
+		nullb->q = blk_mq_init_queue(&null_mq_reg, nullb);
+		if (IS_ERR(nullb->q))
+			nullb->q = NULL;
+	} else if (queue_mode == NULL_Q_BIO) {
+		nullb->q = blk_alloc_queue_node(GFP_KERNEL, home_node);
+		if (nullb->q)
+			blk_queue_make_request(nullb->q, null_queue_bio);
+	} else {
+		nullb->q = blk_init_queue_node(null_request_fn, &nullb->lock,
+					       home_node);
+		if (nullb->q) {
+			blk_queue_prep_rq(nullb->q, null_rq_prep_fn);
+			blk_queue_softirq_done(nullb->q, null_softirq_done_fn);
+		}
+	}
+
+	if (!nullb->q)
+		goto queue_fail;
+
+	nullb->q->queuedata = nullb;
+	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, nullb->q);
+
+	disk = nullb->disk = alloc_disk_node(1, home_node);
+	if (!disk)
+		goto disk_fail;
+
+	mutex_lock(&lock);
+	list_add_tail(&nullb->list, &nullb_list);
+	nullb->index = nullb_indexes++;
+	mutex_unlock(&lock);
+
+	blk_queue_logical_block_size(nullb->q, bs);
+	blk_queue_physical_block_size(nullb->q, bs);
+
+	size = gb * 1024 * 1024 * 1024ULL;
+	sector_div(size, bs);
+	set_capacity(disk, size * (bs >> 9));
+
+	disk->flags |= GENHD_FL_EXT_DEVT;
+	disk->major		= null_major;
+	disk->first_minor	= nullb->index;
+	disk->fops		= &null_fops;
+	disk->private_data	= nullb;
+	disk->queue		= nullb->q;
+	sprintf(disk->disk_name, "nullb%d", nullb->index);
+	add_disk(disk);
+	return 0;
+
+disk_fail:
+	blk_cleanup_queue(nullb->q);
+queue_fail:
+	cleanup_queues(nullb);
+err:
+	kfree(nullb);
+	return -ENOMEM;
+}
+
+static void null_del_devs(void)
+{
+	struct nullb *nullb;
+	unsigned int cpu;
+
+	mutex_lock(&lock);
+	while (!list_empty(&nullb_list)) {
+		nullb = list_entry(nullb_list.next, struct nullb, list);
+		null_del_dev(nullb);
+		cleanup_queues(nullb);
+		kfree(nullb);
+	}
+	mutex_unlock(&lock);
+
+	if (irqmode == NULL_IRQ_TIMER)
+		for_each_possible_cpu(cpu)
+			hrtimer_cancel(&per_cpu(completion_queues, cpu).timer);
+}
+
+static int __init null_init(void)
+{
+	unsigned int i;
+
+	if (bs > PAGE_SIZE || bs < 512 || !is_power_of_2(bs)) {
+		pr_warn("null_blk: invalid block size %d, using 512\n", bs);
+		bs = 512;
+	}
+
+	if (queue_mode == NULL_Q_MQ) {
+		if (submit_queues < 1 || submit_queues > nr_cpu_ids)
+			submit_queues = nr_cpu_ids;
+	} else if (submit_queues < 1 || submit_queues > nr_cpu_ids) {
+		submit_queues = 1;
+	}
+
+	if (hw_queue_depth < 1 || hw_queue_depth > BLK_MQ_MAX_DEPTH)
+		hw_queue_depth = 64;
+
+	/* only timer completions take long enough to be worth polling */
+	if (irqmode == NULL_IRQ_TIMER)
+		null_mq_ops.poll = null_poll;
+
+	mutex_init(&lock);
+
+	/* initialize a completion queue for each cpu */
+	for_each_possible_cpu(i) {
+		struct completion_queue *cq = &per_cpu(completion_queues, i);
+
+		INIT_LIST_HEAD(&cq->list);
+
+		if (irqmode != NULL_IRQ_TIMER)
+			continue;
+
+		hrtimer_init(&cq->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		cq->timer.function = null_cmd_timer_expired;
+	}
+
+	null_major = register_blkdev(0, "nullb");
+	if (null_major < 0)
+		return null_major;
+
+	for (i = 0; i < nr_devices; i++) {
+		if (null_add_dev()) {
+			null_del_devs();
+			unregister_blkdev(null_major, "nullb");
+			return -ENOMEM;
+		}
+	}
+
+	pr_info("null: module loaded\n");
+	return 0;
+}
+
+static void __exit null_exit(void)
+{
+	null_del_devs();
+	unregister_blkdev(null_major, "nullb");
+}
+
+module_init(null_init);
+module_exit(null_exit);
+
+MODULE_LICENSE("GPL");
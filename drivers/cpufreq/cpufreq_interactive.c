@@ -44,6 +44,7 @@ struct cpufreq_interactive_cpuinfo {
 	u64 time_in_idle_timestamp;
 	u64 cputime_speedadj;
 	u64 cputime_speedadj_timestamp;
+	u64 boost_runtime;
 	struct cpufreq_policy *policy;
 	struct cpufreq_frequency_table *freq_table;
 	unsigned int target_freq;
@@ -148,6 +149,7 @@ static void cpufreq_interactive_timer_resched(
 	pcpu->time_in_idle =
 		get_cpu_idle_time_us(smp_processor_id(),
 				     &pcpu->time_in_idle_timestamp);
+	pcpu->boost_runtime = sched_boost_runtime(smp_processor_id());
 	pcpu->cputime_speedadj = 0;
 	pcpu->cputime_speedadj_timestamp = pcpu->time_in_idle_timestamp;
 	expires = jiffies + usecs_to_jiffies(timer_rate);
@@ -273,23 +275,36 @@ static u64 update_load(int cpu)
 	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
 	u64 now;
 	u64 now_idle;
+	u64 now_boost;
 	unsigned int delta_idle;
 	unsigned int delta_time;
 	u64 active_time;
+	u64 boost_time;
 
 	now_idle = get_cpu_idle_time_us(cpu, &now);
+	now_boost = sched_boost_runtime(cpu);
 	delta_idle = (unsigned int)(now_idle - pcpu->time_in_idle);
 	delta_time = (unsigned int)(now - pcpu->time_in_idle_timestamp);
+	boost_time = div_u64(now_boost - pcpu->boost_runtime, NSEC_PER_USEC);
 
 	if (delta_time <= delta_idle)
 		active_time = 0;
 	else
 		active_time = delta_time - delta_idle;
 
+	/*
+	 * Tasks in boosted cgroups get a margin towards full load: the idle
+	 * time counts as active in proportion to their average boost.
+	 */
+	if (boost_time && active_time)
+		active_time += div_u64(min(boost_time, active_time) * delta_idle,
+				       (u32)active_time);
+
 	pcpu->cputime_speedadj += active_time * pcpu->policy->cur;
 
 	pcpu->time_in_idle = now_idle;
 	pcpu->time_in_idle_timestamp = now;
+	pcpu->boost_runtime = now_boost;
 	return now;
 }
 
@@ -956,6 +971,14 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 				ktime_to_us(ktime_get());
 			pcpu->hispeed_validate_time =
 				pcpu->floor_validate_time;
+			/* the first window starts now, boost included */
+			pcpu->time_in_idle =
+				get_cpu_idle_time_us(j,
+					&pcpu->time_in_idle_timestamp);
+			pcpu->boost_runtime = sched_boost_runtime(j);
+			pcpu->cputime_speedadj = 0;
+			pcpu->cputime_speedadj_timestamp =
+				pcpu->time_in_idle_timestamp;
 			down_write(&pcpu->enable_sem);
 			expires = jiffies + usecs_to_jiffies(timer_rate);
 			pcpu->cpu_timer.expires = expires;
@@ -0,0 +1,188 @@
+/*
+ * devfreq-dummy.c - software only devfreq device
+ *
+ * Registers a "devfreq-dummy" platform device whose load is set from
+ * user space, so that the devfreq core and its governors can be
+ * exercised without any real hardware:
+ *
+ *   echo 95 > /sys/devices/platform/devfreq-dummy/load
+ *   cat /sys/class/devfreq/devfreq-dummy/cur_freq
+ *
+ * The device runs at one of the frequencies in freq_table[] and reports
+ * a busy time of load percent of the elapsed time at every poll.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/jiffies.h>
+#include <linux/platform_device.h>
+#include <linux/devfreq.h>
+
+#define DUMMY_NAME	"devfreq-dummy"
+
+static const unsigned long freq_table[] = {
+	100000000, 200000000, 300000000, 400000000,
+};
+
+static char *governor = "simple_ondemand";
+module_param(governor, charp, 0444);
+MODULE_PARM_DESC(governor, "initial devfreq governor");
+
+static unsigned int polling_ms = 100;
+module_param(polling_ms, uint, 0444);
+MODULE_PARM_DESC(polling_ms, "devfreq polling interval in ms");
+
+struct dummy_devfreq {
+	struct devfreq		*devfreq;
+	struct devfreq_dev_profile profile;
+	unsigned long		cur_freq;
+	unsigned int		load;		/* percent */
+	unsigned long		last_poll;	/* jiffies */
+};
+
+static struct platform_device *dummy_pdev;
+
+static int dummy_target(struct device *dev, unsigned long *freq)
+{
+	struct dummy_devfreq *dd = dev_get_drvdata(dev);
+	int i;
+
+	/* lowest frequency at or above the request, or the highest one */
+	for (i = 0; i < ARRAY_SIZE(freq_table) - 1; i++)
+		if (freq_table[i] >= *freq)
+			break;
+
+	if (dd->cur_freq != freq_table[i])
+		dev_dbg(dev, "%lu -> %lu Hz\n", dd->cur_freq, freq_table[i]);
+	dd->cur_freq = freq_table[i];
+	*freq = dd->cur_freq;
+	return 0;
+}
+
+static int dummy_get_dev_status(struct device *dev,
+				struct devfreq_dev_status *stat)
+{
+	struct dummy_devfreq *dd = dev_get_drvdata(dev);
+	unsigned long now = jiffies;
+
+	stat->total_time = jiffies_to_usecs(now - dd->last_poll);
+	stat->busy_time = stat->total_time / 100 * ACCESS_ONCE(dd->load);
+	stat->current_frequency = dd->cur_freq;
+	dd->last_poll = now;
+	return 0;
+}
+
+static ssize_t show_load(struct device *dev, struct device_attribute *attr,
+			 char *buf)
+{
+	struct dummy_devfreq *dd = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", dd->load);
+}
+
+static ssize_t store_load(struct device *dev, struct device_attribute *attr,
+			  const char *buf, size_t count)
+{
+	struct dummy_devfreq *dd = dev_get_drvdata(dev);
+	unsigned int load;
+
+	if (sscanf(buf, "%u", &load) != 1 || load > 100)
+		return -EINVAL;
+
+	dd->load = load;
+	return count;
+}
+
+static DEVICE_ATTR(load, 0644, show_load, store_load);
+
+static int __devinit dummy_devfreq_probe(struct platform_device *pdev)
+{
+	struct dummy_devfreq *dd;
+	int ret;
+
+	dd = kzalloc(sizeof(*dd), GFP_KERNEL);
+	if (!dd)
+		return -ENOMEM;
+
+	dd->cur_freq = freq_table[0];
+	dd->last_poll = jiffies;
+	dd->profile.initial_freq = dd->cur_freq;
+	dd->profile.polling_ms = polling_ms;
+	dd->profile.target = dummy_target;
+	dd->profile.get_dev_status = dummy_get_dev_status;
+	platform_set_drvdata(pdev, dd);
+
+	ret = device_create_file(&pdev->dev, &dev_attr_load);
+	if (ret)
+		goto err_free;
+
+	dd->devfreq = devfreq_add_device(&pdev->dev, &dd->profile,
+					 governor, NULL);
+	if (IS_ERR(dd->devfreq)) {
+		ret = PTR_ERR(dd->devfreq);
+		goto err_remove_file;
+	}
+
+	return 0;
+
+err_remove_file:
+	device_remove_file(&pdev->dev, &dev_attr_load);
+err_free:
+	platform_set_drvdata(pdev, NULL);
+	kfree(dd);
+	return ret;
+}
+
+static int __devexit dummy_devfreq_remove(struct platform_device *pdev)
+{
+	struct dummy_devfreq *dd = platform_get_drvdata(pdev);
+
+	devfreq_remove_device(dd->devfreq);
+	device_remove_file(&pdev->dev, &dev_attr_load);
+	platform_set_drvdata(pdev, NULL);
+	kfree(dd);
+	return 0;
+}
+
+static struct platform_driver dummy_devfreq_driver = {
+	.probe	= dummy_devfreq_probe,
+	.remove	= __devexit_p(dummy_devfreq_remove),
+	.driver	= {
+		.name	= DUMMY_NAME,
+		.owner	= THIS_MODULE,
+	},
+};
+
+static int __init dummy_devfreq_init(void)
+{
+	int ret;
+
+	ret = platform_driver_register(&dummy_devfreq_driver);
+	if (ret)
+		return ret;
+
+	dummy_pdev = platform_device_register_simple(DUMMY_NAME, -1, NULL, 0);
+	if (IS_ERR(dummy_pdev)) {
+		platform_driver_unregister(&dummy_devfreq_driver);
+		return PTR_ERR(dummy_pdev);
+	}
+	return 0;
+}
+late_initcall(dummy_devfreq_init);
+
+static void __exit dummy_devfreq_exit(void)
+{
+	platform_device_unregister(dummy_pdev);
+	platform_driver_unregister(&dummy_devfreq_driver);
+}
+module_exit(dummy_devfreq_exit);
+
+MODULE_DESCRIPTION("Software only devfreq device for governor testing");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,562 @@
+/*
+ * devfreq: Generic Dynamic Voltage and Frequency Scaling (DVFS) Framework
+ *	    for Non-CPU Devices.
+ *
+ * Every registered device is polled from a freezable delayed work at
+ * its profile's polling interval. The governor attached to the device
+ * turns the reported busy/total time into a frequency, which is then
+ * clamped to the user limits and handed to the profile's target().
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/errno.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/stat.h>
+#include <linux/opp.h>
+#include <linux/devfreq.h>
+#include <linux/workqueue.h>
+#include <linux/platform_device.h>
+#include <linux/list.h>
+#include <linux/printk.h>
+#include "governor.h"
+
+static struct class *devfreq_class;
+
+/* Polls all the devfreq devices, freezes during suspend */
+static struct workqueue_struct *devfreq_wq;
+
+/* The list of all device-devfreq and governors */
+static LIST_HEAD(devfreq_list);
+static LIST_HEAD(devfreq_governor_list);
+static DEFINE_MUTEX(devfreq_list_lock);
+
+/**
+ * find_devfreq_governor() - find devfreq governor from name
+ * @name:	name of the governor
+ *
+ * Must be called with devfreq_list_lock held.
+ */
+static struct devfreq_governor *find_devfreq_governor(const char *name)
+{
+	struct devfreq_governor *tmp_governor;
+
+	if (IS_ERR_OR_NULL(name)) {
+		pr_err("DEVFREQ: %s: Invalid parameters\n", __func__);
+		return ERR_PTR(-EINVAL);
+	}
+	WARN(!mutex_is_locked(&devfreq_list_lock),
+	     "devfreq_list_lock must be locked.");
+
+	list_for_each_entry(tmp_governor, &devfreq_governor_list, node) {
+		if (!strncmp(tmp_governor->name, name, DEVFREQ_NAME_LEN))
+			return tmp_governor;
+	}
+
+	return ERR_PTR(-ENODEV);
+}
+
+/**
+ * update_devfreq() - Reevaluate the device and configure frequency.
+ * @devfreq:	the devfreq instance.
+ *
+ * Note: Lock devfreq->lock before calling update_devfreq
+ *	 This function is exported for governors.
+ */
+int update_devfreq(struct devfreq *devfreq)
+{
+	unsigned long freq;
+	int err = 0;
+
+	if (!mutex_is_locked(&devfreq->lock)) {
+		WARN(true, "devfreq->lock must be locked by the caller.\n");
+		return -EINVAL;
+	}
+
+	if (!devfreq->governor)
+		return -EINVAL;
+
+	/* Reevaluate the proper frequency */
+	err = devfreq->governor->get_target_freq(devfreq, &freq);
+	if (err)
+		return err;
+
+	/* Apply the limits set from user space */
+	if (devfreq->max_freq && freq > devfreq->max_freq)
+		freq = devfreq->max_freq;
+	if (devfreq->min_freq && freq < devfreq->min_freq)
+		freq = devfreq->min_freq;
+
+	err = devfreq->profile->target(devfreq->dev.parent, &freq);
+	if (err)
+		return err;
+
+	if (freq != devfreq->previous_freq)
+		devfreq->nr_transitions++;
+	devfreq->previous_freq = freq;
+	return err;
+}
+EXPORT_SYMBOL(update_devfreq);
+
+/**
+ * devfreq_monitor() - Periodically poll devfreq objects.
+ * @work:	the work struct used to run devfreq_monitor periodically.
+ */
+static void devfreq_monitor(struct work_struct *work)
+{
+	struct devfreq *devfreq = container_of(work, struct devfreq,
+					       work.work);
+	int err;
+
+	mutex_lock(&devfreq->lock);
+	if (devfreq->stop_polling)
+		goto out;
+
+	/* no governor while store_governor() switches them */
+	err = devfreq->governor ? update_devfreq(devfreq) : 0;
+	if (err)
+		dev_err(&devfreq->dev, "dvfs failed with (%d) error\n", err);
+
+	if (devfreq->profile->polling_ms)
+		queue_delayed_work(devfreq_wq, &devfreq->work,
+			msecs_to_jiffies(devfreq->profile->polling_ms));
+out:
+	mutex_unlock(&devfreq->lock);
+}
+
+/**
+ * devfreq_dev_release() - Callback for struct device to release the device.
+ * @dev:	the devfreq device
+ *
+ * Frees the devfreq object once the last reference to its device is gone.
+ */
+static void devfreq_dev_release(struct device *dev)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+
+	mutex_destroy(&devfreq->lock);
+	kfree(devfreq);
+}
+
+/**
+ * devfreq_add_device() - Add devfreq feature to the device
+ * @dev:	the device to add devfreq feature.
+ * @profile:	device-specific profile to run devfreq.
+ * @governor_name:	name of the policy to choose frequency.
+ * @data:	private data for the governor. The devfreq framework does not
+ *		touch this value.
+ */
+struct devfreq *devfreq_add_device(struct device *dev,
+				   struct devfreq_dev_profile *profile,
+				   const char *governor_name,
+				   void *data)
+{
+	struct devfreq *devfreq;
+	struct devfreq_governor *governor;
+	int err = 0;
+
+	if (!dev || !profile || !profile->target || !governor_name) {
+		dev_err(dev, "%s: Invalid parameters.\n", __func__);
+		return ERR_PTR(-EINVAL);
+	}
+
+	devfreq = kzalloc(sizeof(struct devfreq), GFP_KERNEL);
+	if (!devfreq) {
+		dev_err(dev, "%s: Unable to create devfreq for the device\n",
+			__func__);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	mutex_init(&devfreq->lock);
+	devfreq->dev.parent = dev;
+	devfreq->dev.class = devfreq_class;
+	devfreq->dev.release = devfreq_dev_release;
+	devfreq->profile = profile;
+	devfreq->previous_freq = profile->initial_freq;
+	devfreq->data = data;
+	devfreq->stop_polling = true;
+	INIT_DELAYED_WORK_DEFERRABLE(&devfreq->work, devfreq_monitor);
+
+	dev_set_name(&devfreq->dev, "%s", dev_name(dev));
+	err = device_register(&devfreq->dev);
+	if (err) {
+		put_device(&devfreq->dev);
+		return ERR_PTR(err);
+	}
+
+	mutex_lock(&devfreq_list_lock);
+	governor = find_devfreq_governor(governor_name);
+	if (IS_ERR(governor)) {
+		mutex_unlock(&devfreq_list_lock);
+		dev_err(dev, "%s: governor %s not found\n", __func__,
+			governor_name);
+		err = PTR_ERR(governor);
+		goto err_unregister;
+	}
+
+	mutex_lock(&devfreq->lock);
+	devfreq->governor = governor;
+	if (governor->init) {
+		err = governor->init(devfreq);
+		if (err) {
+			devfreq->governor = NULL;
+			mutex_unlock(&devfreq->lock);
+			mutex_unlock(&devfreq_list_lock);
+			goto err_unregister;
+		}
+	}
+	if (profile->polling_ms) {
+		devfreq->stop_polling = false;
+		queue_delayed_work(devfreq_wq, &devfreq->work,
+				   msecs_to_jiffies(profile->polling_ms));
+	}
+	mutex_unlock(&devfreq->lock);
+
+	list_add(&devfreq->node, &devfreq_list);
+	mutex_unlock(&devfreq_list_lock);
+
+	return devfreq;
+
+err_unregister:
+	device_unregister(&devfreq->dev);
+	return ERR_PTR(err);
+}
+EXPORT_SYMBOL(devfreq_add_device);
+
+/**
+ * devfreq_remove_device() - Remove devfreq feature from a device.
+ * @devfreq:	the devfreq instance to be removed
+ */
+int devfreq_remove_device(struct devfreq *devfreq)
+{
+	const struct devfreq_governor *governor;
+
+	if (IS_ERR_OR_NULL(devfreq))
+		return -EINVAL;
+
+	mutex_lock(&devfreq_list_lock);
+	list_del(&devfreq->node);
+
+	mutex_lock(&devfreq->lock);
+	devfreq->stop_polling = true;
+	mutex_unlock(&devfreq->lock);
+	cancel_delayed_work_sync(&devfreq->work);
+
+	mutex_lock(&devfreq->lock);
+	governor = devfreq->governor;
+	devfreq->governor = NULL;
+	mutex_unlock(&devfreq->lock);
+
+	if (governor && governor->exit)
+		governor->exit(devfreq);
+	mutex_unlock(&devfreq_list_lock);
+
+	if (devfreq->profile->exit)
+		devfreq->profile->exit(devfreq->dev.parent);
+
+	device_unregister(&devfreq->dev);
+	return 0;
+}
+EXPORT_SYMBOL(devfreq_remove_device);
+
+/**
+ * devfreq_register_governor() - Make a governor available to devices
+ * @governor:	the governor to add
+ */
+int devfreq_register_governor(struct devfreq_governor *governor)
+{
+	struct devfreq_governor *g;
+	int err = 0;
+
+	if (!governor || !governor->get_target_freq)
+		return -EINVAL;
+
+	mutex_lock(&devfreq_list_lock);
+	g = find_devfreq_governor(governor->name);
+	if (!IS_ERR(g))
+		err = -EEXIST;
+	else
+		list_add(&governor->node, &devfreq_governor_list);
+	mutex_unlock(&devfreq_list_lock);
+
+	return err;
+}
+EXPORT_SYMBOL(devfreq_register_governor);
+
+/**
+ * devfreq_unregister_governor() - Remove a governor
+ * @governor:	the governor to remove
+ *
+ * Fails with -EBUSY while a device still uses the governor.
+ */
+int devfreq_unregister_governor(struct devfreq_governor *governor)
+{
+	struct devfreq *devfreq;
+	int err = 0;
+
+	mutex_lock(&devfreq_list_lock);
+	list_for_each_entry(devfreq, &devfreq_list, node) {
+		if (devfreq->governor == governor) {
+			err = -EBUSY;
+			goto out;
+		}
+	}
+	list_del(&governor->node);
+out:
+	mutex_unlock(&devfreq_list_lock);
+	return err;
+}
+EXPORT_SYMBOL(devfreq_unregister_governor);
+
+static ssize_t show_governor(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	struct devfreq *df = to_devfreq(dev);
+	ssize_t ret;
+
+	mutex_lock(&df->lock);
+	ret = sprintf(buf, "%s\n", df->governor ? df->governor->name : "");
+	mutex_unlock(&df->lock);
+	return ret;
+}
+
+static ssize_t store_governor(struct device *dev, struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct devfreq *df = to_devfreq(dev);
+	const struct devfreq_governor *governor, *old;
+	char name[DEVFREQ_NAME_LEN];
+	int err = 0;
+
+	if (sscanf(buf, "%15s", name) != 1)
+		return -EINVAL;
+
+	mutex_lock(&devfreq_list_lock);
+	governor = find_devfreq_governor(name);
+	if (IS_ERR(governor)) {
+		err = PTR_ERR(governor);
+		goto out;
+	}
+
+	mutex_lock(&df->lock);
+	old = df->governor;
+	if (old == governor)
+		goto out_unlock;
+
+	/*
+	 * ->exit() runs with the governor detached and without df->lock,
+	 * as it may remove sysfs files whose handlers take the lock.
+	 */
+	df->governor = NULL;
+	mutex_unlock(&df->lock);
+	if (old && old->exit)
+		old->exit(df);
+	mutex_lock(&df->lock);
+
+	df->governor = governor;
+	if (governor->init) {
+		err = governor->init(df);
+		if (err) {
+			/* keep the device managed by the governor it had */
+			df->governor = old;
+			if (old && old->init && old->init(df)) {
+				dev_err(dev, "%s: cannot restore governor %s\n",
+					__func__, old->name);
+				df->governor = NULL;
+			}
+			if (df->governor)
+				update_devfreq(df);
+			goto out_unlock;
+		}
+	}
+	err = update_devfreq(df);
+out_unlock:
+	mutex_unlock(&df->lock);
+out:
+	mutex_unlock(&devfreq_list_lock);
+	return err ? err : count;
+}
+
+static ssize_t show_available_governors(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct devfreq_governor *governor;
+	ssize_t count = 0;
+
+	mutex_lock(&devfreq_list_lock);
+	list_for_each_entry(governor, &devfreq_governor_list, node)
+		count += scnprintf(&buf[count], (PAGE_SIZE - count - 2),
+				   "%s ", governor->name);
+	mutex_unlock(&devfreq_list_lock);
+
+	/* Truncate the trailing space */
+	if (count)
+		count--;
+
+	count += sprintf(&buf[count], "\n");
+	return count;
+}
+
+static ssize_t show_cur_freq(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", to_devfreq(dev)->previous_freq);
+}
+
+static ssize_t show_total_trans(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", to_devfreq(dev)->nr_transitions);
+}
+
+static ssize_t show_polling_interval(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", to_devfreq(dev)->profile->polling_ms);
+}
+
+static ssize_t store_polling_interval(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct devfreq *df = to_devfreq(dev);
+	unsigned int value;
+	int ret;
+
+	ret = sscanf(buf, "%u", &value);
+	if (ret != 1)
+		return -EINVAL;
+
+	mutex_lock(&df->lock);
+	df->profile->polling_ms = value;
+	df->stop_polling = !value;
+	if (value)
+		queue_delayed_work(devfreq_wq, &df->work,
+				   msecs_to_jiffies(value));
+	mutex_unlock(&df->lock);
+
+	return count;
+}
+
+static ssize_t show_min_freq(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", to_devfreq(dev)->min_freq);
+}
+
+static ssize_t store_min_freq(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct devfreq *df = to_devfreq(dev);
+	unsigned long value;
+	int ret;
+
+	ret = sscanf(buf, "%lu", &value);
+	if (ret != 1)
+		return -EINVAL;
+
+	mutex_lock(&df->lock);
+	if (value && df->max_freq && value > df->max_freq) {
+		ret = -EINVAL;
+		goto unlock;
+	}
+	df->min_freq = value;
+	ret = count;
+unlock:
+	mutex_unlock(&df->lock);
+	return ret;
+}
+
+static ssize_t show_max_freq(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", to_devfreq(dev)->max_freq);
+}
+
+static ssize_t store_max_freq(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct devfreq *df = to_devfreq(dev);
+	unsigned long value;
+	int ret;
+
+	ret = sscanf(buf, "%lu", &value);
+	if (ret != 1)
+		return -EINVAL;
+
+	mutex_lock(&df->lock);
+	if (value && value < df->min_freq) {
+		ret = -EINVAL;
+		goto unlock;
+	}
+	df->max_freq = value;
+	ret = count;
+unlock:
+	mutex_unlock(&df->lock);
+	return ret;
+}
+
+static struct device_attribute devfreq_attributes[] = {
+	__ATTR(governor, S_IRUGO | S_IWUSR, show_governor, store_governor),
+	__ATTR(available_governors, S_IRUGO, show_available_governors, NULL),
+	__ATTR(cur_freq, S_IRUGO, show_cur_freq, NULL),
+	__ATTR(total_trans, S_IRUGO, show_total_trans, NULL),
+	__ATTR(polling_interval, S_IRUGO | S_IWUSR, show_polling_interval,
+	       store_polling_interval),
+	__ATTR(min_freq, S_IRUGO | S_IWUSR, show_min_freq, store_min_freq),
+	__ATTR(max_freq, S_IRUGO | S_IWUSR, show_max_freq, store_max_freq),
+	{ },
+};
+
+/**
+ * devfreq_recommended_opp() - Helper function to get proper OPP for the
+ *			       freq value given to target callback.
+ * @dev:	The devfreq user device. (parent of devfreq)
+ * @freq:	The frequency given to target function
+ *
+ * Locking: This function must be called under rcu_read_lock(). opp is a rcu
+ * protected pointer. The reason for the same is that the opp pointer which is
+ * returned will remain valid for use with opp_get_{voltage, freq} only while
+ * under the locked area. The pointer returned must be used prior to unlocking
+ * with rcu_read_unlock() to maintain the integrity of the pointer.
+ */
+struct opp *devfreq_recommended_opp(struct device *dev, unsigned long *freq)
+{
+	struct opp *opp = opp_find_freq_ceil(dev, freq);
+
+	if (opp == ERR_PTR(-ENODEV))
+		opp = opp_find_freq_floor(dev, freq);
+	return opp;
+}
+EXPORT_SYMBOL(devfreq_recommended_opp);
+
+static int __init devfreq_init(void)
+{
+	devfreq_class = class_create(THIS_MODULE, "devfreq");
+	if (IS_ERR(devfreq_class)) {
+		pr_err("%s: couldn't create class\n", __FILE__);
+		return PTR_ERR(devfreq_class);
+	}
+
+	devfreq_wq = alloc_workqueue("devfreq_wq",
+				     WQ_FREEZABLE | WQ_POWER_EFFICIENT, 0);
+	if (!devfreq_wq) {
+		class_destroy(devfreq_class);
+		pr_err("%s: couldn't create workqueue\n", __FILE__);
+		return -ENOMEM;
+	}
+	devfreq_class->dev_attrs = devfreq_attributes;
+
+	return 0;
+}
+subsys_initcall(devfreq_init);
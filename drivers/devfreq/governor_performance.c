@@ -0,0 +1,38 @@
+/*
+ *  linux/drivers/devfreq/governor_performance.c
+ *
+ * Always runs the device at its highest frequency (or max_freq).
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/devfreq.h>
+#include "governor.h"
+
+static int devfreq_performance_func(struct devfreq *df,
+				    unsigned long *freq)
+{
+	/*
+	 * target callback should be able to get floor value as
+	 * said in devfreq.h
+	 */
+	if (!df->max_freq)
+		*freq = UINT_MAX;
+	else
+		*freq = df->max_freq;
+	return 0;
+}
+
+static struct devfreq_governor devfreq_performance = {
+	.name = "performance",
+	.get_target_freq = devfreq_performance_func,
+};
+
+static int __init devfreq_performance_init(void)
+{
+	return devfreq_register_governor(&devfreq_performance);
+}
+subsys_initcall(devfreq_performance_init);
@@ -0,0 +1,161 @@
+/*
+ *  linux/drivers/devfreq/governor_userspace.c
+ *
+ * Runs the device at the frequency written to the "userspace/set_freq"
+ * attribute of its devfreq node.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/slab.h>
+#include <linux/device.h>
+#include <linux/devfreq.h>
+#include <linux/pm.h>
+#include <linux/mutex.h>
+#include <linux/init.h>
+#include "governor.h"
+
+struct userspace_data {
+	unsigned long user_frequency;
+	bool valid;
+};
+
+static int devfreq_userspace_func(struct devfreq *df, unsigned long *freq)
+{
+	struct userspace_data *data = df->governor_data;
+
+	if (data->valid) {
+		unsigned long adjusted_freq = data->user_frequency;
+
+		if (df->max_freq && adjusted_freq > df->max_freq)
+			adjusted_freq = df->max_freq;
+
+		if (df->min_freq && adjusted_freq < df->min_freq)
+			adjusted_freq = df->min_freq;
+
+		*freq = adjusted_freq;
+	} else {
+		*freq = df->previous_freq; /* No user freq specified yet */
+	}
+	return 0;
+}
+
+/*
+ * The set_freq file is removed without devfreq->lock held, so it can be
+ * used while another governor is being set up: check under the lock.
+ */
+static bool userspace_active(struct devfreq *devfreq)
+{
+	return devfreq->governor &&
+	       devfreq->governor->get_target_freq == devfreq_userspace_func &&
+	       devfreq->governor_data;
+}
+
+static ssize_t store_freq(struct device *dev, struct device_attribute *attr,
+			  const char *buf, size_t count)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct userspace_data *data;
+	unsigned long wanted;
+	int err = 0;
+
+	mutex_lock(&devfreq->lock);
+	if (!userspace_active(devfreq)) {
+		err = -EINVAL;
+		goto out;
+	}
+	data = devfreq->governor_data;
+
+	if (sscanf(buf, "%lu", &wanted) != 1) {
+		err = -EINVAL;
+		goto out;
+	}
+	data->user_frequency = wanted;
+	data->valid = true;
+	err = update_devfreq(devfreq);
+	if (err == 0)
+		err = count;
+out:
+	mutex_unlock(&devfreq->lock);
+	return err;
+}
+
+static ssize_t show_freq(struct device *dev, struct device_attribute *attr,
+			 char *buf)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct userspace_data *data;
+	int err = 0;
+
+	mutex_lock(&devfreq->lock);
+	data = devfreq->governor_data;
+	if (!userspace_active(devfreq))
+		err = -EINVAL;
+	else if (data->valid)
+		err = sprintf(buf, "%lu\n", data->user_frequency);
+	else
+		err = sprintf(buf, "undefined\n");
+	mutex_unlock(&devfreq->lock);
+	return err;
+}
+
+static DEVICE_ATTR(set_freq, 0644, show_freq, store_freq);
+static struct attribute *dev_entries[] = {
+	&dev_attr_set_freq.attr,
+	NULL,
+};
+static struct attribute_group dev_attr_group = {
+	.name	= "userspace",
+	.attrs	= dev_entries,
+};
+
+static int userspace_init(struct devfreq *devfreq)
+{
+	int err = 0;
+	struct userspace_data *data = kzalloc(sizeof(struct userspace_data),
+					      GFP_KERNEL);
+
+	if (!data) {
+		err = -ENOMEM;
+		goto out;
+	}
+	data->valid = false;
+	data->user_frequency = devfreq->previous_freq;
+	err = sysfs_create_group(&devfreq->dev.kobj, &dev_attr_group);
+	if (err) {
+		kfree(data);
+		goto out;
+	}
+	devfreq->governor_data = data;
+out:
+	return err;
+}
+
+/* called without devfreq->lock, see struct devfreq_governor */
+static void userspace_exit(struct devfreq *devfreq)
+{
+	void *data;
+
+	sysfs_remove_group(&devfreq->dev.kobj, &dev_attr_group);
+
+	mutex_lock(&devfreq->lock);
+	data = devfreq->governor_data;
+	devfreq->governor_data = NULL;
+	mutex_unlock(&devfreq->lock);
+	kfree(data);
+}
+
+static struct devfreq_governor devfreq_userspace = {
+	.name = "userspace",
+	.get_target_freq = devfreq_userspace_func,
+	.init = userspace_init,
+	.exit = userspace_exit,
+};
+
+static int __init devfreq_userspace_init(void)
+{
+	return devfreq_register_governor(&devfreq_userspace);
+}
+subsys_initcall(devfreq_userspace_init);
@@ -115,6 +115,16 @@ struct mmc_test_general_result {
 	struct list_head tr_lst;
 };
 
+/**
+ * struct mmc_test_async_req - asynchronous request of a non-blocking test.
+ * @areq: request handed to mmc_start_req()
+ * @test: test the request belongs to
+ */
+struct mmc_test_async_req {
+	struct mmc_async_req areq;
+	struct mmc_test_card *test;
+};
+
 /**
  * struct mmc_test_dbgfs_file - debugfs related file.
  * @link: double-linked list
@@ -745,6 +755,77 @@ static int mmc_test_simple_transfer(struct mmc_test_card *test,
 	return mmc_test_check_result(test, &mrq);
 }
 
+static void mmc_test_nonblock_reset(struct mmc_request *mrq,
+				    struct mmc_command *cmd,
+				    struct mmc_command *stop,
+				    struct mmc_data *data)
+{
+	memset(mrq, 0, sizeof(struct mmc_request));
+	memset(cmd, 0, sizeof(struct mmc_command));
+	memset(data, 0, sizeof(struct mmc_data));
+	memset(stop, 0, sizeof(struct mmc_command));
+
+	mrq->cmd = cmd;
+	mrq->data = data;
+	mrq->stop = stop;
+}
+
+static int mmc_test_check_result_async(struct mmc_card *card,
+				       struct mmc_async_req *areq)
+{
+	struct mmc_test_async_req *test_async =
+		container_of(areq, struct mmc_test_async_req, areq);
+
+	mmc_test_wait_busy(test_async->test);
+
+	return mmc_test_check_result(test_async->test, areq->mrq);
+}
+
+/*
+ * Do @count consecutive transfers with mmc_start_req(), so that each one
+ * is prepared by the host while the previous one is in progress.
+ */
+static int mmc_test_nonblock_transfer(struct mmc_test_card *test,
+				      struct scatterlist *sg, unsigned sg_len,
+				      unsigned dev_addr, unsigned blocks,
+				      unsigned blksz, int write, int count)
+{
+	struct mmc_request mrq[2];
+	struct mmc_command cmd[2];
+	struct mmc_command stop[2];
+	struct mmc_data data[2];
+	struct mmc_test_async_req test_areq[2];
+	struct mmc_async_req *done_areq;
+	int i, cur = 0, ret;
+
+	for (i = 0; i < 2; i++) {
+		mmc_test_nonblock_reset(&mrq[i], &cmd[i], &stop[i], &data[i]);
+		test_areq[i].test = test;
+		test_areq[i].areq.mrq = &mrq[i];
+		test_areq[i].areq.err_check = mmc_test_check_result_async;
+	}
+
+	for (i = 0; i < count; i++) {
+		mmc_test_prepare_mrq(test, &mrq[cur], sg, sg_len, dev_addr,
+				     blocks, blksz, write);
+		done_areq = mmc_start_req(test->card->host,
+					  &test_areq[cur].areq, &ret);
+		if (ret || (!done_areq && i > 0))
+			return ret ? ret : RESULT_FAIL;
+
+		/* the other slot is free again once its request is done */
+		cur = !cur;
+		if (done_areq)
+			mmc_test_nonblock_reset(&mrq[cur], &cmd[cur], &stop[cur],
+						&data[cur]);
+		dev_addr += blocks;
+	}
+
+	mmc_start_req(test->card->host, NULL, &ret);
+
+	return ret;
+}
+
 /*
  * Tests a transfer where the card will fail completely or partly
  */
@@ -1938,6 +2019,89 @@ static int mmc_test_large_seq_perf(struct mmc_test_card *test, int write)
 	return ret;
 }
 
+/*
+ * Consecutive transfers of sz bytes over the whole test area, each one
+ * waited for before the next is started (blocking) or started while the
+ * previous one is in progress (non-blocking).  The scatterlist is mapped
+ * only once so that the difference is the overlap of the host's request
+ * preparation with the transfers.
+ */
+static int mmc_test_seq_nonblock_perf(struct mmc_test_card *test,
+				      unsigned long sz, int write, int nonblock)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned int dev_addr, i, cnt;
+	struct timespec ts1, ts2;
+	int ret;
+
+	if (write) {
+		ret = mmc_test_area_erase(test);
+		if (ret)
+			return ret;
+	}
+
+	ret = mmc_test_area_map(test, sz, 0);
+	if (ret)
+		return ret;
+
+	cnt = t->max_sz / sz;
+	dev_addr = t->dev_addr;
+	getnstimeofday(&ts1);
+	if (nonblock) {
+		ret = mmc_test_nonblock_transfer(test, t->sg, t->sg_len,
+						 dev_addr, t->blocks, 512,
+						 write, cnt);
+	} else {
+		for (i = 0; i < cnt && !ret; i++) {
+			ret = mmc_test_area_transfer(test, dev_addr, write);
+			dev_addr += t->blocks;
+		}
+	}
+	if (ret)
+		return ret;
+	getnstimeofday(&ts2);
+	mmc_test_print_avg_rate(test, sz, cnt, &ts1, &ts2);
+	return 0;
+}
+
+/*
+ * Consecutive performance from 4KiB up to the maximum transfer size.
+ */
+static int mmc_test_profile_nonblock_perf(struct mmc_test_card *test,
+					  int write, int nonblock)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned long sz;
+	int ret;
+
+	for (sz = 4096; sz < t->max_tfr; sz <<= 1) {
+		ret = mmc_test_seq_nonblock_perf(test, sz, write, nonblock);
+		if (ret)
+			return ret;
+	}
+	return mmc_test_seq_nonblock_perf(test, t->max_tfr, write, nonblock);
+}
+
+static int mmc_test_profile_write_blocking_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_nonblock_perf(test, 1, 0);
+}
+
+static int mmc_test_profile_write_nonblock_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_nonblock_perf(test, 1, 1);
+}
+
+static int mmc_test_profile_read_blocking_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_nonblock_perf(test, 0, 0);
+}
+
+static int mmc_test_profile_read_nonblock_perf(struct mmc_test_card *test)
+{
+	return mmc_test_profile_nonblock_perf(test, 0, 1);
+}
+
 /*
  * Large sequential read performance.
  */
@@ -2221,6 +2385,34 @@ static const struct mmc_test_case mmc_test_cases[] = {
 		.cleanup = mmc_test_area_cleanup,
 	},
 
+	{
+		.name = "Write performance with blocking req 4k to max",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_write_blocking_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Write performance with non-blocking req 4k to max",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_profile_write_nonblock_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Read performance with blocking req 4k to max",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_profile_read_blocking_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Read performance with non-blocking req 4k to max",
+		.prepare = mmc_test_area_prepare_fill,
+		.run = mmc_test_profile_read_nonblock_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
@@ -20,6 +20,7 @@
 #include <linux/err.h>
 #include <linux/leds.h>
 #include <linux/scatterlist.h>
+#include <linux/slab.h>
 #include <linux/log2.h>
 #include <linux/regulator/consumer.h>
 #include <linux/pm_runtime.h>
@@ -199,9 +200,118 @@ mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 
 static void mmc_wait_done(struct mmc_request *mrq)
 {
-	complete(mrq->done_data);
+	complete(&mrq->completion);
+}
+
+static void __mmc_start_req(struct mmc_host *host, struct mmc_request *mrq)
+{
+	init_completion(&mrq->completion);
+	mrq->done = mmc_wait_done;
+	mmc_start_request(host, mrq);
+}
+
+static void mmc_wait_for_req_done(struct mmc_host *host,
+				  struct mmc_request *mrq)
+{
+	wait_for_completion(&mrq->completion);
+}
+
+/**
+ *	mmc_pre_req - Prepare for a new request
+ *	@host: MMC host to prepare command
+ *	@mrq: MMC request to prepare for
+ *	@is_first_req: true if there is no previous started request
+ *		       that may run in parallel to this call, otherwise false
+ *
+ *	mmc_pre_req() is called in prior to mmc_start_req() to let
+ *	host prepare for the new request. Preparation of a request may be
+ *	performed while another request is running on the host.
+ */
+static void mmc_pre_req(struct mmc_host *host, struct mmc_request *mrq,
+		 bool is_first_req)
+{
+	if (host->ops->pre_req)
+		host->ops->pre_req(host, mrq, is_first_req);
+}
+
+/**
+ *	mmc_post_req - Post process a completed request
+ *	@host: MMC host to post process command
+ *	@mrq: MMC request to post process for
+ *	@err: Error, if non zero, clean up any resources made in pre_req
+ *
+ *	Let the host post process a completed request. Post processing of
+ *	a request may be performed while another request is running.
+ */
+static void mmc_post_req(struct mmc_host *host, struct mmc_request *mrq,
+			 int err)
+{
+	if (host->ops->post_req)
+		host->ops->post_req(host, mrq, err);
 }
 
+/**
+ *	mmc_start_req - start a non-blocking request
+ *	@host: MMC host to start command
+ *	@areq: async request to start
+ *	@error: out parameter returns 0 for success, otherwise non zero
+ *
+ *	Start a new MMC custom command request for a host.
+ *	If there is an ongoing async request wait for completion
+ *	of that request and start the new one and return.
+ *	Does not wait for the new request to complete.
+ *
+ *	Returns the completed request, NULL in case of none completed.
+ *	Wait for the ongoing request (previously started) to complete and
+ *	return the completed request. If there is no ongoing request, NULL
+ *	is returned without waiting. NULL is not an error condition.
+ */
+struct mmc_async_req *mmc_start_req(struct mmc_host *host,
+				    struct mmc_async_req *areq, int *error)
+{
+	int err = 0;
+	struct mmc_async_req *data = host->areq;
+
+	/* Prepare a new request */
+	if (areq)
+		mmc_pre_req(host, areq->mrq, !host->areq);
+
+	if (host->areq) {
+		mmc_wait_for_req_done(host, host->areq->mrq);
+		err = host->areq->err_check(host->card, host->areq);
+		/*
+		 * The card raises the exception event in the R1 status
+		 * when it needs urgent BKOPS.  They are started by the
+		 * BKOPS work once the queue has drained.
+		 */
+		if (!err && host->card && mmc_card_mmc(host->card) &&
+		    host->card->ext_csd.bkops_en && !mmc_host_is_spi(host) &&
+		    (host->areq->mrq->cmd->resp[0] & R1_EXCEPTION_EVENT))
+			mmc_card_set_need_bkops(host->card);
+		if (err) {
+			mmc_post_req(host, host->areq->mrq, 0);
+			if (areq)
+				mmc_post_req(host, areq->mrq, -EINVAL);
+
+			host->areq = NULL;
+			goto out;
+		}
+	}
+
+	if (areq)
+		__mmc_start_req(host, areq->mrq);
+
+	if (host->areq)
+		mmc_post_req(host, host->areq->mrq, 0);
+
+	host->areq = areq;
+ out:
+	if (error)
+		*error = err;
+	return data;
+}
+EXPORT_SYMBOL(mmc_start_req);
+
 /**
  *	mmc_wait_for_req - start a request and wait for completion
  *	@host: MMC host to start command
@@ -213,14 +323,8 @@ static void mmc_wait_done(struct mmc_request *mrq)
  */
 void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 {
-	DECLARE_COMPLETION_ONSTACK(complete);
-
-	mrq->done_data = &complete;
-	mrq->done = mmc_wait_done;
-
-	mmc_start_request(host, mrq);
-
-	wait_for_completion(&complete);
+	__mmc_start_req(host, mrq);
+	mmc_wait_for_req_done(host, mrq);
 }
 
 EXPORT_SYMBOL(mmc_wait_for_req);
@@ -1618,6 +1722,239 @@ int mmc_set_blocklen(struct mmc_card *card, unsigned int blocklen)
 }
 EXPORT_SYMBOL(mmc_set_blocklen);
 
+/**
+ *	mmc_flush_cache - flush the volatile cache of a card
+ *	@card: MMC card
+ *
+ *	Writes what the card holds in its cache to the media.  Nothing to
+ *	do if the cache is not enabled.  The host must be claimed.
+ */
+int mmc_flush_cache(struct mmc_card *card)
+{
+	int err = 0;
+
+	if (mmc_card_mmc(card) && card->ext_csd.cache_ctrl) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_FLUSH_CACHE, 1, 0);
+		if (err)
+			pr_err("%s: cache flush error %d\n",
+			       mmc_hostname(card->host), err);
+	}
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_flush_cache);
+
+/**
+ *	mmc_interrupt_hpi - interrupt a long operation of the card
+ *	@card: MMC card
+ *
+ *	Sends HPI until the card leaves the programming state.  Returns
+ *	-EINVAL if HPI is not enabled on the card.
+ */
+int mmc_interrupt_hpi(struct mmc_card *card)
+{
+	int err;
+	u32 status;
+
+	BUG_ON(!card);
+
+	if (!card->ext_csd.hpi_en)
+		return -EINVAL;
+
+	mmc_claim_host(card->host);
+	err = mmc_send_status(card, &status);
+	if (err) {
+		pr_err("%s: get card status failed\n",
+		       mmc_hostname(card->host));
+		goto out;
+	}
+
+	/*
+	 * We don't know how long the card takes to act on HPI, so keep
+	 * sending it until the card is out of the programming state.  A
+	 * timeout on HPI means the card has already left it.
+	 */
+	while (R1_CURRENT_STATE(status) == R1_STATE_PRG) {
+		err = mmc_send_hpi_cmd(card, &status);
+		if (err)
+			pr_debug("%s: abort HPI (%d error)\n",
+				 mmc_hostname(card->host), err);
+
+		err = mmc_send_status(card, &status);
+		if (err)
+			break;
+	}
+
+out:
+	mmc_release_host(card->host);
+	return err;
+}
+EXPORT_SYMBOL(mmc_interrupt_hpi);
+
+/* Upper bound for urgent BKOPS, which are not interrupted */
+#define MMC_BKOPS_MAX_TIMEOUT	(4 * 60 * 1000)	/* 4 minutes */
+
+/* How long the queue has to be idle before BKOPS are started */
+#define MMC_IDLE_BKOPS_DELAY_MS	200
+
+static int mmc_read_bkops_status(struct mmc_card *card)
+{
+	int err;
+	u8 *ext_csd;
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return -ENOMEM;
+
+	err = mmc_send_ext_csd(card, ext_csd);
+	if (!err)
+		card->ext_csd.raw_bkops_status = ext_csd[EXT_CSD_BKOPS_STATUS];
+
+	kfree(ext_csd);
+	return err;
+}
+
+/**
+ *	mmc_start_bkops - start background operations of a card
+ *	@card: MMC card
+ *	@from_exception: the card raised the urgent BKOPS event
+ *
+ *	On the urgent BKOPS event the card is let to run its BKOPS to
+ *	the end, since it cannot keep up with writes until it has.  From
+ *	the idle work BKOPS are started for any pending level and left
+ *	running; mmc_stop_bkops() interrupts them with HPI.  Both are
+ *	started from the BKOPS work, never from the request path.
+ */
+void mmc_start_bkops(struct mmc_card *card, bool from_exception)
+{
+	int err;
+
+	BUG_ON(!card);
+
+	if (!card->ext_csd.bkops_en || mmc_card_doing_bkops(card))
+		return;
+
+	mmc_claim_host(card->host);
+
+	if (from_exception)
+		mmc_card_clr_need_bkops(card);
+
+	err = mmc_read_bkops_status(card);
+	if (err) {
+		pr_err("%s: failed to read BKOPS status: %d\n",
+		       mmc_hostname(card->host), err);
+		goto out;
+	}
+
+	if (!card->ext_csd.raw_bkops_status)
+		goto out;
+
+	if (from_exception) {
+		if (card->ext_csd.raw_bkops_status < EXT_CSD_BKOPS_LEVEL_2)
+			goto out;
+
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_BKOPS_START, 1,
+				 MMC_BKOPS_MAX_TIMEOUT);
+		if (!err)
+			card->bkops_stats.urgent++;
+	} else {
+		err = __mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				   EXT_CSD_BKOPS_START, 1, 0, false);
+		if (!err) {
+			mmc_card_set_doing_bkops(card);
+			card->bkops_stats.idle++;
+		}
+	}
+	if (err)
+		pr_warning("%s: error %d starting BKOPS\n",
+			   mmc_hostname(card->host), err);
+out:
+	mmc_release_host(card->host);
+}
+EXPORT_SYMBOL(mmc_start_bkops);
+
+/**
+ *	mmc_stop_bkops - stop background operations of a card
+ *	@card: MMC card
+ *
+ *	Interrupts the BKOPS started by the idle work with HPI, if the
+ *	card has not finished them already.
+ */
+int mmc_stop_bkops(struct mmc_card *card)
+{
+	int err;
+	u32 status;
+
+	BUG_ON(!card);
+
+	mmc_claim_host(card->host);
+	err = mmc_send_status(card, &status);
+	if (!err && R1_CURRENT_STATE(status) == R1_STATE_PRG) {
+		err = mmc_interrupt_hpi(card);
+		if (!err)
+			card->bkops_stats.hpi++;
+	}
+	if (!err)
+		mmc_card_clr_doing_bkops(card);
+	mmc_release_host(card->host);
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_stop_bkops);
+
+/*
+ * Idle time BKOPS are only started on cards that can be interrupted
+ * with HPI, so that a new request does not wait for them.
+ */
+static bool mmc_can_idle_bkops(struct mmc_card *card)
+{
+	return mmc_card_mmc(card) && card->ext_csd.bkops_en &&
+	       card->ext_csd.hpi_en && (card->host->caps2 & MMC_CAP2_BKOPS);
+}
+
+void mmc_bkops_work(struct work_struct *work)
+{
+	struct mmc_card *card = container_of(work, struct mmc_card,
+					     bkops_work.work);
+
+	mmc_start_bkops(card, mmc_card_need_bkops(card));
+}
+
+/**
+ *	mmc_schedule_idle_bkops - start BKOPS if the card stays idle
+ *	@card: MMC card
+ *
+ *	Called by the block driver when its queue ran empty.  Urgent
+ *	BKOPS the card asked for during the last requests are started
+ *	right away.
+ */
+void mmc_schedule_idle_bkops(struct mmc_card *card)
+{
+	if (mmc_card_mmc(card) && mmc_card_need_bkops(card))
+		mmc_schedule_delayed_work(&card->bkops_work, 0);
+	else if (mmc_can_idle_bkops(card))
+		mmc_schedule_delayed_work(&card->bkops_work,
+				msecs_to_jiffies(MMC_IDLE_BKOPS_DELAY_MS));
+}
+EXPORT_SYMBOL(mmc_schedule_idle_bkops);
+
+/**
+ *	mmc_cancel_idle_bkops - cancel BKOPS scheduled for idle time
+ *	@card: MMC card
+ *
+ *	Must be called without the host claimed, as the idle work claims
+ *	it.  BKOPS the work already started are left to mmc_stop_bkops().
+ *	Urgent BKOPS cancelled here stay pending for the next idle period.
+ */
+void mmc_cancel_idle_bkops(struct mmc_card *card)
+{
+	if (mmc_card_mmc(card) && card->ext_csd.bkops_en)
+		cancel_delayed_work_sync(&card->bkops_work);
+}
+EXPORT_SYMBOL(mmc_cancel_idle_bkops);
+
 static int mmc_rescan_try_freq(struct mmc_host *host, unsigned freq)
 {
 	host->f_init = freq;
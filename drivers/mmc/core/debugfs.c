@@ -284,6 +284,30 @@ static const struct file_operations mmc_dbg_ext_csd_fops = {
 	.llseek		= default_llseek,
 };
 
+static int mmc_bkops_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_card *card = s->private;
+	struct mmc_bkops_stats *stats = &card->bkops_stats;
+
+	seq_printf(s, "urgent:\t\t%u\n", stats->urgent);
+	seq_printf(s, "idle:\t\t%u\n", stats->idle);
+	seq_printf(s, "interrupted:\t%u\n", stats->hpi);
+
+	return 0;
+}
+
+static int mmc_bkops_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_bkops_stats_show, inode->i_private);
+}
+
+static const struct file_operations mmc_dbg_bkops_stats_fops = {
+	.open		= mmc_bkops_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void mmc_add_card_debugfs(struct mmc_card *card)
 {
 	struct mmc_host	*host = card->host;
@@ -316,6 +340,11 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 					&mmc_dbg_ext_csd_fops))
 			goto err;
 
+	if (mmc_card_mmc(card) && card->ext_csd.bkops)
+		if (!debugfs_create_file("bkops_stats", S_IRUSR, root, card,
+					&mmc_dbg_bkops_stats_fops))
+			goto err;
+
 	return;
 
 err:
@@ -405,12 +405,50 @@ static int mmc_read_ext_csd(struct mmc_card *card, u8 *ext_csd)
 			ext_csd[EXT_CSD_TRIM_MULT];
 	}
 
-	if (card->ext_csd.rev >= 5)
+	if (card->ext_csd.rev >= 5) {
 		card->ext_csd.rel_param = ext_csd[EXT_CSD_WR_REL_PARAM];
 
+		if (ext_csd[EXT_CSD_HPI_FEATURES] & EXT_CSD_HPI_SUPPORT) {
+			card->ext_csd.hpi = true;
+			if (ext_csd[EXT_CSD_HPI_FEATURES] &
+			    EXT_CSD_HPI_IMPL_CMD12)
+				card->ext_csd.hpi_cmd = MMC_STOP_TRANSMISSION;
+			else
+				card->ext_csd.hpi_cmd = MMC_SEND_STATUS;
+			card->ext_csd.out_of_int_time =
+				ext_csd[EXT_CSD_OUT_OF_INTERRUPT_TIME] * 10;
+		}
+
+		/*
+		 * BKOPS_EN can be written only once, so it is left to the
+		 * vendor or the user to set.
+		 */
+		if (ext_csd[EXT_CSD_BKOPS_SUPPORT] & 0x1) {
+			card->ext_csd.bkops = true;
+			card->ext_csd.bkops_en = ext_csd[EXT_CSD_BKOPS_EN] & 0x1;
+			card->ext_csd.raw_bkops_status =
+				ext_csd[EXT_CSD_BKOPS_STATUS];
+			if (!card->ext_csd.bkops_en)
+				pr_info("%s: BKOPS_EN bit is not set\n",
+					mmc_hostname(card->host));
+		}
+	}
+
 	/* eMMC v4.5 or later */
-	if (card->ext_csd.rev >= 6)
+	if (card->ext_csd.rev >= 6) {
 		card->ext_csd.feature_support |= MMC_DISCARD_FEATURE;
+		card->ext_csd.max_packed_writes =
+			ext_csd[EXT_CSD_MAX_PACKED_WRITES];
+		card->ext_csd.max_packed_reads =
+			ext_csd[EXT_CSD_MAX_PACKED_READS];
+		card->ext_csd.generic_cmd6_time =
+			ext_csd[EXT_CSD_GENERIC_CMD6_TIME] * 10;
+		card->ext_csd.cache_size =
+			ext_csd[EXT_CSD_CACHE_SIZE + 0] << 0 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 1] << 8 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 2] << 16 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 3] << 24;
+	}
 
 	/* moviNAND VHX 4.41 device supports a discard*/
 	if (card->cid.movi_pnm == 0x47324741 ||
@@ -664,6 +702,7 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		card->type = MMC_TYPE_MMC;
 		card->rca = 1;
 		memcpy(card->raw_cid, cid, sizeof(card->raw_cid));
+		INIT_DELAYED_WORK(&card->bkops_work, mmc_bkops_work);
 	}
 
 	/*
@@ -906,6 +945,70 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		}
 	}
 
+	/*
+	 * Enable HPI (if supported), it is what lets idle time BKOPS be
+	 * interrupted when a request comes.
+	 */
+	card->ext_csd.hpi_en = false;
+	mmc_card_clr_doing_bkops(card);
+	if (card->ext_csd.hpi) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_HPI_MGMT, 1, 0);
+		if (err && err != -EBADMSG)
+			goto free_card;
+
+		if (err) {
+			printk(KERN_WARNING "%s: enabling HPI failed\n",
+			       mmc_hostname(card->host));
+			err = 0;
+		} else {
+			card->ext_csd.hpi_en = true;
+		}
+	}
+
+	/*
+	 * Turn the volatile cache on (if any).  Writes are then only
+	 * guaranteed to be on the media after mmc_flush_cache().
+	 */
+	card->ext_csd.cache_ctrl = false;
+	if ((host->caps2 & MMC_CAP2_CACHE_CTRL) &&
+	    card->ext_csd.cache_size > 0) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_CACHE_CTRL, 1,
+				 card->ext_csd.generic_cmd6_time);
+		if (err && err != -EBADMSG)
+			goto free_card;
+
+		if (err) {
+			printk(KERN_WARNING "%s: enabling cache failed\n",
+			       mmc_hostname(card->host));
+			err = 0;
+		} else {
+			card->ext_csd.cache_ctrl = true;
+		}
+	}
+
+	/*
+	 * Enable the packed command failure event, so that the block
+	 * driver can find out which request of a failed pack went wrong.
+	 */
+	card->ext_csd.packed_event_en = false;
+	if (card->ext_csd.max_packed_writes && mmc_host_packed_wr(host)) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_EXP_EVENTS_CTRL,
+				 EXT_CSD_PACKED_EVENT_EN, 0);
+		if (err && err != -EBADMSG)
+			goto free_card;
+
+		if (err) {
+			printk(KERN_WARNING "%s: enabling packed event failed\n",
+			       mmc_hostname(card->host));
+			err = 0;
+		} else {
+			card->ext_csd.packed_event_en = true;
+		}
+	}
+
 	if (!oldcard)
 		host->card = card;
 
@@ -937,6 +1040,7 @@ static void mmc_remove(struct mmc_host *host)
 	BUG_ON(!host);
 	BUG_ON(!host->card);
 
+	mmc_cancel_idle_bkops(host->card);
 	mmc_remove_card(host->card);
 	host->card = NULL;
 }
@@ -980,12 +1084,22 @@ static int mmc_suspend(struct mmc_host *host)
 	BUG_ON(!host);
 	BUG_ON(!host->card);
 
+	mmc_cancel_idle_bkops(host->card);
 	mmc_claim_host(host);
+	if (mmc_card_doing_bkops(host->card)) {
+		err = mmc_stop_bkops(host->card);
+		if (err)
+			goto out;
+	}
+	err = mmc_flush_cache(host->card);
+	if (err)
+		goto out;
 	if (mmc_card_can_sleep(host))
 		err = mmc_card_sleep(host);
 	else if (!mmc_host_is_spi(host))
 		mmc_deselect_cards(host);
 	host->card->state &= ~MMC_STATE_HIGHSPEED;
+out:
 	mmc_release_host_sync(host);
 
 	return err;
@@ -1029,6 +1143,12 @@ static int mmc_sleep(struct mmc_host *host)
 	int err = -ENOSYS;
 
 	if (card && card->ext_csd.rev >= 3) {
+		/* the card only takes the sleep command in transfer state */
+		if (mmc_card_doing_bkops(card)) {
+			err = mmc_stop_bkops(card);
+			if (err)
+				return err;
+		}
 		err = mmc_card_sleepawake(host, 1);
 		if (err < 0)
 			pr_debug("%s: Error %d while putting card into sleep",
@@ -1619,7 +1619,8 @@ static void twl6030_current_avg(struct work_struct *work)
 		di->current_avg_uA = current_avg_uA * 1000;
 	}
 
-	schedule_delayed_work(&di->twl6030_current_avg_work,
+	queue_delayed_work(system_power_efficient_wq,
+			&di->twl6030_current_avg_work,
 		msecs_to_jiffies(1000 * di->current_avg_interval));
 	return;
 err:
@@ -1790,7 +1791,8 @@ static void twl6030_bci_battery_work(struct work_struct *work)
 	req.func_cb = NULL;
 	ret = twl6030_gpadc_conversion(&req);
 
-	schedule_delayed_work(&di->twl6030_bci_monitor_work,
+	queue_delayed_work(system_power_efficient_wq,
+			&di->twl6030_bci_monitor_work,
 			msecs_to_jiffies(1000 * di->monitoring_interval));
 	if (ret < 0) {
 		dev_dbg(di->dev, "gpadc conversion failed: %d\n", ret);
@@ -1853,7 +1855,8 @@ static void twl6030_current_mode_changed(struct twl6030_bci_device_info *di)
 		goto err;
 
 	cancel_delayed_work(&di->twl6030_current_avg_work);
-	schedule_delayed_work(&di->twl6030_current_avg_work,
+	queue_delayed_work(system_power_efficient_wq,
+			&di->twl6030_current_avg_work,
 		msecs_to_jiffies(1000 * di->current_avg_interval));
 	return;
 err:
@@ -1863,7 +1866,8 @@ err:
 static void twl6030_work_interval_changed(struct twl6030_bci_device_info *di)
 {
 	cancel_delayed_work(&di->twl6030_bci_monitor_work);
-	schedule_delayed_work(&di->twl6030_bci_monitor_work,
+	queue_delayed_work(system_power_efficient_wq,
+			&di->twl6030_bci_monitor_work,
 		msecs_to_jiffies(1000 * di->monitoring_interval));
 }
 
@@ -1875,7 +1879,8 @@ static void twl6030_bci_battery_external_power_changed(struct power_supply *psy)
 	struct twl6030_bci_device_info *di = to_twl6030_bci_device_info(psy);
 
 	cancel_delayed_work(&di->twl6030_bci_monitor_work);
-	schedule_delayed_work(&di->twl6030_bci_monitor_work, 0);
+	queue_delayed_work(system_power_efficient_wq,
+			&di->twl6030_bci_monitor_work, 0);
 }
 
 #define to_twl6030_ac_device_info(x) container_of((x), \
@@ -2586,7 +2591,8 @@ static ssize_t set_vbus_charge_thres(struct device *dev,
 	di->vbus_charge_thres = val & 0xffffffff;
 
 	cancel_delayed_work(&di->twl6030_bci_monitor_work);
-	schedule_delayed_work(&di->twl6030_bci_monitor_work, 0);
+	queue_delayed_work(system_power_efficient_wq,
+			&di->twl6030_bci_monitor_work, 0);
 
 	return status;
 }
@@ -3058,9 +3064,11 @@ static int __devinit twl6030_bci_battery_probe(struct platform_device *pdev)
 	if (ret)
 		dev_dbg(&pdev->dev, "could not create sysfs files\n");
 
-	schedule_delayed_work(&di->twl6030_bci_monitor_work, 0);
+	queue_delayed_work(system_power_efficient_wq,
+			&di->twl6030_bci_monitor_work, 0);
 
-	schedule_delayed_work(&di->twl6030_current_avg_work, 0);
+	queue_delayed_work(system_power_efficient_wq,
+			&di->twl6030_current_avg_work, 0);
 
 	return 0;
 
@@ -3106,8 +3114,8 @@ static int __devexit twl6030_bci_battery_remove(struct platform_device *pdev)
 
 	otg_unregister_notifier(di->otg, &di->nb);
 	sysfs_remove_group(&pdev->dev.kobj, &twl6030_bci_attr_group);
-	cancel_delayed_work(&di->twl6030_bci_monitor_work);
-	cancel_delayed_work(&di->twl6030_current_avg_work);
+	cancel_delayed_work_sync(&di->twl6030_bci_monitor_work);
+	cancel_delayed_work_sync(&di->twl6030_current_avg_work);
 	flush_scheduled_work();
 	power_supply_unregister(&di->bat);
 	power_supply_unregister(&di->usb);
@@ -3195,8 +3203,10 @@ static int twl6030_bci_battery_resume(struct device *dev)
 	if (ret)
 		goto err;
 
-	schedule_delayed_work(&di->twl6030_bci_monitor_work, 0);
-	schedule_delayed_work(&di->twl6030_current_avg_work, 50);
+	queue_delayed_work(system_power_efficient_wq,
+			&di->twl6030_bci_monitor_work, 0);
+	queue_delayed_work(system_power_efficient_wq,
+			&di->twl6030_current_avg_work, 50);
 
 	events = BQ2415x_RESET_TIMER;
 	blocking_notifier_call_chain(&notifier_list, events, NULL);
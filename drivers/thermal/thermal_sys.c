@@ -598,11 +598,11 @@ static void thermal_zone_device_set_polling(struct thermal_zone_device *tz,
 		return;
 
 	if (delay > 1000)
-		schedule_delayed_work(&(tz->poll_queue),
-				      round_jiffies(msecs_to_jiffies(delay)));
+		queue_delayed_work(system_power_efficient_wq, &(tz->poll_queue),
+				   round_jiffies(msecs_to_jiffies(delay)));
 	else
-		schedule_delayed_work(&(tz->poll_queue),
-				      msecs_to_jiffies(delay));
+		queue_delayed_work(system_power_efficient_wq, &(tz->poll_queue),
+				   msecs_to_jiffies(delay));
 }
 
 static void thermal_zone_device_passive(struct thermal_zone_device *tz,
@@ -105,6 +105,8 @@ struct dio {
 	unsigned long refcount;		/* direct_io_worker() and bios */
 	struct bio *bio_list;		/* singly linked via bi_private */
 	struct task_struct *waiter;	/* waiting task (NULL if none) */
+	struct block_device *bio_bdev;	/* of the last bio submitted */
+	blk_qc_t bio_cookie;		/* of the last bio, to poll for */
 
 	/* AIO related stuff */
 	struct kiocb *iocb;		/* kiocb */
@@ -375,6 +377,15 @@ static void dio_bio_submit(struct dio *dio)
 	else
 		submit_bio(dio->rw, bio);
 
+	/*
+	 * A sync dio reaps its bios itself, so this one is still there to
+	 * read its poll cookie from.
+	 */
+	if (!dio->is_async) {
+		dio->bio_bdev = bio->bi_bdev;
+		dio->bio_cookie = bio->bi_cookie;
+	}
+
 	dio->bio = NULL;
 	dio->boundary = 0;
 	dio->logical_offset_in_bio = 0;
@@ -412,7 +423,9 @@ static struct bio *dio_await_one(struct dio *dio)
 		__set_current_state(TASK_UNINTERRUPTIBLE);
 		dio->waiter = current;
 		spin_unlock_irqrestore(&dio->bio_lock, flags);
-		io_schedule();
+		if (!blk_qc_t_valid(dio->bio_cookie) ||
+		    !blk_poll(bdev_get_queue(dio->bio_bdev), dio->bio_cookie))
+			io_schedule();
 		/* wake up sets us TASK_RUNNING */
 		spin_lock_irqsave(&dio->bio_lock, flags);
 		dio->waiter = NULL;
@@ -1013,6 +1026,7 @@ direct_io_worker(int rw, struct kiocb *iocb, struct inode *inode,
 
 	spin_lock_init(&dio->bio_lock);
 	dio->refcount = 1;
+	dio->bio_cookie = BLK_QC_T_NONE;
 
 	/*
 	 * In case of non-aligned buffers, we may need 2 more
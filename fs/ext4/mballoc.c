@@ -815,8 +815,6 @@ static int ext4_mb_init_cache(struct page *page, char *incore)
 
 	/* read all groups the page covers into the cache */
 	for (i = 0; i < groups_per_page; i++) {
-		struct ext4_group_desc *desc;
-
 		if (first_group + i >= ngroups)
 			break;
 
@@ -833,65 +831,20 @@ static int ext4_mb_init_cache(struct page *page, char *incore)
 		}
 
 		err = -EIO;
-		desc = ext4_get_group_desc(sb, first_group + i, NULL);
-		if (desc == NULL)
-			goto out;
-
-		err = -ENOMEM;
-		bh[i] = sb_getblk(sb, ext4_block_bitmap(sb, desc));
+		bh[i] = ext4_read_block_bitmap_nowait(sb, first_group + i);
 		if (bh[i] == NULL)
 			goto out;
-
-		if (bitmap_uptodate(bh[i]))
-			continue;
-
-		lock_buffer(bh[i]);
-		if (bitmap_uptodate(bh[i])) {
-			unlock_buffer(bh[i]);
-			continue;
-		}
-		ext4_lock_group(sb, first_group + i);
-		if (desc->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT)) {
-			ext4_init_block_bitmap(sb, bh[i],
-						first_group + i, desc);
-			set_bitmap_uptodate(bh[i]);
-			set_buffer_uptodate(bh[i]);
-			ext4_unlock_group(sb, first_group + i);
-			unlock_buffer(bh[i]);
-			continue;
-		}
-		ext4_unlock_group(sb, first_group + i);
-		if (buffer_uptodate(bh[i])) {
-			/*
-			 * if not uninit if bh is uptodate,
-			 * bitmap is also uptodate
-			 */
-			set_bitmap_uptodate(bh[i]);
-			unlock_buffer(bh[i]);
-			continue;
-		}
-		get_bh(bh[i]);
-		/*
-		 * submit the buffer_head for read. We can
-		 * safely mark the bitmap as uptodate now.
-		 * We do it here so the bitmap uptodate bit
-		 * get set with buffer lock held.
-		 */
-		set_bitmap_uptodate(bh[i]);
-		bh[i]->b_end_io = end_buffer_read_sync;
-		submit_bh(READ, bh[i]);
 		mb_debug(1, "read bitmap for group %u\n", first_group + i);
 	}
 
 	/* wait for I/O completion */
-	for (i = 0; i < groups_per_page; i++)
-		if (bh[i])
-			wait_on_buffer(bh[i]);
-
-	err = -EIO;
-	for (i = 0; i < groups_per_page; i++)
-		if (bh[i] && !buffer_uptodate(bh[i]))
+	for (i = 0; i < groups_per_page; i++) {
+		if (bh[i] &&
+		    ext4_wait_block_bitmap(sb, first_group + i, bh[i])) {
+			err = -EIO;
 			goto out;
+		}
+	}
 
 	err = 0;
 	first_block = page->index * blocks_per_page;
@@ -1911,7 +1864,21 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 
 	/* We only do this if the grp has never been initialized */
 	if (unlikely(EXT4_MB_GRP_NEED_INIT(grp))) {
-		int ret = ext4_mb_init_group(ac->ac_sb, group);
+		int ret;
+
+		/*
+		 * bb_free and bb_largest_free_order still are what the
+		 * group descriptor says: don't read the bitmap of a group
+		 * that is empty or too full for this pass anyway.
+		 */
+		if (!grp->bb_free)
+			return 0;
+		if (cr == 0 && grp->bb_largest_free_order < ac->ac_2order)
+			return 0;
+		if (cr <= 2 && grp->bb_free < ac->ac_g_ex.fe_len)
+			return 0;
+
+		ret = ext4_mb_init_group(ac->ac_sb, group);
 		if (ret)
 			return 0;
 	}
@@ -1954,10 +1921,49 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Start reading the block bitmaps of the @nr groups from @group on that
+ * will have to be read before they can be scanned, so that the reads
+ * overlap with the scan instead of stalling it one group at a time.
+ * Returns the group to continue from.
+ */
+static ext4_group_t ext4_mb_prefetch(struct super_block *sb,
+				     ext4_group_t group, unsigned int nr,
+				     ext4_group_t ngroups)
+{
+	struct blk_plug plug;
+
+	blk_start_plug(&plug);
+	while (nr-- > 0) {
+		struct ext4_group_desc *gdp;
+		struct ext4_group_info *grp;
+		struct buffer_head *bh;
+
+		gdp = ext4_get_group_desc(sb, group, NULL);
+		grp = ext4_get_group_info(sb, group);
+
+		/* an uninitialized group needs no read */
+		if (gdp && EXT4_MB_GRP_NEED_INIT(grp) && grp->bb_free &&
+		    !(gdp->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT)) &&
+		    !test_and_set_bit(EXT4_GROUP_INFO_BBITMAP_READ_BIT,
+				      &grp->bb_state)) {
+			bh = ext4_read_block_bitmap_nowait(sb, group);
+			if (bh)
+				brelse(bh);
+		}
+
+		if (++group >= ngroups)
+			group = 0;
+	}
+	blk_finish_plug(&plug);
+
+	return group;
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
-	ext4_group_t ngroups, group, i;
+	ext4_group_t ngroups, group, prefetch_grp, i;
 	int cr;
 	int err = 0;
 	struct ext4_sb_info *sbi;
@@ -2024,6 +2030,7 @@ repeat:
 		 * from the goal value specified
 		 */
 		group = ac->ac_g_ex.fe_group;
+		prefetch_grp = group < ngroups ? group : 0;
 
 		for (i = 0; i < ngroups; group++, i++) {
 			/*
@@ -2033,6 +2040,11 @@ repeat:
 			if (group >= ngroups)
 				group = 0;
 
+			/* read the bitmaps ahead once the scan reaches them */
+			if (group == prefetch_grp && sbi->s_mb_prefetch)
+				prefetch_grp = ext4_mb_prefetch(sb, group,
+						sbi->s_mb_prefetch, ngroups);
+
 			/* This now checks without needing the buddy page */
 			if (!ext4_mb_good_group(ac, group, cr))
 				continue;
@@ -2263,7 +2275,17 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	INIT_LIST_HEAD(&meta_group_info[i]->bb_prealloc_list);
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
-	meta_group_info[i]->bb_largest_free_order = -1;  /* uninit */
+
+	/*
+	 * Until the buddy is loaded, the largest free order is bounded by
+	 * bb_free, which is enough to skip groups too full for a request
+	 */
+	if (meta_group_info[i]->bb_free)
+		meta_group_info[i]->bb_largest_free_order =
+			min_t(int, fls(meta_group_info[i]->bb_free) - 1,
+			      sb->s_blocksize_bits + 1);
+	else
+		meta_group_info[i]->bb_largest_free_order = -1;
 
 #ifdef DOUBLE_CHECK
 	{
@@ -2476,6 +2498,7 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
 	sbi->s_mb_group_prealloc = MB_DEFAULT_GROUP_PREALLOC;
+	sbi->s_mb_prefetch = MB_DEFAULT_PREFETCH;
 
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
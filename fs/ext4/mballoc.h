@@ -94,6 +94,11 @@ extern u8 mb_enable_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * block bitmaps of the groups ahead of the scan read at a time
+ */
+#define MB_DEFAULT_PREFETCH		32
+
 
 struct ext4_free_data {
 	/* this links the free block information from group_info */
@@ -35,6 +35,9 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	/* valid check of the segment numbers */
 	si->hit_ext = sbi->read_hit_ext;
 	si->total_ext = sbi->total_hit_ext;
+	si->hit_largest = sbi->hit_largest;
+	si->hit_cached = sbi->hit_cached;
+	si->ext_node = atomic_read(&sbi->total_ext_node);
 	si->ndirty_node = get_pages(sbi, F2FS_DIRTY_NODES);
 	si->ndirty_dent = get_pages(sbi, F2FS_DIRTY_DENTS);
 	si->ndirty_dirs = sbi->n_dirty_dirs;
@@ -46,6 +49,7 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->valid_node_count = valid_node_count(sbi);
 	si->valid_inode_count = valid_inode_count(sbi);
 	si->inline_inode = sbi->inline_inode;
+	si->inline_dir = sbi->inline_dir;
 	si->utilization = utilization(sbi);
 
 	si->free_segs = free_segments(sbi);
@@ -58,6 +62,18 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->sits = SIT_I(sbi)->dirty_sentries;
 	si->fnids = NM_I(sbi)->fcnt;
 	si->bg_gc = sbi->bg_gc;
+	si->bg_gc_busy = sbi->bg_gc_busy;
+	si->gc_time[BG_GC] = sbi->gc_time[BG_GC];
+	si->gc_time[FG_GC] = sbi->gc_time[FG_GC];
+	if (SM_I(sbi)->dcc_info) {
+		struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+		si->issued_discard = dcc->issued_discard;
+		si->issued_discard_blks = dcc->issued_blks;
+		si->merged_discard = dcc->merged_discard;
+		si->nr_discard_cmd = atomic_read(&dcc->nr_cmds);
+		si->undiscard_blks = dcc->undiscard_blks;
+	}
 	si->util_free = (int)(free_user_blocks(sbi) >> sbi->log_blocks_per_seg)
 		* 100 / (int)(sbi->user_block_count >> sbi->log_blocks_per_seg)
 		/ 2;
@@ -128,6 +144,7 @@ static void update_mem_info(struct f2fs_sb_info *sbi)
 
 	/* build sm */
 	si->base_mem += sizeof(struct f2fs_sm_info);
+	si->base_mem += sizeof(struct discard_cmd_control);
 
 	/* build sit */
 	si->base_mem += sizeof(struct sit_info);
@@ -150,7 +167,8 @@ static void update_mem_info(struct f2fs_sb_info *sbi)
 	/* build dirty segmap */
 	si->base_mem += sizeof(struct dirty_seglist_info);
 	si->base_mem += NR_DIRTY_TYPE * f2fs_bitmap_size(TOTAL_SEGS(sbi));
-	si->base_mem += f2fs_bitmap_size(TOTAL_SECS(sbi));
+	si->base_mem += 2 * f2fs_bitmap_size(TOTAL_SECS(sbi));
+	si->base_mem += TOTAL_SECS(sbi) * sizeof(unsigned int);
 
 	/* buld nm */
 	si->base_mem += sizeof(struct f2fs_nm_info);
@@ -169,6 +187,11 @@ get_cache:
 	si->cache_mem += npages << PAGE_CACHE_SHIFT;
 	si->cache_mem += sbi->n_orphans * sizeof(struct orphan_inode_entry);
 	si->cache_mem += sbi->n_dirty_dirs * sizeof(struct dir_inode_entry);
+	si->cache_mem += atomic_read(&sbi->total_ext_node) *
+						sizeof(struct extent_node);
+	if (SM_I(sbi)->dcc_info)
+		si->cache_mem += atomic_read(&SM_I(sbi)->dcc_info->nr_cmds) *
+						sizeof(struct discard_cmd);
 }
 
 static int stat_show(struct seq_file *s, void *v)
@@ -200,6 +223,8 @@ static int stat_show(struct seq_file *s, void *v)
 			   si->valid_count - si->valid_node_count);
 		seq_printf(s, "  - Inline_data Inode: %u\n",
 			   si->inline_inode);
+		seq_printf(s, "  - Inline_dentry Inode: %u\n",
+			   si->inline_dir);
 		seq_printf(s, "\nMain area: %d segs, %d secs %d zones\n",
 			   si->main_area_segs, si->main_area_sections,
 			   si->main_area_zones);
@@ -236,13 +261,28 @@ static int stat_show(struct seq_file *s, void *v)
 		seq_printf(s, "CP calls: %d\n", si->cp_count);
 		seq_printf(s, "GC calls: %d (BG: %d)\n",
 			   si->call_count, si->bg_gc);
+		seq_printf(s, "  - BG deferred while busy: %d\n",
+			   si->bg_gc_busy);
+		seq_printf(s, "  - time: %u ms (BG: %u ms, FG: %u ms)\n",
+			   si->gc_time[BG_GC] + si->gc_time[FG_GC],
+			   si->gc_time[BG_GC], si->gc_time[FG_GC]);
 		seq_printf(s, "  - data segments : %d\n", si->data_segs);
 		seq_printf(s, "  - node segments : %d\n", si->node_segs);
 		seq_printf(s, "Try to move %d blocks\n", si->tot_blks);
 		seq_printf(s, "  - data blocks : %d\n", si->data_blks);
 		seq_printf(s, "  - node blocks : %d\n", si->node_blks);
+		seq_printf(s, "Discard: %u cmds (%u blocks) issued, %u merged\n",
+			   si->issued_discard, si->issued_discard_blks,
+			   si->merged_discard);
+		seq_printf(s, "  - pending: %d cmds (%u blocks)\n",
+			   si->nr_discard_cmd, si->undiscard_blks);
 		seq_printf(s, "\nExtent Hit Ratio: %d / %d\n",
 			   si->hit_ext, si->total_ext);
+		seq_printf(s, "  - largest: %d, cached: %d, rbtree: %d\n",
+			   si->hit_largest, si->hit_cached,
+			   si->hit_ext - si->hit_largest - si->hit_cached);
+		seq_printf(s, "  - misses: %d\n  - extent nodes: %d\n",
+			   si->total_ext - si->hit_ext, si->ext_node);
 		seq_puts(s, "\nBalancing F2FS Async:\n");
 		seq_printf(s, "  - nodes: %4d in %4d\n",
 			   si->ndirty_node, si->node_pages);
@@ -0,0 +1,362 @@
+/*
+ * fs/f2fs/extent_cache.c
+ *
+ * Each inode caches the block mappings of its data in an rb-tree of
+ * extents, so that reads of fragmented files find their blocks without
+ * walking the node pages. All the extent nodes of a partition are kept
+ * in a global lru list, which a shrinker trims under memory pressure.
+ * The largest extent of an inode is also kept aside, since it is the
+ * one stored in the on-disk inode.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/f2fs_fs.h>
+
+#include "f2fs.h"
+
+static struct kmem_cache *extent_node_slab;
+
+static inline bool extent_contains(struct extent_info *ei, pgoff_t fofs)
+{
+	return ei->len && fofs >= ei->fofs && fofs < ei->fofs + ei->len;
+}
+
+/*
+ * Look up the extent node covering @fofs. If there is none, @prev and
+ * @next are set to its neighbours in the tree, if any.
+ */
+static struct extent_node *__lookup_extent_node(struct extent_tree *et,
+			pgoff_t fofs, struct extent_node **prev,
+			struct extent_node **next)
+{
+	struct rb_node *node = et->root.rb_node;
+	struct extent_node *en;
+
+	if (prev)
+		*prev = NULL;
+	if (next)
+		*next = NULL;
+
+	while (node) {
+		en = rb_entry(node, struct extent_node, rb_node);
+
+		if (fofs < en->ei.fofs) {
+			if (next)
+				*next = en;
+			node = node->rb_left;
+		} else if (fofs >= en->ei.fofs + en->ei.len) {
+			if (prev)
+				*prev = en;
+			node = node->rb_right;
+		} else {
+			return en;
+		}
+	}
+	return NULL;
+}
+
+static struct extent_node *__insert_extent_node(struct f2fs_sb_info *sbi,
+			struct extent_tree *et, struct extent_info *ei)
+{
+	struct rb_node **p = &et->root.rb_node;
+	struct rb_node *parent = NULL;
+	struct extent_node *en;
+
+	while (*p) {
+		parent = *p;
+		en = rb_entry(parent, struct extent_node, rb_node);
+
+		if (ei->fofs < en->ei.fofs) {
+			p = &(*p)->rb_left;
+		} else if (ei->fofs >= en->ei.fofs + en->ei.len) {
+			p = &(*p)->rb_right;
+		} else {
+			f2fs_bug_on(1);
+			return NULL;
+		}
+	}
+
+	/* called under the tree lock, and the cache may always be dropped */
+	en = kmem_cache_alloc(extent_node_slab, GFP_ATOMIC);
+	if (!en)
+		return NULL;
+
+	en->ei = *ei;
+	en->et = et;
+	rb_link_node(&en->rb_node, parent, p);
+	rb_insert_color(&en->rb_node, &et->root);
+	et->count++;
+	atomic_inc(&sbi->total_ext_node);
+
+	spin_lock(&sbi->extent_lock);
+	list_add_tail(&en->list, &sbi->extent_list);
+	spin_unlock(&sbi->extent_lock);
+	return en;
+}
+
+/* the caller holds et->lock and has taken @en off the lru list */
+static void __release_extent_node(struct f2fs_sb_info *sbi,
+			struct extent_tree *et, struct extent_node *en)
+{
+	rb_erase(&en->rb_node, &et->root);
+	et->count--;
+	if (et->cached_en == en)
+		et->cached_en = NULL;
+	atomic_dec(&sbi->total_ext_node);
+	kmem_cache_free(extent_node_slab, en);
+}
+
+static void __free_extent_node(struct f2fs_sb_info *sbi,
+			struct extent_tree *et, struct extent_node *en)
+{
+	spin_lock(&sbi->extent_lock);
+	list_del(&en->list);
+	spin_unlock(&sbi->extent_lock);
+
+	__release_extent_node(sbi, et, en);
+}
+
+static bool __update_largest_extent(struct extent_tree *et,
+						struct extent_node *en)
+{
+	if (!en || en->ei.len <= et->largest.len)
+		return false;
+	et->largest = en->ei;
+	return true;
+}
+
+void init_extent_tree(struct inode *inode, struct f2fs_extent *i_ext)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct extent_tree *et = &F2FS_I(inode)->et;
+	struct extent_info ei;
+
+	set_extent_info(&ei, le32_to_cpu(i_ext->fofs),
+			le32_to_cpu(i_ext->blk_addr), le32_to_cpu(i_ext->len));
+
+	write_lock(&et->lock);
+	et->largest = ei;
+	if (ei.len)
+		et->cached_en = __insert_extent_node(sbi, et, &ei);
+	write_unlock(&et->lock);
+}
+
+void destroy_extent_tree(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct extent_tree *et = &F2FS_I(inode)->et;
+	struct rb_node *node;
+
+	write_lock(&et->lock);
+	while ((node = rb_first(&et->root)))
+		__free_extent_node(sbi, et,
+				rb_entry(node, struct extent_node, rb_node));
+	et->largest.len = 0;
+	write_unlock(&et->lock);
+}
+
+bool lookup_extent_tree(struct inode *inode, pgoff_t pgofs,
+						struct extent_info *ei)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct extent_tree *et = &F2FS_I(inode)->et;
+	struct extent_node *en;
+	bool ret = true;
+
+	stat_inc_total_hit(inode->i_sb);
+
+	read_lock(&et->lock);
+	if (extent_contains(&et->largest, pgofs)) {
+		*ei = et->largest;
+		stat_inc_largest_hit(inode->i_sb);
+		goto hit;
+	}
+
+	en = et->cached_en;
+	if (en && extent_contains(&en->ei, pgofs)) {
+		stat_inc_cached_hit(inode->i_sb);
+	} else {
+		en = __lookup_extent_node(et, pgofs, NULL, NULL);
+		if (!en) {
+			ret = false;
+			goto out;
+		}
+		et->cached_en = en;
+	}
+	*ei = en->ei;
+
+	spin_lock(&sbi->extent_lock);
+	list_move_tail(&en->list, &sbi->extent_list);
+	spin_unlock(&sbi->extent_lock);
+hit:
+	stat_inc_read_hit(inode->i_sb);
+out:
+	read_unlock(&et->lock);
+	return ret;
+}
+
+/*
+ * Record that block @fofs of the inode now lives at @blk_addr, which is
+ * NULL_ADDR when the block is truncated. Returns true if the largest
+ * extent changed, so that the caller can write it back to the inode.
+ */
+bool update_extent_tree(struct inode *inode, pgoff_t fofs, block_t blk_addr)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct extent_tree *et = &F2FS_I(inode)->et;
+	struct extent_node *en, *en1 = NULL, *en2 = NULL;
+	struct extent_node *prev, *next;
+	struct extent_info ei, dei;
+	struct rb_node *node;
+	unsigned int endofs;
+	bool rescan = false, updated = false;
+
+	write_lock(&et->lock);
+
+	if (extent_contains(&et->largest, fofs)) {
+		et->largest.len = 0;
+		rescan = updated = true;
+	}
+
+	/*
+	 * 1. split the extent covering fofs. Extents of any length are
+	 * cached, as new mappings are, and the shrinker bounds the total.
+	 */
+	en = __lookup_extent_node(et, fofs, NULL, NULL);
+	if (en) {
+		dei = en->ei;
+		__free_extent_node(sbi, et, en);
+
+		if (fofs > dei.fofs) {
+			set_extent_info(&ei, dei.fofs, dei.blk_addr,
+							fofs - dei.fofs);
+			en1 = __insert_extent_node(sbi, et, &ei);
+		}
+
+		endofs = dei.fofs + dei.len - 1;
+		if (endofs > fofs) {
+			set_extent_info(&ei, fofs + 1,
+				dei.blk_addr + fofs - dei.fofs + 1,
+				endofs - fofs);
+			en2 = __insert_extent_node(sbi, et, &ei);
+		}
+	}
+
+	/* 2. cache the new mapping, merging it with its neighbours */
+	en = NULL;
+	if (blk_addr != NULL_ADDR) {
+		__lookup_extent_node(et, fofs, &prev, &next);
+
+		if (prev && prev->ei.fofs + prev->ei.len == fofs &&
+				prev->ei.blk_addr + prev->ei.len == blk_addr) {
+			prev->ei.len++;
+			en = prev;
+		}
+
+		if (next && next->ei.fofs == fofs + 1 &&
+				next->ei.blk_addr == blk_addr + 1) {
+			if (en) {
+				en->ei.len += next->ei.len;
+				__free_extent_node(sbi, et, next);
+				if (en2 == next)
+					en2 = NULL;
+			} else {
+				next->ei.fofs--;
+				next->ei.blk_addr--;
+				next->ei.len++;
+				en = next;
+			}
+		}
+
+		if (!en) {
+			set_extent_info(&ei, fofs, blk_addr, 1);
+			en = __insert_extent_node(sbi, et, &ei);
+		}
+		if (en)
+			et->cached_en = en;
+	}
+
+	/*
+	 * 3. the largest extent is the one kept in the on-disk inode. If it
+	 * was split, the next largest may be anywhere in the tree.
+	 */
+	if (rescan) {
+		for (node = rb_first(&et->root); node; node = rb_next(node))
+			__update_largest_extent(et,
+				rb_entry(node, struct extent_node, rb_node));
+	} else {
+		if (__update_largest_extent(et, en1))
+			updated = true;
+		if (__update_largest_extent(et, en2))
+			updated = true;
+		if (__update_largest_extent(et, en))
+			updated = true;
+	}
+
+	write_unlock(&et->lock);
+	return updated;
+}
+
+static int shrink_extent_nodes(struct f2fs_sb_info *sbi, int nr_to_scan)
+{
+	struct extent_node *en, *tmp;
+	struct extent_tree *et;
+	int freed = 0;
+
+	spin_lock(&sbi->extent_lock);
+	list_for_each_entry_safe(en, tmp, &sbi->extent_list, list) {
+		if (nr_to_scan-- <= 0)
+			break;
+
+		/* the tree lock nests outside extent_lock, so only try it */
+		et = en->et;
+		if (!write_trylock(&et->lock))
+			continue;
+
+		list_del(&en->list);
+		__release_extent_node(sbi, et, en);
+		write_unlock(&et->lock);
+		freed++;
+	}
+	spin_unlock(&sbi->extent_lock);
+	return freed;
+}
+
+static int f2fs_shrink_extent_cache(struct shrinker *shrink,
+					struct shrink_control *sc)
+{
+	struct f2fs_sb_info *sbi = container_of(shrink, struct f2fs_sb_info,
+							extent_shrinker);
+
+	if (sc->nr_to_scan)
+		shrink_extent_nodes(sbi, sc->nr_to_scan);
+
+	return atomic_read(&sbi->total_ext_node);
+}
+
+void init_extent_cache_info(struct f2fs_sb_info *sbi)
+{
+	INIT_LIST_HEAD(&sbi->extent_list);
+	spin_lock_init(&sbi->extent_lock);
+	atomic_set(&sbi->total_ext_node, 0);
+	sbi->extent_shrinker.shrink = f2fs_shrink_extent_cache;
+	sbi->extent_shrinker.seeks = DEFAULT_SEEKS;
+}
+
+int __init create_extent_cache(void)
+{
+	extent_node_slab = f2fs_kmem_cache_create("f2fs_extent_node",
+			sizeof(struct extent_node));
+	if (!extent_node_slab)
+		return -ENOMEM;
+	return 0;
+}
+
+void destroy_extent_cache(void)
+{
+	kmem_cache_destroy(extent_node_slab);
+}
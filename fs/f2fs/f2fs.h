@@ -19,6 +19,7 @@
 #include <linux/magic.h>
 #include <linux/kobject.h>
 #include <linux/sched.h>
+#include <linux/rbtree.h>
 
 #ifdef CONFIG_F2FS_CHECK_FS
 #define f2fs_bug_on(condition)	BUG_ON(condition)
@@ -40,6 +41,7 @@
 #define F2FS_MOUNT_DISABLE_EXT_IDENTIFY	0x00000040
 #define F2FS_MOUNT_INLINE_XATTR		0x00000080
 #define F2FS_MOUNT_INLINE_DATA		0x00000100
+#define F2FS_MOUNT_INLINE_DENTRY	0x00000200
 
 #define clear_opt(sbi, option)	(sbi->mount_opt.opt &= ~F2FS_MOUNT_##option)
 #define set_opt(sbi, option)	(sbi->mount_opt.opt |= F2FS_MOUNT_##option)
@@ -117,6 +119,41 @@ struct discard_entry {
 	int len;		/* # of consecutive blocks of the discard */
 };
 
+/* for the queue of discards issued in the background */
+#define DEF_DISCARD_GRANULARITY		1	/* issue discards of any size */
+#define DEF_DISCARD_IDLE_INTERVAL	1000	/* no I/O for 1 sec */
+#define DEF_MIN_DISCARD_ISSUE_TIME	50	/* ms, between idle rounds */
+#define DEF_MAX_DISCARD_ISSUE_TIME	60000	/* ms, with nothing queued */
+#define DEF_MAX_DISCARD_REQUEST		8	/* commands per idle round */
+
+struct discard_cmd {
+	struct rb_node rb_node;	/* rb node located in rb-tree */
+	block_t lstart;		/* start block address of the discard */
+	block_t len;		/* # of consecutive blocks of the discard */
+	bool issuing;		/* being sent to the device */
+};
+
+struct discard_cmd_control {
+	struct task_struct *f2fs_issue_discard;	/* discard thread */
+	wait_queue_head_t discard_wait_queue;	/* waiting queue for wake-up */
+	int discard_wake;			/* set to wake the thread up */
+	struct rb_root root;			/* queued commands by address */
+	struct mutex cmd_lock;			/* protects the rb-tree */
+	struct mutex issue_lock;		/* held while a command is sent */
+	atomic_t nr_cmds;			/* # of queued commands */
+	unsigned int undiscard_blks;		/* # of queued blocks */
+
+	unsigned int min_granularity;		/* smallest discard to issue */
+	unsigned int max_requests;		/* commands issued per round */
+	unsigned int idle_interval;		/* required I/O-free time in ms */
+	unsigned long last_ios;			/* disk I/Os at the last check */
+	unsigned long last_active;		/* jiffies when I/O was last seen */
+
+	unsigned int issued_discard;		/* # of commands sent */
+	unsigned int issued_blks;		/* # of blocks discarded */
+	unsigned int merged_discard;		/* # of ranges merged on queueing */
+};
+
 /* for the list of fsync inodes, used only during recovery */
 struct fsync_inode_entry {
 	struct list_head list;	/* list head */
@@ -152,6 +189,13 @@ static inline int update_sits_in_cursum(struct f2fs_summary_block *rs, int i)
 #define F2FS_IOC_GETFLAGS               FS_IOC_GETFLAGS
 #define F2FS_IOC_SETFLAGS               FS_IOC_SETFLAGS
 
+#define F2FS_IOCTL_MAGIC		0xf5
+#define F2FS_IOC_START_ATOMIC_WRITE	_IO(F2FS_IOCTL_MAGIC, 1)
+#define F2FS_IOC_COMMIT_ATOMIC_WRITE	_IO(F2FS_IOCTL_MAGIC, 2)
+#define F2FS_IOC_ABORT_ATOMIC_WRITE	_IO(F2FS_IOCTL_MAGIC, 5)
+#define F2FS_IOC_DEFRAGMENT		_IOWR(F2FS_IOCTL_MAGIC, 8,	\
+						struct f2fs_defragment)
+
 #if defined(__KERNEL__) && defined(CONFIG_COMPAT)
 /*
  * ioctl commands in 32 bit emulation
@@ -160,6 +204,13 @@ static inline int update_sits_in_cursum(struct f2fs_summary_block *rs, int i)
 #define F2FS_IOC32_SETFLAGS             FS_IOC32_SETFLAGS
 #endif
 
+struct f2fs_defragment {
+	__u64 start;			/* byte offset of the range */
+	__u64 len;			/* byte length of the range */
+	__u32 extents_before;		/* # of extents found in the range */
+	__u32 extents_after;		/* # of extents left in the range */
+};
+
 /*
  * For INODE and NODE manager
  */
@@ -182,15 +233,27 @@ enum {
 #define F2FS_LINK_MAX		32000	/* maximum link count per file */
 
 /* for in-memory extent cache entry */
-#define F2FS_MIN_EXTENT_LEN	16	/* minimum extent length */
-
 struct extent_info {
-	rwlock_t ext_lock;	/* rwlock for consistency */
 	unsigned int fofs;	/* start offset in a file */
 	u32 blk_addr;		/* start block address of the extent */
 	unsigned int len;	/* length of the extent */
 };
 
+struct extent_node {
+	struct rb_node rb_node;		/* rb node located in extent tree */
+	struct list_head list;		/* node in global extent lru list */
+	struct extent_info ei;		/* extent info */
+	struct extent_tree *et;		/* extent tree this node belongs to */
+};
+
+struct extent_tree {
+	struct rb_root root;		/* root of extent node rb-tree */
+	struct extent_node *cached_en;	/* recently accessed extent node */
+	struct extent_info largest;	/* largest extent, kept in the inode */
+	rwlock_t lock;			/* protect extent tree */
+	unsigned int count;		/* # of extent nodes in the tree */
+};
+
 /*
  * i_advise uses FADVISE_XXX_BIT. We can add additional hints later.
  */
@@ -216,27 +279,28 @@ struct f2fs_inode_info {
 	unsigned int clevel;		/* maximum level of given file name */
 	nid_t i_xattr_nid;		/* node id that contains xattrs */
 	unsigned long long xattr_ver;	/* cp version of xattr modification */
-	struct extent_info ext;		/* in-memory extent cache entry */
+	struct extent_tree et;		/* in-memory extent cache */
+
+	struct list_head inmem_pages;	/* pages of an atomic write */
+	struct mutex inmem_lock;	/* lock for inmem_pages */
 };
 
-static inline void get_extent_info(struct extent_info *ext,
-					struct f2fs_extent i_ext)
+static inline void set_extent_info(struct extent_info *ei, unsigned int fofs,
+					u32 blk_addr, unsigned int len)
 {
-	write_lock(&ext->ext_lock);
-	ext->fofs = le32_to_cpu(i_ext.fofs);
-	ext->blk_addr = le32_to_cpu(i_ext.blk_addr);
-	ext->len = le32_to_cpu(i_ext.len);
-	write_unlock(&ext->ext_lock);
+	ei->fofs = fofs;
+	ei->blk_addr = blk_addr;
+	ei->len = len;
 }
 
-static inline void set_raw_extent(struct extent_info *ext,
+static inline void set_raw_extent(struct extent_tree *et,
 					struct f2fs_extent *i_ext)
 {
-	read_lock(&ext->ext_lock);
-	i_ext->fofs = cpu_to_le32(ext->fofs);
-	i_ext->blk_addr = cpu_to_le32(ext->blk_addr);
-	i_ext->len = cpu_to_le32(ext->len);
-	read_unlock(&ext->ext_lock);
+	read_lock(&et->lock);
+	i_ext->fofs = cpu_to_le32(et->largest.fofs);
+	i_ext->blk_addr = cpu_to_le32(et->largest.blk_addr);
+	i_ext->len = cpu_to_le32(et->largest.len);
+	read_unlock(&et->lock);
 }
 
 struct f2fs_nm_info {
@@ -342,6 +406,9 @@ struct f2fs_sm_info {
 	int nr_discards;			/* # of discards in the list */
 	int max_discards;			/* max. discards to be issued */
 
+	/* for discards issued in the background */
+	struct discard_cmd_control *dcc_info;
+
 	unsigned int ipu_policy;	/* in-place-update policy */
 	unsigned int min_ipu_util;	/* in-place-update threshold */
 };
@@ -471,6 +538,12 @@ struct f2fs_sb_info {
 	/* maximum # of trials to find a victim segment for SSR and GC */
 	unsigned int max_victim_search;
 
+	/* for extent cache */
+	struct list_head extent_list;		/* lru list of extent nodes */
+	spinlock_t extent_lock;			/* protect extent lru list */
+	atomic_t total_ext_node;		/* # of cached extent nodes */
+	struct shrinker extent_shrinker;	/* reclaim extent nodes */
+
 	/*
 	 * for stat information.
 	 * one is for the LFS mode, and the other is for the SSR mode.
@@ -480,8 +553,12 @@ struct f2fs_sb_info {
 	unsigned int segment_count[2];		/* # of allocated segments */
 	unsigned int block_count[2];		/* # of allocated blocks */
 	int total_hit_ext, read_hit_ext;	/* extent cache hit ratio */
+	int hit_largest, hit_cached;		/* hits without rb-tree walk */
 	int inline_inode;			/* # of inline_data inodes */
+	int inline_dir;				/* # of inline_dentry inodes */
 	int bg_gc;				/* background gc calls */
+	int bg_gc_busy;				/* bg gc deferred by busy I/O */
+	unsigned int gc_time[2];		/* bg/fg gc time in msec */
 	unsigned int n_dirty_dirs;		/* # of dir inodes */
 #endif
 	unsigned int last_victim[2];		/* last victim segment # */
@@ -951,6 +1028,9 @@ enum {
 	FI_NO_EXTENT,		/* not to use the extent cache */
 	FI_INLINE_XATTR,	/* used for inline xattr */
 	FI_INLINE_DATA,		/* used for inline data*/
+	FI_INLINE_DENTRY,	/* used for inline dentry */
+	FI_ATOMIC_FILE,		/* indicate atomic file */
+	FI_DO_DEFRAG,		/* indicate defragment is running */
 };
 
 static inline void set_inode_flag(struct f2fs_inode_info *fi, int flag)
@@ -990,6 +1070,8 @@ static inline void get_inline_info(struct f2fs_inode_info *fi,
 		set_inode_flag(fi, FI_INLINE_XATTR);
 	if (ri->i_inline & F2FS_INLINE_DATA)
 		set_inode_flag(fi, FI_INLINE_DATA);
+	if (ri->i_inline & F2FS_INLINE_DENTRY)
+		set_inode_flag(fi, FI_INLINE_DENTRY);
 }
 
 static inline void set_raw_inline(struct f2fs_inode_info *fi,
@@ -1001,6 +1083,8 @@ static inline void set_raw_inline(struct f2fs_inode_info *fi,
 		ri->i_inline |= F2FS_INLINE_XATTR;
 	if (is_inode_flag_set(fi, FI_INLINE_DATA))
 		ri->i_inline |= F2FS_INLINE_DATA;
+	if (is_inode_flag_set(fi, FI_INLINE_DENTRY))
+		ri->i_inline |= F2FS_INLINE_DENTRY;
 }
 
 static inline int f2fs_has_inline_xattr(struct inode *inode)
@@ -1041,6 +1125,16 @@ static inline void *inline_data_addr(struct page *page)
 	return (void *)&(ri->i_addr[1]);
 }
 
+static inline int f2fs_has_inline_dentry(struct inode *inode)
+{
+	return is_inode_flag_set(F2FS_I(inode), FI_INLINE_DENTRY);
+}
+
+static inline bool f2fs_is_atomic_file(struct inode *inode)
+{
+	return is_inode_flag_set(F2FS_I(inode), FI_ATOMIC_FILE);
+}
+
 static inline int f2fs_readonly(struct super_block *sb)
 {
 	return sb->s_flags & MS_RDONLY;
@@ -1085,6 +1179,45 @@ struct dentry *f2fs_get_parent(struct dentry *child);
 /*
  * dir.c
  */
+/* the dentries of a dentry block or of an inline directory */
+struct f2fs_dentry_ptr {
+	void *bitmap;
+	struct f2fs_dir_entry *dentry;
+	__u8 (*filename)[F2FS_SLOT_LEN];
+	int max;
+};
+
+static inline void make_dentry_ptr(struct f2fs_dentry_ptr *d,
+					void *src, bool is_inline)
+{
+	if (is_inline) {
+		struct f2fs_inline_dentry *t = src;
+
+		d->max = NR_INLINE_DENTRY;
+		d->bitmap = &t->dentry_bitmap;
+		d->dentry = t->dentry;
+		d->filename = t->filename;
+	} else {
+		struct f2fs_dentry_block *t = src;
+
+		d->max = NR_DENTRY_IN_BLOCK;
+		d->bitmap = &t->dentry_bitmap;
+		d->dentry = t->dentry;
+		d->filename = t->filename;
+	}
+}
+
+struct f2fs_dir_entry *find_target_dentry(const char *, size_t, f2fs_hash_t,
+					int *, struct f2fs_dentry_ptr *);
+bool f2fs_fill_dentries(struct file *, void *, filldir_t,
+			struct f2fs_dentry_ptr *, unsigned int, unsigned int);
+void do_make_empty_dir(struct inode *, struct inode *,
+			struct f2fs_dentry_ptr *);
+struct page *init_inode_metadata(struct inode *, struct inode *,
+			const struct qstr *);
+void update_parent_metadata(struct inode *, struct inode *, unsigned int);
+int room_for_filename(const void *, int, int);
+void f2fs_drop_nlink(struct inode *, struct inode *, struct page *);
 struct f2fs_dir_entry *f2fs_find_entry(struct inode *, struct qstr *,
 							struct page **);
 struct f2fs_dir_entry *f2fs_parent_dir(struct inode *, struct page **);
@@ -1092,8 +1225,11 @@ ino_t f2fs_inode_by_name(struct inode *, struct qstr *);
 void f2fs_set_link(struct inode *, struct f2fs_dir_entry *,
 				struct page *, struct inode *);
 int update_dent_inode(struct inode *, const struct qstr *);
+void f2fs_update_dentry(struct inode *, struct f2fs_dentry_ptr *,
+			const struct qstr *, f2fs_hash_t, unsigned int);
 int __f2fs_add_link(struct inode *, const struct qstr *, struct inode *);
-void f2fs_delete_entry(struct f2fs_dir_entry *, struct page *, struct inode *);
+void f2fs_delete_entry(struct f2fs_dir_entry *, struct page *,
+				struct inode *, struct inode *);
 int f2fs_make_empty(struct inode *, struct inode *);
 bool f2fs_empty_dir(struct inode *);
 
@@ -1135,7 +1271,8 @@ void ra_node_page(struct f2fs_sb_info *, nid_t);
 struct page *get_node_page(struct f2fs_sb_info *, pgoff_t);
 struct page *get_node_page_ra(struct page *, int);
 void sync_inode_page(struct dnode_of_data *);
-int sync_node_pages(struct f2fs_sb_info *, nid_t, struct writeback_control *);
+int sync_node_pages(struct f2fs_sb_info *, nid_t, struct writeback_control *,
+								bool);
 bool alloc_nid(struct f2fs_sb_info *, nid_t *);
 void alloc_nid_done(struct f2fs_sb_info *, nid_t);
 void alloc_nid_failed(struct f2fs_sb_info *, nid_t);
@@ -1154,6 +1291,8 @@ void destroy_node_manager_caches(void);
 /*
  * segment.c
  */
+void register_inmem_page(struct inode *, struct page *);
+int commit_inmem_pages(struct inode *, bool);
 void f2fs_balance_fs(struct f2fs_sb_info *);
 void f2fs_balance_fs_bg(struct f2fs_sb_info *);
 void invalidate_blocks(struct f2fs_sb_info *, block_t);
@@ -1218,6 +1357,7 @@ void f2fs_submit_page_mbio(struct f2fs_sb_info *, struct page *, block_t,
 int reserve_new_block(struct dnode_of_data *);
 int f2fs_reserve_block(struct dnode_of_data *, pgoff_t);
 void update_extent_cache(block_t, struct dnode_of_data *);
+void revoke_data_blkaddr(struct dnode_of_data *, block_t);
 struct page *find_data_page(struct inode *, pgoff_t, bool);
 struct page *get_lock_data_page(struct inode *, pgoff_t);
 struct page *get_new_data_page(struct inode *, struct page *, pgoff_t, bool);
@@ -1234,6 +1374,17 @@ void build_gc_manager(struct f2fs_sb_info *);
 int __init create_gc_caches(void);
 void destroy_gc_caches(void);
 
+/*
+ * extent_cache.c
+ */
+void init_extent_tree(struct inode *, struct f2fs_extent *);
+void destroy_extent_tree(struct inode *);
+bool lookup_extent_tree(struct inode *, pgoff_t, struct extent_info *);
+bool update_extent_tree(struct inode *, pgoff_t, block_t);
+void init_extent_cache_info(struct f2fs_sb_info *);
+int __init create_extent_cache(void);
+void destroy_extent_cache(void);
+
 /*
  * recovery.c
  */
@@ -1250,11 +1401,15 @@ struct f2fs_stat_info {
 	struct mutex stat_lock;
 	int all_area_segs, sit_area_segs, nat_area_segs, ssa_area_segs;
 	int main_area_segs, main_area_sections, main_area_zones;
-	int hit_ext, total_ext;
+	int hit_ext, total_ext, hit_largest, hit_cached, ext_node;
 	int ndirty_node, ndirty_dent, ndirty_dirs, ndirty_meta;
 	int nats, sits, fnids;
 	int total_count, utilization;
-	int bg_gc, inline_inode;
+	int bg_gc, bg_gc_busy, inline_inode, inline_dir;
+	unsigned int gc_time[2];
+	unsigned int issued_discard, issued_discard_blks, merged_discard;
+	int nr_discard_cmd;
+	unsigned int undiscard_blks;
 	unsigned int valid_count, valid_node_count, valid_inode_count;
 	unsigned int bimodal, avg_vblocks;
 	int util_free, util_valid, util_invalid;
@@ -1280,10 +1435,15 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 #define stat_inc_cp_count(si)		((si)->cp_count++)
 #define stat_inc_call_count(si)		((si)->call_count++)
 #define stat_inc_bggc_count(sbi)	((sbi)->bg_gc++)
+#define stat_inc_bggc_busy(sbi)		((sbi)->bg_gc_busy++)
+#define stat_add_gc_time(sbi, type, start)				\
+		((sbi)->gc_time[type] += jiffies_to_msecs(jiffies - (start)))
 #define stat_inc_dirty_dir(sbi)		((sbi)->n_dirty_dirs++)
 #define stat_dec_dirty_dir(sbi)		((sbi)->n_dirty_dirs--)
 #define stat_inc_total_hit(sb)		((F2FS_SB(sb))->total_hit_ext++)
 #define stat_inc_read_hit(sb)		((F2FS_SB(sb))->read_hit_ext++)
+#define stat_inc_largest_hit(sb)	((F2FS_SB(sb))->hit_largest++)
+#define stat_inc_cached_hit(sb)		((F2FS_SB(sb))->hit_cached++)
 #define stat_inc_inline_inode(inode)					\
 	do {								\
 		if (f2fs_has_inline_data(inode))			\
@@ -1294,6 +1454,16 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 		if (f2fs_has_inline_data(inode))			\
 			((F2FS_SB(inode->i_sb))->inline_inode--);	\
 	} while (0)
+#define stat_inc_inline_dir(inode)					\
+	do {								\
+		if (f2fs_has_inline_dentry(inode))			\
+			((F2FS_SB(inode->i_sb))->inline_dir++);		\
+	} while (0)
+#define stat_dec_inline_dir(inode)					\
+	do {								\
+		if (f2fs_has_inline_dentry(inode))			\
+			((F2FS_SB(inode->i_sb))->inline_dir--);		\
+	} while (0)
 
 #define stat_inc_seg_type(sbi, curseg)					\
 		((sbi)->segment_count[(curseg)->alloc_type]++)
@@ -1335,12 +1505,18 @@ void f2fs_destroy_root_stats(void);
 #define stat_inc_cp_count(si)
 #define stat_inc_call_count(si)
 #define stat_inc_bggc_count(si)
+#define stat_inc_bggc_busy(sbi)
+#define stat_add_gc_time(sbi, type, start)
 #define stat_inc_dirty_dir(sbi)
 #define stat_dec_dirty_dir(sbi)
 #define stat_inc_total_hit(sb)
 #define stat_inc_read_hit(sb)
+#define stat_inc_largest_hit(sb)
+#define stat_inc_cached_hit(sb)
 #define stat_inc_inline_inode(inode)
 #define stat_dec_inline_inode(inode)
+#define stat_inc_inline_dir(inode)
+#define stat_dec_inline_dir(inode)
 #define stat_inc_seg_type(sbi, curseg)
 #define stat_inc_block_count(sbi, curseg)
 #define stat_inc_seg_count(si, type)
@@ -1372,4 +1548,13 @@ int f2fs_read_inline_data(struct inode *, struct page *);
 int f2fs_convert_inline_data(struct inode *, pgoff_t);
 int f2fs_write_inline_data(struct inode *, struct page *, unsigned int);
 int recover_inline_data(struct inode *, struct page *);
+struct f2fs_dir_entry *find_in_inline_dir(struct inode *, struct qstr *,
+							struct page **);
+struct f2fs_dir_entry *f2fs_parent_inline_dir(struct inode *, struct page **);
+int make_empty_inline_dir(struct inode *, struct inode *, struct page *);
+int f2fs_add_inline_entry(struct inode *, const struct qstr *, struct inode *);
+void f2fs_delete_inline_entry(struct f2fs_dir_entry *, struct page *,
+						struct inode *, struct inode *);
+bool f2fs_empty_inline_dir(struct inode *);
+int f2fs_read_inline_dir(struct file *, void *, filldir_t);
 #endif
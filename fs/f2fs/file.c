@@ -110,7 +110,8 @@ static int get_parent_ino(struct inode *inode, nid_t *pino)
 	return 1;
 }
 
-int f2fs_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
+static int f2fs_do_sync_file(struct file *file, loff_t start, loff_t end,
+						int datasync, bool atomic)
 {
 	struct inode *inode = file->f_mapping->host;
 	struct f2fs_inode_info *fi = F2FS_I(inode);
@@ -177,7 +178,7 @@ int f2fs_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 		}
 	} else {
 		/* if there is no written node page, write its inode page */
-		while (!sync_node_pages(sbi, inode->i_ino, &wbc)) {
+		while (!sync_node_pages(sbi, inode->i_ino, &wbc, atomic)) {
 			if (fsync_mark_done(sbi, inode->i_ino))
 				goto out;
 			mark_inode_dirty_sync(inode);
@@ -195,6 +196,15 @@ out:
 	return ret;
 }
 
+int f2fs_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
+{
+	/* an atomic write becomes durable only by its commit */
+	if (f2fs_is_atomic_file(file->f_mapping->host))
+		return 0;
+
+	return f2fs_do_sync_file(file, start, end, datasync, false);
+}
+
 static int f2fs_file_mmap(struct file *file, struct vm_area_struct *vma)
 {
 	file_accessed(file);
@@ -271,7 +281,7 @@ int truncate_blocks(struct inode *inode, u64 from)
 
 	trace_f2fs_truncate_blocks_enter(inode, from);
 
-	if (f2fs_has_inline_data(inode))
+	if (f2fs_has_inline_data(inode) || f2fs_has_inline_dentry(inode))
 		goto done;
 
 	free_from = (pgoff_t)
@@ -587,6 +597,20 @@ static long f2fs_fallocate(struct file *file, int mode,
 	return ret;
 }
 
+static int f2fs_release_file(struct inode *inode, struct file *filp)
+{
+	/* a transaction that was not committed is dropped at close */
+	if (f2fs_is_atomic_file(inode)) {
+		mutex_lock(&inode->i_mutex);
+		if (f2fs_is_atomic_file(inode)) {
+			commit_inmem_pages(inode, true);
+			clear_inode_flag(F2FS_I(inode), FI_ATOMIC_FILE);
+		}
+		mutex_unlock(&inode->i_mutex);
+	}
+	return 0;
+}
+
 #define F2FS_REG_FLMASK		(~(FS_DIRSYNC_FL | FS_TOPDIR_FL))
 #define F2FS_OTHER_FLMASK	(FS_NODUMP_FL | FS_NOATIME_FL)
 
@@ -600,6 +624,263 @@ static inline __u32 f2fs_mask_flags(umode_t mode, __u32 flags)
 		return flags & F2FS_OTHER_FLMASK;
 }
 
+/*
+ * Between START and COMMIT, the written pages of the file stay in memory.
+ * COMMIT writes all of them and syncs the file, so that they survive a
+ * power cut either all together or not at all. ABORT and close drop them.
+ */
+static int f2fs_ioc_start_atomic_write(struct file *filp)
+{
+	struct inode *inode = filp->f_dentry->d_inode;
+	int ret;
+
+	if (!S_ISREG(inode->i_mode))
+		return -EINVAL;
+
+	if (!inode_owner_or_capable(inode))
+		return -EACCES;
+
+	mutex_lock(&inode->i_mutex);
+	if (f2fs_is_atomic_file(inode)) {
+		ret = 0;
+		goto out;
+	}
+
+	/* inline data is written through the inode page, not by the list */
+	ret = f2fs_convert_inline_data(inode, MAX_INLINE_DATA + 1);
+	if (ret)
+		goto out;
+
+	/* dirty pages written before the transaction are not part of it */
+	ret = filemap_write_and_wait(inode->i_mapping);
+	if (ret)
+		goto out;
+
+	set_inode_flag(F2FS_I(inode), FI_ATOMIC_FILE);
+out:
+	mutex_unlock(&inode->i_mutex);
+	return ret;
+}
+
+static int f2fs_ioc_commit_atomic_write(struct file *filp)
+{
+	struct inode *inode = filp->f_dentry->d_inode;
+	int ret;
+
+	if (!inode_owner_or_capable(inode))
+		return -EACCES;
+
+	ret = mnt_want_write_file(filp);
+	if (ret)
+		return ret;
+
+	/*
+	 * The file stays atomic until the transaction is synced, so that a
+	 * failed commit leaves its pages to be committed again or aborted.
+	 * The sync puts the fsync mark on the last dnode of the commit only.
+	 */
+	mutex_lock(&inode->i_mutex);
+	if (f2fs_is_atomic_file(inode)) {
+		ret = commit_inmem_pages(inode, false);
+		if (!ret)
+			ret = f2fs_do_sync_file(filp, 0, LLONG_MAX, 0, true);
+		if (!ret)
+			clear_inode_flag(F2FS_I(inode), FI_ATOMIC_FILE);
+	} else {
+		ret = f2fs_do_sync_file(filp, 0, LLONG_MAX, 0, false);
+	}
+	mutex_unlock(&inode->i_mutex);
+
+	mnt_drop_write_file(filp);
+	return ret;
+}
+
+static int f2fs_ioc_abort_atomic_write(struct file *filp)
+{
+	struct inode *inode = filp->f_dentry->d_inode;
+
+	if (!inode_owner_or_capable(inode))
+		return -EACCES;
+
+	mutex_lock(&inode->i_mutex);
+	if (f2fs_is_atomic_file(inode)) {
+		commit_inmem_pages(inode, true);
+		clear_inode_flag(F2FS_I(inode), FI_ATOMIC_FILE);
+	}
+	mutex_unlock(&inode->i_mutex);
+	return 0;
+}
+
+/*
+ * Count the runs of consecutive block addresses which map the pages in
+ * [pg_start, pg_end). Holes and blocks not written yet end a run.
+ */
+static int count_data_extents(struct inode *inode, pgoff_t pg_start,
+				pgoff_t pg_end, unsigned int *extents)
+{
+	block_t blkaddr, prev = NULL_ADDR;
+	pgoff_t index = pg_start;
+	unsigned int end_offset;
+	struct dnode_of_data dn;
+	int err;
+
+	*extents = 0;
+	while (index < pg_end) {
+		set_new_dnode(&dn, inode, NULL, NULL, 0);
+		err = get_dnode_of_data(&dn, index, LOOKUP_NODE_RA);
+		if (err == -ENOENT) {
+			prev = NULL_ADDR;
+			index++;
+			continue;
+		} else if (err) {
+			return err;
+		}
+
+		end_offset = IS_INODE(dn.node_page) ?
+				ADDRS_PER_INODE(F2FS_I(inode)) : ADDRS_PER_BLOCK;
+		for (; dn.ofs_in_node < end_offset && index < pg_end;
+					dn.ofs_in_node++, index++) {
+			blkaddr = datablock_addr(dn.node_page, dn.ofs_in_node);
+			if (blkaddr == NULL_ADDR || blkaddr == NEW_ADDR) {
+				prev = NULL_ADDR;
+				continue;
+			}
+			if (prev == NULL_ADDR || blkaddr != prev + 1)
+				(*extents)++;
+			prev = blkaddr;
+		}
+		f2fs_put_dnode(&dn);
+	}
+	return 0;
+}
+
+/*
+ * Rewrite the pages of a fragmented range so that writeback allocates them
+ * again, one after another, in the current data log. Writeback of regular
+ * files is serialized by sbi->writepages, so the new blocks are consecutive
+ * as long as the log allocates in LFS mode. SSR would scatter them over the
+ * holes of dirty segments instead, so give up with -EAGAIN when it may kick
+ * in before the range is done; cleaning will make room in the meantime.
+ */
+static int f2fs_defragment_range(struct file *filp,
+					struct f2fs_defragment *range)
+{
+	struct inode *inode = filp->f_dentry->d_inode;
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct address_space *mapping = inode->i_mapping;
+	unsigned int blks_per_sec = sbi->blocks_per_seg * sbi->segs_per_sec;
+	pgoff_t pg_start, pg_end, index, batch_start, batch_end;
+	unsigned int nr_secs;
+	struct page *page;
+	int err;
+
+	if (f2fs_has_inline_data(inode) || f2fs_is_atomic_file(inode))
+		return -EINVAL;
+
+	pg_start = range->start >> PAGE_CACHE_SHIFT;
+	pg_end = DIV_ROUND_UP(min_t(u64, range->start + range->len,
+				i_size_read(inode)), PAGE_CACHE_SIZE);
+	range->extents_before = range->extents_after = 0;
+	if (pg_start >= pg_end)
+		return 0;
+
+	/* every dirty page of the range has to get its block first */
+	err = filemap_write_and_wait_range(mapping,
+			(loff_t)pg_start << PAGE_CACHE_SHIFT,
+			((loff_t)pg_end << PAGE_CACHE_SHIFT) - 1);
+	if (err)
+		return err;
+
+	err = count_data_extents(inode, pg_start, pg_end,
+						&range->extents_before);
+	if (err || range->extents_before <= 1) {
+		range->extents_after = range->extents_before;
+		return err;
+	}
+
+	nr_secs = DIV_ROUND_UP(pg_end - pg_start, blks_per_sec);
+	if (has_not_enough_free_secs(sbi, 0) ||
+			free_sections(sbi) < nr_secs +
+					overprovision_sections(sbi))
+		return -EAGAIN;
+
+	set_inode_flag(F2FS_I(inode), FI_DO_DEFRAG);
+
+	for (index = pg_start; index < pg_end; index = batch_end) {
+		/* one section at a time, to bound the dirty pages */
+		batch_start = index;
+		batch_end = min_t(pgoff_t, index + blks_per_sec, pg_end);
+
+		page_cache_sync_readahead(mapping, &filp->f_ra, filp, index,
+							batch_end - index);
+
+		for (; index < batch_end; index++) {
+			page = get_lock_data_page(inode, index);
+			if (IS_ERR(page)) {
+				err = PTR_ERR(page);
+				if (err == -ENOENT)
+					continue;
+				goto clear_out;
+			}
+
+			f2fs_wait_on_page_writeback(page, DATA);
+			set_page_dirty(page);
+			f2fs_put_page(page, 1);
+		}
+
+		err = filemap_write_and_wait_range(mapping,
+			(loff_t)batch_start << PAGE_CACHE_SHIFT,
+			((loff_t)batch_end << PAGE_CACHE_SHIFT) - 1);
+		if (err)
+			goto clear_out;
+	}
+
+	err = count_data_extents(inode, pg_start, pg_end,
+						&range->extents_after);
+clear_out:
+	clear_inode_flag(F2FS_I(inode), FI_DO_DEFRAG);
+	return err;
+}
+
+static int f2fs_ioc_defragment(struct file *filp, unsigned long arg)
+{
+	struct inode *inode = filp->f_dentry->d_inode;
+	struct f2fs_defragment range;
+	int err;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (!S_ISREG(inode->i_mode))
+		return -EINVAL;
+
+	if (copy_from_user(&range, (struct f2fs_defragment __user *)arg,
+							sizeof(range)))
+		return -EFAULT;
+
+	if (range.start + range.len < range.start)
+		return -EINVAL;
+
+	err = mnt_want_write_file(filp);
+	if (err)
+		return err;
+
+	f2fs_balance_fs(F2FS_SB(inode->i_sb));
+
+	mutex_lock(&inode->i_mutex);
+	err = f2fs_defragment_range(filp, &range);
+	mutex_unlock(&inode->i_mutex);
+
+	mnt_drop_write_file(filp);
+	if (err)
+		return err;
+
+	if (copy_to_user((struct f2fs_defragment __user *)arg, &range,
+							sizeof(range)))
+		return -EFAULT;
+	return 0;
+}
+
 long f2fs_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	struct inode *inode = filp->f_dentry->d_inode;
@@ -655,6 +936,14 @@ out:
 		mnt_drop_write_file(filp);
 		return ret;
 	}
+	case F2FS_IOC_START_ATOMIC_WRITE:
+		return f2fs_ioc_start_atomic_write(filp);
+	case F2FS_IOC_COMMIT_ATOMIC_WRITE:
+		return f2fs_ioc_commit_atomic_write(filp);
+	case F2FS_IOC_ABORT_ATOMIC_WRITE:
+		return f2fs_ioc_abort_atomic_write(filp);
+	case F2FS_IOC_DEFRAGMENT:
+		return f2fs_ioc_defragment(filp, arg);
 	default:
 		return -ENOTTY;
 	}
@@ -670,6 +959,11 @@ long f2fs_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case F2FS_IOC32_SETFLAGS:
 		cmd = F2FS_IOC_SETFLAGS;
 		break;
+	case F2FS_IOC_START_ATOMIC_WRITE:
+	case F2FS_IOC_COMMIT_ATOMIC_WRITE:
+	case F2FS_IOC_ABORT_ATOMIC_WRITE:
+	case F2FS_IOC_DEFRAGMENT:
+		break;
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -684,6 +978,7 @@ const struct file_operations f2fs_file_operations = {
 	.aio_read	= generic_file_aio_read,
 	.aio_write	= generic_file_aio_write,
 	.open		= generic_file_open,
+	.release	= f2fs_release_file,
 	.mmap		= f2fs_file_mmap,
 	.fsync		= f2fs_sync_file,
 	.fallocate	= f2fs_fallocate,
@@ -31,9 +31,9 @@ static int gc_thread_func(void *data)
 	struct f2fs_sb_info *sbi = data;
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	wait_queue_head_t *wq = &sbi->gc_thread->gc_wait_queue_head;
-	long wait_ms;
+	long wait_ms, sleep_ms;
 
-	wait_ms = gc_th->min_sleep_time;
+	wait_ms = sleep_ms = gc_th->min_sleep_time;
 
 	do {
 		if (try_to_freeze())
@@ -41,17 +41,20 @@ static int gc_thread_func(void *data)
 		else
 			wait_event_interruptible_timeout(*wq,
 						kthread_should_stop(),
-						msecs_to_jiffies(wait_ms));
+						msecs_to_jiffies(sleep_ms));
 		if (kthread_should_stop())
 			break;
 
+		sleep_ms = wait_ms;
+
 		/*
 		 * [GC triggering condition]
 		 * 0. GC is not conducted currently.
 		 * 1. There are enough dirty segments.
 		 * 2. IO subsystem is idle by checking the # of writeback pages.
 		 * 3. IO subsystem is idle by checking the # of requests in
-		 *    bdev's request list.
+		 *    bdev's request list, and no I/O was done for the last
+		 *    idle_interval.
 		 *
 		 * Note) We have to avoid triggering GCs too much frequently.
 		 * Because it is possible that some segments can be
@@ -61,22 +64,31 @@ static int gc_thread_func(void *data)
 		if (!mutex_trylock(&sbi->gc_mutex))
 			continue;
 
+		/*
+		 * Check again soon while the device is busy, so that GC starts
+		 * right after an idle interval instead of a full sleep later.
+		 */
 		if (!is_idle(sbi)) {
-			wait_ms = increase_sleep_time(gc_th, wait_ms);
+			stat_inc_bggc_busy(sbi);
+			sleep_ms = gc_th->idle_interval ? : gc_th->min_sleep_time;
 			mutex_unlock(&sbi->gc_mutex);
 			continue;
 		}
 
 		if (has_enough_invalid_blocks(sbi))
-			wait_ms = decrease_sleep_time(gc_th, wait_ms);
+			wait_ms = decrease_sleep_time(sbi, gc_th, wait_ms);
 		else
-			wait_ms = increase_sleep_time(gc_th, wait_ms);
+			wait_ms = increase_sleep_time(sbi, gc_th, wait_ms);
 
 		stat_inc_bggc_count(sbi);
 
 		/* if return value is not zero, no victim was selected */
 		if (f2fs_gc(sbi))
 			wait_ms = gc_th->no_gc_sleep_time;
+		sleep_ms = wait_ms;
+
+		/* the I/O of GC itself does not make the device busy */
+		gc_th->last_ios = disk_ios(sbi->sb->s_bdev);
 
 		/* balancing f2fs's metadata periodically */
 		f2fs_balance_fs_bg(sbi);
@@ -105,6 +117,10 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 
 	gc_th->gc_idle = 0;
 
+	gc_th->idle_interval = DEF_GC_THREAD_IDLE_INTERVAL;
+	gc_th->last_ios = disk_ios(sbi->sb->s_bdev);
+	gc_th->last_active = jiffies;
+
 	sbi->gc_thread = gc_th;
 	init_waitqueue_head(&sbi->gc_thread->gc_wait_queue_head);
 	sbi->gc_thread->f2fs_gc_task = kthread_run(gc_thread_func, sbi,
@@ -153,8 +169,8 @@ static void select_policy(struct f2fs_sb_info *sbi, int gc_type,
 		p->ofs_unit = 1;
 	} else {
 		p->gc_mode = select_gc_type(sbi->gc_thread, gc_type);
-		p->dirty_segmap = dirty_i->dirty_segmap[DIRTY];
-		p->max_search = dirty_i->nr_dirty[DIRTY];
+		p->dirty_segmap = dirty_i->dirty_secmap;
+		p->max_search = dirty_i->nr_dirty_secs;
 		p->ofs_unit = sbi->segs_per_sec;
 	}
 
@@ -279,8 +295,16 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 		unsigned long cost;
 		unsigned int segno;
 
-		segno = find_next_bit(p.dirty_segmap,
+		if (p.alloc_mode == LFS) {
+			/* cleaning goes by sections, so skip the clean ones */
+			secno = find_next_bit(p.dirty_segmap, TOTAL_SECS(sbi),
+						GET_SECNO(sbi, p.offset));
+			segno = secno < TOTAL_SECS(sbi) ?
+				secno * sbi->segs_per_sec : TOTAL_SEGS(sbi);
+		} else {
+			segno = find_next_bit(p.dirty_segmap,
 						TOTAL_SEGS(sbi), p.offset);
+		}
 		if (segno >= TOTAL_SEGS(sbi)) {
 			if (sbi->last_victim[p.gc_mode]) {
 				sbi->last_victim[p.gc_mode] = 0;
@@ -444,7 +468,7 @@ next_step:
 			.nr_to_write = LONG_MAX,
 			.for_reclaim = 0,
 		};
-		sync_node_pages(sbi, 0, &wbc);
+		sync_node_pages(sbi, 0, &wbc, false);
 
 		/*
 		 * In the case of FG_GC, it'd be better to reclaim this victim
@@ -520,6 +544,10 @@ static void move_data_page(struct inode *inode, struct page *page, int gc_type)
 		.rw = WRITE_SYNC,
 	};
 
+	/* the page may hold an uncommitted atomic write */
+	if (f2fs_is_atomic_file(inode))
+		goto out;
+
 	if (gc_type == BG_GC) {
 		if (PageWriteback(page))
 			goto out;
@@ -683,6 +711,7 @@ int f2fs_gc(struct f2fs_sb_info *sbi)
 {
 	struct list_head ilist;
 	unsigned int segno, i;
+	unsigned long start = jiffies;
 	int gc_type = BG_GC;
 	int nfree = 0;
 	int ret = -1;
@@ -723,6 +752,7 @@ gc_more:
 	if (gc_type == FG_GC)
 		write_checkpoint(sbi, false);
 stop:
+	stat_add_gc_time(sbi, gc_type, start);
 	mutex_unlock(&sbi->gc_mutex);
 
 	put_gc_inode(&ilist);
@@ -16,6 +16,7 @@
 #define DEF_GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define DEF_GC_THREAD_MAX_SLEEP_TIME	60000
 #define DEF_GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+#define DEF_GC_THREAD_IDLE_INTERVAL	5000	/* no I/O for 5 sec */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
 
@@ -33,6 +34,11 @@ struct f2fs_gc_kthread {
 
 	/* for changing gc mode */
 	unsigned int gc_idle;
+
+	/* for idle detection */
+	unsigned int idle_interval;	/* required I/O-free time in ms */
+	unsigned long last_ios;		/* disk I/Os seen at the last check */
+	unsigned long last_active;	/* jiffies when I/O was last seen */
 };
 
 struct inode_entry {
@@ -64,21 +70,45 @@ static inline block_t limit_free_user_blocks(struct f2fs_sb_info *sbi)
 	return (long)(reclaimable_user_blocks * LIMIT_FREE_BLOCK) / 100;
 }
 
-static inline long increase_sleep_time(struct f2fs_gc_kthread *gc_th, long wait)
+/*
+ * The fewer free blocks are left below the level that triggers background
+ * GC, the sooner the GC thread has to run again: its longest sleep shrinks
+ * linearly with them from max_sleep_time down to min_sleep_time.
+ */
+static inline long cur_max_sleep_time(struct f2fs_sb_info *sbi,
+					struct f2fs_gc_kthread *gc_th)
+{
+	block_t free = free_user_blocks(sbi);
+	block_t limit = limit_free_user_blocks(sbi);
+
+	if (free >= limit || gc_th->max_sleep_time <= gc_th->min_sleep_time)
+		return gc_th->max_sleep_time;
+
+	return gc_th->min_sleep_time + div_u64((u64)free *
+		(gc_th->max_sleep_time - gc_th->min_sleep_time), limit);
+}
+
+static inline long increase_sleep_time(struct f2fs_sb_info *sbi,
+				struct f2fs_gc_kthread *gc_th, long wait)
 {
+	long max_wait = cur_max_sleep_time(sbi, gc_th);
+
 	if (wait == gc_th->no_gc_sleep_time)
 		return wait;
 
 	wait += gc_th->min_sleep_time;
-	if (wait > gc_th->max_sleep_time)
-		wait = gc_th->max_sleep_time;
+	if (wait > max_wait)
+		wait = max_wait;
 	return wait;
 }
 
-static inline long decrease_sleep_time(struct f2fs_gc_kthread *gc_th, long wait)
+static inline long decrease_sleep_time(struct f2fs_sb_info *sbi,
+				struct f2fs_gc_kthread *gc_th, long wait)
 {
-	if (wait == gc_th->no_gc_sleep_time)
-		wait = gc_th->max_sleep_time;
+	long max_wait = cur_max_sleep_time(sbi, gc_th);
+
+	if (wait == gc_th->no_gc_sleep_time || wait > max_wait)
+		wait = max_wait;
 
 	wait -= gc_th->min_sleep_time;
 	if (wait <= gc_th->min_sleep_time)
@@ -101,10 +131,10 @@ static inline bool has_enough_invalid_blocks(struct f2fs_sb_info *sbi)
 	return false;
 }
 
-static inline int is_idle(struct f2fs_sb_info *sbi)
+static inline bool is_idle(struct f2fs_sb_info *sbi)
 {
-	struct block_device *bdev = sbi->sb->s_bdev;
-	struct request_queue *q = bdev_get_queue(bdev);
-	struct request_list *rl = &q->rq;
-	return !(rl->count[BLK_RW_SYNC]) && !(rl->count[BLK_RW_ASYNC]);
+	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
+
+	return bdev_is_idle(sbi->sb->s_bdev, &gc_th->last_ios,
+				&gc_th->last_active, gc_th->idle_interval);
 }
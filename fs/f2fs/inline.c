@@ -222,3 +222,261 @@ process_inline:
 	}
 	return 0;
 }
+
+struct f2fs_dir_entry *find_in_inline_dir(struct inode *dir,
+				struct qstr *name, struct page **res_page)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(dir->i_sb);
+	struct f2fs_dir_entry *de;
+	struct f2fs_dentry_ptr d;
+	f2fs_hash_t namehash;
+	struct page *ipage;
+
+	ipage = get_node_page(sbi, dir->i_ino);
+	if (IS_ERR(ipage))
+		return NULL;
+
+	namehash = f2fs_dentry_hash(name->name, name->len);
+	make_dentry_ptr(&d, inline_data_addr(ipage), true);
+	de = find_target_dentry(name->name, name->len, namehash, NULL, &d);
+
+	unlock_page(ipage);
+	if (de)
+		*res_page = ipage;
+	else
+		f2fs_put_page(ipage, 0);
+	return de;
+}
+
+struct f2fs_dir_entry *f2fs_parent_inline_dir(struct inode *dir,
+							struct page **p)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(dir->i_sb);
+	struct f2fs_inline_dentry *dentry_blk;
+	struct page *ipage;
+
+	ipage = get_node_page(sbi, dir->i_ino);
+	if (IS_ERR(ipage))
+		return NULL;
+
+	dentry_blk = inline_data_addr(ipage);
+	*p = ipage;
+	unlock_page(ipage);
+	return &dentry_blk->dentry[1];
+}
+
+int make_empty_inline_dir(struct inode *inode, struct inode *parent,
+							struct page *ipage)
+{
+	struct f2fs_dentry_ptr d;
+
+	make_dentry_ptr(&d, inline_data_addr(ipage), true);
+	do_make_empty_dir(inode, parent, &d);
+	set_page_dirty(ipage);
+
+	/* update i_size to MAX_INLINE_DATA */
+	if (i_size_read(inode) < MAX_INLINE_DATA) {
+		i_size_write(inode, MAX_INLINE_DATA);
+		set_inode_flag(F2FS_I(inode), FI_UPDATE_DIR);
+	}
+	return 0;
+}
+
+/*
+ * Move the inline entries of @dir to a new dentry block. Bucket 0 of
+ * level 0 spans blocks 0 and 1 for every hash, so all the entries keep
+ * their slots in block 0.  On error @ipage has been unlocked and put,
+ * as f2fs_reserve_block() does with the dnode it fails on.
+ */
+static int f2fs_convert_inline_dir(struct inode *dir, struct page *ipage,
+				struct f2fs_inline_dentry *inline_dentry)
+{
+	struct f2fs_dentry_block *dentry_blk;
+	struct dnode_of_data dn;
+	struct page *page;
+	int err;
+
+	page = grab_cache_page(dir->i_mapping, 0);
+	if (!page) {
+		f2fs_put_page(ipage, 1);
+		return -ENOMEM;
+	}
+
+	/* i_addr[0] is not used by the inline dentries */
+	set_new_dnode(&dn, dir, ipage, NULL, 0);
+	err = f2fs_reserve_block(&dn, 0);
+	if (err)
+		goto out;
+
+	f2fs_wait_on_page_writeback(page, DATA);
+	zero_user_segment(page, 0, PAGE_CACHE_SIZE);
+
+	dentry_blk = kmap_atomic(page);
+	memcpy(dentry_blk->dentry_bitmap, inline_dentry->dentry_bitmap,
+					INLINE_DENTRY_BITMAP_SIZE);
+	memcpy(dentry_blk->dentry, inline_dentry->dentry,
+			sizeof(struct f2fs_dir_entry) * NR_INLINE_DENTRY);
+	memcpy(dentry_blk->filename, inline_dentry->filename,
+					NR_INLINE_DENTRY * F2FS_SLOT_LEN);
+	kunmap_atomic(dentry_blk);
+
+	SetPageUptodate(page);
+	set_page_dirty(page);
+
+	/* clear inline dentries and flag after the dentry block is set */
+	f2fs_wait_on_page_writeback(ipage, NODE);
+	zero_user_segment(ipage, INLINE_DATA_OFFSET,
+				 INLINE_DATA_OFFSET + MAX_INLINE_DATA);
+	stat_dec_inline_dir(dir);
+	clear_inode_flag(F2FS_I(dir), FI_INLINE_DENTRY);
+
+	if (i_size_read(dir) < PAGE_CACHE_SIZE)
+		i_size_write(dir, PAGE_CACHE_SIZE);
+	F2FS_I(dir)->i_current_depth = 1;
+	update_inode(dir, ipage);
+out:
+	f2fs_put_page(page, 1);
+	return err;
+}
+
+/*
+ * Returns -EAGAIN once the entries were moved to a dentry block because
+ * there was no room left, so that the caller adds @name there.
+ */
+int f2fs_add_inline_entry(struct inode *dir, const struct qstr *name,
+						struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(dir->i_sb);
+	struct f2fs_inline_dentry *dentry_blk;
+	int slots = GET_DENTRY_SLOTS(name->len);
+	struct f2fs_dentry_ptr d;
+	f2fs_hash_t name_hash;
+	unsigned int bit_pos;
+	struct page *ipage, *page;
+	int err = 0;
+
+	ipage = get_node_page(sbi, dir->i_ino);
+	if (IS_ERR(ipage))
+		return PTR_ERR(ipage);
+
+	dentry_blk = inline_data_addr(ipage);
+	bit_pos = room_for_filename(&dentry_blk->dentry_bitmap,
+						slots, NR_INLINE_DENTRY);
+	if (bit_pos >= NR_INLINE_DENTRY) {
+		err = f2fs_convert_inline_dir(dir, ipage, dentry_blk);
+		if (err)
+			return err;
+		f2fs_put_page(ipage, 1);
+		return -EAGAIN;
+	}
+
+	/*
+	 * Inheriting the acl of @dir may read its inode page, so it must not
+	 * be locked meanwhile. The slot stays free since i_mutex of @dir is
+	 * held by all the callers.
+	 */
+	unlock_page(ipage);
+
+	down_write(&F2FS_I(inode)->i_sem);
+	page = init_inode_metadata(inode, dir, name);
+	if (IS_ERR(page)) {
+		err = PTR_ERR(page);
+		up_write(&F2FS_I(inode)->i_sem);
+		f2fs_put_page(ipage, 0);
+		return err;
+	}
+
+	lock_page(ipage);
+	f2fs_wait_on_page_writeback(ipage, NODE);
+	name_hash = f2fs_dentry_hash(name->name, name->len);
+	make_dentry_ptr(&d, dentry_blk, true);
+	f2fs_update_dentry(inode, &d, name, name_hash, bit_pos);
+	set_page_dirty(ipage);
+
+	/* we don't need to mark_inode_dirty now */
+	F2FS_I(inode)->i_pino = dir->i_ino;
+	update_inode(inode, page);
+	f2fs_put_page(page, 1);
+
+	update_parent_metadata(dir, inode, F2FS_I(dir)->i_current_depth);
+	up_write(&F2FS_I(inode)->i_sem);
+
+	if (is_inode_flag_set(F2FS_I(dir), FI_UPDATE_DIR)) {
+		update_inode(dir, ipage);
+		clear_inode_flag(F2FS_I(dir), FI_UPDATE_DIR);
+	}
+	f2fs_put_page(ipage, 1);
+	return 0;
+}
+
+void f2fs_delete_inline_entry(struct f2fs_dir_entry *dentry, struct page *page,
+					struct inode *dir, struct inode *inode)
+{
+	struct f2fs_inline_dentry *inline_dentry;
+	int slots = GET_DENTRY_SLOTS(le16_to_cpu(dentry->name_len));
+	unsigned int bit_pos;
+	int i;
+
+	lock_page(page);
+	f2fs_wait_on_page_writeback(page, NODE);
+
+	inline_dentry = inline_data_addr(page);
+	bit_pos = dentry - inline_dentry->dentry;
+	for (i = 0; i < slots; i++)
+		test_and_clear_bit_le(bit_pos + i,
+				&inline_dentry->dentry_bitmap);
+
+	set_page_dirty(page);
+
+	dir->i_ctime = dir->i_mtime = CURRENT_TIME;
+
+	if (inode)
+		f2fs_drop_nlink(dir, inode, page);
+
+	f2fs_put_page(page, 1);
+}
+
+bool f2fs_empty_inline_dir(struct inode *dir)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(dir->i_sb);
+	struct f2fs_inline_dentry *dentry_blk;
+	unsigned int bit_pos = 2;
+	struct page *ipage;
+
+	ipage = get_node_page(sbi, dir->i_ino);
+	if (IS_ERR(ipage))
+		return false;
+
+	dentry_blk = inline_data_addr(ipage);
+	bit_pos = find_next_bit_le(&dentry_blk->dentry_bitmap,
+					NR_INLINE_DENTRY, bit_pos);
+
+	f2fs_put_page(ipage, 1);
+
+	return bit_pos >= NR_INLINE_DENTRY;
+}
+
+int f2fs_read_inline_dir(struct file *file, void *dirent, filldir_t filldir)
+{
+	struct inode *inode = file->f_dentry->d_inode;
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct f2fs_dentry_ptr d;
+	struct page *ipage;
+
+	if (file->f_pos >= NR_INLINE_DENTRY)
+		return 0;
+
+	ipage = get_node_page(sbi, inode->i_ino);
+	if (IS_ERR(ipage))
+		return PTR_ERR(ipage);
+
+	/* i_mutex keeps the entries stable, filldir may fault */
+	unlock_page(ipage);
+
+	make_dentry_ptr(&d, inline_data_addr(ipage), true);
+	if (!f2fs_fill_dentries(file, dirent, filldir, &d, 0, file->f_pos))
+		file->f_pos = NR_INLINE_DENTRY;
+
+	f2fs_put_page(ipage, 0);
+	return 0;
+}
@@ -109,7 +109,7 @@ static int do_read_inode(struct inode *inode)
 	fi->i_pino = le32_to_cpu(ri->i_pino);
 	fi->i_dir_level = ri->i_dir_level;
 
-	get_extent_info(&fi->ext, ri->i_ext);
+	init_extent_tree(inode, &ri->i_ext);
 	get_inline_info(fi, ri);
 
 	/* get rdev by using inline_info */
@@ -191,7 +191,7 @@ void update_inode(struct inode *inode, struct page *node_page)
 	ri->i_links = cpu_to_le32(inode->i_nlink);
 	ri->i_size = cpu_to_le64(i_size_read(inode));
 	ri->i_blocks = cpu_to_le64(inode->i_blocks);
-	set_raw_extent(&F2FS_I(inode)->ext, &ri->i_ext);
+	set_raw_extent(&F2FS_I(inode)->et, &ri->i_ext);
 	set_raw_inline(F2FS_I(inode), ri);
 
 	ri->i_atime = cpu_to_le64(inode->i_atime.tv_sec);
@@ -288,8 +288,10 @@ void f2fs_evict_inode(struct inode *inode)
 	f2fs_lock_op(sbi);
 	remove_inode_page(inode);
 	stat_dec_inline_inode(inode);
+	stat_dec_inline_dir(inode);
 	f2fs_unlock_op(sbi);
 
 no_delete:
+	destroy_extent_tree(inode);
 	end_writeback(inode);
 }
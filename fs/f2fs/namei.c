@@ -236,7 +236,7 @@ static int f2fs_unlink(struct inode *dir, struct dentry *dentry)
 		f2fs_put_page(page, 0);
 		goto fail;
 	}
-	f2fs_delete_entry(de, page, inode);
+	f2fs_delete_entry(de, page, dir, inode);
 	f2fs_unlock_op(sbi);
 
 	/* In order to evict this inode,  we set it dirty */
@@ -303,12 +303,15 @@ static int f2fs_mkdir(struct inode *dir, struct dentry *dentry, int mode)
 	mapping_set_gfp_mask(inode->i_mapping, GFP_F2FS_ZERO);
 
 	set_inode_flag(F2FS_I(inode), FI_INC_LINK);
+	if (test_opt(sbi, INLINE_DENTRY))
+		set_inode_flag(F2FS_I(inode), FI_INLINE_DENTRY);
 	f2fs_lock_op(sbi);
 	err = f2fs_add_link(dentry, inode);
 	f2fs_unlock_op(sbi);
 	if (err)
 		goto out_fail;
 
+	stat_inc_inline_dir(inode);
 	alloc_nid_done(sbi, inode->i_ino);
 
 	d_instantiate(dentry, inode);
@@ -445,6 +448,8 @@ static int f2fs_rename(struct inode *old_dir, struct dentry *old_dentry,
 		update_inode_page(old_inode);
 		update_inode_page(new_inode);
 	} else {
+		bool was_inline = f2fs_has_inline_dentry(new_dir);
+
 		err = f2fs_add_link(new_dentry, old_inode);
 		if (err)
 			goto out_dir;
@@ -453,12 +458,33 @@ static int f2fs_rename(struct inode *old_dir, struct dentry *old_dentry,
 			inc_nlink(new_dir);
 			update_inode_page(new_dir);
 		}
+
+		/*
+		 * Adding the new entry may have moved the inline entries of
+		 * old_dir to a dentry block, so old_entry must be found again.
+		 */
+		if (old_dir == new_dir && was_inline &&
+				!f2fs_has_inline_dentry(old_dir)) {
+			struct f2fs_dir_entry *de;
+			struct page *page;
+
+			de = f2fs_find_entry(old_dir, &old_dentry->d_name,
+								&page);
+			if (!de) {
+				err = -EIO;
+				goto out_dir;
+			}
+			kunmap(old_page);
+			f2fs_put_page(old_page, 0);
+			old_entry = de;
+			old_page = page;
+		}
 	}
 
 	old_inode->i_ctime = CURRENT_TIME;
 	mark_inode_dirty(old_inode);
 
-	f2fs_delete_entry(old_entry, old_page, NULL);
+	f2fs_delete_entry(old_entry, old_page, old_dir, NULL);
 
 	if (old_dir_entry) {
 		if (old_dir != new_dir) {
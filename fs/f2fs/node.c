@@ -1041,16 +1041,64 @@ void sync_inode_page(struct dnode_of_data *dn)
 	}
 }
 
+/*
+ * Find the last dirty dnode of @ino, which fsync writes last. The page is
+ * returned with a reference held.
+ */
+static struct page *last_fsync_dnode(struct f2fs_sb_info *sbi, nid_t ino)
+{
+	pgoff_t index = 0, end = LONG_MAX;
+	struct pagevec pvec;
+	struct page *last_page = NULL;
+
+	pagevec_init(&pvec, 0);
+
+	while (index <= end) {
+		int i, nr_pages;
+		nr_pages = pagevec_lookup_tag(&pvec, NODE_MAPPING(sbi), &index,
+				PAGECACHE_TAG_DIRTY,
+				min(end - index, (pgoff_t)PAGEVEC_SIZE-1) + 1);
+		if (nr_pages == 0)
+			break;
+
+		for (i = 0; i < nr_pages; i++) {
+			struct page *page = pvec.pages[i];
+
+			if (!IS_DNODE(page) || !is_cold_node(page) ||
+					ino_of_node(page) != ino)
+				continue;
+
+			if (last_page)
+				f2fs_put_page(last_page, 0);
+			get_page(page);
+			last_page = page;
+		}
+		pagevec_release(&pvec);
+		cond_resched();
+	}
+	return last_page;
+}
+
+/*
+ * With @atomic, only the last dnode written for @ino gets the fsync mark.
+ * Roll-forward recovery replays the dnodes of an inode up to its last
+ * fsync mark, so a commit cut short leaves none of its dnodes replayed.
+ */
 int sync_node_pages(struct f2fs_sb_info *sbi, nid_t ino,
-					struct writeback_control *wbc)
+			struct writeback_control *wbc, bool atomic)
 {
 	pgoff_t index, end;
 	struct pagevec pvec;
+	struct page *last_page = NULL;
 	int step = ino ? 2 : 0;
 	int nwritten = 0, wrote = 0;
+	bool marked = false;
 
 	pagevec_init(&pvec, 0);
 
+	if (ino && atomic)
+		last_page = last_fsync_dnode(sbi, ino);
+
 next_step:
 	index = 0;
 	end = LONG_MAX;
@@ -1109,7 +1157,10 @@ continue_unlock:
 			/* called by fsync() */
 			if (ino && IS_DNODE(page)) {
 				int mark = !is_checkpointed_node(sbi, ino);
-				set_fsync_mark(page, 1);
+				set_fsync_mark(page, !atomic ||
+							page == last_page);
+				if (page == last_page)
+					marked = true;
 				if (IS_INODE(page))
 					set_dentry_mark(page, mark);
 				nwritten++;
@@ -1137,6 +1188,20 @@ continue_unlock:
 		goto next_step;
 	}
 
+	if (last_page) {
+		/* someone else wrote the last dnode, so write it with the mark */
+		if (!marked && wbc->nr_to_write) {
+			lock_page(last_page);
+			if (last_page->mapping == NODE_MAPPING(sbi)) {
+				set_page_dirty(last_page);
+				unlock_page(last_page);
+				goto next_step;
+			}
+			unlock_page(last_page);
+		}
+		f2fs_put_page(last_page, 0);
+	}
+
 	if (wrote)
 		f2fs_submit_merged_bio(sbi, NODE, WRITE);
 	return nwritten;
@@ -1248,7 +1313,7 @@ static int f2fs_write_node_pages(struct address_space *mapping,
 
 	diff = nr_pages_to_write(sbi, NODE, wbc);
 	wbc->sync_mode = WB_SYNC_NONE;
-	sync_node_pages(sbi, 0, wbc);
+	sync_node_pages(sbi, 0, wbc, false);
 	wbc->nr_to_write = max((long)0, wbc->nr_to_write - diff);
 	return 0;
 
@@ -15,6 +15,9 @@
 #include <linux/prefetch.h>
 #include <linux/vmalloc.h>
 #include <linux/swap.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/ioprio.h>
 
 #include "f2fs.h"
 #include "segment.h"
@@ -24,6 +27,8 @@
 #define __reverse_ffz(x) __reverse_ffs(~(x))
 
 static struct kmem_cache *discard_entry_slab;
+static struct kmem_cache *discard_cmd_slab;
+static struct kmem_cache *inmem_entry_slab;
 
 /*
  * __reverse_ffs is copied from include/asm-generic/bitops/__ffs.h since
@@ -171,6 +176,177 @@ found_middle:
 	return result + __reverse_ffz(tmp);
 }
 
+/*
+ * Pages written during an atomic write are not marked dirty, so that
+ * writeback and checkpoint leave them alone. They are kept referenced in
+ * fi->inmem_pages until the transaction is committed or aborted.
+ */
+void register_inmem_page(struct inode *inode, struct page *page)
+{
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	struct inmem_pages *new;
+
+	new = f2fs_kmem_cache_alloc(inmem_entry_slab, GFP_NOFS);
+	new->page = page;
+	INIT_LIST_HEAD(&new->list);
+
+	set_page_private(page, (unsigned long)ATOMIC_WRITTEN_PAGE);
+	SetPagePrivate(page);
+
+	mutex_lock(&fi->inmem_lock);
+	get_page(page);
+	list_add_tail(&new->list, &fi->inmem_pages);
+	mutex_unlock(&fi->inmem_lock);
+}
+
+/*
+ * Write one page of an atomic write out of place, remembering where its
+ * block was for revoke_inmem_page()
+ */
+static int write_inmem_page(struct inode *inode, struct inmem_pages *cur,
+						struct f2fs_io_info *fio)
+{
+	struct page *page = cur->page;
+	struct dnode_of_data dn;
+	int err = 0;
+
+	lock_page(page);
+	cur->old_addr = NULL_ADDR;
+	if (page->mapping != inode->i_mapping)
+		goto out;
+
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, page->index, LOOKUP_NODE);
+	if (err) {
+		unlock_page(page);
+		return err;
+	}
+	cur->old_addr = dn.data_blkaddr;
+	f2fs_put_dnode(&dn);
+
+	f2fs_wait_on_page_writeback(page, DATA);
+	if (clear_page_dirty_for_io(page))
+		inode_dec_dirty_dents(inode);
+	err = do_write_data_page(page, fio);
+	if (err)
+		cur->old_addr = NULL_ADDR;
+out:
+	unlock_page(page);
+	return err;
+}
+
+/*
+ * Give a page written by a commit that failed later on its old block
+ * back, so that a checkpoint does not find half of the transaction.  The
+ * page keeps the data of the transaction for another commit.
+ */
+static void revoke_inmem_page(struct inode *inode, struct inmem_pages *cur)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct sit_info *sit_i = SIT_I(sbi);
+	struct page *page = cur->page;
+	struct dnode_of_data dn;
+	block_t new_addr;
+
+	if (cur->old_addr == NULL_ADDR)
+		return;
+
+	lock_page(page);
+	/* the new block must not be reused while it is being written */
+	f2fs_wait_on_page_writeback(page, DATA);
+
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	if (get_dnode_of_data(&dn, page->index, LOOKUP_NODE)) {
+		f2fs_msg(sbi->sb, KERN_ERR, "cannot revoke block %lu of "
+			 "inode %lu", page->index, inode->i_ino);
+		goto out;
+	}
+
+	new_addr = dn.data_blkaddr;
+	if (new_addr != cur->old_addr && new_addr != NULL_ADDR) {
+		if (cur->old_addr == NEW_ADDR) {
+			invalidate_blocks(sbi, new_addr);
+		} else {
+			mutex_lock(&sit_i->sentry_lock);
+			refresh_sit_entry(sbi, new_addr, cur->old_addr);
+			mutex_unlock(&sit_i->sentry_lock);
+		}
+		revoke_data_blkaddr(&dn, cur->old_addr);
+	}
+	f2fs_put_dnode(&dn);
+out:
+	cur->old_addr = NULL_ADDR;
+	unlock_page(page);
+}
+
+/*
+ * Write out or drop the pages of an atomic write. The pages are written
+ * out of place while checkpoint is blocked, so that a checkpoint covers
+ * either none or all of them. The caller makes the transaction durable
+ * with fsync, whose fsync mark on the last dnode bounds what roll-forward
+ * recovery replays. Aborted pages are made !uptodate to be read again.
+ *
+ * If a page cannot be written, the pages written before it are revoked
+ * and all of them stay in fi->inmem_pages, to be committed again or
+ * aborted.
+ */
+int commit_inmem_pages(struct inode *inode, bool abort)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	struct inmem_pages *cur, *tmp;
+	bool submit_bio = false;
+	struct f2fs_io_info fio = {
+		.type = DATA,
+		.rw = WRITE_SYNC,
+	};
+	int err = 0;
+
+	if (!abort) {
+		f2fs_balance_fs(sbi);
+		f2fs_lock_op(sbi);
+	}
+
+	mutex_lock(&fi->inmem_lock);
+	if (!abort) {
+		list_for_each_entry(cur, &fi->inmem_pages, list) {
+			err = write_inmem_page(inode, cur, &fio);
+			if (err)
+				break;
+			submit_bio = true;
+		}
+		if (submit_bio)
+			f2fs_submit_merged_bio(sbi, DATA, WRITE);
+
+		if (err) {
+			list_for_each_entry(cur, &fi->inmem_pages, list)
+				revoke_inmem_page(inode, cur);
+			goto out;
+		}
+	}
+
+	list_for_each_entry_safe(cur, tmp, &fi->inmem_pages, list) {
+		struct page *page = cur->page;
+
+		lock_page(page);
+		if (abort)
+			ClearPageUptodate(page);
+
+		set_page_private(page, 0);
+		ClearPagePrivate(page);
+		f2fs_put_page(page, 1);
+
+		list_del(&cur->list);
+		kmem_cache_free(inmem_entry_slab, cur);
+	}
+out:
+	mutex_unlock(&fi->inmem_lock);
+
+	if (!abort)
+		f2fs_unlock_op(sbi);
+	return err;
+}
+
 /*
  * This function balances dirty node and dentry pages.
  * In addition, it controls garbage collection.
@@ -195,6 +371,28 @@ void f2fs_balance_fs_bg(struct f2fs_sb_info *sbi)
 		f2fs_sync_fs(sbi->sb, true);
 }
 
+/*
+ * Victim search for cleaning walks dirty_secmap, so that each section with
+ * DIRTY segments is visited once, however many of its segments are dirty.
+ */
+static void __inc_dirty_sec(struct dirty_seglist_info *dirty_i,
+						unsigned int secno)
+{
+	if (dirty_i->nr_dirty_in_sec[secno]++ == 0) {
+		set_bit(secno, dirty_i->dirty_secmap);
+		dirty_i->nr_dirty_secs++;
+	}
+}
+
+static void __dec_dirty_sec(struct dirty_seglist_info *dirty_i,
+						unsigned int secno)
+{
+	if (--dirty_i->nr_dirty_in_sec[secno] == 0) {
+		clear_bit(secno, dirty_i->dirty_secmap);
+		dirty_i->nr_dirty_secs--;
+	}
+}
+
 static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		enum dirty_type dirty_type)
 {
@@ -204,8 +402,11 @@ static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 	if (IS_CURSEG(sbi, segno))
 		return;
 
-	if (!test_and_set_bit(segno, dirty_i->dirty_segmap[dirty_type]))
+	if (!test_and_set_bit(segno, dirty_i->dirty_segmap[dirty_type])) {
 		dirty_i->nr_dirty[dirty_type]++;
+		if (dirty_type == DIRTY)
+			__inc_dirty_sec(dirty_i, GET_SECNO(sbi, segno));
+	}
 
 	if (dirty_type == DIRTY) {
 		struct seg_entry *sentry = get_seg_entry(sbi, segno);
@@ -221,8 +422,11 @@ static void __remove_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 {
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
 
-	if (test_and_clear_bit(segno, dirty_i->dirty_segmap[dirty_type]))
+	if (test_and_clear_bit(segno, dirty_i->dirty_segmap[dirty_type])) {
 		dirty_i->nr_dirty[dirty_type]--;
+		if (dirty_type == DIRTY)
+			__dec_dirty_sec(dirty_i, GET_SECNO(sbi, segno));
+	}
 
 	if (dirty_type == DIRTY) {
 		struct seg_entry *sentry = get_seg_entry(sbi, segno);
@@ -276,6 +480,368 @@ static void f2fs_issue_discard(struct f2fs_sb_info *sbi,
 	trace_f2fs_issue_discard(sbi->sb, blkstart, blklen);
 }
 
+/*
+ * Look up the queued discard covering @blkaddr. If there is none, @prev and
+ * @next are set to its neighbours in the tree, if any.
+ */
+static struct discard_cmd *__lookup_discard_cmd(
+			struct discard_cmd_control *dcc, block_t blkaddr,
+			struct discard_cmd **prev, struct discard_cmd **next)
+{
+	struct rb_node *node = dcc->root.rb_node;
+	struct discard_cmd *dc;
+
+	if (prev)
+		*prev = NULL;
+	if (next)
+		*next = NULL;
+
+	while (node) {
+		dc = rb_entry(node, struct discard_cmd, rb_node);
+
+		if (blkaddr < dc->lstart) {
+			if (next)
+				*next = dc;
+			node = node->rb_left;
+		} else if (blkaddr >= dc->lstart + dc->len) {
+			if (prev)
+				*prev = dc;
+			node = node->rb_right;
+		} else {
+			return dc;
+		}
+	}
+	return NULL;
+}
+
+static struct discard_cmd *__insert_discard_cmd(
+			struct discard_cmd_control *dcc,
+			block_t lstart, block_t len)
+{
+	struct rb_node **p = &dcc->root.rb_node;
+	struct rb_node *parent = NULL;
+	struct discard_cmd *dc;
+
+	while (*p) {
+		parent = *p;
+		dc = rb_entry(parent, struct discard_cmd, rb_node);
+
+		if (lstart < dc->lstart) {
+			p = &(*p)->rb_left;
+		} else if (lstart >= dc->lstart + dc->len) {
+			p = &(*p)->rb_right;
+		} else {
+			f2fs_bug_on(1);
+			return NULL;
+		}
+	}
+
+	dc = f2fs_kmem_cache_alloc(discard_cmd_slab, GFP_NOFS);
+	dc->lstart = lstart;
+	dc->len = len;
+	dc->issuing = false;
+	rb_link_node(&dc->rb_node, parent, p);
+	rb_insert_color(&dc->rb_node, &dcc->root);
+	atomic_inc(&dcc->nr_cmds);
+	dcc->undiscard_blks += len;
+	return dc;
+}
+
+static void __remove_discard_cmd(struct discard_cmd_control *dcc,
+						struct discard_cmd *dc)
+{
+	rb_erase(&dc->rb_node, &dcc->root);
+	atomic_dec(&dcc->nr_cmds);
+	dcc->undiscard_blks -= dc->len;
+	kmem_cache_free(discard_cmd_slab, dc);
+}
+
+/*
+ * Queue blocks none of which is queued yet, merging them with the queued
+ * ranges right before and after them, @prev and @next
+ */
+static void __queue_discard_range(struct discard_cmd_control *dcc,
+			block_t blkstart, block_t blklen,
+			struct discard_cmd *prev, struct discard_cmd *next)
+{
+	/* the range being sent is fixed until it completes */
+	if (prev && prev->issuing)
+		prev = NULL;
+	if (next && next->issuing)
+		next = NULL;
+
+	if (prev && prev->lstart + prev->len == blkstart) {
+		prev->len += blklen;
+		dcc->undiscard_blks += blklen;
+		dcc->merged_discard++;
+
+		if (next && next->lstart == blkstart + blklen) {
+			prev->len += next->len;
+			dcc->undiscard_blks += next->len;
+			__remove_discard_cmd(dcc, next);
+			dcc->merged_discard++;
+		}
+	} else if (next && next->lstart == blkstart + blklen) {
+		next->lstart = blkstart;
+		next->len += blklen;
+		dcc->undiscard_blks += blklen;
+		dcc->merged_discard++;
+	} else {
+		/* failing means the tree is broken: better not discard */
+		__insert_discard_cmd(dcc, blkstart, blklen);
+	}
+}
+
+/*
+ * Queue a discard of the given blocks for the discard thread. The queued
+ * ranges never overlap, as f2fs_wait_discard() cuts a block out of the
+ * one range holding it: the parts of the blocks that are queued already
+ * are skipped, and the others are merged with the ranges they touch.
+ * Without the thread, i.e. when discard was enabled by remount, the
+ * blocks are discarded right away.
+ */
+static void f2fs_queue_discard(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *dc, *prev, *next;
+	block_t end = blkstart + blklen, piece_end;
+
+	if (!dcc->f2fs_issue_discard) {
+		f2fs_issue_discard(sbi, blkstart, blklen);
+		return;
+	}
+
+	mutex_lock(&dcc->cmd_lock);
+	while (blkstart < end) {
+		dc = __lookup_discard_cmd(dcc, blkstart, &prev, &next);
+		if (dc) {
+			blkstart = dc->lstart + dc->len;
+			continue;
+		}
+
+		piece_end = end;
+		if (next && next->lstart < end)
+			piece_end = next->lstart;
+		__queue_discard_range(dcc, blkstart, piece_end - blkstart,
+								prev, next);
+		blkstart = piece_end;
+	}
+	mutex_unlock(&dcc->cmd_lock);
+}
+
+/*
+ * A block is about to be written, so it must not be discarded any more.
+ * It is cut out of its queued discard, or, if that is being sent, the
+ * write waits for the discard to complete.
+ */
+static void f2fs_wait_discard(struct f2fs_sb_info *sbi, block_t blkaddr)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *dc;
+	block_t end;
+
+	if (!atomic_read(&dcc->nr_cmds))
+		return;
+
+	mutex_lock(&dcc->cmd_lock);
+	dc = __lookup_discard_cmd(dcc, blkaddr, NULL, NULL);
+	if (!dc)
+		goto out;
+
+	/* issue_lock is held from before ->issuing is set until it is sent */
+	if (dc->issuing) {
+		mutex_unlock(&dcc->cmd_lock);
+		mutex_lock(&dcc->issue_lock);
+		mutex_unlock(&dcc->issue_lock);
+		return;
+	}
+
+	end = dc->lstart + dc->len;
+	if (dc->len == 1) {
+		__remove_discard_cmd(dcc, dc);
+	} else if (blkaddr == dc->lstart) {
+		dc->lstart++;
+		dc->len--;
+		dcc->undiscard_blks--;
+	} else {
+		dc->len = blkaddr - dc->lstart;
+		dcc->undiscard_blks -= end - blkaddr;
+		/* on failure the tail is not discarded, which is safe */
+		if (blkaddr + 1 < end)
+			__insert_discard_cmd(dcc, blkaddr + 1,
+						end - blkaddr - 1);
+	}
+out:
+	mutex_unlock(&dcc->cmd_lock);
+}
+
+/*
+ * Send up to @nr queued discards to the device in address order. Discards
+ * smaller than min_granularity are dropped, and larger ones are sent one
+ * section at a time. issue_lock is taken for each of them, so that a write
+ * into a range being discarded never waits for more than a section.
+ */
+static int __issue_discard_cmds(struct f2fs_sb_info *sbi, int nr)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	block_t max_len = sbi->segs_per_sec << sbi->log_blocks_per_seg;
+	struct rb_node *node;
+	struct discard_cmd *dc;
+	block_t lstart, len;
+	int issued = 0;
+
+	while (issued < nr) {
+		mutex_lock(&dcc->issue_lock);
+		mutex_lock(&dcc->cmd_lock);
+		node = rb_first(&dcc->root);
+		if (!node) {
+			mutex_unlock(&dcc->cmd_lock);
+			mutex_unlock(&dcc->issue_lock);
+			break;
+		}
+		dc = rb_entry(node, struct discard_cmd, rb_node);
+
+		if (dc->len < dcc->min_granularity) {
+			__remove_discard_cmd(dcc, dc);
+			mutex_unlock(&dcc->cmd_lock);
+			mutex_unlock(&dcc->issue_lock);
+			continue;
+		}
+
+		if (dc->len > max_len) {
+			len = dc->len - max_len;
+			dc->len = max_len;
+			dcc->undiscard_blks -= len;
+			if (!__insert_discard_cmd(dcc, dc->lstart + max_len,
+								len)) {
+				dc->len += len;
+				dcc->undiscard_blks += len;
+			}
+		}
+		dc->issuing = true;
+		lstart = dc->lstart;
+		len = dc->len;
+		mutex_unlock(&dcc->cmd_lock);
+
+		f2fs_issue_discard(sbi, lstart, len);
+
+		mutex_lock(&dcc->cmd_lock);
+		dcc->issued_discard++;
+		dcc->issued_blks += len;
+		__remove_discard_cmd(dcc, dc);
+		mutex_unlock(&dcc->cmd_lock);
+		mutex_unlock(&dcc->issue_lock);
+		issued++;
+	}
+	return issued;
+}
+
+static void wake_up_discard_thread(struct discard_cmd_control *dcc)
+{
+	if (!dcc->f2fs_issue_discard || !atomic_read(&dcc->nr_cmds))
+		return;
+	dcc->discard_wake = 1;
+	wake_up_interruptible_all(&dcc->discard_wait_queue);
+}
+
+static int issue_discard_thread(void *data)
+{
+	struct f2fs_sb_info *sbi = data;
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	wait_queue_head_t *q = &dcc->discard_wait_queue;
+	struct block_device *bdev = sbi->sb->s_bdev;
+	long wait_ms = DEF_MAX_DISCARD_ISSUE_TIME;
+
+	/* discards only use the time the device has nothing else to do */
+	set_user_nice(current, 19);
+	set_task_ioprio(current, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+
+	do {
+		if (try_to_freeze())
+			continue;
+		else
+			wait_event_interruptible_timeout(*q,
+					kthread_should_stop() ||
+					dcc->discard_wake,
+					msecs_to_jiffies(wait_ms));
+		if (kthread_should_stop())
+			break;
+
+		dcc->discard_wake = 0;
+
+		if (!atomic_read(&dcc->nr_cmds)) {
+			wait_ms = DEF_MAX_DISCARD_ISSUE_TIME;
+			continue;
+		}
+
+		if (!bdev_is_idle(bdev, &dcc->last_ios, &dcc->last_active,
+						dcc->idle_interval)) {
+			wait_ms = dcc->idle_interval ? :
+					DEF_MIN_DISCARD_ISSUE_TIME;
+			continue;
+		}
+
+		__issue_discard_cmds(sbi, dcc->max_requests);
+
+		/* the discards themselves do not make the device busy */
+		dcc->last_ios = disk_ios(bdev);
+		wait_ms = DEF_MIN_DISCARD_ISSUE_TIME;
+	} while (!kthread_should_stop());
+	return 0;
+}
+
+static int create_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	dev_t dev = sbi->sb->s_bdev->bd_dev;
+	struct discard_cmd_control *dcc;
+	int err = 0;
+
+	dcc = kzalloc(sizeof(struct discard_cmd_control), GFP_KERNEL);
+	if (!dcc)
+		return -ENOMEM;
+
+	init_waitqueue_head(&dcc->discard_wait_queue);
+	dcc->root = RB_ROOT;
+	mutex_init(&dcc->cmd_lock);
+	mutex_init(&dcc->issue_lock);
+	atomic_set(&dcc->nr_cmds, 0);
+	dcc->min_granularity = DEF_DISCARD_GRANULARITY;
+	dcc->max_requests = DEF_MAX_DISCARD_REQUEST;
+	dcc->idle_interval = DEF_DISCARD_IDLE_INTERVAL;
+	dcc->last_ios = disk_ios(sbi->sb->s_bdev);
+	dcc->last_active = jiffies;
+	SM_I(sbi)->dcc_info = dcc;
+
+	if (!test_opt(sbi, DISCARD))
+		return 0;
+
+	dcc->f2fs_issue_discard = kthread_run(issue_discard_thread, sbi,
+				"f2fs_discard-%u:%u", MAJOR(dev), MINOR(dev));
+	if (IS_ERR(dcc->f2fs_issue_discard)) {
+		err = PTR_ERR(dcc->f2fs_issue_discard);
+		kfree(dcc);
+		SM_I(sbi)->dcc_info = NULL;
+	}
+	return err;
+}
+
+static void destroy_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (!dcc)
+		return;
+
+	/* the discards queued by the last checkpoint are sent before umount */
+	if (dcc->f2fs_issue_discard) {
+		kthread_stop(dcc->f2fs_issue_discard);
+		__issue_discard_cmds(sbi, INT_MAX);
+	}
+	SM_I(sbi)->dcc_info = NULL;
+	kfree(dcc);
+}
+
 static void add_discard_addrs(struct f2fs_sb_info *sbi,
 			unsigned int segno, struct seg_entry *se)
 {
@@ -363,18 +929,21 @@ void clear_prefree_segments(struct f2fs_sb_info *sbi)
 		if (!test_opt(sbi, DISCARD))
 			continue;
 
-		f2fs_issue_discard(sbi, START_BLOCK(sbi, start),
+		f2fs_queue_discard(sbi, START_BLOCK(sbi, start),
 				(end - start) << sbi->log_blocks_per_seg);
 	}
 	mutex_unlock(&dirty_i->seglist_lock);
 
-	/* send small discards */
+	/* queue small discards */
 	list_for_each_entry_safe(entry, this, head, list) {
-		f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+		f2fs_queue_discard(sbi, entry->blkaddr, entry->len);
 		list_del(&entry->list);
 		SM_I(sbi)->nr_discards -= entry->len;
 		kmem_cache_free(discard_entry_slab, entry);
 	}
+
+	/* the checkpoint does not wait for the discards to be sent */
+	wake_up_discard_thread(SM_I(sbi)->dcc_info);
 }
 
 static void __mark_sit_entry_dirty(struct f2fs_sb_info *sbi, unsigned int segno)
@@ -869,6 +1438,8 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 	*new_blkaddr = NEXT_FREE_BLKADDR(sbi, curseg);
 	old_cursegno = curseg->segno;
 
+	f2fs_wait_discard(sbi, *new_blkaddr);
+
 	/*
 	 * __add_sum_entry should be resided under the curseg_mutex
 	 * because, this function updates a summary entry in the
@@ -1706,10 +2277,27 @@ static int init_victim_secmap(struct f2fs_sb_info *sbi)
 	return 0;
 }
 
+static int init_dirty_secmap(struct f2fs_sb_info *sbi)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned int bitmap_size = f2fs_bitmap_size(TOTAL_SECS(sbi));
+
+	dirty_i->dirty_secmap = kzalloc(bitmap_size, GFP_KERNEL);
+	if (!dirty_i->dirty_secmap)
+		return -ENOMEM;
+
+	dirty_i->nr_dirty_in_sec = kcalloc(TOTAL_SECS(sbi),
+					sizeof(unsigned int), GFP_KERNEL);
+	if (!dirty_i->nr_dirty_in_sec)
+		return -ENOMEM;
+	return 0;
+}
+
 static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i;
 	unsigned int bitmap_size, i;
+	int err;
 
 	/* allocate memory for dirty segments list information */
 	dirty_i = kzalloc(sizeof(struct dirty_seglist_info), GFP_KERNEL);
@@ -1727,6 +2315,10 @@ static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 			return -ENOMEM;
 	}
 
+	err = init_dirty_secmap(sbi);
+	if (err)
+		return err;
+
 	init_dirty_segmap(sbi);
 	return init_victim_secmap(sbi);
 }
@@ -1790,6 +2382,10 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 	sm_info->nr_discards = 0;
 	sm_info->max_discards = 0;
 
+	err = create_discard_cmd_control(sbi);
+	if (err)
+		return err;
+
 	err = build_sit_info(sbi);
 	if (err)
 		return err;
@@ -1829,6 +2425,13 @@ static void destroy_victim_secmap(struct f2fs_sb_info *sbi)
 	kfree(dirty_i->victim_secmap);
 }
 
+static void destroy_dirty_secmap(struct f2fs_sb_info *sbi)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	kfree(dirty_i->nr_dirty_in_sec);
+	kfree(dirty_i->dirty_secmap);
+}
+
 static void destroy_dirty_segmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
@@ -1842,6 +2445,7 @@ static void destroy_dirty_segmap(struct f2fs_sb_info *sbi)
 		discard_dirty_segmap(sbi, i);
 
 	destroy_victim_secmap(sbi);
+	destroy_dirty_secmap(sbi);
 	SM_I(sbi)->dirty_info = NULL;
 	kfree(dirty_i);
 }
@@ -1898,6 +2502,7 @@ void destroy_segment_manager(struct f2fs_sb_info *sbi)
 	struct f2fs_sm_info *sm_info = SM_I(sbi);
 	if (!sm_info)
 		return;
+	destroy_discard_cmd_control(sbi);
 	destroy_dirty_segmap(sbi);
 	destroy_curseg(sbi);
 	destroy_free_segmap(sbi);
@@ -1912,10 +2517,28 @@ int __init create_segment_manager_caches(void)
 			sizeof(struct discard_entry));
 	if (!discard_entry_slab)
 		return -ENOMEM;
+
+	discard_cmd_slab = f2fs_kmem_cache_create("discard_cmd",
+			sizeof(struct discard_cmd));
+	if (!discard_cmd_slab)
+		goto destroy_discard_entry;
+
+	inmem_entry_slab = f2fs_kmem_cache_create("inmem_page_entry",
+			sizeof(struct inmem_pages));
+	if (!inmem_entry_slab)
+		goto destroy_discard_cmd;
 	return 0;
+
+destroy_discard_cmd:
+	kmem_cache_destroy(discard_cmd_slab);
+destroy_discard_entry:
+	kmem_cache_destroy(discard_entry_slab);
+	return -ENOMEM;
 }
 
 void destroy_segment_manager_caches(void)
 {
+	kmem_cache_destroy(inmem_entry_slab);
+	kmem_cache_destroy(discard_cmd_slab);
 	kmem_cache_destroy(discard_entry_slab);
 }
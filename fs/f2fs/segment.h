@@ -20,6 +20,11 @@
 #define GET_L2R_SEGNO(free_i, segno)	(segno - free_i->start_segno)
 #define GET_R2L_SEGNO(free_i, segno)	(segno + free_i->start_segno)
 
+/* page_private of the pages registered by an atomic write */
+#define ATOMIC_WRITTEN_PAGE		0x0000ffff
+#define IS_ATOMIC_WRITTEN_PAGE(page)			\
+		(page_private(page) == (unsigned long)ATOMIC_WRITTEN_PAGE)
+
 #define IS_DATASEG(t)	(t <= CURSEG_COLD_DATA)
 #define IS_NODESEG(t)	(t >= CURSEG_HOT_NODE)
 
@@ -135,11 +140,18 @@ enum {
 };
 
 /* for a function parameter to select a victim segment */
+struct inmem_pages {
+	struct list_head list;
+	struct page *page;
+	block_t old_addr;		/* block address before the commit */
+};
+
 struct victim_sel_policy {
 	int alloc_mode;			/* LFS or SSR */
 	int gc_mode;			/* GC_CB or GC_GREEDY */
-	unsigned long *dirty_segmap;	/* dirty segment bitmap */
-	unsigned int max_search;	/* maximum # of segments to search */
+	unsigned long *dirty_segmap;	/* dirty segment (SSR) or section
+					   (LFS) bitmap */
+	unsigned int max_search;	/* maximum # of units to search */
 	unsigned int offset;		/* last scanned bitmap offset */
 	unsigned int ofs_unit;		/* bitmap search unit */
 	unsigned int min_cost;		/* minimum cost */
@@ -218,6 +230,9 @@ struct dirty_seglist_info {
 	struct mutex seglist_lock;		/* lock for segment bitmaps */
 	int nr_dirty[NR_DIRTY_TYPE];		/* # of dirty segments */
 	unsigned long *victim_secmap;		/* background GC victims */
+	unsigned long *dirty_secmap;		/* sections with DIRTY segments */
+	unsigned int *nr_dirty_in_sec;		/* # of DIRTY segments per sec */
+	int nr_dirty_secs;			/* # of sections in dirty_secmap */
 };
 
 /* victim selection function for cleaning and SSR */
@@ -486,6 +501,14 @@ static inline bool need_inplace_update(struct inode *inode)
 	if (S_ISDIR(inode->i_mode))
 		return false;
 
+	/* the old blocks of an atomic write must survive until it is synced */
+	if (f2fs_is_atomic_file(inode))
+		return false;
+
+	/* defragment moves the blocks by writing them elsewhere */
+	if (is_inode_flag_set(F2FS_I(inode), FI_DO_DEFRAG))
+		return false;
+
 	switch (SM_I(sbi)->ipu_policy) {
 	case F2FS_IPU_FORCE:
 		return true;
@@ -707,3 +730,38 @@ static inline long nr_pages_to_write(struct f2fs_sb_info *sbi, int type,
 	wbc->nr_to_write = desired;
 	return desired - nr_to_write;
 }
+
+static inline unsigned long disk_ios(struct block_device *bdev)
+{
+	struct hd_struct *part = &bdev->bd_disk->part0;
+
+	return part_stat_read(part, ios[READ]) +
+			part_stat_read(part, ios[WRITE]);
+}
+
+/*
+ * The device is idle once it has no request pending and has completed no
+ * I/O for @interval ms. The whole disk is checked, since I/O to the other
+ * partitions, as on app launches, suffers from background work as well.
+ * Completions are sampled at each check, so the idle time is known to
+ * within the interval between two checks.
+ */
+static inline bool bdev_is_idle(struct block_device *bdev,
+			unsigned long *last_ios, unsigned long *last_active,
+			unsigned int interval)
+{
+	struct request_queue *q = bdev_get_queue(bdev);
+	struct request_list *rl = &q->rq;
+	unsigned long ios = disk_ios(bdev);
+
+	if (rl->count[BLK_RW_SYNC] || rl->count[BLK_RW_ASYNC] ||
+			part_in_flight(&bdev->bd_disk->part0) ||
+			ios != *last_ios) {
+		*last_ios = ios;
+		*last_active = jiffies;
+		return false;
+	}
+
+	return time_after_eq(jiffies, *last_active +
+				msecs_to_jiffies(interval));
+}
@@ -26,11 +26,12 @@ MODULE_ALIAS("devname:fuse");
 
 static struct kmem_cache *fuse_req_cachep;
 
-static struct fuse_conn *fuse_get_conn(struct file *file)
+static struct fuse_chan *fuse_get_chan(struct file *file)
 {
 	/*
 	 * Lockless access is OK, because file->private data is set
-	 * once during mount and is valid until the file is released.
+	 * once during mount or FUSE_DEV_IOC_CLONE and is valid until
+	 * the file is released.
 	 */
 	return file->private_data;
 }
@@ -209,6 +210,10 @@ void fuse_put_request(struct fuse_conn *fc, struct fuse_req *req)
 		if (req->waiting)
 			atomic_dec(&fc->num_waiting);
 
+		/* the opener did not get to use the lower file */
+		if (req->passthrough_filp)
+			fput(req->passthrough_filp);
+
 		if (req->stolen_file)
 			put_reserved_req(fc, req);
 		else
@@ -230,57 +235,152 @@ static unsigned len_args(unsigned numargs, struct fuse_arg *args)
 
 static u64 fuse_get_unique(struct fuse_conn *fc)
 {
-	fc->reqctr++;
+	u64 unique;
+
 	/* zero is special */
-	if (fc->reqctr == 0)
-		fc->reqctr = 1;
+	do {
+		unique = atomic64_inc_return(&fc->reqctr);
+	} while (unique == 0);
 
-	return fc->reqctr;
+	return unique;
 }
 
-static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
+/*
+ * Pick the channel to queue a request on.  A channel with an idle
+ * reader is preferred, looking at the channel of this CPU first, so
+ * that the request is picked up right away and on the same CPU if the
+ * daemon threads are bound to CPUs.  Otherwise the channels take turns.
+ *
+ * The queues are looked at without their locks, so this is only a
+ * hint: the channel has to be checked again under its lock.
+ */
+static struct fuse_chan *fuse_pick_chan(struct fuse_conn *fc)
+{
+	unsigned nr = ACCESS_ONCE(fc->nr_chans);
+	struct fuse_chan *chan;
+	unsigned start;
+	unsigned i;
+
+	/* pairs with the barrier in fuse_chan_new() */
+	smp_rmb();
+	if (nr == 1)
+		return fc->chans[0];
+
+	start = raw_smp_processor_id() % nr;
+	for (i = 0; i < nr; i++) {
+		chan = fc->chans[(start + i) % nr];
+		if (chan->connected && chan->readers &&
+		    list_empty(&chan->pending))
+			return chan;
+	}
+
+	for (i = 0; i < nr; i++) {
+		chan = fc->chans[fc->chan_next++ % nr];
+		if (chan->connected)
+			return chan;
+	}
+	return fc->chans[0];
+}
+
+/*
+ * Lock a channel to queue a request on.  Returns NULL if the device
+ * files of the connection are all closed, or it is aborted.
+ *
+ * A channel is only disconnected under fc->lock, and with fc->connected
+ * cleared if it was the last one, so this does not loop for long.
+ */
+static struct fuse_chan *fuse_lock_chan(struct fuse_conn *fc)
+{
+	struct fuse_chan *chan;
+
+	for (;;) {
+		chan = fuse_pick_chan(fc);
+		spin_lock(&chan->lock);
+		if (chan->connected)
+			return chan;
+		spin_unlock(&chan->lock);
+
+		if (!fc->connected)
+			return NULL;
+		cpu_relax();
+	}
+}
+
+/*
+ * Lock the channel a request is queued on, which may change while
+ * the request is pending
+ */
+static struct fuse_chan *lock_req_chan(struct fuse_req *req)
+{
+	struct fuse_chan *chan;
+
+	for (;;) {
+		chan = ACCESS_ONCE(req->chan);
+		spin_lock(&chan->lock);
+		if (likely(chan == req->chan))
+			return chan;
+		spin_unlock(&chan->lock);
+	}
+}
+
+/* Called with chan->lock held */
+static void queue_request(struct fuse_chan *chan, struct fuse_req *req)
 {
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
-	list_add_tail(&req->list, &fc->pending);
+	req->chan = chan;
+	list_add_tail(&req->list, &chan->pending);
 	req->state = FUSE_REQ_PENDING;
 	if (!req->waiting) {
 		req->waiting = 1;
-		atomic_inc(&fc->num_waiting);
+		atomic_inc(&chan->fc->num_waiting);
 	}
-	wake_up(&fc->waitq);
-	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+	wake_up(&chan->waitq);
+	kill_fasync(&chan->fasync, SIGIO, POLL_IN);
 }
 
 void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 		       u64 nodeid, u64 nlookup)
 {
+	struct fuse_chan *chan = NULL;
+
 	forget->forget_one.nodeid = nodeid;
 	forget->forget_one.nlookup = nlookup;
 
-	spin_lock(&fc->lock);
-	if (fc->connected) {
-		fc->forget_list_tail->next = forget;
-		fc->forget_list_tail = forget;
-		wake_up(&fc->waitq);
-		kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+	if (fc->connected)
+		chan = fuse_lock_chan(fc);
+	if (chan) {
+		chan->forget_list_tail->next = forget;
+		chan->forget_list_tail = forget;
+		wake_up(&chan->waitq);
+		kill_fasync(&chan->fasync, SIGIO, POLL_IN);
+		spin_unlock(&chan->lock);
 	} else {
 		kfree(forget);
 	}
-	spin_unlock(&fc->lock);
 }
 
+/*
+ * Called with fc->lock held.  At least one channel is connected while
+ * there are background requests, see fuse_disconnect().
+ */
 static void flush_bg_queue(struct fuse_conn *fc)
 {
 	while (fc->active_background < fc->max_background &&
 	       !list_empty(&fc->bg_queue)) {
+		struct fuse_chan *chan;
 		struct fuse_req *req;
 
+		chan = fuse_lock_chan(fc);
+		if (WARN_ON(!chan))
+			break;
+
 		req = list_entry(fc->bg_queue.next, struct fuse_req, list);
 		list_del(&req->list);
 		fc->active_background++;
 		req->in.h.unique = fuse_get_unique(fc);
-		queue_request(fc, req);
+		queue_request(chan, req);
+		spin_unlock(&chan->lock);
 	}
 }
 
@@ -292,17 +392,20 @@ static void flush_bg_queue(struct fuse_conn *fc)
  * the 'end' callback is called if given, else the reference to the
  * request is released
  *
- * Called with fc->lock, unlocks it
+ * Called with chan->lock, unlocks it.  fc->lock must not be held.
  */
-static void request_end(struct fuse_conn *fc, struct fuse_req *req)
-__releases(fc->lock)
+static void request_end(struct fuse_chan *chan, struct fuse_req *req)
+__releases(chan->lock)
 {
+	struct fuse_conn *fc = chan->fc;
 	void (*end) (struct fuse_conn *, struct fuse_req *) = req->end;
 	req->end = NULL;
 	list_del(&req->list);
 	list_del(&req->intr_entry);
 	req->state = FUSE_REQ_FINISHED;
+	spin_unlock(&chan->lock);
 	if (req->background) {
+		spin_lock(&fc->lock);
 		if (fc->num_background == fc->max_background) {
 			fc->blocked = 0;
 			wake_up_all(&fc->blocked_waitq);
@@ -315,50 +418,55 @@ __releases(fc->lock)
 		fc->num_background--;
 		fc->active_background--;
 		flush_bg_queue(fc);
+		spin_unlock(&fc->lock);
 	}
-	spin_unlock(&fc->lock);
 	wake_up(&req->waitq);
 	if (end)
 		end(fc, req);
 	fuse_put_request(fc, req);
 }
 
-static void wait_answer_interruptible(struct fuse_conn *fc,
-				      struct fuse_req *req)
-__releases(fc->lock)
-__acquires(fc->lock)
+static struct fuse_chan *wait_answer_interruptible(struct fuse_chan *chan,
+						   struct fuse_req *req)
+__releases(chan->lock)
+__acquires(req->chan->lock)
 {
 	if (signal_pending(current))
-		return;
+		return chan;
 
-	spin_unlock(&fc->lock);
+	spin_unlock(&chan->lock);
 	wait_event_interruptible(req->waitq, req->state == FUSE_REQ_FINISHED);
-	spin_lock(&fc->lock);
+	return lock_req_chan(req);
 }
 
-static void queue_interrupt(struct fuse_conn *fc, struct fuse_req *req)
+static void queue_interrupt(struct fuse_chan *chan, struct fuse_req *req)
 {
-	list_add_tail(&req->intr_entry, &fc->interrupts);
-	wake_up(&fc->waitq);
-	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+	list_add_tail(&req->intr_entry, &chan->interrupts);
+	wake_up(&chan->waitq);
+	kill_fasync(&chan->fasync, SIGIO, POLL_IN);
 }
 
-static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
-__releases(fc->lock)
-__acquires(fc->lock)
+/*
+ * Called with the lock of the channel the request is queued on,
+ * unlocks it
+ */
+static void request_wait_answer(struct fuse_chan *chan, struct fuse_req *req)
+__releases(chan->lock)
 {
+	struct fuse_conn *fc = chan->fc;
+
 	if (!fc->no_interrupt) {
 		/* Any signal may interrupt this */
-		wait_answer_interruptible(fc, req);
+		chan = wait_answer_interruptible(chan, req);
 
 		if (req->aborted)
 			goto aborted;
 		if (req->state == FUSE_REQ_FINISHED)
-			return;
+			goto out;
 
 		req->interrupted = 1;
 		if (req->state == FUSE_REQ_SENT)
-			queue_interrupt(fc, req);
+			queue_interrupt(chan, req);
 	}
 
 	if (!req->force) {
@@ -366,20 +474,20 @@ __acquires(fc->lock)
 
 		/* Only fatal signals may interrupt this */
 		block_sigs(&oldset);
-		wait_answer_interruptible(fc, req);
+		chan = wait_answer_interruptible(chan, req);
 		restore_sigs(&oldset);
 
 		if (req->aborted)
 			goto aborted;
 		if (req->state == FUSE_REQ_FINISHED)
-			return;
+			goto out;
 
 		/* Request is not yet in userspace, bail out */
 		if (req->state == FUSE_REQ_PENDING) {
 			list_del(&req->list);
 			__fuse_put_request(req);
 			req->out.h.error = -EINTR;
-			return;
+			goto out;
 		}
 	}
 
@@ -387,15 +495,15 @@ __acquires(fc->lock)
 	 * Either request is already in userspace, or it was forced.
 	 * Wait it out.
 	 */
-	spin_unlock(&fc->lock);
+	spin_unlock(&chan->lock);
 
 	while (req->state != FUSE_REQ_FINISHED)
 		wait_event_freezable(req->waitq,
 				     req->state == FUSE_REQ_FINISHED);
-	spin_lock(&fc->lock);
+	chan = lock_req_chan(req);
 
 	if (!req->aborted)
-		return;
+		goto out;
 
  aborted:
 	BUG_ON(req->state != FUSE_REQ_FINISHED);
@@ -405,30 +513,37 @@ __acquires(fc->lock)
 		   locked state, there mustn't be any filesystem
 		   operation (e.g. page fault), since that could lead
 		   to deadlock */
-		spin_unlock(&fc->lock);
+		spin_unlock(&chan->lock);
 		wait_event(req->waitq, !req->locked);
-		spin_lock(&fc->lock);
+		chan = lock_req_chan(req);
 	}
+ out:
+	spin_unlock(&chan->lock);
 }
 
 void fuse_request_send(struct fuse_conn *fc, struct fuse_req *req)
 {
+	struct fuse_chan *chan;
+
 	req->isreply = 1;
-	spin_lock(&fc->lock);
 	if (!fc->connected)
 		req->out.h.error = -ENOTCONN;
 	else if (fc->conn_error)
 		req->out.h.error = -ECONNREFUSED;
 	else {
+		chan = fuse_lock_chan(fc);
+		if (!chan) {
+			req->out.h.error = -ENOTCONN;
+			return;
+		}
 		req->in.h.unique = fuse_get_unique(fc);
-		queue_request(fc, req);
+		queue_request(chan, req);
 		/* acquire extra reference, since request is still needed
 		   after request_end() */
 		__fuse_get_request(req);
 
-		request_wait_answer(fc, req);
+		request_wait_answer(chan, req);
 	}
-	spin_unlock(&fc->lock);
 }
 EXPORT_SYMBOL_GPL(fuse_request_send);
 
@@ -455,8 +570,15 @@ static void fuse_request_send_nowait(struct fuse_conn *fc, struct fuse_req *req)
 		fuse_request_send_nowait_locked(fc, req);
 		spin_unlock(&fc->lock);
 	} else {
+		void (*end) (struct fuse_conn *, struct fuse_req *) = req->end;
+
+		spin_unlock(&fc->lock);
+		req->end = NULL;
 		req->out.h.error = -ENOTCONN;
-		request_end(fc, req);
+		req->state = FUSE_REQ_FINISHED;
+		if (end)
+			end(fc, req);
+		fuse_put_request(fc, req);
 	}
 }
 
@@ -470,16 +592,18 @@ EXPORT_SYMBOL_GPL(fuse_request_send_background);
 static int fuse_request_send_notify_reply(struct fuse_conn *fc,
 					  struct fuse_req *req, u64 unique)
 {
+	struct fuse_chan *chan = NULL;
 	int err = -ENODEV;
 
 	req->isreply = 0;
 	req->in.h.unique = unique;
-	spin_lock(&fc->lock);
-	if (fc->connected) {
-		queue_request(fc, req);
+	if (fc->connected)
+		chan = fuse_lock_chan(fc);
+	if (chan) {
+		queue_request(chan, req);
+		spin_unlock(&chan->lock);
 		err = 0;
 	}
-	spin_unlock(&fc->lock);
 
 	return err;
 }
@@ -501,16 +625,16 @@ void fuse_request_send_background_locked(struct fuse_conn *fc,
  * anything that could cause a page-fault.  If the request was already
  * aborted bail out.
  */
-static int lock_request(struct fuse_conn *fc, struct fuse_req *req)
+static int lock_request(struct fuse_req *req)
 {
 	int err = 0;
 	if (req) {
-		spin_lock(&fc->lock);
+		spin_lock(&req->chan->lock);
 		if (req->aborted)
 			err = -ENOENT;
 		else
 			req->locked = 1;
-		spin_unlock(&fc->lock);
+		spin_unlock(&req->chan->lock);
 	}
 	return err;
 }
@@ -520,14 +644,14 @@ static int lock_request(struct fuse_conn *fc, struct fuse_req *req)
  * requester thread is currently waiting for it to be unlocked, so
  * wake it up.
  */
-static void unlock_request(struct fuse_conn *fc, struct fuse_req *req)
+static void unlock_request(struct fuse_req *req)
 {
 	if (req) {
-		spin_lock(&fc->lock);
+		spin_lock(&req->chan->lock);
 		req->locked = 0;
 		if (req->aborted)
 			wake_up(&req->waitq);
-		spin_unlock(&fc->lock);
+		spin_unlock(&req->chan->lock);
 	}
 }
 
@@ -594,7 +718,7 @@ static int fuse_copy_fill(struct fuse_copy_state *cs)
 	unsigned long offset;
 	int err;
 
-	unlock_request(cs->fc, cs->req);
+	unlock_request(cs->req);
 	fuse_copy_finish(cs);
 	if (cs->pipebufs) {
 		struct pipe_buffer *buf = cs->pipebufs;
@@ -652,7 +776,7 @@ static int fuse_copy_fill(struct fuse_copy_state *cs)
 		cs->addr += cs->len;
 	}
 
-	return lock_request(cs->fc, cs->req);
+	return lock_request(cs->req);
 }
 
 /* Do as much copy to/from userspace buffer as we can */
@@ -700,7 +824,7 @@ static int fuse_try_move_page(struct fuse_copy_state *cs, struct page **pagep)
 	struct address_space *mapping;
 	pgoff_t index;
 
-	unlock_request(cs->fc, cs->req);
+	unlock_request(cs->req);
 	fuse_copy_finish(cs);
 
 	err = buf->ops->confirm(cs->pipe, buf);
@@ -757,12 +881,12 @@ static int fuse_try_move_page(struct fuse_copy_state *cs, struct page **pagep)
 		lru_cache_add_file(newpage);
 
 	err = 0;
-	spin_lock(&cs->fc->lock);
+	spin_lock(&cs->req->chan->lock);
 	if (cs->req->aborted)
 		err = -ENOENT;
 	else
 		*pagep = newpage;
-	spin_unlock(&cs->fc->lock);
+	spin_unlock(&cs->req->chan->lock);
 
 	if (err) {
 		unlock_page(newpage);
@@ -782,7 +906,7 @@ out_fallback:
 	cs->mapaddr = buf->ops->map(cs->pipe, buf, 1);
 	cs->buf = cs->mapaddr + buf->offset;
 
-	err = lock_request(cs->fc, cs->req);
+	err = lock_request(cs->req);
 	if (err)
 		return err;
 
@@ -797,7 +921,7 @@ static int fuse_ref_page(struct fuse_copy_state *cs, struct page *page,
 	if (cs->nr_segs == cs->pipe->buffers)
 		return -EIO;
 
-	unlock_request(cs->fc, cs->req);
+	unlock_request(cs->req);
 	fuse_copy_finish(cs);
 
 	buf = cs->pipebufs;
@@ -910,36 +1034,41 @@ static int fuse_copy_args(struct fuse_copy_state *cs, unsigned numargs,
 	return err;
 }
 
-static int forget_pending(struct fuse_conn *fc)
+static int forget_pending(struct fuse_chan *chan)
 {
-	return fc->forget_list_head.next != NULL;
+	return chan->forget_list_head.next != NULL;
 }
 
-static int request_pending(struct fuse_conn *fc)
+static int request_pending(struct fuse_chan *chan)
 {
-	return !list_empty(&fc->pending) || !list_empty(&fc->interrupts) ||
-		forget_pending(fc);
+	return !list_empty(&chan->pending) || !list_empty(&chan->interrupts) ||
+		forget_pending(chan);
 }
 
 /* Wait until a request is available on the pending list */
-static void request_wait(struct fuse_conn *fc)
-__releases(fc->lock)
-__acquires(fc->lock)
+static void request_wait(struct fuse_chan *chan)
+__releases(chan->lock)
+__acquires(chan->lock)
 {
+	struct fuse_conn *fc = chan->fc;
 	DECLARE_WAITQUEUE(wait, current);
 
-	add_wait_queue_exclusive(&fc->waitq, &wait);
-	while (fc->connected && !request_pending(fc)) {
+	add_wait_queue_exclusive(&chan->waitq, &wait);
+	chan->readers++;
+	for (;;) {
+		/* fc->connected is cleared without chan->lock */
 		set_current_state(TASK_INTERRUPTIBLE);
-		if (signal_pending(current))
+		if (!fc->connected || request_pending(chan) ||
+		    signal_pending(current))
 			break;
 
-		spin_unlock(&fc->lock);
+		spin_unlock(&chan->lock);
 		schedule();
-		spin_lock(&fc->lock);
+		spin_lock(&chan->lock);
 	}
+	chan->readers--;
 	set_current_state(TASK_RUNNING);
-	remove_wait_queue(&fc->waitq, &wait);
+	remove_wait_queue(&chan->waitq, &wait);
 }
 
 /*
@@ -948,11 +1077,12 @@ __acquires(fc->lock)
  * Unlike other requests this is assembled on demand, without a need
  * to allocate a separate fuse_req structure.
  *
- * Called with fc->lock held, releases it
+ * Called with chan->lock held, releases it
  */
-static int fuse_read_interrupt(struct fuse_conn *fc, struct fuse_copy_state *cs,
+static int fuse_read_interrupt(struct fuse_chan *chan,
+			       struct fuse_copy_state *cs,
 			       size_t nbytes, struct fuse_req *req)
-__releases(fc->lock)
+__releases(chan->lock)
 {
 	struct fuse_in_header ih;
 	struct fuse_interrupt_in arg;
@@ -960,7 +1090,7 @@ __releases(fc->lock)
 	int err;
 
 	list_del_init(&req->intr_entry);
-	req->intr_unique = fuse_get_unique(fc);
+	req->intr_unique = fuse_get_unique(chan->fc);
 	memset(&ih, 0, sizeof(ih));
 	memset(&arg, 0, sizeof(arg));
 	ih.len = reqsize;
@@ -968,7 +1098,7 @@ __releases(fc->lock)
 	ih.unique = req->intr_unique;
 	arg.unique = req->in.h.unique;
 
-	spin_unlock(&fc->lock);
+	spin_unlock(&chan->lock);
 	if (nbytes < reqsize)
 		return -EINVAL;
 
@@ -980,21 +1110,21 @@ __releases(fc->lock)
 	return err ? err : reqsize;
 }
 
-static struct fuse_forget_link *dequeue_forget(struct fuse_conn *fc,
+static struct fuse_forget_link *dequeue_forget(struct fuse_chan *chan,
 					       unsigned max,
 					       unsigned *countp)
 {
-	struct fuse_forget_link *head = fc->forget_list_head.next;
+	struct fuse_forget_link *head = chan->forget_list_head.next;
 	struct fuse_forget_link **newhead = &head;
 	unsigned count;
 
 	for (count = 0; *newhead != NULL && count < max; count++)
 		newhead = &(*newhead)->next;
 
-	fc->forget_list_head.next = *newhead;
+	chan->forget_list_head.next = *newhead;
 	*newhead = NULL;
-	if (fc->forget_list_head.next == NULL)
-		fc->forget_list_tail = &fc->forget_list_head;
+	if (chan->forget_list_head.next == NULL)
+		chan->forget_list_tail = &chan->forget_list_head;
 
 	if (countp != NULL)
 		*countp = count;
@@ -1002,24 +1132,24 @@ static struct fuse_forget_link *dequeue_forget(struct fuse_conn *fc,
 	return head;
 }
 
-static int fuse_read_single_forget(struct fuse_conn *fc,
+static int fuse_read_single_forget(struct fuse_chan *chan,
 				   struct fuse_copy_state *cs,
 				   size_t nbytes)
-__releases(fc->lock)
+__releases(chan->lock)
 {
 	int err;
-	struct fuse_forget_link *forget = dequeue_forget(fc, 1, NULL);
+	struct fuse_forget_link *forget = dequeue_forget(chan, 1, NULL);
 	struct fuse_forget_in arg = {
 		.nlookup = forget->forget_one.nlookup,
 	};
 	struct fuse_in_header ih = {
 		.opcode = FUSE_FORGET,
 		.nodeid = forget->forget_one.nodeid,
-		.unique = fuse_get_unique(fc),
+		.unique = fuse_get_unique(chan->fc),
 		.len = sizeof(ih) + sizeof(arg),
 	};
 
-	spin_unlock(&fc->lock);
+	spin_unlock(&chan->lock);
 	kfree(forget);
 	if (nbytes < ih.len)
 		return -EINVAL;
@@ -1035,9 +1165,9 @@ __releases(fc->lock)
 	return ih.len;
 }
 
-static int fuse_read_batch_forget(struct fuse_conn *fc,
+static int fuse_read_batch_forget(struct fuse_chan *chan,
 				   struct fuse_copy_state *cs, size_t nbytes)
-__releases(fc->lock)
+__releases(chan->lock)
 {
 	int err;
 	unsigned max_forgets;
@@ -1046,18 +1176,18 @@ __releases(fc->lock)
 	struct fuse_batch_forget_in arg = { .count = 0 };
 	struct fuse_in_header ih = {
 		.opcode = FUSE_BATCH_FORGET,
-		.unique = fuse_get_unique(fc),
+		.unique = fuse_get_unique(chan->fc),
 		.len = sizeof(ih) + sizeof(arg),
 	};
 
 	if (nbytes < ih.len) {
-		spin_unlock(&fc->lock);
+		spin_unlock(&chan->lock);
 		return -EINVAL;
 	}
 
 	max_forgets = (nbytes - ih.len) / sizeof(struct fuse_forget_one);
-	head = dequeue_forget(fc, max_forgets, &count);
-	spin_unlock(&fc->lock);
+	head = dequeue_forget(chan, max_forgets, &count);
+	spin_unlock(&chan->lock);
 
 	arg.count = count;
 	ih.len += count * sizeof(struct fuse_forget_one);
@@ -1084,14 +1214,14 @@ __releases(fc->lock)
 	return ih.len;
 }
 
-static int fuse_read_forget(struct fuse_conn *fc, struct fuse_copy_state *cs,
+static int fuse_read_forget(struct fuse_chan *chan, struct fuse_copy_state *cs,
 			    size_t nbytes)
-__releases(fc->lock)
+__releases(chan->lock)
 {
-	if (fc->minor < 16 || fc->forget_list_head.next->next == NULL)
-		return fuse_read_single_forget(fc, cs, nbytes);
+	if (chan->fc->minor < 16 || chan->forget_list_head.next->next == NULL)
+		return fuse_read_single_forget(chan, cs, nbytes);
 	else
-		return fuse_read_batch_forget(fc, cs, nbytes);
+		return fuse_read_batch_forget(chan, cs, nbytes);
 }
 
 /*
@@ -1103,46 +1233,47 @@ __releases(fc->lock)
  * request_end().  Otherwise add it to the processing list, and set
  * the 'sent' flag.
  */
-static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
+static ssize_t fuse_dev_do_read(struct fuse_chan *chan, struct file *file,
 				struct fuse_copy_state *cs, size_t nbytes)
 {
+	struct fuse_conn *fc = chan->fc;
 	int err;
 	struct fuse_req *req;
 	struct fuse_in *in;
 	unsigned reqsize;
 
  restart:
-	spin_lock(&fc->lock);
+	spin_lock(&chan->lock);
 	err = -EAGAIN;
 	if ((file->f_flags & O_NONBLOCK) && fc->connected &&
-	    !request_pending(fc))
+	    !request_pending(chan))
 		goto err_unlock;
 
-	request_wait(fc);
+	request_wait(chan);
 	err = -ENODEV;
 	if (!fc->connected)
 		goto err_unlock;
 	err = -ERESTARTSYS;
-	if (!request_pending(fc))
+	if (!request_pending(chan))
 		goto err_unlock;
 
-	if (!list_empty(&fc->interrupts)) {
-		req = list_entry(fc->interrupts.next, struct fuse_req,
+	if (!list_empty(&chan->interrupts)) {
+		req = list_entry(chan->interrupts.next, struct fuse_req,
 				 intr_entry);
-		return fuse_read_interrupt(fc, cs, nbytes, req);
+		return fuse_read_interrupt(chan, cs, nbytes, req);
 	}
 
-	if (forget_pending(fc)) {
-		if (list_empty(&fc->pending) || fc->forget_batch-- > 0)
-			return fuse_read_forget(fc, cs, nbytes);
+	if (forget_pending(chan)) {
+		if (list_empty(&chan->pending) || chan->forget_batch-- > 0)
+			return fuse_read_forget(chan, cs, nbytes);
 
-		if (fc->forget_batch <= -8)
-			fc->forget_batch = 16;
+		if (chan->forget_batch <= -8)
+			chan->forget_batch = 16;
 	}
 
-	req = list_entry(fc->pending.next, struct fuse_req, list);
+	req = list_entry(chan->pending.next, struct fuse_req, list);
 	req->state = FUSE_REQ_READING;
-	list_move(&req->list, &fc->io);
+	list_move(&req->list, &chan->io);
 
 	in = &req->in;
 	reqsize = in->h.len;
@@ -1152,40 +1283,40 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 		/* SETXATTR is special, since it may contain too large data */
 		if (in->h.opcode == FUSE_SETXATTR)
 			req->out.h.error = -E2BIG;
-		request_end(fc, req);
+		request_end(chan, req);
 		goto restart;
 	}
-	spin_unlock(&fc->lock);
+	spin_unlock(&chan->lock);
 	cs->req = req;
 	err = fuse_copy_one(cs, &in->h, sizeof(in->h));
 	if (!err)
 		err = fuse_copy_args(cs, in->numargs, in->argpages,
 				     (struct fuse_arg *) in->args, 0);
 	fuse_copy_finish(cs);
-	spin_lock(&fc->lock);
+	spin_lock(&chan->lock);
 	req->locked = 0;
 	if (req->aborted) {
-		request_end(fc, req);
+		request_end(chan, req);
 		return -ENODEV;
 	}
 	if (err) {
 		req->out.h.error = -EIO;
-		request_end(fc, req);
+		request_end(chan, req);
 		return err;
 	}
 	if (!req->isreply)
-		request_end(fc, req);
+		request_end(chan, req);
 	else {
 		req->state = FUSE_REQ_SENT;
-		list_move_tail(&req->list, &fc->processing);
+		list_move_tail(&req->list, &chan->processing);
 		if (req->interrupted)
-			queue_interrupt(fc, req);
-		spin_unlock(&fc->lock);
+			queue_interrupt(chan, req);
+		spin_unlock(&chan->lock);
 	}
 	return reqsize;
 
  err_unlock:
-	spin_unlock(&fc->lock);
+	spin_unlock(&chan->lock);
 	return err;
 }
 
@@ -1194,13 +1325,13 @@ static ssize_t fuse_dev_read(struct kiocb *iocb, const struct iovec *iov,
 {
 	struct fuse_copy_state cs;
 	struct file *file = iocb->ki_filp;
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_chan *chan = fuse_get_chan(file);
+	if (!chan)
 		return -EPERM;
 
-	fuse_copy_init(&cs, fc, 1, iov, nr_segs);
+	fuse_copy_init(&cs, chan->fc, 1, iov, nr_segs);
 
-	return fuse_dev_do_read(fc, file, &cs, iov_length(iov, nr_segs));
+	return fuse_dev_do_read(chan, file, &cs, iov_length(iov, nr_segs));
 }
 
 static int fuse_dev_pipe_buf_steal(struct pipe_inode_info *pipe,
@@ -1228,18 +1359,18 @@ static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 	int do_wakeup = 0;
 	struct pipe_buffer *bufs;
 	struct fuse_copy_state cs;
-	struct fuse_conn *fc = fuse_get_conn(in);
-	if (!fc)
+	struct fuse_chan *chan = fuse_get_chan(in);
+	if (!chan)
 		return -EPERM;
 
 	bufs = kmalloc(pipe->buffers * sizeof(struct pipe_buffer), GFP_KERNEL);
 	if (!bufs)
 		return -ENOMEM;
 
-	fuse_copy_init(&cs, fc, 1, NULL, 0);
+	fuse_copy_init(&cs, chan->fc, 1, NULL, 0);
 	cs.pipebufs = bufs;
 	cs.pipe = pipe;
-	ret = fuse_dev_do_read(fc, in, &cs, len);
+	ret = fuse_dev_do_read(chan, in, &cs, len);
 	if (ret < 0)
 		goto out;
 
@@ -1609,11 +1740,11 @@ static int fuse_notify(struct fuse_conn *fc, enum fuse_notify_code code,
 }
 
 /* Look up request on processing list by unique ID */
-static struct fuse_req *request_find(struct fuse_conn *fc, u64 unique)
+static struct fuse_req *request_find(struct fuse_chan *chan, u64 unique)
 {
 	struct list_head *entry;
 
-	list_for_each(entry, &fc->processing) {
+	list_for_each(entry, &chan->processing) {
 		struct fuse_req *req;
 		req = list_entry(entry, struct fuse_req, list);
 		if (req->in.h.unique == unique || req->intr_unique == unique)
@@ -1648,13 +1779,14 @@ static int copy_out_args(struct fuse_copy_state *cs, struct fuse_out *out,
 /*
  * Write a single reply to a request.  First the header is copied from
  * the write buffer.  The request is then searched on the processing
- * list by the unique ID found in the header.  If found, then remove
- * it from the list and copy the rest of the buffer to the request.
- * The request is finished by calling request_end()
+ * list of the channel by the unique ID found in the header.  If found,
+ * then remove it from the list and copy the rest of the buffer to the
+ * request.  The request is finished by calling request_end()
  */
-static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
+static ssize_t fuse_dev_do_write(struct fuse_chan *chan,
 				 struct fuse_copy_state *cs, size_t nbytes)
 {
+	struct fuse_conn *fc = chan->fc;
 	int err;
 	struct fuse_req *req;
 	struct fuse_out_header oh;
@@ -1683,20 +1815,20 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 	if (oh.error <= -1000 || oh.error > 0)
 		goto err_finish;
 
-	spin_lock(&fc->lock);
+	spin_lock(&chan->lock);
 	err = -ENOENT;
 	if (!fc->connected)
 		goto err_unlock;
 
-	req = request_find(fc, oh.unique);
+	req = request_find(chan, oh.unique);
 	if (!req)
 		goto err_unlock;
 
 	if (req->aborted) {
-		spin_unlock(&fc->lock);
+		spin_unlock(&chan->lock);
 		fuse_copy_finish(cs);
-		spin_lock(&fc->lock);
-		request_end(fc, req);
+		spin_lock(&chan->lock);
+		request_end(chan, req);
 		return -ENOENT;
 	}
 	/* Is it an interrupt reply? */
@@ -1708,38 +1840,41 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 		if (oh.error == -ENOSYS)
 			fc->no_interrupt = 1;
 		else if (oh.error == -EAGAIN)
-			queue_interrupt(fc, req);
+			queue_interrupt(chan, req);
 
-		spin_unlock(&fc->lock);
+		spin_unlock(&chan->lock);
 		fuse_copy_finish(cs);
 		return nbytes;
 	}
 
 	req->state = FUSE_REQ_WRITING;
-	list_move(&req->list, &fc->io);
+	list_move(&req->list, &chan->io);
 	req->out.h = oh;
 	req->locked = 1;
 	cs->req = req;
 	if (!req->out.page_replace)
 		cs->move_pages = 0;
-	spin_unlock(&fc->lock);
+	spin_unlock(&chan->lock);
 
 	err = copy_out_args(cs, &req->out, nbytes);
 	fuse_copy_finish(cs);
 
-	spin_lock(&fc->lock);
+	if (!err && fc->passthrough)
+		fuse_passthrough_setup(fc, req);
+
+	spin_lock(&chan->lock);
 	req->locked = 0;
 	if (!err) {
 		if (req->aborted)
 			err = -ENOENT;
 	} else if (!req->aborted)
 		req->out.h.error = -EIO;
-	request_end(fc, req);
+	request_end(chan, req);
 
 	return err ? err : nbytes;
 
  err_unlock:
-	spin_unlock(&fc->lock);
+	spin_unlock(&chan->lock);
  err_finish:
 	fuse_copy_finish(cs);
 	return err;
@@ -1749,13 +1884,13 @@ static ssize_t fuse_dev_write(struct kiocb *iocb, const struct iovec *iov,
 			      unsigned long nr_segs, loff_t pos)
 {
 	struct fuse_copy_state cs;
-	struct fuse_conn *fc = fuse_get_conn(iocb->ki_filp);
-	if (!fc)
+	struct fuse_chan *chan = fuse_get_chan(iocb->ki_filp);
+	if (!chan)
 		return -EPERM;
 
-	fuse_copy_init(&cs, fc, 0, iov, nr_segs);
+	fuse_copy_init(&cs, chan->fc, 0, iov, nr_segs);
 
-	return fuse_dev_do_write(fc, &cs, iov_length(iov, nr_segs));
+	return fuse_dev_do_write(chan, &cs, iov_length(iov, nr_segs));
 }
 
 static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
@@ -1766,12 +1901,12 @@ static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
 	unsigned idx;
 	struct pipe_buffer *bufs;
 	struct fuse_copy_state cs;
-	struct fuse_conn *fc;
+	struct fuse_chan *chan;
 	size_t rem;
 	ssize_t ret;
 
-	fc = fuse_get_conn(out);
-	if (!fc)
+	chan = fuse_get_chan(out);
+	if (!chan)
 		return -EPERM;
 
 	bufs = kmalloc(pipe->buffers * sizeof(struct pipe_buffer), GFP_KERNEL);
@@ -1818,14 +1953,14 @@ static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
 	}
 	pipe_unlock(pipe);
 
-	fuse_copy_init(&cs, fc, 0, NULL, nbuf);
+	fuse_copy_init(&cs, chan->fc, 0, NULL, nbuf);
 	cs.pipebufs = bufs;
 	cs.pipe = pipe;
 
 	if (flags & SPLICE_F_MOVE)
 		cs.move_pages = 1;
 
-	ret = fuse_dev_do_write(fc, &cs, len);
+	ret = fuse_dev_do_write(chan, &cs, len);
 
 	for (idx = 0; idx < nbuf; idx++) {
 		struct pipe_buffer *buf = &bufs[idx];
@@ -1839,18 +1974,18 @@ out:
 static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 {
 	unsigned mask = POLLOUT | POLLWRNORM;
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_chan *chan = fuse_get_chan(file);
+	if (!chan)
 		return POLLERR;
 
-	poll_wait(file, &fc->waitq, wait);
+	poll_wait(file, &chan->waitq, wait);
 
-	spin_lock(&fc->lock);
-	if (!fc->connected)
+	spin_lock(&chan->lock);
+	if (!chan->fc->connected)
 		mask = POLLERR;
-	else if (request_pending(fc))
+	else if (request_pending(chan))
 		mask |= POLLIN | POLLRDNORM;
-	spin_unlock(&fc->lock);
+	spin_unlock(&chan->lock);
 
 	return mask;
 }
@@ -1858,18 +1993,18 @@ static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 /*
  * Abort all requests on the given list (pending or processing)
  *
- * This function releases and reacquires fc->lock
+ * This function releases and reacquires chan->lock
  */
-static void end_requests(struct fuse_conn *fc, struct list_head *head)
-__releases(fc->lock)
-__acquires(fc->lock)
+static void end_requests(struct fuse_chan *chan, struct list_head *head)
+__releases(chan->lock)
+__acquires(chan->lock)
 {
 	while (!list_empty(head)) {
 		struct fuse_req *req;
 		req = list_entry(head->next, struct fuse_req, list);
 		req->out.h.error = -ECONNABORTED;
-		request_end(fc, req);
-		spin_lock(&fc->lock);
+		request_end(chan, req);
+		spin_lock(&chan->lock);
 	}
 }
 
@@ -1884,13 +2019,15 @@ __acquires(fc->lock)
  * called after waiting for the request to be unlocked (if it was
  * locked).
  */
-static void end_io_requests(struct fuse_conn *fc)
-__releases(fc->lock)
-__acquires(fc->lock)
+static void end_io_requests(struct fuse_chan *chan)
+__releases(chan->lock)
+__acquires(chan->lock)
 {
-	while (!list_empty(&fc->io)) {
+	struct fuse_conn *fc = chan->fc;
+
+	while (!list_empty(&chan->io)) {
 		struct fuse_req *req =
-			list_entry(fc->io.next, struct fuse_req, list);
+			list_entry(chan->io.next, struct fuse_req, list);
 		void (*end) (struct fuse_conn *, struct fuse_req *) = req->end;
 
 		req->aborted = 1;
@@ -1901,25 +2038,23 @@ __acquires(fc->lock)
 		if (end) {
 			req->end = NULL;
 			__fuse_get_request(req);
-			spin_unlock(&fc->lock);
+			spin_unlock(&chan->lock);
 			wait_event(req->waitq, !req->locked);
 			end(fc, req);
 			fuse_put_request(fc, req);
-			spin_lock(&fc->lock);
+			spin_lock(&chan->lock);
 		}
 	}
 }
 
-static void end_queued_requests(struct fuse_conn *fc)
-__releases(fc->lock)
-__acquires(fc->lock)
+static void end_queued_requests(struct fuse_chan *chan)
+__releases(chan->lock)
+__acquires(chan->lock)
 {
-	fc->max_background = UINT_MAX;
-	flush_bg_queue(fc);
-	end_requests(fc, &fc->pending);
-	end_requests(fc, &fc->processing);
-	while (forget_pending(fc))
-		kfree(dequeue_forget(fc, 1, NULL));
+	end_requests(chan, &chan->pending);
+	end_requests(chan, &chan->processing);
+	while (forget_pending(chan))
+		kfree(dequeue_forget(chan, 1, NULL));
 }
 
 static void end_polls(struct fuse_conn *fc)
@@ -1937,6 +2072,51 @@ static void end_polls(struct fuse_conn *fc)
 	}
 }
 
+/*
+ * Disconnect all channels and end the requests on them.
+ *
+ * Background requests still waiting for their turn are queued on the
+ * channels first, so that they are ended too.  Once no channel is
+ * connected nothing can be queued anymore, and the requests on the
+ * channels are ended without fc->lock, which request_end() takes.
+ *
+ * Requests on the io list must be ended first, their aborted flag
+ * keeps them from progressing to the processing list.
+ *
+ * Called with fc->lock held, releases it.
+ */
+static void fuse_disconnect(struct fuse_conn *fc)
+__releases(fc->lock)
+{
+	unsigned i;
+
+	fc->connected = 0;
+	fc->blocked = 0;
+	fc->max_background = UINT_MAX;
+	flush_bg_queue(fc);
+	for (i = 0; i < fc->nr_chans; i++) {
+		struct fuse_chan *chan = fc->chans[i];
+
+		spin_lock(&chan->lock);
+		chan->connected = 0;
+		spin_unlock(&chan->lock);
+	}
+	end_polls(fc);
+	wake_up_all(&fc->blocked_waitq);
+	spin_unlock(&fc->lock);
+
+	for (i = 0; i < fc->nr_chans; i++) {
+		struct fuse_chan *chan = fc->chans[i];
+
+		spin_lock(&chan->lock);
+		end_io_requests(chan);
+		end_queued_requests(chan);
+		spin_unlock(&chan->lock);
+		wake_up_all(&chan->waitq);
+		kill_fasync(&chan->fasync, SIGIO, POLL_IN);
+	}
+}
+
 /*
  * Abort all requests.
  *
@@ -1950,7 +2130,8 @@ static void end_polls(struct fuse_conn *fc)
  *
  * During the aborting, progression of requests from the pending and
  * processing lists onto the io list, and progression of new requests
- * onto the pending list is prevented by req->connected being false.
+ * onto the pending list is prevented by fc->connected and
+ * chan->connected being false.
  *
  * Progression of requests under I/O to the processing list is
  * prevented by the req->aborted flag being true for these requests.
@@ -1959,31 +2140,79 @@ static void end_polls(struct fuse_conn *fc)
 void fuse_abort_conn(struct fuse_conn *fc)
 {
 	spin_lock(&fc->lock);
-	if (fc->connected) {
-		fc->connected = 0;
-		fc->blocked = 0;
-		end_io_requests(fc);
-		end_queued_requests(fc);
-		end_polls(fc);
-		wake_up_all(&fc->waitq);
-		wake_up_all(&fc->blocked_waitq);
-		kill_fasync(&fc->fasync, SIGIO, POLL_IN);
-	}
-	spin_unlock(&fc->lock);
+	if (fc->connected)
+		fuse_disconnect(fc);
+	else
+		spin_unlock(&fc->lock);
 }
 EXPORT_SYMBOL_GPL(fuse_abort_conn);
 
+/* Called with fc->lock held */
+static struct fuse_chan *fuse_other_chan(struct fuse_chan *chan)
+{
+	struct fuse_conn *fc = chan->fc;
+	unsigned i;
+
+	for (i = 0; i < fc->nr_chans; i++) {
+		if (fc->chans[i] != chan && fc->chans[i]->connected)
+			return fc->chans[i];
+	}
+	return NULL;
+}
+
+/*
+ * The device file of a channel is closed, but other channels of the
+ * connection are left.  Requests and forgets not yet read from the
+ * channel are handed to one of them.  Requests read from the channel
+ * cannot be answered anymore, and are ended.
+ *
+ * Called with fc->lock held, releases it.
+ */
+static void fuse_chan_detach(struct fuse_chan *chan, struct fuse_chan *to)
+__releases(chan->fc->lock)
+{
+	struct fuse_req *req;
+
+	spin_lock(&chan->lock);
+	chan->connected = 0;
+	spin_lock_nested(&to->lock, SINGLE_DEPTH_NESTING);
+	list_for_each_entry(req, &chan->pending, list)
+		req->chan = to;
+	list_splice_tail_init(&chan->pending, &to->pending);
+	if (forget_pending(chan)) {
+		to->forget_list_tail->next = chan->forget_list_head.next;
+		to->forget_list_tail = chan->forget_list_tail;
+		chan->forget_list_head.next = NULL;
+		chan->forget_list_tail = &chan->forget_list_head;
+	}
+	spin_unlock(&to->lock);
+	spin_unlock(&chan->fc->lock);
+
+	wake_up_all(&to->waitq);
+	kill_fasync(&to->fasync, SIGIO, POLL_IN);
+
+	end_queued_requests(chan);
+	spin_unlock(&chan->lock);
+
+	spin_lock(&chan->fc->lock);
+	chan->released = 1;
+	spin_unlock(&chan->fc->lock);
+}
+
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (fc) {
+	struct fuse_chan *chan = fuse_get_chan(file);
+	if (chan) {
+		struct fuse_conn *fc = chan->fc;
+		struct fuse_chan *to = NULL;
+
 		spin_lock(&fc->lock);
-		fc->connected = 0;
-		fc->blocked = 0;
-		end_queued_requests(fc);
-		end_polls(fc);
-		wake_up_all(&fc->blocked_waitq);
-		spin_unlock(&fc->lock);
+		if (fc->connected)
+			to = fuse_other_chan(chan);
+		if (to)
+			fuse_chan_detach(chan, to);
+		else
+			fuse_disconnect(fc);
 		fuse_conn_put(fc);
 	}
 
@@ -1993,12 +2222,161 @@ EXPORT_SYMBOL_GPL(fuse_dev_release);
 
 static int fuse_dev_fasync(int fd, struct file *file, int on)
 {
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_chan *chan = fuse_get_chan(file);
+	if (!chan)
 		return -EPERM;
 
 	/* No locking - fasync_helper does its own locking */
-	return fasync_helper(fd, file, on, &fc->fasync);
+	return fasync_helper(fd, file, on, &chan->fasync);
+}
+
+/*
+ * Allocate a channel and add it to the connection, reusing the slot of
+ * a channel whose device file was closed and which is fully detached,
+ * if there is one.  The first channel is added at mount, the others
+ * only while the connection is up.
+ */
+struct fuse_chan *fuse_chan_new(struct fuse_conn *fc)
+{
+	struct fuse_chan *chan;
+	struct fuse_chan *new;
+	unsigned i;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return ERR_PTR(-ENOMEM);
+
+	spin_lock_init(&new->lock);
+	new->fc = fc;
+	new->connected = 1;
+	init_waitqueue_head(&new->waitq);
+	INIT_LIST_HEAD(&new->pending);
+	INIT_LIST_HEAD(&new->processing);
+	INIT_LIST_HEAD(&new->io);
+	INIT_LIST_HEAD(&new->interrupts);
+	new->forget_list_tail = &new->forget_list_head;
+
+	spin_lock(&fc->lock);
+	chan = ERR_PTR(-ENODEV);
+	if (fc->nr_chans && !fc->connected)
+		goto out_unlock;
+
+	for (i = 0; i < fc->nr_chans; i++) {
+		chan = fc->chans[i];
+		if (chan->released) {
+			spin_lock(&chan->lock);
+			chan->released = 0;
+			chan->connected = 1;
+			chan->forget_batch = 0;
+			spin_unlock(&chan->lock);
+			goto out_unlock;
+		}
+	}
+
+	chan = ERR_PTR(-EMFILE);
+	if (fc->nr_chans < FUSE_MAX_CHANNELS) {
+		chan = new;
+		new = NULL;
+		fc->chans[fc->nr_chans] = chan;
+		/* the channel is set up before fuse_pick_chan() sees it */
+		smp_wmb();
+		fc->nr_chans++;
+	}
+ out_unlock:
+	spin_unlock(&fc->lock);
+	kfree(new);
+	return chan;
+}
+
+void fuse_chans_wake_up(struct fuse_conn *fc)
+{
+	unsigned i;
+
+	for (i = 0; i < fc->nr_chans; i++) {
+		kill_fasync(&fc->chans[i]->fasync, SIGIO, POLL_IN);
+		wake_up_all(&fc->chans[i]->waitq);
+	}
+}
+
+/*
+ * Attach a newly opened device file to the connection of another one,
+ * as a channel of its own, so that each thread of a daemon can read
+ * requests from its own device file
+ */
+static long fuse_dev_clone(struct file *file, __u32 __user *argp)
+{
+	struct fuse_chan *chan;
+	struct fuse_conn *fc;
+	struct file *old;
+	__u32 oldfd;
+	int err;
+
+	if (get_user(oldfd, argp))
+		return -EFAULT;
+
+	old = fget(oldfd);
+	if (!old)
+		return -EBADF;
+
+	err = -EINVAL;
+	if (old->f_op != &fuse_dev_operations ||
+	    file->f_op != &fuse_dev_operations)
+		goto out_fput;
+
+	mutex_lock(&fuse_mutex);
+	if (file->private_data || !fuse_get_chan(old))
+		goto out_unlock;
+
+	fc = fuse_get_chan(old)->fc;
+	chan = fuse_chan_new(fc);
+	err = PTR_ERR(chan);
+	if (IS_ERR(chan))
+		goto out_unlock;
+
+	file->private_data = chan;
+	fuse_conn_get(fc);
+	err = 0;
+ out_unlock:
+	mutex_unlock(&fuse_mutex);
+ out_fput:
+	fput(old);
+	return err;
+}
+
+/*
+ * Lower files are registered by the daemon through the device, not with
+ * the descriptor in the reply to OPEN, which is written in whatever
+ * context the write to the device happens to run.
+ */
+static long fuse_dev_passthrough(struct file *file, unsigned int cmd,
+				 __u32 __user *argp)
+{
+	struct fuse_chan *chan = fuse_get_chan(file);
+	__u32 arg;
+
+	if (!chan)
+		return -EPERM;
+
+	if (get_user(arg, argp))
+		return -EFAULT;
+
+	if (cmd == FUSE_DEV_IOC_PASSTHROUGH_OPEN)
+		return fuse_passthrough_register(chan->fc, arg);
+	return fuse_passthrough_unregister(chan->fc, arg);
+}
+
+static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	switch (cmd) {
+	case FUSE_DEV_IOC_CLONE:
+		return fuse_dev_clone(file, (__u32 __user *) arg);
+	case FUSE_DEV_IOC_PASSTHROUGH_OPEN:
+	case FUSE_DEV_IOC_PASSTHROUGH_CLOSE:
+		return fuse_dev_passthrough(file, cmd, (__u32 __user *) arg);
+	default:
+		return -ENOTTY;
+	}
 }
 
 const struct file_operations fuse_dev_operations = {
@@ -2013,6 +2391,8 @@ const struct file_operations fuse_dev_operations = {
 	.poll		= fuse_dev_poll,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
+	.unlocked_ioctl	= fuse_dev_ioctl,
+	.compat_ioctl	= fuse_dev_ioctl,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
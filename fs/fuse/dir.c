@@ -145,6 +145,19 @@ u64 fuse_get_attr_version(struct fuse_conn *fc)
 	return curr_version;
 }
 
+/*
+ * Note that an entry of the directory was looked up.  The next READDIR
+ * of the directory goes out as READDIRPLUS; see fuse_use_readdirplus().
+ */
+static void fuse_advise_use_readdirplus(struct inode *dir)
+{
+	struct fuse_inode *fi = get_fuse_inode(dir);
+
+	/* stat is hot, don't dirty the cacheline when the bit is set */
+	if (!test_bit(FUSE_I_ADVISE_RDPLUS, &fi->state))
+		set_bit(FUSE_I_ADVISE_RDPLUS, &fi->state);
+}
+
 /*
  * Check whether the dentry is still valid
  *
@@ -194,6 +207,8 @@ static int fuse_dentry_revalidate(struct dentry *entry, struct nameidata *nd)
 		fuse_lookup_init(fc, req, get_node_id(parent->d_inode),
 				 &entry->d_name, &outarg);
 		fuse_request_send(fc, req);
+		if (fc->readdirplus_auto)
+			fuse_advise_use_readdirplus(parent->d_inode);
 		dput(parent);
 		err = req->out.h.error;
 		fuse_put_request(fc, req);
@@ -218,6 +233,15 @@ static int fuse_dentry_revalidate(struct dentry *entry, struct nameidata *nd)
 				       entry_attr_timeout(&outarg),
 				       attr_version);
 		fuse_change_entry_timeout(entry, &outarg);
+	} else if (inode && get_fuse_conn(inode)->readdirplus_auto) {
+		struct inode *dir;
+
+		/* may be in rcu-walk: the parent inode is freed by rcu */
+		rcu_read_lock();
+		dir = ACCESS_ONCE(ACCESS_ONCE(entry->d_parent)->d_inode);
+		if (dir)
+			fuse_advise_use_readdirplus(dir);
+		rcu_read_unlock();
 	}
 	return 1;
 }
@@ -355,6 +379,8 @@ static struct dentry *fuse_lookup(struct inode *dir, struct dentry *entry,
 	else
 		fuse_invalidate_entry_cache(entry);
 
+	if (fc->readdirplus_auto)
+		fuse_advise_use_readdirplus(dir);
 	return newent;
 
  out_iput:
@@ -441,6 +467,8 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry, int mode,
 	if (!S_ISREG(outentry.attr.mode) || invalid_nodeid(outentry.nodeid))
 		goto out_free_ff;
 
+	ff->passthrough_filp = req->passthrough_filp;
+	req->passthrough_filp = NULL;
 	fuse_put_request(fc, req);
 	ff->fh = outopen.fh;
 	ff->nodeid = outentry.nodeid;
@@ -770,6 +798,17 @@ static int fuse_link(struct dentry *entry, struct inode *newdir,
 static void fuse_fillattr(struct inode *inode, struct fuse_attr *attr,
 			  struct kstat *stat)
 {
+	struct fuse_conn *fc = get_fuse_conn(inode);
+
+	/* see the comment in fuse_change_attributes() */
+	if (fc->writeback_cache && S_ISREG(inode->i_mode)) {
+		attr->size = i_size_read(inode);
+		attr->mtime = inode->i_mtime.tv_sec;
+		attr->mtimensec = inode->i_mtime.tv_nsec;
+		attr->ctime = inode->i_ctime.tv_sec;
+		attr->ctimensec = inode->i_ctime.tv_nsec;
+	}
+
 	stat->dev = inode->i_sb->s_dev;
 	stat->ino = attr->ino;
 	stat->mode = (inode->i_mode & S_IFMT) | (attr->mode & 07777);
@@ -1078,6 +1117,181 @@ static int parse_dirfile(char *buf, size_t nbytes, struct file *file,
 	return 0;
 }
 
+/*
+ * With FUSE_READDIRPLUS_AUTO a directory is listed with READDIRPLUS only
+ * while its entries are looked up too, as by ls -l or a gallery scan that
+ * stats every file; a plain listing sends less and costs the filesystem
+ * no attributes.  The first chunk of every listing is READDIRPLUS, to
+ * find out.  If entries were looked up since the previous chunk, the rest
+ * of the listing is READDIRPLUS; if none were by the time the next
+ * listing starts, it isn't.  Programs that stat each entry as they read
+ * it switch over after the first chunk, ls -l from its second run on.
+ */
+static bool fuse_use_readdirplus(struct inode *dir, struct file *file)
+{
+	struct fuse_conn *fc = get_fuse_conn(dir);
+	struct fuse_inode *fi = get_fuse_inode(dir);
+
+	if (!fc->do_readdirplus)
+		return false;
+	if (!fc->readdirplus_auto)
+		return true;
+	if (test_and_clear_bit(FUSE_I_ADVISE_RDPLUS, &fi->state)) {
+		set_bit(FUSE_I_RDPLUS, &fi->state);
+		return true;
+	}
+	if (file->f_pos == 0) {
+		clear_bit(FUSE_I_RDPLUS, &fi->state);
+		return true;
+	}
+	return test_bit(FUSE_I_RDPLUS, &fi->state);
+}
+
+/*
+ * Put an entry of a READDIRPLUS reply in the dcache, or refresh the
+ * dentry already there, as a LOOKUP of the name would.  Called with
+ * the i_mutex of the directory, which readdir holds.
+ */
+static int fuse_direntplus_link(struct file *file,
+				struct fuse_direntplus *direntplus,
+				u64 attr_version)
+{
+	struct fuse_entry_out *o = &direntplus->entry_out;
+	struct fuse_dirent *dirent = &direntplus->dirent;
+	struct dentry *parent = file->f_path.dentry;
+	struct inode *dir = parent->d_inode;
+	struct fuse_conn *fc = get_fuse_conn(dir);
+	struct dentry *dentry;
+	struct dentry *alias;
+	struct inode *inode;
+	struct qstr name;
+	int err;
+
+	/* zero nodeid: only the name is given, not an ENOENT as in lookup */
+	if (!o->nodeid)
+		return 0;
+
+	name.name = (unsigned char *) dirent->name;
+	name.len = dirent->namelen;
+	if (name.name[0] == '.' &&
+	    (name.len == 1 || (name.len == 2 && name.name[1] == '.')))
+		return -EIO;
+
+	if (invalid_nodeid(o->nodeid) || !fuse_valid_type(o->attr.mode))
+		return -EIO;
+
+	name.hash = full_name_hash(name.name, name.len);
+	dentry = d_lookup(parent, &name);
+	if (dentry) {
+		inode = dentry->d_inode;
+		if (!inode) {
+			d_drop(dentry);
+		} else if (get_node_id(inode) != o->nodeid ||
+			   ((o->attr.mode ^ inode->i_mode) & S_IFMT)) {
+			err = d_invalidate(dentry);
+			if (err)
+				goto out;
+		} else if (is_bad_inode(inode)) {
+			err = -EIO;
+			goto out;
+		} else {
+			struct fuse_inode *fi = get_fuse_inode(inode);
+
+			spin_lock(&fc->lock);
+			fi->nlookup++;
+			spin_unlock(&fc->lock);
+
+			fuse_change_attributes(inode, &o->attr,
+					       entry_attr_timeout(o),
+					       attr_version);
+			goto found;
+		}
+		dput(dentry);
+	}
+
+	dentry = d_alloc(parent, &name);
+	err = -ENOMEM;
+	if (!dentry)
+		goto out;
+
+	/* fuse_iget() counts the lookup */
+	inode = fuse_iget(dir->i_sb, o->nodeid, o->generation, &o->attr,
+			  entry_attr_timeout(o), attr_version);
+	if (!inode)
+		goto out;
+
+	if (S_ISDIR(inode->i_mode)) {
+		mutex_lock(&fc->inst_mutex);
+		alias = fuse_d_add_directory(dentry, inode);
+		mutex_unlock(&fc->inst_mutex);
+		err = PTR_ERR(alias);
+		if (IS_ERR(alias)) {
+			/* as in lookup, the inode keeps the count until evicted */
+			iput(inode);
+			err = 0;
+			goto out;
+		}
+	} else {
+		alias = d_splice_alias(inode, dentry);
+	}
+	if (alias) {
+		dput(dentry);
+		dentry = alias;
+	}
+
+ found:
+	fuse_change_entry_timeout(dentry, o);
+	err = 0;
+ out:
+	dput(dentry);
+	return err;
+}
+
+static int parse_dirplusfile(char *buf, size_t nbytes, struct file *file,
+			     void *dstbuf, filldir_t filldir, u64 attr_version)
+{
+	struct fuse_conn *fc = get_fuse_conn(file->f_path.dentry->d_inode);
+	int over = 0;
+
+	while (nbytes >= FUSE_NAME_OFFSET_DIRENTPLUS) {
+		struct fuse_direntplus *direntplus =
+			(struct fuse_direntplus *) buf;
+		struct fuse_dirent *dirent = &direntplus->dirent;
+		size_t reclen = FUSE_DIRENTPLUS_SIZE(direntplus);
+		struct fuse_forget_link *forget;
+
+		if (!dirent->namelen || dirent->namelen > FUSE_NAME_MAX)
+			return -EIO;
+		if (reclen > nbytes)
+			break;
+
+		if (!over) {
+			over = filldir(dstbuf, dirent->name, dirent->namelen,
+				       file->f_pos, dirent->ino, dirent->type);
+			if (!over)
+				file->f_pos = dirent->off;
+		}
+
+		buf += reclen;
+		nbytes -= reclen;
+
+		/*
+		 * Entries that did not fit in the user's buffer are still
+		 * linked, every lookup the reply counted has to end up on
+		 * an inode or be forgotten.
+		 */
+		if (fuse_direntplus_link(file, direntplus, attr_version)) {
+			forget = fuse_alloc_forget();
+			if (forget)
+				fuse_queue_forget(fc, forget,
+						  direntplus->entry_out.nodeid,
+						  1);
+		}
+	}
+
+	return 0;
+}
+
 static int fuse_readdir(struct file *file, void *dstbuf, filldir_t filldir)
 {
 	int err;
@@ -1086,6 +1300,8 @@ static int fuse_readdir(struct file *file, void *dstbuf, filldir_t filldir)
 	struct inode *inode = file->f_path.dentry->d_inode;
 	struct fuse_conn *fc = get_fuse_conn(inode);
 	struct fuse_req *req;
+	u64 attr_version = 0;
+	bool plus;
 
 	if (is_bad_inode(inode))
 		return -EIO;
@@ -1102,14 +1318,28 @@ static int fuse_readdir(struct file *file, void *dstbuf, filldir_t filldir)
 	req->out.argpages = 1;
 	req->num_pages = 1;
 	req->pages[0] = page;
-	fuse_read_fill(req, file, file->f_pos, PAGE_SIZE, FUSE_READDIR);
+	plus = fuse_use_readdirplus(inode, file);
+	if (plus) {
+		attr_version = fuse_get_attr_version(fc);
+		fuse_read_fill(req, file, file->f_pos, PAGE_SIZE,
+			       FUSE_READDIRPLUS);
+	} else {
+		fuse_read_fill(req, file, file->f_pos, PAGE_SIZE,
+			       FUSE_READDIR);
+	}
 	fuse_request_send(fc, req);
 	nbytes = req->out.args[0].size;
 	err = req->out.h.error;
 	fuse_put_request(fc, req);
-	if (!err)
-		err = parse_dirfile(page_address(page), nbytes, file, dstbuf,
-				    filldir);
+	if (!err) {
+		if (plus)
+			err = parse_dirplusfile(page_address(page), nbytes,
+						file, dstbuf, filldir,
+						attr_version);
+		else
+			err = parse_dirfile(page_address(page), nbytes, file,
+					    dstbuf, filldir);
+	}
 
 	__free_page(page);
 	fuse_invalidate_attr(inode); /* atime changed */
@@ -1270,6 +1500,49 @@ void fuse_release_nowrite(struct inode *inode)
 	spin_unlock(&fc->lock);
 }
 
+/*
+ * With the writeback cache, send the i_mtime kept by the kernel to the
+ * filesystem.  Called when the inode is written back.
+ */
+int fuse_flush_mtime(struct inode *inode, struct fuse_file *ff)
+{
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_req *req;
+	struct fuse_setattr_in inarg;
+	struct fuse_attr_out outarg;
+	int err;
+
+	req = fuse_get_req(fc);
+	if (IS_ERR(req))
+		return PTR_ERR(req);
+
+	memset(&inarg, 0, sizeof(inarg));
+	memset(&outarg, 0, sizeof(outarg));
+	inarg.valid = FATTR_MTIME;
+	inarg.mtime = inode->i_mtime.tv_sec;
+	inarg.mtimensec = inode->i_mtime.tv_nsec;
+	if (ff) {
+		inarg.valid |= FATTR_FH;
+		inarg.fh = ff->fh;
+	}
+	req->in.h.opcode = FUSE_SETATTR;
+	req->in.h.nodeid = get_node_id(inode);
+	req->in.numargs = 1;
+	req->in.args[0].size = sizeof(inarg);
+	req->in.args[0].value = &inarg;
+	req->out.numargs = 1;
+	if (fc->minor < 9)
+		req->out.args[0].size = FUSE_COMPAT_ATTR_OUT_SIZE;
+	else
+		req->out.args[0].size = sizeof(outarg);
+	req->out.args[0].value = &outarg;
+	fuse_request_send(fc, req);
+	err = req->out.h.error;
+	fuse_put_request(fc, req);
+
+	return err;
+}
+
 /*
  * Set attributes, and at the same time refresh them.
  *
@@ -1287,6 +1560,7 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	struct fuse_setattr_in inarg;
 	struct fuse_attr_out outarg;
 	bool is_truncate = false;
+	bool is_wb = fc->writeback_cache && S_ISREG(inode->i_mode);
 	loff_t oldsize;
 	int err;
 
@@ -1309,6 +1583,21 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	if (attr->ia_valid & ATTR_SIZE)
 		is_truncate = true;
 
+	/*
+	 * Cached data written back after the new mode, owner or times
+	 * would be written with the wrong rights or undo the times.
+	 */
+	if (is_wb && !is_truncate && (attr->ia_valid &
+			(ATTR_MODE | ATTR_UID | ATTR_GID | ATTR_MTIME_SET |
+			 ATTR_TIMES_SET))) {
+		err = write_inode_now(inode, true);
+		if (err)
+			return err;
+
+		fuse_set_nowrite(inode);
+		fuse_release_nowrite(inode);
+	}
+
 	req = fuse_get_req(fc);
 	if (IS_ERR(req))
 		return PTR_ERR(req);
@@ -1358,8 +1647,16 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	spin_lock(&fc->lock);
 	fuse_change_attributes_common(inode, &outarg.attr,
 				      attr_timeout(&outarg));
+	if (is_wb) {
+		/* the kernel keeps the times, see fuse_change_attributes() */
+		if (attr->ia_valid & ATTR_MTIME)
+			inode->i_mtime = attr->ia_mtime;
+		if (attr->ia_valid & ATTR_CTIME)
+			inode->i_ctime = attr->ia_ctime;
+	}
 	oldsize = inode->i_size;
-	i_size_write(inode, outarg.attr.size);
+	if (!is_wb || is_truncate)
+		i_size_write(inode, outarg.attr.size);
 
 	if (is_truncate) {
 		/* NOTE: this may release/reacquire fc->lock */
@@ -1371,7 +1668,7 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	 * Only call invalidate_inode_pages2() after removing
 	 * FUSE_NOWRITE, otherwise fuse_launder_page() would deadlock.
 	 */
-	if (S_ISREG(inode->i_mode) && oldsize != outarg.attr.size) {
+	if (S_ISREG(inode->i_mode) && oldsize != inode->i_size) {
 		truncate_pagecache(inode, oldsize, outarg.attr.size);
 		invalidate_inode_pages2(inode->i_mapping);
 	}
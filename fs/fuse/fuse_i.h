@@ -22,6 +22,7 @@
 #include <linux/rbtree.h>
 #include <linux/poll.h>
 #include <linux/workqueue.h>
+#include <linux/idr.h>
 
 /** Max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
@@ -35,6 +36,11 @@
 /** Number of dentries for each connection in the control filesystem */
 #define FUSE_CTL_NUM_DENTRIES 5
 
+/** Max number of channels of a connection, see FUSE_DEV_IOC_CLONE */
+#define FUSE_MAX_CHANNELS 64
+
+#define FUSE_SUPER_MAGIC 0x65735546
+
 /** If the FUSE_DEFAULT_PERMISSIONS flag is given, the filesystem
     module will check permissions based on the file mode.  Otherwise no
     permission checking is done in the kernel */
@@ -103,6 +109,17 @@ struct fuse_inode {
 
 	/** List of writepage requestst (pending or sent) */
 	struct list_head writepages;
+
+	/** Miscellaneous bits describing inode state */
+	unsigned long state;
+};
+
+/** FUSE inode state bits */
+enum {
+	/** Entries of the directory were looked up since its last READDIR */
+	FUSE_I_ADVISE_RDPLUS,
+	/** The last listing of the directory was followed by lookups */
+	FUSE_I_RDPLUS,
 };
 
 struct fuse_conn;
@@ -138,6 +155,9 @@ struct fuse_file {
 
 	/** Wait queue head for poll */
 	wait_queue_head_t poll_wait;
+
+	/** Lower file serving read, write and mmap, or NULL */
+	struct file *passthrough_filp;
 };
 
 /** One input argument of a request */
@@ -212,7 +232,7 @@ enum fuse_req_state {
  */
 struct fuse_req {
 	/** This can be on either pending processing or io lists in
-	    fuse_conn */
+	    fuse_chan */
 	struct list_head list;
 
 	/** Entry on the interrupts list  */
@@ -227,7 +247,7 @@ struct fuse_req {
 	/*
 	 * The following bitfields are either set once before the
 	 * request is queued or setting/clearing them is protected by
-	 * fuse_conn->lock
+	 * fuse_chan->lock of the channel it is queued on
 	 */
 
 	/** True if the request has reply */
@@ -254,6 +274,11 @@ struct fuse_req {
 	/** State of the request */
 	enum fuse_req_state state;
 
+	/** The channel the request is queued on.  A pending request is
+	    moved to another channel if its device file is closed,
+	    changing this under the locks of both channels */
+	struct fuse_chan *chan;
+
 	/** The request input */
 	struct fuse_in in;
 
@@ -310,6 +335,62 @@ struct fuse_req {
 
 	/** Request is stolen from fuse_file->reserved_req */
 	struct file *stolen_file;
+
+	/** Lower file handed over in the reply to OPEN or CREATE */
+	struct file *passthrough_filp;
+};
+
+/**
+ * A request channel of a connection.
+ *
+ * Each device file attached to the connection, the one passed to mount
+ * and those attached with FUSE_DEV_IOC_CLONE, is a channel with its own
+ * queues and lock, so that the threads of a daemon reading from
+ * different device files do not contend with each other.
+ */
+struct fuse_chan {
+	/** Lock protecting the queues and the requests queued on them */
+	spinlock_t lock;
+
+	/** The connection of this channel */
+	struct fuse_conn *fc;
+
+	/** Set while requests may be queued, cleared when the device
+	    file is closed or the connection is aborted.  Changed under
+	    fuse_conn->lock too */
+	int connected;
+
+	/** Set under fuse_conn->lock once the device file is closed and
+	    the channel is fully detached, so that its slot can be reused */
+	int released;
+
+	/** Number of readers waiting for a request */
+	unsigned readers;
+
+	/** Readers of the channel are waiting on this */
+	wait_queue_head_t waitq;
+
+	/** The list of pending requests */
+	struct list_head pending;
+
+	/** The list of requests being processed */
+	struct list_head processing;
+
+	/** The list of requests under I/O */
+	struct list_head io;
+
+	/** Pending interrupts */
+	struct list_head interrupts;
+
+	/** Queue of pending forgets */
+	struct fuse_forget_link forget_list_head;
+	struct fuse_forget_link *forget_list_tail;
+
+	/** Batching of FORGET requests (positive indicates FORGET batch) */
+	int forget_batch;
+
+	/** O_ASYNC requests */
+	struct fasync_struct *fasync;
 };
 
 /**
@@ -344,17 +425,16 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
-	/** Readers of the connection are waiting on this */
-	wait_queue_head_t waitq;
+	/** The channels of the connection.  Added under the lock, and
+	    only freed with the connection; a channel whose device file
+	    was closed may be reused for a new one */
+	struct fuse_chan *chans[FUSE_MAX_CHANNELS];
 
-	/** The list of pending requests */
-	struct list_head pending;
+	/** Number of entries in chans */
+	unsigned nr_chans;
 
-	/** The list of requests being processed */
-	struct list_head processing;
-
-	/** The list of requests under I/O */
-	struct list_head io;
+	/** Next channel to queue on, if no reader is idle */
+	unsigned chan_next;
 
 	/** The next unique kernel file handle */
 	u64 khctr;
@@ -362,6 +442,9 @@ struct fuse_conn {
 	/** rbtree of fuse_files waiting for poll events indexed by ph */
 	struct rb_root polled_files;
 
+	/** Lower files registered for passthrough, by id, under lock */
+	struct idr passthrough_idr;
+
 	/** Maximum number of outstanding background requests */
 	unsigned max_background;
 
@@ -377,16 +460,6 @@ struct fuse_conn {
 	/** The list of background requests set aside for later queuing */
 	struct list_head bg_queue;
 
-	/** Pending interrupts */
-	struct list_head interrupts;
-
-	/** Queue of pending forgets */
-	struct fuse_forget_link forget_list_head;
-	struct fuse_forget_link *forget_list_tail;
-
-	/** Batching of FORGET requests (positive indicates FORGET batch) */
-	int forget_batch;
-
 	/** Flag indicating if connection is blocked.  This will be
 	    the case before the INIT reply is received, and if there
 	    are too many outstading backgrounds requests */
@@ -399,7 +472,7 @@ struct fuse_conn {
 	wait_queue_head_t reserved_req_waitq;
 
 	/** The next unique request id */
-	u64 reqctr;
+	atomic64_t reqctr;
 
 	/** Connection established, cleared on umount, connection
 	    abort and device release */
@@ -475,6 +548,19 @@ struct fuse_conn {
 	/** Don't apply umask to creation modes */
 	unsigned dont_mask:1;
 
+	/** Open may hand over a registered lower file to serve the I/O */
+	unsigned passthrough:1;
+
+	/** Keep dirty pages of buffered writes in the page cache, the
+	    kernel owns i_size and i_mtime of regular files */
+	unsigned writeback_cache:1;
+
+	/** Does the filesystem support readdirplus? */
+	unsigned do_readdirplus:1;
+
+	/** Use readdirplus only when the entries are looked up as well */
+	unsigned readdirplus_auto:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -496,9 +582,6 @@ struct fuse_conn {
 	/** number of dentries used in the above array */
 	int ctl_ndents;
 
-	/** O_ASYNC requests */
-	struct fasync_struct *fasync;
-
 	/** Key for lock owner ID scrambling */
 	u32 scramble_key[4];
 
@@ -765,6 +848,34 @@ long fuse_do_ioctl(struct file *file, unsigned int cmd, unsigned long arg,
 unsigned fuse_file_poll(struct file *file, poll_table *wait);
 int fuse_dev_release(struct inode *inode, struct file *file);
 
+/**
+ * Allocate a channel of the connection
+ */
+struct fuse_chan *fuse_chan_new(struct fuse_conn *fc);
+
+/**
+ * Wake up the readers of all channels of the connection
+ */
+void fuse_chans_wake_up(struct fuse_conn *fc);
+
 void fuse_write_update_size(struct inode *inode, loff_t pos);
 
+int fuse_write_inode(struct inode *inode, struct writeback_control *wbc);
+int fuse_flush_mtime(struct inode *inode, struct fuse_file *ff);
+int fuse_write_wait_range(struct inode *inode, loff_t start, loff_t end);
+
+/* passthrough.c */
+int fuse_passthrough_register(struct fuse_conn *fc, unsigned int fd);
+int fuse_passthrough_unregister(struct fuse_conn *fc, unsigned int id);
+void fuse_passthrough_conn_release(struct fuse_conn *fc);
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req);
+void fuse_passthrough_open(struct fuse_file *ff, struct file *file);
+void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
@@ -0,0 +1,278 @@
+/*
+  FUSE: Filesystem in Userspace
+  Passthrough of file I/O to a lower file
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+/*
+ * A filesystem that only forwards the data of its files to files on
+ * another filesystem, like the emulated storage of Android, may register
+ * a lower file with FUSE_DEV_IOC_PASSTHROUGH_OPEN and reply to OPEN and
+ * CREATE with FOPEN_PASSTHROUGH and its id in passthrough_id.  Read, write
+ * and mmap of the fuse file then go straight to the lower file, without a
+ * round trip through the daemon.  Permissions are checked by the daemon
+ * at open, and the I/O is done with the credentials the daemon opened the
+ * lower file with, which is why registering needs CAP_SYS_ADMIN.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/fsnotify.h>
+#include <linux/pagemap.h>
+
+static struct fuse_open_out *fuse_passthrough_open_out(struct fuse_req *req)
+{
+	if (req->in.h.opcode == FUSE_OPEN && req->out.numargs == 1)
+		return req->out.args[0].value;
+	if (req->in.h.opcode == FUSE_CREATE && req->out.numargs == 2)
+		return req->out.args[1].value;
+	return NULL;
+}
+
+/**
+ * fuse_passthrough_register - register a lower file of a connection
+ * @fc:		the connection, which must have accepted FUSE_PASSTHROUGH
+ * @fd:		descriptor of the lower file, in the calling daemon
+ *
+ * Called for FUSE_DEV_IOC_PASSTHROUGH_OPEN.  The registration holds a
+ * reference to the file until it is dropped by id or the connection goes
+ * away.  Returns the id, which is never 0, or an error.
+ */
+int fuse_passthrough_register(struct fuse_conn *fc, unsigned int fd)
+{
+	struct file *lower;
+	int id, err;
+
+	if (!fc->passthrough)
+		return -EINVAL;
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	lower = fget(fd);
+	if (!lower)
+		return -EBADF;
+
+	/* no stacking of fuse on fuse, which could recurse without end */
+	err = -EINVAL;
+	if (!S_ISREG(lower->f_path.dentry->d_inode->i_mode) ||
+	    lower->f_path.dentry->d_sb->s_magic == FUSE_SUPER_MAGIC ||
+	    !lower->f_op || !lower->f_op->aio_read || !lower->f_op->aio_write)
+		goto out_fput;
+
+	do {
+		err = -ENOMEM;
+		if (!idr_pre_get(&fc->passthrough_idr, GFP_KERNEL))
+			goto out_fput;
+		spin_lock(&fc->lock);
+		err = idr_get_new_above(&fc->passthrough_idr, lower, 1, &id);
+		spin_unlock(&fc->lock);
+	} while (err == -EAGAIN);
+	if (err)
+		goto out_fput;
+
+	return id;
+
+ out_fput:
+	fput(lower);
+	return err;
+}
+
+/*
+ * Called for FUSE_DEV_IOC_PASSTHROUGH_CLOSE.  Files already opened with
+ * the lower file keep their own reference to it.
+ */
+int fuse_passthrough_unregister(struct fuse_conn *fc, unsigned int id)
+{
+	struct file *lower;
+
+	if (!id || id > INT_MAX)
+		return -ENOENT;
+
+	spin_lock(&fc->lock);
+	lower = idr_find(&fc->passthrough_idr, id);
+	if (lower)
+		idr_remove(&fc->passthrough_idr, id);
+	spin_unlock(&fc->lock);
+
+	if (!lower)
+		return -ENOENT;
+
+	fput(lower);
+	return 0;
+}
+
+static int fuse_passthrough_put(int id, void *p, void *data)
+{
+	fput(p);
+	return 0;
+}
+
+/*
+ * Called when the last reference to the connection is gone
+ */
+void fuse_passthrough_conn_release(struct fuse_conn *fc)
+{
+	idr_for_each(&fc->passthrough_idr, fuse_passthrough_put, NULL);
+	idr_remove_all(&fc->passthrough_idr);
+	idr_destroy(&fc->passthrough_idr);
+}
+
+/*
+ * Called for the reply to OPEN or CREATE while it is written to the
+ * device.  The lower file is looked up among those the daemon registered,
+ * nothing is taken from the file table of the writer; an unknown id opens
+ * the file without passthrough.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg = fuse_passthrough_open_out(req);
+	struct file *lower;
+	u32 id;
+
+	if (!outarg || req->out.h.error ||
+	    !(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	outarg->open_flags &= ~FOPEN_PASSTHROUGH;
+
+	id = outarg->passthrough_id;
+	if (!id || id > INT_MAX)
+		return;
+
+	spin_lock(&fc->lock);
+	lower = idr_find(&fc->passthrough_idr, id);
+	if (lower)
+		get_file(lower);
+	spin_unlock(&fc->lock);
+
+	if (!lower)
+		return;
+
+	outarg->open_flags |= FOPEN_PASSTHROUGH;
+	req->passthrough_filp = lower;
+}
+
+/*
+ * Called once the fuse file is open: the lower file has to allow all the
+ * I/O the fuse file allows, otherwise the daemon serves it.
+ */
+void fuse_passthrough_open(struct fuse_file *ff, struct file *file)
+{
+	struct file *lower = ff->passthrough_filp;
+
+	if (!lower)
+		return;
+
+	if (((file->f_mode & FMODE_READ) && !(lower->f_mode & FMODE_READ)) ||
+	    ((file->f_mode & FMODE_WRITE) && !(lower->f_mode & FMODE_WRITE)) ||
+	    ((file->f_flags ^ lower->f_flags) & O_APPEND) ||
+	    (ff->open_flags & FOPEN_DIRECT_IO))
+		fuse_passthrough_release(ff);
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough_filp) {
+		fput(ff->passthrough_filp);
+		ff->passthrough_filp = NULL;
+	}
+}
+
+static ssize_t fuse_passthrough_rw(struct kiocb *iocb,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos, int rw)
+{
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+	struct file *lower = ff->passthrough_filp;
+	struct inode *inode = iocb->ki_filp->f_mapping->host;
+	size_t count = iov_length(iov, nr_segs);
+	const struct cred *old_cred;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	/* other opens may have cached writes in the range */
+	if (ff->fc->writeback_cache && count) {
+		ret = fuse_write_wait_range(inode, pos, pos + count - 1);
+		if (ret)
+			return ret;
+	}
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = pos;
+	kiocb.ki_left = count;
+	kiocb.ki_nbytes = count;
+
+	old_cred = override_creds(lower->f_cred);
+	if (rw == WRITE)
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, kiocb.ki_pos);
+	else
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, kiocb.ki_pos);
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+	revert_creds(old_cred);
+
+	if (ret > 0) {
+		iocb->ki_pos = kiocb.ki_pos;
+		if (rw == WRITE)
+			fsnotify_modify(lower);
+		else
+			fsnotify_access(lower);
+	}
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, READ);
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	struct inode *inode = iocb->ki_filp->f_mapping->host;
+	ssize_t ret;
+
+	ret = fuse_passthrough_rw(iocb, iov, nr_segs, pos, WRITE);
+	if (ret > 0) {
+		/* size and times come from the daemon again */
+		fuse_write_update_size(inode, iocb->ki_pos);
+		fuse_invalidate_attr(inode);
+
+		/* pages cached by other opens of the file are stale now */
+		if (inode->i_mapping->nrpages)
+			invalidate_inode_pages2_range(inode->i_mapping,
+				(iocb->ki_pos - ret) >> PAGE_CACHE_SHIFT,
+				(iocb->ki_pos - 1) >> PAGE_CACHE_SHIFT);
+	}
+	return ret;
+}
+
+/*
+ * The mapping is set up on the lower file, so that page faults and
+ * writeback of dirty pages go to the lower filesystem directly.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	int ret;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	get_file(lower);
+	ret = lower->f_op->mmap(lower, vma);
+	if (ret) {
+		fput(lower);
+		return ret;
+	}
+
+	vma->vm_file = lower;
+	fput(file);
+	return 0;
+}
@@ -739,12 +739,14 @@ static void yaffs_free_tnode(struct yaffs_dev *dev, struct yaffs_tnode *tn)
 {
 	yaffs_free_raw_tnode(dev, tn);
 	dev->n_tnodes--;
+	dev->tnode_gen++;
 	dev->checkpoint_blocks_required = 0;	/* force recalculation */
 }
 
 static void yaffs_deinit_tnodes_and_objs(struct yaffs_dev *dev)
 {
 	yaffs_deinit_raw_tnodes_and_objs(dev);
+	dev->tnode_gen++;
 	dev->n_obj = 0;
 	dev->n_tnodes = 0;
 }
@@ -816,18 +818,23 @@ u32 yaffs_get_group_base(struct yaffs_dev *dev, struct yaffs_tnode *tn,
  * in the tree. 0 means only the level 0 tnode is in the tree.
  */
 
-/* FindLevel0Tnode finds the level 0 tnode, if one exists. */
+/* FindLevel0Tnode finds the level 0 tnode, if one exists.
+ *
+ * Reads of a file mostly go through the chunks in order, so the level 0
+ * tnode found last is remembered in the file structure and used again
+ * for the following chunks without walking down the tree. It stays valid
+ * until a tnode is freed, since the tree never moves a level 0 tnode.
+ */
 struct yaffs_tnode *yaffs_find_tnode_0(struct yaffs_dev *dev,
 				       struct yaffs_file_var *file_struct,
 				       u32 chunk_id)
 {
 	struct yaffs_tnode *tn = file_struct->top;
 	u32 i;
+	u32 base;
 	int required_depth;
 	int level = file_struct->top_level;
 
-	dev = dev;
-
 	/* Check sane level and chunk Id */
 	if (level < 0 || level > YAFFS_TNODES_MAX_LEVEL)
 		return NULL;
@@ -835,9 +842,21 @@ struct yaffs_tnode *yaffs_find_tnode_0(struct yaffs_dev *dev,
 	if (chunk_id > YAFFS_MAX_CHUNK_ID)
 		return NULL;
 
+	base = chunk_id >> YAFFS_TNODES_LEVEL0_BITS;
+
+	if (!dev->param.disable_tnode_cache) {
+		if (file_struct->cached_tn &&
+		    file_struct->cached_tn_base == base &&
+		    file_struct->cached_tn_gen == dev->tnode_gen) {
+			dev->tnode_cache_hits++;
+			return file_struct->cached_tn;
+		}
+		dev->tnode_cache_misses++;
+	}
+
 	/* First check we're tall enough (ie enough top_level) */
 
-	i = chunk_id >> YAFFS_TNODES_LEVEL0_BITS;
+	i = base;
 	required_depth = 0;
 	while (i) {
 		i >>= YAFFS_TNODES_INTERNAL_BITS;
@@ -857,6 +876,12 @@ struct yaffs_tnode *yaffs_find_tnode_0(struct yaffs_dev *dev,
 		level--;
 	}
 
+	if (tn && !dev->param.disable_tnode_cache) {
+		file_struct->cached_tn = tn;
+		file_struct->cached_tn_base = base;
+		file_struct->cached_tn_gen = dev->tnode_gen;
+	}
+
 	return tn;
 }
 
@@ -3009,6 +3034,63 @@ static int yaffs_rd_data_obj(struct yaffs_obj *in, int inode_chunk, u8 * buffer)
 
 }
 
+/* Number of whole chunks from inode_chunk on that can be read straight into
+ * the caller's buffer as one run: none of them is in the short op cache and
+ * all of them map through the same level 0 tnode.
+ */
+static int yaffs_rd_run_length(struct yaffs_obj *in, int inode_chunk,
+			       int n_bytes)
+{
+	struct yaffs_dev *dev = in->my_dev;
+	int max_run;
+	int n_run = 1;
+
+	if (dev->param.disable_tnode_cache)
+		return 1;
+
+	max_run = YAFFS_NTNODES_LEVEL0 -
+	    (inode_chunk & YAFFS_TNODES_LEVEL0_MASK);
+
+	while (n_run < max_run &&
+	       n_bytes >= (n_run + 1) * dev->data_bytes_per_chunk &&
+	       !yaffs_find_chunk_cache(in, inode_chunk + n_run))
+		n_run++;
+
+	return n_run;
+}
+
+/* Reads a run of whole chunks, as counted by yaffs_rd_run_length(), with a
+ * single look up of their level 0 tnode.
+ */
+static void yaffs_rd_data_obj_run(struct yaffs_obj *in, int inode_chunk,
+				  int n_chunks, u8 * buffer)
+{
+	struct yaffs_dev *dev = in->my_dev;
+	struct yaffs_ext_tags tags;
+	struct yaffs_tnode *tn;
+	int nand_chunk;
+	int i;
+
+	tn = yaffs_find_tnode_0(dev, &in->variant.file_variant, inode_chunk);
+
+	for (i = 0; i < n_chunks; i++) {
+		nand_chunk = -1;
+		if (tn)
+			nand_chunk = yaffs_find_chunk_in_group(dev,
+					yaffs_get_group_base(dev, tn,
+							     inode_chunk + i),
+					&tags, in->obj_id, inode_chunk + i);
+
+		if (nand_chunk >= 0)
+			yaffs_rd_chunk_tags_nand(dev, nand_chunk, buffer, NULL);
+		else
+			/* get sane (zero) data if you read a hole */
+			memset(buffer, 0, dev->data_bytes_per_chunk);
+
+		buffer += dev->data_bytes_per_chunk;
+	}
+}
+
 void yaffs_chunk_del(struct yaffs_dev *dev, int chunk_id, int mark_flash,
 		     int lyn)
 {
@@ -3612,8 +3694,11 @@ int yaffs_file_rd(struct yaffs_obj *in, u8 * buffer, loff_t offset, int n_bytes)
 
 		} else {
 
-			/* A full chunk. Read directly into the supplied buffer. */
-			yaffs_rd_data_obj(in, chunk, buffer);
+			/* Full chunks. Read directly into the supplied buffer. */
+			int n_run = yaffs_rd_run_length(in, chunk, n);
+
+			yaffs_rd_data_obj_run(in, chunk, n_run, buffer);
+			n_copy = n_run * dev->data_bytes_per_chunk;
 
 		}
 
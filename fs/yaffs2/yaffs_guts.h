@@ -352,6 +352,11 @@ struct yaffs_file_var {
 	u32 shrink_size;
 	int top_level;
 	struct yaffs_tnode *top;
+
+	/* Level 0 tnode found by the last lookup, see yaffs_find_tnode_0() */
+	struct yaffs_tnode *cached_tn;
+	u32 cached_tn_base;	/* chunk_id >> YAFFS_TNODES_LEVEL0_BITS */
+	u32 cached_tn_gen;	/* dev->tnode_gen when it was cached */
 };
 
 struct yaffs_dir_var {
@@ -565,6 +570,7 @@ struct yaffs_param {
 	/* Debug control flags. Don't use unless you know what you're doing */
 	int use_header_file_size;	/* Flag to determine if we should use file sizes from the header */
 	int disable_lazy_load;	/* Disable lazy loading on this device */
+	int disable_tnode_cache;	/* Walk the tnode tree for every chunk */
 	int wide_tnodes_disabled;	/* Set to disable wide tnodes */
 	int disable_soft_del;	/* yaffs 1 only: Set to disable the use of softdeletion. */
 
@@ -713,6 +719,11 @@ struct yaffs_dev {
 	/* Dirty directory handling */
 	struct list_head dirty_dirs;	/* List of dirty directories */
 
+	/* Bumped whenever a tnode is freed, which invalidates the cached
+	 * level 0 tnodes of all the files.
+	 */
+	u32 tnode_gen;
+
 	/* Statistcs */
 	u32 n_page_writes;
 	u32 n_page_reads;
@@ -734,6 +745,8 @@ struct yaffs_dev {
 	u32 n_unmarked_deletions;
 	u32 refresh_count;
 	u32 cache_hits;
+	u32 tnode_cache_hits;
+	u32 tnode_cache_misses;
 
 };
 
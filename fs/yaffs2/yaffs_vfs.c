@@ -1762,6 +1762,7 @@ struct yaffs_options {
 	int tags_ecc_overridden;
 	int lazy_loading_enabled;
 	int lazy_loading_overridden;
+	int no_tnode_cache;
 	int empty_lost_and_found;
 	int empty_lost_and_found_overridden;
 };
@@ -1813,6 +1814,8 @@ static int yaffs_parse_options(struct yaffs_options *options,
 			options->empty_lost_and_found_overridden = 1;
 		} else if (!strcmp(cur_opt, "no-cache")) {
 			options->no_cache = 1;
+		} else if (!strcmp(cur_opt, "no-tnode-cache")) {
+			options->no_tnode_cache = 1;
 		} else if (!strcmp(cur_opt, "no-checkpoint-read")) {
 			options->skip_checkpoint_read = 1;
 		} else if (!strcmp(cur_opt, "no-checkpoint-write")) {
@@ -2227,6 +2230,8 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 	if (options.lazy_loading_overridden)
 		param->disable_lazy_load = !options.lazy_loading_enabled;
 
+	param->disable_tnode_cache = options.no_tnode_cache;
+
 #ifdef CONFIG_YAFFS_DISABLE_TAGS_ECC
 	param->no_tags_ecc = 1;
 #endif
@@ -2435,6 +2440,8 @@ static char *yaffs_dump_dev_part0(char *buf, struct yaffs_dev *dev)
 			param->empty_lost_n_found);
 	buf += sprintf(buf, "disable_lazy_load..... %d\n",
 			param->disable_lazy_load);
+	buf += sprintf(buf, "disable_tnode_cache... %d\n",
+			param->disable_tnode_cache);
 	buf += sprintf(buf, "refresh_period........ %d\n",
 			param->refresh_period);
 	buf += sprintf(buf, "n_caches.............. %d\n", param->n_caches);
@@ -2486,6 +2493,11 @@ static char *yaffs_dump_dev_part1(char *buf, struct yaffs_dev *dev)
 	    sprintf(buf, "n_tags_ecc_unfixed.... %u\n",
 		    dev->n_tags_ecc_unfixed);
 	buf += sprintf(buf, "cache_hits............ %u\n", dev->cache_hits);
+	buf +=
+	    sprintf(buf, "tnode_cache_hits...... %u\n", dev->tnode_cache_hits);
+	buf +=
+	    sprintf(buf, "tnode_cache_misses.... %u\n",
+		    dev->tnode_cache_misses);
 	buf +=
 	    sprintf(buf, "n_deleted_files....... %u\n", dev->n_deleted_files);
 	buf +=
@@ -40,6 +40,10 @@ typedef int (congested_fn)(void *, int);
 enum bdi_stat_item {
 	BDI_RECLAIMABLE,
 	BDI_WRITEBACK,
+	BDI_RA_PAGES,		/* pages read ahead */
+	BDI_RA_HIT,		/* of them, pages used */
+	BDI_RA_WASTED,		/* of them, pages dropped unused */
+	BDI_RA_MISS,		/* reads that missed the page cache */
 	NR_BDI_STAT_ITEMS
 };
 
@@ -124,6 +128,16 @@ static inline void __add_bdi_stat(struct backing_dev_info *bdi,
 	__percpu_counter_add(&bdi->bdi_stat[item], amount, BDI_STAT_BATCH);
 }
 
+static inline void add_bdi_stat(struct backing_dev_info *bdi,
+		enum bdi_stat_item item, s64 amount)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	__add_bdi_stat(bdi, item, amount);
+	local_irq_restore(flags);
+}
+
 static inline void __inc_bdi_stat(struct backing_dev_info *bdi,
 		enum bdi_stat_item item)
 {
@@ -911,6 +911,17 @@ struct fown_struct {
 	int signum;		/* posix.1b rt signal to be delivered on IO */
 };
 
+/*
+ * The readahead window of a sequential stream
+ */
+struct file_ra_stream {
+	pgoff_t start;
+	unsigned int size;
+	unsigned int async_size;
+};
+
+#define RA_STREAMS	3		/* streams kept besides the current */
+
 /*
  * Track a single file's readahead state
  */
@@ -923,6 +934,16 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	/* windows of interleaved streams, most recently used first */
+	struct file_ra_stream streams[RA_STREAMS];
+
+	/* strided reads, of stride_len pages every stride pages */
+	pgoff_t stride_prev;		/* where the last read started */
+	pgoff_t stride_ahead;		/* first chunk not read ahead yet */
+	unsigned int stride;
+	unsigned int stride_len;
+	unsigned int stride_count;	/* reads seen at this stride */
 };
 
 /*
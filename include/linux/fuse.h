@@ -47,12 +47,22 @@
  *  - FUSE_IOCTL_UNRESTRICTED shall now return with array of 'struct
  *    fuse_ioctl_iovec' instead of ambiguous 'struct iovec'
  *  - add FUSE_IOCTL_32BIT flag
+ *
+ * Extensions negotiated by INIT flags only, without a minor version:
+ *  - add FUSE_PASSTHROUGH init flag, FOPEN_PASSTHROUGH open flag,
+ *    passthrough_id in fuse_open_out, and FUSE_DEV_IOC_PASSTHROUGH_OPEN
+ *    and FUSE_DEV_IOC_PASSTHROUGH_CLOSE ioctls on the device
+ *  - add FUSE_WRITEBACK_CACHE init flag
+ *  - add FUSE_DEV_IOC_CLONE ioctl on the device
+ *  - add FUSE_READDIRPLUS, FUSE_DO_READDIRPLUS and FUSE_READDIRPLUS_AUTO
+ *    init flags, and struct fuse_direntplus
  */
 
 #ifndef _LINUX_FUSE_H
 #define _LINUX_FUSE_H
 
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 /*
  * Version negotiation:
@@ -145,16 +155,22 @@ struct fuse_file_lock {
  * FOPEN_DIRECT_IO: bypass page cache for this open file
  * FOPEN_KEEP_CACHE: don't invalidate the data cache on open
  * FOPEN_NONSEEKABLE: the file is not seekable
+ * FOPEN_PASSTHROUGH: read, write and mmap go to the file passthrough_id
  */
 #define FOPEN_DIRECT_IO		(1 << 0)
 #define FOPEN_KEEP_CACHE	(1 << 1)
 #define FOPEN_NONSEEKABLE	(1 << 2)
+#define FOPEN_PASSTHROUGH	(1 << 31)
 
 /**
  * INIT request/reply flags
  *
  * FUSE_EXPORT_SUPPORT: filesystem handles lookups of "." and ".."
  * FUSE_DONT_MASK: don't apply umask to file mode on create operations
+ * FUSE_DO_READDIRPLUS: do READDIRPLUS (READDIR+LOOKUP in one)
+ * FUSE_READDIRPLUS_AUTO: adaptive readdirplus
+ * FUSE_WRITEBACK_CACHE: use writeback cache for buffered writes
+ * FUSE_PASSTHROUGH: open may hand over a registered file to serve the I/O
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -163,6 +179,10 @@ struct fuse_file_lock {
 #define FUSE_EXPORT_SUPPORT	(1 << 4)
 #define FUSE_BIG_WRITES		(1 << 5)
 #define FUSE_DONT_MASK		(1 << 6)
+#define FUSE_DO_READDIRPLUS	(1 << 13)
+#define FUSE_READDIRPLUS_AUTO	(1 << 14)
+#define FUSE_WRITEBACK_CACHE	(1 << 16)
+#define FUSE_PASSTHROUGH	(1 << 31)
 
 /**
  * CUSE INIT request/reply flags
@@ -265,6 +285,7 @@ enum fuse_opcode {
 	FUSE_POLL          = 40,
 	FUSE_NOTIFY_REPLY  = 41,
 	FUSE_BATCH_FORGET  = 42,
+	FUSE_READDIRPLUS   = 44,
 
 	/* CUSE specific operations */
 	CUSE_INIT          = 4096,
@@ -380,7 +401,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	__u64	fh;
 	__u32	open_flags;
-	__u32	padding;
+	__u32	passthrough_id;
 };
 
 struct fuse_release_in {
@@ -587,6 +608,22 @@ struct fuse_dirent {
 #define FUSE_DIRENT_SIZE(d) \
 	FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + (d)->namelen)
 
+/*
+ * A READDIRPLUS entry is a READDIR entry with the reply to a LOOKUP of
+ * its name in front.  Each entry with a nonzero nodeid counts as a
+ * lookup, to be balanced by FORGET.  An entry_out of zeroes, as for "."
+ * and "..", gives only the name.
+ */
+struct fuse_direntplus {
+	struct fuse_entry_out entry_out;
+	struct fuse_dirent dirent;
+};
+
+#define FUSE_NAME_OFFSET_DIRENTPLUS \
+	offsetof(struct fuse_direntplus, dirent.name)
+#define FUSE_DIRENTPLUS_SIZE(d) \
+	FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET_DIRENTPLUS + (d)->dirent.namelen)
+
 struct fuse_notify_inval_inode_out {
 	__u64	ino;
 	__s64	off;
@@ -624,4 +661,21 @@ struct fuse_notify_retrieve_in {
 	__u64	dummy4;
 };
 
+/*
+ * Attach a newly opened /dev/fuse descriptor to the connection of the
+ * descriptor passed as argument.  Each descriptor is a separate channel
+ * with its own request queue: requests are spread over the channels,
+ * and the reply to a request is written to the channel it was read from.
+ *
+ * FUSE_DEV_IOC_PASSTHROUGH_OPEN registers the file descriptor passed as
+ * argument as a lower file of the connection and returns its id, for
+ * passthrough_id of open replies; FUSE_DEV_IOC_PASSTHROUGH_CLOSE drops
+ * the id passed as argument.  Both need FUSE_PASSTHROUGH accepted in INIT
+ * and CAP_SYS_ADMIN.
+ */
+#define FUSE_DEV_IOC_MAGIC		229
+#define FUSE_DEV_IOC_CLONE		_IOR(FUSE_DEV_IOC_MAGIC, 0, __u32)
+#define FUSE_DEV_IOC_PASSTHROUGH_OPEN	_IOW(FUSE_DEV_IOC_MAGIC, 1, __u32)
+#define FUSE_DEV_IOC_PASSTHROUGH_CLOSE	_IOW(FUSE_DEV_IOC_MAGIC, 2, __u32)
+
 #endif /* _LINUX_FUSE_H */
@@ -10,6 +10,7 @@
 #ifndef LINUX_MMC_CARD_H
 #define LINUX_MMC_CARD_H
 
+#include <linux/workqueue.h>
 #include <linux/mmc/core.h>
 #include <linux/mod_devicetable.h>
 
@@ -78,11 +79,33 @@ struct mmc_ext_csd {
 	u8			raw_sec_feature_support;/* 231 */
 	u8			raw_trim_mult;		/* 232 */
 	u8			raw_sectors[4];		/* 212 - 4 bytes */
+	u8			max_packed_writes;	/* 500 */
+	u8			max_packed_reads;	/* 501 */
+	bool			packed_event_en;	/* packed failure event */
+	bool			hpi;			/* HPI supported */
+	bool			hpi_en;			/* HPI enabled */
+	unsigned int		hpi_cmd;		/* CMD12 or CMD13 */
+	unsigned int		out_of_int_time;	/* In milliseconds */
+	bool			bkops;			/* BKOPS supported */
+	bool			bkops_en;		/* BKOPS enabled */
+	u8			raw_bkops_status;	/* 246 */
+	unsigned int		cache_size;		/* Units: KB */
+	bool			cache_ctrl;		/* cache enabled */
+	unsigned int		generic_cmd6_time;	/* In milliseconds */
 
 	unsigned int            feature_support;
 #define MMC_DISCARD_FEATURE	BIT(0)                  /* CMD38 feature */
 };
 
+/*
+ * Background operations started by the core, shown in debugfs.
+ */
+struct mmc_bkops_stats {
+	unsigned int		urgent;		/* on the urgent BKOPS event */
+	unsigned int		idle;		/* while the card was idle */
+	unsigned int		hpi;		/* interrupted by new requests */
+};
+
 struct sd_scr {
 	unsigned char		sda_vsn;
 	unsigned char		sda_spec3;
@@ -182,6 +205,8 @@ struct mmc_card {
 #define MMC_STATE_ULTRAHIGHSPEED (1<<5)		/* card is in ultra high speed mode */
 #define MMC_CARD_SDXC		(1<<6)		/* card is SDXC */
 #define MMC_STATE_INSERTED	(1<<7)		/* card present in the slot */
+#define MMC_STATE_DOING_BKOPS	(1<<8)		/* card is doing BKOPS */
+#define MMC_STATE_NEED_BKOPS	(1<<9)		/* card asked for urgent BKOPS */
 	unsigned int		quirks; 	/* card quirks */
 #define MMC_QUIRK_LENIENT_FN0	(1<<0)		/* allow SDIO FN0 writes outside of the VS CCCR range */
 #define MMC_QUIRK_BLKSZ_FOR_BYTE_MODE (1<<1)	/* use func->cur_blksize */
@@ -222,6 +247,9 @@ struct mmc_card {
 
 	unsigned int		sd_bus_speed;	/* Bus Speed Mode set for the card */
 
+	struct delayed_work	bkops_work;	/* idle time BKOPS */
+	struct mmc_bkops_stats	bkops_stats;
+
 	struct dentry		*debugfs_root;
 };
 
@@ -322,6 +350,8 @@ static inline void __maybe_unused remove_quirk(struct mmc_card *card, int data)
 #define mmc_card_ddr_mode(c)	((c)->state & MMC_STATE_HIGHSPEED_DDR)
 #define mmc_sd_card_uhs(c) ((c)->state & MMC_STATE_ULTRAHIGHSPEED)
 #define mmc_card_ext_capacity(c) ((c)->state & MMC_CARD_SDXC)
+#define mmc_card_doing_bkops(c)	((c)->state & MMC_STATE_DOING_BKOPS)
+#define mmc_card_need_bkops(c)	((c)->state & MMC_STATE_NEED_BKOPS)
 
 #define mmc_card_set_present(c)	((c)->state |= MMC_STATE_PRESENT)
 #define mmc_card_set_inserted(c) ((c)->state |= MMC_STATE_INSERTED)
@@ -331,6 +361,10 @@ static inline void __maybe_unused remove_quirk(struct mmc_card *card, int data)
 #define mmc_card_set_ddr_mode(c) ((c)->state |= MMC_STATE_HIGHSPEED_DDR)
 #define mmc_sd_card_set_uhs(c) ((c)->state |= MMC_STATE_ULTRAHIGHSPEED)
 #define mmc_card_set_ext_capacity(c) ((c)->state |= MMC_CARD_SDXC)
+#define mmc_card_set_doing_bkops(c) ((c)->state |= MMC_STATE_DOING_BKOPS)
+#define mmc_card_clr_doing_bkops(c) ((c)->state &= ~MMC_STATE_DOING_BKOPS)
+#define mmc_card_set_need_bkops(c) ((c)->state |= MMC_STATE_NEED_BKOPS)
+#define mmc_card_clr_need_bkops(c) ((c)->state &= ~MMC_STATE_NEED_BKOPS)
 
 /*
  * Quirk add/remove for MMC products.
@@ -39,6 +39,7 @@
 #define SCHED_BATCH		3
 /* SCHED_ISO: reserved but not implemented yet */
 #define SCHED_IDLE		5
+#define SCHED_DEADLINE		6
 /* Can be ORed in to make sure the process is reverted back to SCHED_NORMAL on fork */
 #define SCHED_RESET_ON_FORK     0x40000000
 
@@ -101,6 +102,37 @@ struct fs_struct;
 struct perf_event_context;
 struct blk_plug;
 
+/*
+ * Extended scheduling parameters, for sched_setattr() and sched_getattr().
+ *
+ * @size is the size of the structure known to user space, so that it can
+ * grow. sched_runtime, sched_deadline and sched_period are in ns and are
+ * only used by SCHED_DEADLINE: each sched_period, the task is guaranteed
+ * sched_runtime of cpu time before sched_deadline from the start of the
+ * period. A zero sched_period means sched_deadline.
+ */
+#define SCHED_ATTR_SIZE_VER0	48	/* sizeof first published struct */
+
+struct sched_attr {
+	u32 size;
+
+	u32 sched_policy;
+	u64 sched_flags;
+
+	/* SCHED_NORMAL, SCHED_BATCH */
+	s32 sched_nice;
+
+	/* SCHED_FIFO, SCHED_RR */
+	u32 sched_priority;
+
+	/* SCHED_DEADLINE */
+	u64 sched_runtime;
+	u64 sched_deadline;
+	u64 sched_period;
+};
+
+#define SCHED_FLAG_RESET_ON_FORK	0x01
+
 /*
  * List of flags we want to share for kernel threads,
  * if only because they are not used by them anyway.
@@ -1122,6 +1154,7 @@ struct sched_class {
 	void (*switched_to) (struct rq *this_rq, struct task_struct *task);
 	void (*prio_changed) (struct rq *this_rq, struct task_struct *task,
 			     int oldprio);
+	void (*task_dead) (struct task_struct *p);
 
 	unsigned int (*get_rr_interval) (struct rq *rq,
 					 struct task_struct *task);
@@ -1168,6 +1201,9 @@ struct sched_statistics {
 	u64			nr_wakeups_affine_attempts;
 	u64			nr_wakeups_passive;
 	u64			nr_wakeups_idle;
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+	u64			nr_wakeups_boosted;
+#endif
 };
 #endif
 
@@ -1213,6 +1249,38 @@ struct sched_rt_entity {
 #endif
 };
 
+struct sched_dl_entity {
+	struct rb_node	rb_node;
+
+	/*
+	 * Parameters set by sched_setattr(), in ns, and the bandwidth
+	 * dl_runtime / dl_period in 1 << 20 units, which admission control
+	 * reserved on dl_bw_cpu.
+	 */
+	u64 dl_runtime;
+	u64 dl_deadline;
+	u64 dl_period;
+	u64 dl_bw;
+	int dl_bw_cpu;
+
+	/*
+	 * Current instance: remaining runtime and absolute deadline, in
+	 * rq->clock time.
+	 */
+	s64 runtime;
+	u64 deadline;
+
+	/*
+	 * @dl_new: no instance was started since the parameters were set.
+	 * @dl_throttled: the runtime is exhausted; the entity is off the
+	 *		  dl_rq until dl_timer replenishes it.
+	 * @dl_yielded: the task called sched_yield(), ending the instance.
+	 */
+	int dl_new, dl_throttled, dl_yielded;
+
+	struct hrtimer dl_timer;
+};
+
 struct rcu_node;
 
 enum perf_event_task_context {
@@ -1240,6 +1308,7 @@ struct task_struct {
 	const struct sched_class *sched_class;
 	struct sched_entity se;
 	struct sched_rt_entity rt;
+	struct sched_dl_entity dl;
 #ifdef CONFIG_CGROUP_SCHED
 	struct task_group *sched_task_group;
 #endif
@@ -1587,6 +1656,7 @@ struct task_struct {
  * priority is 0..MAX_RT_PRIO-1, and SCHED_NORMAL/SCHED_BATCH
  * tasks are in the range MAX_RT_PRIO..MAX_PRIO-1. Priority
  * values are inverted: lower p->prio value means higher priority.
+ * SCHED_DEADLINE tasks are above all of them, at MAX_DL_PRIO-1.
  *
  * The MAX_USER_RT_PRIO value allows the actual maximum
  * RT priority to be separate from the value exported to
@@ -1595,12 +1665,26 @@ struct task_struct {
  * MAX_RT_PRIO must not be smaller than MAX_USER_RT_PRIO.
  */
 
+#define MAX_DL_PRIO		0
+
 #define MAX_USER_RT_PRIO	100
 #define MAX_RT_PRIO		MAX_USER_RT_PRIO
 
 #define MAX_PRIO		(MAX_RT_PRIO + 40)
 #define DEFAULT_PRIO		(MAX_RT_PRIO + 20)
 
+static inline int dl_prio(int prio)
+{
+	if (unlikely(prio < MAX_DL_PRIO))
+		return 1;
+	return 0;
+}
+
+static inline int dl_task(struct task_struct *p)
+{
+	return dl_prio(p->prio);
+}
+
 static inline int rt_prio(int prio)
 {
 	if (unlikely(prio < MAX_RT_PRIO))
@@ -2060,6 +2144,8 @@ extern int sched_setscheduler(struct task_struct *, int,
 			      const struct sched_param *);
 extern int sched_setscheduler_nocheck(struct task_struct *, int,
 				      const struct sched_param *);
+extern int sched_setattr(struct task_struct *,
+			 const struct sched_attr *);
 extern struct task_struct *idle_task(int cpu);
 extern struct task_struct *curr_task(int cpu);
 extern void set_curr_task(int cpu, struct task_struct *p);
@@ -2660,6 +2746,15 @@ extern int sched_rt_can_attach(struct task_group *tg, struct task_struct *tsk);
 #endif
 #endif /* CONFIG_CGROUP_SCHED */
 
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+extern u64 sched_boost_runtime(int cpu);
+#else
+static inline u64 sched_boost_runtime(int cpu)
+{
+	return 0;
+}
+#endif
+
 extern int task_can_switch_user(struct user_struct *up,
 					struct task_struct *tsk);
 
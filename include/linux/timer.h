@@ -217,6 +217,20 @@ extern void set_timer_slack(struct timer_list *time, int slack_hz);
  */
 #define NEXT_TIMER_MAX_DELTA	((1UL << 30) - 1)
 
+#if defined(CONFIG_NO_HZ) && defined(CONFIG_SMP)
+/*
+ * CPU which collects deferrable timers and unbound delayed work so
+ * that the other cpus can stay in deep idle (-1 disables this):
+ */
+extern int sysctl_timer_housekeeping_cpu;
+extern int timer_housekeeping_target(int cpu);
+#else
+static inline int timer_housekeeping_target(int cpu)
+{
+	return cpu;
+}
+#endif
+
 /*
  * Return when the next timer-wheel timeout occurs (in absolute jiffies),
  * locks the timer base and does the comparison against the given
@@ -241,6 +255,20 @@ extern void run_local_timers(void);
 struct hrtimer;
 extern enum hrtimer_restart it_real_fn(struct hrtimer *);
 
+#ifdef CONFIG_TIMER_WAKEUP_STATS
+extern void timer_wakeup_idle_enter(void);
+extern void timer_wakeup_idle_exit(void);
+extern void timer_wakeup_account(void *fn);
+extern void timer_wakeup_account_hrtimer(struct hrtimer *timer);
+extern void timer_wakeup_coalesced(void);
+#else
+static inline void timer_wakeup_idle_enter(void) { }
+static inline void timer_wakeup_idle_exit(void) { }
+static inline void timer_wakeup_account(void *fn) { }
+static inline void timer_wakeup_account_hrtimer(struct hrtimer *timer) { }
+static inline void timer_wakeup_coalesced(void) { }
+#endif
+
 unsigned long __round_jiffies(unsigned long j, int cpu);
 unsigned long __round_jiffies_relative(unsigned long j, int cpu);
 unsigned long round_jiffies(unsigned long j);
@@ -1197,6 +1197,7 @@ static void __run_hrtimer(struct hrtimer *timer, ktime_t *now)
 	 * the timer base.
 	 */
 	raw_spin_unlock(&cpu_base->lock);
+	timer_wakeup_account_hrtimer(timer);
 	trace_hrtimer_expire_entry(timer, now);
 	restart = fn(timer);
 	trace_hrtimer_expire_exit(timer);
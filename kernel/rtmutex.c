@@ -98,11 +98,22 @@ static inline void mark_rt_mutex_waiters(struct rt_mutex *lock)
  */
 int rt_mutex_getprio(struct task_struct *task)
 {
+	int prio;
+
 	if (likely(!task_has_pi_waiters(task)))
 		return task->normal_prio;
 
-	return min(task_top_pi_waiter(task)->pi_list_entry.prio,
+	prio = min(task_top_pi_waiter(task)->pi_list_entry.prio,
 		   task->normal_prio);
+
+	/*
+	 * Only SCHED_DEADLINE tasks have deadline parameters to run with,
+	 * a deadline waiter boosts other owners to the top RT priority.
+	 */
+	if (unlikely(dl_prio(prio)) && task->policy != SCHED_DEADLINE)
+		prio = 0;
+
+	return prio;
 }
 
 /*
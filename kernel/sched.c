@@ -135,6 +135,18 @@ static inline int task_has_rt_policy(struct task_struct *p)
 	return rt_policy(p->policy);
 }
 
+static inline int dl_policy(int policy)
+{
+	if (unlikely(policy == SCHED_DEADLINE))
+		return 1;
+	return 0;
+}
+
+static inline int task_has_dl_policy(struct task_struct *p)
+{
+	return dl_policy(p->policy);
+}
+
 /*
  * This is the priority-queue data structure of the RT scheduling class:
  */
@@ -276,6 +288,12 @@ struct task_group {
 #ifdef CONFIG_SCHED_AUTOGROUP
 	struct autogroup *autogroup;
 #endif
+
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+	/* utilization margin in percent, and wake on an idle cpu */
+	unsigned int boost;
+	unsigned int latency_sensitive;
+#endif
 };
 
 /* task_group_lock serializes the addition/removal of task groups */
@@ -411,6 +429,18 @@ struct rt_rq {
 #endif
 };
 
+/* Deadline class' related fields in a runqueue: */
+struct dl_rq {
+	/* runnable, not throttled entities sorted by absolute deadline */
+	struct rb_root rb_root;
+	struct rb_node *rb_leftmost;
+
+	unsigned long dl_nr_running;
+
+	/* bandwidth admitted on this cpu, protected by dl_bw_lock */
+	u64 total_bw;
+};
+
 #ifdef CONFIG_SMP
 
 /*
@@ -476,6 +506,7 @@ struct rq {
 
 	struct cfs_rq cfs;
 	struct rt_rq rt;
+	struct dl_rq dl;
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* list of leaf cfs_rq on this cpu: */
@@ -559,6 +590,14 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+	unsigned int ttwu_boosted;
+#endif
+#endif
+
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+	/* runtime of boosted tasks weighted by their boost, in ns */
+	u64 boost_runtime;
 #endif
 
 #ifdef CONFIG_SMP
@@ -645,6 +684,69 @@ static inline struct task_group *task_group(struct task_struct *p)
 
 #endif /* CONFIG_CGROUP_SCHED */
 
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+/*
+ * Like task_group(), these must be called with p->pi_lock or the task's
+ * rq->lock held.
+ */
+static inline unsigned int task_boost(struct task_struct *p)
+{
+	return task_group(p)->boost;
+}
+
+static inline int task_latency_sensitive(struct task_struct *p)
+{
+	return task_group(p)->latency_sensitive;
+}
+
+/* Called from update_curr() with rq->lock held */
+static inline void
+sched_boost_charge(struct rq *rq, struct task_struct *p, u64 delta_exec)
+{
+	unsigned int boost = task_boost(p);
+
+	if (boost)
+		rq->boost_runtime += delta_exec * boost;
+}
+
+/**
+ * sched_boost_runtime - boost weighted runtime of a cpu
+ * @cpu: the cpu to sample
+ *
+ * Returns the SCHED_OTHER runtime on @cpu, each slice weighted by the
+ * boost percentage of the task group that ran it, in ns. Over a sampling
+ * window with A ns of active time, the delta is A times the average boost
+ * in that window, which a cpufreq governor can turn into a utilization
+ * margin.
+ */
+u64 sched_boost_runtime(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+	u64 runtime;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	runtime = rq->boost_runtime;
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+
+	return div_u64(runtime, 100);
+}
+EXPORT_SYMBOL_GPL(sched_boost_runtime);
+#else
+static inline unsigned int task_boost(struct task_struct *p)
+{
+	return 0;
+}
+
+static inline int task_latency_sensitive(struct task_struct *p)
+{
+	return 0;
+}
+
+static inline void
+sched_boost_charge(struct rq *rq, struct task_struct *p, u64 delta_exec) { }
+#endif /* CONFIG_CGROUP_SCHED_BOOST */
+
 static void update_rq_clock_task(struct rq *rq, s64 delta);
 
 static void update_rq_clock(struct rq *rq)
@@ -835,6 +937,14 @@ static inline u64 global_rt_runtime(void)
 	return (u64)sysctl_sched_rt_runtime * NSEC_PER_USEC;
 }
 
+static unsigned long to_ratio(u64 period, u64 runtime)
+{
+	if (runtime == RUNTIME_INF)
+		return 1ULL << 20;
+
+	return div64_u64(runtime << 20, period);
+}
+
 #ifndef prepare_arch_switch
 # define prepare_arch_switch(next)	do { } while (0)
 #endif
@@ -1197,7 +1307,8 @@ static void resched_cpu(int cpu)
 #ifdef CONFIG_NO_HZ
 /*
  * In the semi idle case, use the nearest busy cpu for migrating timers
- * from an idle cpu.  This is good for power-savings.
+ * from an idle cpu.  This is good for power-savings. A busy housekeeping
+ * cpu is preferred over any other busy cpu.
  *
  * We don't do similar optimization for completely idle system, as
  * selecting an idle cpu will add more delays to the timers than intended
@@ -1209,6 +1320,10 @@ int get_nohz_timer_target(void)
 	int i;
 	struct sched_domain *sd;
 
+	i = timer_housekeeping_target(cpu);
+	if (i != cpu && !idle_cpu(i))
+		return i;
+
 	rcu_read_lock();
 	for_each_domain(cpu, sd) {
 		for_each_cpu(i, sched_domain_span(sd)) {
@@ -1769,6 +1884,7 @@ static inline void __set_task_cpu(struct task_struct *p, unsigned int cpu)
 #endif
 }
 
+static const struct sched_class dl_sched_class;
 static const struct sched_class rt_sched_class;
 
 #define sched_class_highest (&stop_sched_class)
@@ -2024,9 +2140,35 @@ static void update_rq_clock_task(struct rq *rq, s64 delta)
 
 #endif /* CONFIG_IRQ_TIME_ACCOUNTING */
 
+/*
+ * SCHED_DEADLINE tasks are partitioned: admission control reserves the
+ * bandwidth of each one on a single cpu, dl_bw_cpu, where it then runs.
+ * The bandwidth reserved on a cpu may not exceed the share of it given
+ * to real-time tasks by sched_rt_runtime_us/sched_rt_period_us, which
+ * keeps every cpu schedulable by EDF. dl_bw_lock serializes the updates
+ * of all the dl_rq->total_bw.
+ */
+static DEFINE_RAW_SPINLOCK(dl_bw_lock);
+
+static inline u64 dl_bw_limit(void)
+{
+	return to_ratio(global_rt_period(), global_rt_runtime());
+}
+
+static void dl_bw_release(struct task_struct *p)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&dl_bw_lock, flags);
+	cpu_rq(p->dl.dl_bw_cpu)->dl.total_bw -= p->dl.dl_bw;
+	p->dl.dl_bw = 0;
+	raw_spin_unlock_irqrestore(&dl_bw_lock, flags);
+}
+
 #include "sched_idletask.c"
 #include "sched_fair.c"
 #include "sched_rt.c"
+#include "sched_dl.c"
 #include "sched_autogroup.c"
 #include "sched_stoptask.c"
 #ifdef CONFIG_SCHED_DEBUG
@@ -2082,7 +2224,9 @@ static inline int normal_prio(struct task_struct *p)
 {
 	int prio;
 
-	if (task_has_rt_policy(p))
+	if (task_has_dl_policy(p))
+		prio = MAX_DL_PRIO-1;
+	else if (task_has_rt_policy(p))
 		prio = MAX_RT_PRIO-1 - p->rt_priority;
 	else
 		prio = __normal_prio(p);
@@ -2156,6 +2300,19 @@ static void check_preempt_curr(struct rq *rq, struct task_struct *p, int flags)
 }
 
 #ifdef CONFIG_SMP
+/*
+ * A deadline task moved off its cpu by hotplug or by a kernel affinity
+ * change takes its reservation along, even if that overcommits.
+ */
+static void dl_bw_move(struct task_struct *p, int new_cpu)
+{
+	raw_spin_lock(&dl_bw_lock);
+	cpu_rq(p->dl.dl_bw_cpu)->dl.total_bw -= p->dl.dl_bw;
+	cpu_rq(new_cpu)->dl.total_bw += p->dl.dl_bw;
+	p->dl.dl_bw_cpu = new_cpu;
+	raw_spin_unlock(&dl_bw_lock);
+}
+
 /*
  * Is this task likely cache-hot:
  */
@@ -2216,6 +2373,9 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 
 	trace_sched_migrate_task(p, new_cpu);
 
+	if (unlikely(task_has_dl_policy(p)) && p->dl.dl_bw_cpu != new_cpu)
+		dl_bw_move(p, new_cpu);
+
 	if (task_cpu(p) != new_cpu) {
 		p->se.nr_migrations++;
 		perf_sw_event(PERF_COUNT_SW_CPU_MIGRATIONS, 1, 1, NULL, 0);
@@ -2498,6 +2658,12 @@ ttwu_stat(struct task_struct *p, int cpu, int wake_flags)
 	if (wake_flags & WF_SYNC)
 		schedstat_inc(p, se.statistics.nr_wakeups_sync);
 
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+	if (task_boost(p) || task_latency_sensitive(p)) {
+		schedstat_inc(rq, ttwu_boosted);
+		schedstat_inc(p, se.statistics.nr_wakeups_boosted);
+	}
+#endif
 #endif /* CONFIG_SCHEDSTATS */
 }
 
@@ -2845,6 +3011,15 @@ static void __sched_fork(struct task_struct *p)
 
 	INIT_LIST_HEAD(&p->rt.run_list);
 
+	RB_CLEAR_NODE(&p->dl.rb_node);
+	p->dl.dl_runtime = p->dl.runtime = 0;
+	p->dl.dl_deadline = p->dl.deadline = 0;
+	p->dl.dl_period = 0;
+	p->dl.dl_bw = 0;
+	p->dl.dl_new = p->dl.dl_throttled = p->dl.dl_yielded = 0;
+	hrtimer_init(&p->dl.dl_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	p->dl.dl_timer.function = dl_task_timer;
+
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&p->preempt_notifiers);
 #endif
@@ -2866,6 +3041,15 @@ void sched_fork(struct task_struct *p)
 	 */
 	p->state = TASK_RUNNING;
 
+	/*
+	 * The bandwidth of a deadline task is not inherited, its children
+	 * start as SCHED_NORMAL.
+	 */
+	if (unlikely(task_has_dl_policy(p))) {
+		p->policy = SCHED_NORMAL;
+		p->normal_prio = p->static_prio;
+	}
+
 	/*
 	 * Revert to default priority/policy on fork if requested.
 	 */
@@ -2892,6 +3076,8 @@ void sched_fork(struct task_struct *p)
 	 * Make sure we do not leak PI boosting priority to the child.
 	 */
 	p->prio = current->normal_prio;
+	if (unlikely(dl_prio(p->prio)))
+		p->prio = p->normal_prio;
 
 	if (!rt_prio(p->prio))
 		p->sched_class = &fair_sched_class;
@@ -3094,6 +3280,9 @@ static void finish_task_switch(struct rq *rq, struct task_struct *prev)
 	if (mm)
 		mmdrop(mm);
 	if (unlikely(prev_state == TASK_DEAD)) {
+		if (prev->sched_class->task_dead)
+			prev->sched_class->task_dead(prev);
+
 		/*
 		 * Remove function-return probe instances associated with this
 		 * task and put them back on the free list.
@@ -4861,7 +5050,7 @@ void rt_mutex_setprio(struct task_struct *p, int prio)
 	struct rq *rq;
 	const struct sched_class *prev_class;
 
-	BUG_ON(prio < 0 || prio > MAX_PRIO);
+	BUG_ON(prio < MAX_DL_PRIO-1 || prio > MAX_PRIO);
 
 	rq = __task_rq_lock(p);
 
@@ -4875,7 +5064,9 @@ void rt_mutex_setprio(struct task_struct *p, int prio)
 	if (running)
 		p->sched_class->put_prev_task(rq, p);
 
-	if (rt_prio(prio))
+	if (dl_prio(prio))
+		p->sched_class = &dl_sched_class;
+	else if (rt_prio(prio))
 		p->sched_class = &rt_sched_class;
 	else
 		p->sched_class = &fair_sched_class;
@@ -4912,7 +5103,7 @@ void set_user_nice(struct task_struct *p, long nice)
 	 * it wont have any effect on scheduling until the task is
 	 * SCHED_FIFO/SCHED_RR:
 	 */
-	if (task_has_rt_policy(p)) {
+	if (task_has_rt_policy(p) || task_has_dl_policy(p)) {
 		p->static_prio = NICE_TO_PRIO(nice);
 		goto out_unlock;
 	}
@@ -5055,13 +5246,112 @@ __setscheduler(struct rq *rq, struct task_struct *p, int policy, int prio)
 	p->normal_prio = normal_prio(p);
 	/* we are holding p->pi_lock already */
 	p->prio = rt_mutex_getprio(p);
-	if (rt_prio(p->prio))
+	if (dl_prio(p->prio))
+		p->sched_class = &dl_sched_class;
+	else if (rt_prio(p->prio))
 		p->sched_class = &rt_sched_class;
 	else
 		p->sched_class = &fair_sched_class;
 	set_load_weight(p);
 }
 
+/*
+ * The runtime must fit in the relative deadline, which must fit in the
+ * period. Below 2^10 ns the runtime is not enforceable, and above 2^63
+ * the arithmetic overflows.
+ */
+static bool __checkparam_dl(const struct sched_attr *attr)
+{
+	u64 period;
+
+	if (!attr || attr->sched_deadline == 0)
+		return false;
+
+	period = attr->sched_period ?: attr->sched_deadline;
+
+	if (attr->sched_runtime < (1ULL << 10) ||
+	    attr->sched_runtime > attr->sched_deadline ||
+	    attr->sched_deadline > period ||
+	    period & (1ULL << 63))
+		return false;
+
+	return true;
+}
+
+static bool dl_param_changed(struct task_struct *p,
+			     const struct sched_attr *attr)
+{
+	struct sched_dl_entity *dl_se = &p->dl;
+
+	return dl_se->dl_runtime != attr->sched_runtime ||
+	       dl_se->dl_deadline != attr->sched_deadline ||
+	       dl_se->dl_period != (attr->sched_period ?: attr->sched_deadline);
+}
+
+/*
+ * Admission control: release the bandwidth @p holds and reserve the one
+ * of @attr, on the cpu @p is on if it has room or else on the least
+ * loaded allowed cpu that has. Returns that cpu, or -EBUSY with the old
+ * reservation left in place. Called with @p's rq->lock held.
+ */
+static int dl_admit(struct task_struct *p, const struct sched_attr *attr)
+{
+	u64 limit = dl_bw_limit();
+	u64 new_bw, best_bw = 0;
+	int cpu, best = -1;
+
+	new_bw = to_ratio(attr->sched_period ?: attr->sched_deadline,
+			  attr->sched_runtime);
+
+	raw_spin_lock(&dl_bw_lock);
+	if (task_has_dl_policy(p))
+		cpu_rq(p->dl.dl_bw_cpu)->dl.total_bw -= p->dl.dl_bw;
+
+	cpu = task_cpu(p);
+	if (cpu_rq(cpu)->dl.total_bw + new_bw <= limit) {
+		best = cpu;
+	} else {
+		for_each_cpu_and(cpu, &p->cpus_allowed, cpu_active_mask) {
+			u64 bw = cpu_rq(cpu)->dl.total_bw + new_bw;
+
+			if (bw <= limit && (best < 0 || bw < best_bw)) {
+				best = cpu;
+				best_bw = bw;
+			}
+		}
+	}
+
+	if (best >= 0) {
+		cpu_rq(best)->dl.total_bw += new_bw;
+	} else {
+		if (task_has_dl_policy(p))
+			cpu_rq(p->dl.dl_bw_cpu)->dl.total_bw += p->dl.dl_bw;
+		best = -EBUSY;
+	}
+	raw_spin_unlock(&dl_bw_lock);
+
+	return best;
+}
+
+/*
+ * Set the deadline parameters and the reservation dl_admit() made on
+ * @cpu. The next enqueue starts a new instance. Must hold rq lock.
+ */
+static void
+__setparam_dl(struct task_struct *p, const struct sched_attr *attr, int cpu)
+{
+	struct sched_dl_entity *dl_se = &p->dl;
+
+	dl_se->dl_runtime = attr->sched_runtime;
+	dl_se->dl_deadline = attr->sched_deadline;
+	dl_se->dl_period = attr->sched_period ?: attr->sched_deadline;
+	dl_se->dl_bw = to_ratio(dl_se->dl_period, dl_se->dl_runtime);
+	dl_se->dl_bw_cpu = cpu;
+	dl_se->dl_new = 1;
+	dl_se->dl_throttled = 0;
+	dl_se->dl_yielded = 0;
+}
+
 /*
  * check the target process has a UID that matches the current process's
  */
@@ -5082,13 +5372,15 @@ static bool check_same_owner(struct task_struct *p)
 }
 
 static int __sched_setscheduler(struct task_struct *p, int policy,
-				const struct sched_param *param, bool user)
+				const struct sched_param *param,
+				const struct sched_attr *attr, bool user)
 {
 	int retval, oldprio, oldpolicy = -1, on_rq, running;
 	unsigned long flags;
 	const struct sched_class *prev_class;
 	struct rq *rq;
 	int reset_on_fork;
+	int dl_cpu = -1;
 
 	/* may grab non-irq protected spin_locks */
 	BUG_ON(in_interrupt());
@@ -5103,10 +5395,14 @@ recheck:
 
 		if (policy != SCHED_FIFO && policy != SCHED_RR &&
 				policy != SCHED_NORMAL && policy != SCHED_BATCH &&
-				policy != SCHED_IDLE)
+				policy != SCHED_IDLE && policy != SCHED_DEADLINE)
 			return -EINVAL;
 	}
 
+	/* SCHED_DEADLINE can only be set with sched_setattr() */
+	if (dl_policy(policy) && !__checkparam_dl(attr))
+		return -EINVAL;
+
 	/*
 	 * Valid priorities for SCHED_FIFO and SCHED_RR are
 	 * 1..MAX_USER_RT_PRIO-1, valid priority for SCHED_NORMAL,
@@ -5123,6 +5419,10 @@ recheck:
 	 * Allow unprivileged RT tasks to decrease priority:
 	 */
 	if (user && !capable(CAP_SYS_NICE)) {
+		/* reserving bandwidth is a privilege */
+		if (dl_policy(policy))
+			return -EPERM;
+
 		if (rt_policy(policy)) {
 			unsigned long rlim_rtprio =
 					task_rlimit(p, RLIMIT_RTPRIO);
@@ -5182,7 +5482,8 @@ recheck:
 	 * If not changing anything there's no need to proceed further:
 	 */
 	if (unlikely(policy == p->policy && (!rt_policy(policy) ||
-			param->sched_priority == p->rt_priority))) {
+			param->sched_priority == p->rt_priority) &&
+			!(dl_policy(policy) && dl_param_changed(p, attr)))) {
 
 		__task_rq_unlock(rq);
 		raw_spin_unlock_irqrestore(&p->pi_lock, flags);
@@ -5210,6 +5511,17 @@ recheck:
 		task_rq_unlock(rq, p, &flags);
 		goto recheck;
 	}
+
+	if (dl_policy(policy)) {
+		dl_cpu = dl_admit(p, attr);
+		if (dl_cpu < 0) {
+			task_rq_unlock(rq, p, &flags);
+			return -EBUSY;
+		}
+	} else if (task_has_dl_policy(p)) {
+		dl_bw_release(p);
+	}
+
 	on_rq = p->on_rq;
 	running = task_current(rq, p);
 	if (on_rq)
@@ -5221,6 +5533,8 @@ recheck:
 
 	oldprio = p->prio;
 	prev_class = p->sched_class;
+	if (dl_policy(policy))
+		__setparam_dl(p, attr, dl_cpu);
 	__setscheduler(rq, p, policy, param->sched_priority);
 
 	if (running)
@@ -5233,6 +5547,18 @@ recheck:
 
 	rt_mutex_adjust_pi(p);
 
+#ifdef CONFIG_SMP
+	/*
+	 * A sleeping task is woken on dl_bw_cpu, a runnable one is moved.
+	 * migration_cpu_stop() rechecks both under the locks.
+	 */
+	if (dl_policy(policy) && p->on_rq && task_cpu(p) != dl_cpu) {
+		struct migration_arg arg = { p, dl_cpu };
+
+		stop_one_cpu(task_cpu(p), migration_cpu_stop, &arg);
+	}
+#endif
+
 	return 0;
 }
 
@@ -5247,10 +5573,51 @@ recheck:
 int sched_setscheduler(struct task_struct *p, int policy,
 		       const struct sched_param *param)
 {
-	return __sched_setscheduler(p, policy, param, true);
+	return __sched_setscheduler(p, policy, param, NULL, true);
 }
 EXPORT_SYMBOL_GPL(sched_setscheduler);
 
+/**
+ * sched_setattr - change the scheduling policy and parameters of a thread.
+ * @p: the task in question.
+ * @attr: the new policy and its parameters.
+ *
+ * This is the only way to set SCHED_DEADLINE. It may sleep, so it must
+ * not be called under rcu_read_lock(); the caller pins @p instead.
+ */
+int sched_setattr(struct task_struct *p, const struct sched_attr *attr)
+{
+	struct sched_param param = { .sched_priority = attr->sched_priority };
+	int policy = attr->sched_policy;
+	int nice = attr->sched_nice;
+	int retval;
+
+	if (policy < 0 || attr->sched_flags & ~SCHED_FLAG_RESET_ON_FORK)
+		return -EINVAL;
+	if (attr->sched_flags & SCHED_FLAG_RESET_ON_FORK)
+		policy |= SCHED_RESET_ON_FORK;
+
+	if (rt_policy(attr->sched_policy) || dl_policy(attr->sched_policy))
+		return __sched_setscheduler(p, policy, &param, attr, true);
+
+	if (nice < -20 || nice > 19)
+		return -EINVAL;
+
+	retval = __sched_setscheduler(p, policy, &param, attr, true);
+	if (retval || nice == TASK_NICE(p))
+		return retval;
+
+	/* as sys_setpriority() does */
+	if (nice < TASK_NICE(p) && !can_nice(p, nice))
+		return -EACCES;
+	retval = security_task_setnice(p, nice);
+	if (!retval)
+		set_user_nice(p, nice);
+
+	return retval;
+}
+EXPORT_SYMBOL_GPL(sched_setattr);
+
 /**
  * sched_setscheduler_nocheck - change the scheduling policy and/or RT priority of a thread from kernelspace.
  * @p: the task in question.
@@ -5265,7 +5632,7 @@ EXPORT_SYMBOL_GPL(sched_setscheduler);
 int sched_setscheduler_nocheck(struct task_struct *p, int policy,
 			       const struct sched_param *param)
 {
-	return __sched_setscheduler(p, policy, param, false);
+	return __sched_setscheduler(p, policy, param, NULL, false);
 }
 
 static int
@@ -5380,6 +5747,149 @@ out_unlock:
 	return retval;
 }
 
+/*
+ * Copy a struct sched_attr from user space. A larger structure from a
+ * newer user space is accepted as long as the fields we do not know
+ * about are zero; otherwise our size is written back and -E2BIG lets
+ * the caller retry with it.
+ */
+static int sched_copy_attr(struct sched_attr __user *uattr,
+			   struct sched_attr *attr)
+{
+	u32 size;
+	int ret;
+
+	if (!access_ok(VERIFY_WRITE, uattr, SCHED_ATTR_SIZE_VER0))
+		return -EFAULT;
+
+	memset(attr, 0, sizeof(*attr));
+
+	ret = get_user(size, &uattr->size);
+	if (ret)
+		return ret;
+
+	if (size > PAGE_SIZE)
+		goto err_size;
+	if (!size)
+		size = SCHED_ATTR_SIZE_VER0;
+	if (size < SCHED_ATTR_SIZE_VER0)
+		goto err_size;
+
+	if (size > sizeof(*attr)) {
+		unsigned char __user *addr;
+		unsigned char __user *end;
+		unsigned char val;
+
+		addr = (void __user *)uattr + sizeof(*attr);
+		end  = (void __user *)uattr + size;
+
+		for (; addr < end; addr++) {
+			ret = get_user(val, addr);
+			if (ret)
+				return ret;
+			if (val)
+				goto err_size;
+		}
+		size = sizeof(*attr);
+	}
+
+	if (copy_from_user(attr, uattr, size))
+		return -EFAULT;
+
+	return 0;
+
+err_size:
+	put_user(sizeof(*attr), &uattr->size);
+	return -E2BIG;
+}
+
+/**
+ * sys_sched_setattr - set/change the scheduling policy and parameters
+ * @pid: the pid in question.
+ * @uattr: structure containing the extended parameters.
+ * @flags: for future extension, must be 0.
+ */
+SYSCALL_DEFINE3(sched_setattr, pid_t, pid, struct sched_attr __user *, uattr,
+		unsigned int, flags)
+{
+	struct sched_attr attr;
+	struct task_struct *p;
+	int retval;
+
+	if (!uattr || pid < 0 || flags)
+		return -EINVAL;
+
+	retval = sched_copy_attr(uattr, &attr);
+	if (retval)
+		return retval;
+
+	rcu_read_lock();
+	p = find_process_by_pid(pid);
+	if (p)
+		get_task_struct(p);
+	rcu_read_unlock();
+	if (!p)
+		return -ESRCH;
+
+	retval = sched_setattr(p, &attr);
+	put_task_struct(p);
+
+	return retval;
+}
+
+/**
+ * sys_sched_getattr - get the scheduling policy and parameters of a thread
+ * @pid: the pid in question.
+ * @uattr: structure containing the extended parameters.
+ * @size: sizeof(attr) for fwd/bwd compatibility.
+ * @flags: for future extension, must be 0.
+ */
+SYSCALL_DEFINE4(sched_getattr, pid_t, pid, struct sched_attr __user *, uattr,
+		unsigned int, size, unsigned int, flags)
+{
+	struct sched_attr attr = {
+		.size = sizeof(struct sched_attr),
+	};
+	struct task_struct *p;
+	int retval;
+
+	if (!uattr || pid < 0 || size > PAGE_SIZE ||
+	    size < SCHED_ATTR_SIZE_VER0 || flags)
+		return -EINVAL;
+
+	rcu_read_lock();
+	p = find_process_by_pid(pid);
+	retval = -ESRCH;
+	if (!p)
+		goto out_unlock;
+
+	retval = security_task_getscheduler(p);
+	if (retval)
+		goto out_unlock;
+
+	attr.sched_policy = p->policy;
+	if (p->sched_reset_on_fork)
+		attr.sched_flags |= SCHED_FLAG_RESET_ON_FORK;
+	if (task_has_dl_policy(p)) {
+		attr.sched_runtime = p->dl.dl_runtime;
+		attr.sched_deadline = p->dl.dl_deadline;
+		attr.sched_period = p->dl.dl_period;
+	} else if (task_has_rt_policy(p)) {
+		attr.sched_priority = p->rt_priority;
+	} else {
+		attr.sched_nice = TASK_NICE(p);
+	}
+	rcu_read_unlock();
+
+	/* only the part of the structure user space knows about */
+	attr.size = min_t(unsigned int, size, sizeof(attr));
+	return copy_to_user(uattr, &attr, attr.size) ? -EFAULT : 0;
+
+out_unlock:
+	rcu_read_unlock();
+	return retval;
+}
+
 long sched_setaffinity(pid_t pid, const struct cpumask *in_mask)
 {
 	cpumask_var_t cpus_allowed, new_mask;
@@ -5418,6 +5928,12 @@ long sched_setaffinity(pid_t pid, const struct cpumask *in_mask)
 
 	cpuset_cpus_allowed(p, cpus_allowed);
 	cpumask_and(new_mask, in_mask, cpus_allowed);
+
+	/* a deadline task must keep the cpu its bandwidth is reserved on */
+	retval = -EBUSY;
+	if (task_has_dl_policy(p) &&
+	    !cpumask_test_cpu(p->dl.dl_bw_cpu, new_mask))
+		goto out_unlock;
 again:
 	retval = set_cpus_allowed_ptr(p, new_mask);
 
@@ -5758,6 +6274,7 @@ SYSCALL_DEFINE1(sched_get_priority_max, int, policy)
 	case SCHED_NORMAL:
 	case SCHED_BATCH:
 	case SCHED_IDLE:
+	case SCHED_DEADLINE:
 		ret = 0;
 		break;
 	}
@@ -5783,6 +6300,7 @@ SYSCALL_DEFINE1(sched_get_priority_min, int, policy)
 	case SCHED_NORMAL:
 	case SCHED_BATCH:
 	case SCHED_IDLE:
+	case SCHED_DEADLINE:
 		ret = 0;
 	}
 	return ret;
@@ -7961,6 +8479,14 @@ static void init_cfs_rq(struct cfs_rq *cfs_rq, struct rq *rq)
 #endif
 }
 
+static void init_dl_rq(struct dl_rq *dl_rq)
+{
+	dl_rq->rb_root = RB_ROOT;
+	dl_rq->rb_leftmost = NULL;
+	dl_rq->dl_nr_running = 0;
+	dl_rq->total_bw = 0;
+}
+
 static void init_rt_rq(struct rt_rq *rt_rq, struct rq *rq)
 {
 	struct rt_prio_array *array;
@@ -8119,6 +8645,7 @@ void __init sched_init(void)
 		rq->calc_load_update = jiffies + LOAD_FREQ;
 		init_cfs_rq(&rq->cfs, rq);
 		init_rt_rq(&rq->rt, rq);
+		init_dl_rq(&rq->dl);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 		root_task_group.shares = root_task_group_load;
 		INIT_LIST_HEAD(&rq->leaf_cfs_rq_list);
@@ -8706,14 +9233,6 @@ unsigned long sched_group_shares(struct task_group *tg)
  */
 static DEFINE_MUTEX(rt_constraints_mutex);
 
-static unsigned long to_ratio(u64 period, u64 runtime)
-{
-	if (runtime == RUNTIME_INF)
-		return 1ULL << 20;
-
-	return div64_u64(runtime << 20, period);
-}
-
 /* Must be called with tasklist_lock held */
 static inline int tg_has_rt_tasks(struct task_group *tg)
 {
@@ -9094,6 +9613,44 @@ static u64 cpu_rt_period_read_uint(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+static int cpu_boost_write_u64(struct cgroup *cgrp, struct cftype *cft,
+			       u64 boost)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	/* like the shares, the root group is not tunable */
+	if (tg == &root_task_group || boost > 100)
+		return -EINVAL;
+
+	tg->boost = boost;
+	return 0;
+}
+
+static u64 cpu_boost_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->boost;
+}
+
+static int cpu_latency_sensitive_write_u64(struct cgroup *cgrp,
+					   struct cftype *cft, u64 val)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	if (tg == &root_task_group || val > 1)
+		return -EINVAL;
+
+	tg->latency_sensitive = val;
+	return 0;
+}
+
+static u64 cpu_latency_sensitive_read_u64(struct cgroup *cgrp,
+					  struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->latency_sensitive;
+}
+#endif /* CONFIG_CGROUP_SCHED_BOOST */
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -9114,6 +9671,18 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_rt_period_write_uint,
 	},
 #endif
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+	{
+		.name = "boost",
+		.read_u64 = cpu_boost_read_u64,
+		.write_u64 = cpu_boost_write_u64,
+	},
+	{
+		.name = "latency_sensitive",
+		.read_u64 = cpu_latency_sensitive_read_u64,
+		.write_u64 = cpu_latency_sensitive_write_u64,
+	},
+#endif
 };
 
 static int cpu_cgroup_populate(struct cgroup_subsys *ss, struct cgroup *cont)
@@ -295,6 +295,9 @@ static void print_cpu(struct seq_file *m, int cpu)
 
 	P(ttwu_count);
 	P(ttwu_local);
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+	P(ttwu_boosted);
+#endif
 
 #undef P
 #undef P64
@@ -453,6 +456,9 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	P(se.statistics.nr_wakeups_affine_attempts);
 	P(se.statistics.nr_wakeups_passive);
 	P(se.statistics.nr_wakeups_idle);
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+	P(se.statistics.nr_wakeups_boosted);
+#endif
 
 	{
 		u64 avg_atom, avg_per_cpu;
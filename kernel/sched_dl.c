@@ -0,0 +1,413 @@
+/*
+ * Deadline Scheduling Class (SCHED_DEADLINE)
+ *
+ * Earliest Deadline First (EDF) scheduling of tasks reserved with a
+ * Constant Bandwidth Server (CBS): every dl_period a task gets dl_runtime
+ * of cpu time to be consumed before dl_deadline from the start of the
+ * period. A task that tries to run longer is throttled until its next
+ * period, so it can only miss its own deadlines and never makes another
+ * deadline task miss theirs.
+ *
+ * Deadline tasks are partitioned, see dl_admit(): each runs on the cpu
+ * its bandwidth is reserved on, and there is no balancing between the
+ * dl_rqs.
+ */
+
+static inline struct task_struct *dl_task_of(struct sched_dl_entity *dl_se)
+{
+	return container_of(dl_se, struct task_struct, dl);
+}
+
+static inline int dl_time_before(u64 a, u64 b)
+{
+	return (s64)(a - b) < 0;
+}
+
+static inline int on_dl_rq(struct sched_dl_entity *dl_se)
+{
+	return !RB_EMPTY_NODE(&dl_se->rb_node);
+}
+
+static void __enqueue_dl_entity(struct dl_rq *dl_rq,
+				struct sched_dl_entity *dl_se)
+{
+	struct rb_node **link = &dl_rq->rb_root.rb_node;
+	struct rb_node *parent = NULL;
+	struct sched_dl_entity *entry;
+	int leftmost = 1;
+
+	BUG_ON(on_dl_rq(dl_se));
+
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct sched_dl_entity, rb_node);
+		if (dl_time_before(dl_se->deadline, entry->deadline)) {
+			link = &parent->rb_left;
+		} else {
+			link = &parent->rb_right;
+			leftmost = 0;
+		}
+	}
+
+	if (leftmost)
+		dl_rq->rb_leftmost = &dl_se->rb_node;
+
+	rb_link_node(&dl_se->rb_node, parent, link);
+	rb_insert_color(&dl_se->rb_node, &dl_rq->rb_root);
+	dl_rq->dl_nr_running++;
+}
+
+static void __dequeue_dl_entity(struct dl_rq *dl_rq,
+				struct sched_dl_entity *dl_se)
+{
+	if (!on_dl_rq(dl_se))
+		return;
+
+	if (dl_rq->rb_leftmost == &dl_se->rb_node)
+		dl_rq->rb_leftmost = rb_next(&dl_se->rb_node);
+
+	rb_erase(&dl_se->rb_node, &dl_rq->rb_root);
+	RB_CLEAR_NODE(&dl_se->rb_node);
+	dl_rq->dl_nr_running--;
+}
+
+/*
+ * Start a new instance: one runtime to be consumed within one relative
+ * deadline from now.
+ */
+static void setup_new_dl_entity(struct sched_dl_entity *dl_se, u64 now)
+{
+	dl_se->deadline = now + dl_se->dl_deadline;
+	dl_se->runtime = dl_se->dl_runtime;
+	dl_se->dl_new = 0;
+}
+
+/*
+ * CBS replenishment: postpone the deadline by one period and add one
+ * runtime, until there is runtime left. A task that fell so far behind
+ * that the deadline is still in the past starts a new instance instead.
+ */
+static void replenish_dl_entity(struct sched_dl_entity *dl_se, u64 now)
+{
+	while (dl_se->runtime <= 0) {
+		dl_se->deadline += dl_se->dl_period;
+		dl_se->runtime += dl_se->dl_runtime;
+	}
+
+	if (dl_time_before(dl_se->deadline, now))
+		setup_new_dl_entity(dl_se, now);
+
+	dl_se->dl_yielded = 0;
+}
+
+/*
+ * When a task wakes up, running out its remaining runtime before its
+ * current deadline must not use more than the reserved bandwidth:
+ *
+ *   runtime / (deadline - now) <= dl_runtime / dl_period
+ *
+ * The values are scaled down by 2^10 to keep the products in 64 bits.
+ */
+static int dl_entity_overflow(struct sched_dl_entity *dl_se, u64 now)
+{
+	u64 left, right;
+
+	if (dl_se->runtime <= 0)
+		return 0;
+
+	left = (dl_se->dl_period >> 10) * ((u64)dl_se->runtime >> 10);
+	right = ((dl_se->deadline - now) >> 10) * (dl_se->dl_runtime >> 10);
+
+	return dl_time_before(right, left);
+}
+
+static void update_dl_entity(struct sched_dl_entity *dl_se, u64 now)
+{
+	if (dl_se->dl_new || dl_time_before(dl_se->deadline, now) ||
+	    dl_entity_overflow(dl_se, now))
+		setup_new_dl_entity(dl_se, now);
+}
+
+/*
+ * Arm the replenishment timer at the deadline of a throttled entity.
+ * Returns 0 if the deadline already passed, the caller replenishes then.
+ */
+static int start_dl_timer(struct rq *rq, struct sched_dl_entity *dl_se)
+{
+	struct hrtimer *timer = &dl_se->dl_timer;
+	ktime_t now, act;
+	s64 delta;
+
+	/* the deadline is in rq->clock time, the timer in CLOCK_MONOTONIC */
+	now = hrtimer_cb_get_time(timer);
+	delta = ktime_to_ns(now) - rq->clock;
+	act = ns_to_ktime(dl_se->deadline + delta);
+
+	if (ktime_us_delta(act, now) <= 0)
+		return 0;
+
+	/* wakeup == 0: we hold rq->lock, softirqd must not be woken */
+	__hrtimer_start_range_ns(timer, act, 0, HRTIMER_MODE_ABS, 0);
+
+	return hrtimer_active(timer);
+}
+
+static void check_preempt_curr_dl(struct rq *rq, struct task_struct *p,
+				  int flags);
+
+static enum hrtimer_restart dl_task_timer(struct hrtimer *timer)
+{
+	struct sched_dl_entity *dl_se = container_of(timer,
+						     struct sched_dl_entity,
+						     dl_timer);
+	struct task_struct *p = dl_task_of(dl_se);
+	unsigned long flags;
+	struct rq *rq;
+
+	rq = task_rq_lock(p, &flags);
+
+	/* new parameters or another policy were set meanwhile */
+	if (!dl_task(p) || !dl_se->dl_throttled)
+		goto unlock;
+
+	update_rq_clock(rq);
+	dl_se->dl_throttled = 0;
+	replenish_dl_entity(dl_se, rq->clock);
+
+	if (p->on_rq) {
+		__enqueue_dl_entity(&rq->dl, dl_se);
+		if (dl_task(rq->curr))
+			check_preempt_curr_dl(rq, p, 0);
+		else
+			resched_task(rq->curr);
+	}
+
+unlock:
+	task_rq_unlock(rq, p, &flags);
+
+	return HRTIMER_NORESTART;
+}
+
+#ifdef CONFIG_SCHED_HRTICK
+/* enforce the runtime precisely rather than at the next tick */
+static void hrtick_start_dl(struct rq *rq, struct task_struct *p)
+{
+	s64 delta = p->dl.runtime;
+
+	if (hrtick_enabled(rq) && delta > 0)
+		hrtick_start(rq, delta);
+}
+#else
+static inline void hrtick_start_dl(struct rq *rq, struct task_struct *p)
+{
+}
+#endif
+
+/*
+ * Update the current task's runtime statistics and charge its
+ * reservation; throttle it once the runtime is exhausted.
+ */
+static void update_curr_dl(struct rq *rq)
+{
+	struct task_struct *curr = rq->curr;
+	struct sched_dl_entity *dl_se = &curr->dl;
+	u64 delta_exec;
+
+	if (curr->sched_class != &dl_sched_class || !on_dl_rq(dl_se))
+		return;
+
+	delta_exec = rq->clock_task - curr->se.exec_start;
+	if (unlikely((s64)delta_exec < 0))
+		delta_exec = 0;
+
+	schedstat_set(curr->se.statistics.exec_max,
+		      max(curr->se.statistics.exec_max, delta_exec));
+
+	curr->se.sum_exec_runtime += delta_exec;
+	account_group_exec_runtime(curr, delta_exec);
+
+	curr->se.exec_start = rq->clock_task;
+	cpuacct_charge(curr, delta_exec);
+
+	sched_rt_avg_update(rq, delta_exec);
+
+	if (dl_se->dl_yielded)
+		dl_se->runtime = 0;
+	else
+		dl_se->runtime -= delta_exec;
+	if (dl_se->runtime > 0)
+		return;
+
+	__dequeue_dl_entity(&rq->dl, dl_se);
+	dl_se->dl_throttled = 1;
+	if (!start_dl_timer(rq, dl_se)) {
+		dl_se->dl_throttled = 0;
+		replenish_dl_entity(dl_se, rq->clock);
+		__enqueue_dl_entity(&rq->dl, dl_se);
+	}
+
+	resched_task(curr);
+}
+
+static void enqueue_task_dl(struct rq *rq, struct task_struct *p, int flags)
+{
+	struct sched_dl_entity *dl_se = &p->dl;
+
+	/* a throttled task is queued by its replenishment timer */
+	if (!dl_se->dl_throttled) {
+		if (dl_se->dl_new || flags & ENQUEUE_WAKEUP)
+			update_dl_entity(dl_se, rq->clock);
+		__enqueue_dl_entity(&rq->dl, dl_se);
+	}
+
+	inc_nr_running(rq);
+}
+
+static void dequeue_task_dl(struct rq *rq, struct task_struct *p, int flags)
+{
+	update_curr_dl(rq);
+	__dequeue_dl_entity(&rq->dl, &p->dl);
+
+	dec_nr_running(rq);
+}
+
+/*
+ * sched_yield() from a deadline task ends its current instance: what is
+ * left of the runtime is dropped and the task is throttled until the
+ * replenishment of the next one. Periodic tasks call it when a job is
+ * done.
+ */
+static void yield_task_dl(struct rq *rq)
+{
+	struct task_struct *p = rq->curr;
+
+	if (p->dl.runtime > 0) {
+		p->dl.dl_yielded = 1;
+		update_rq_clock(rq);
+		update_curr_dl(rq);
+	}
+}
+
+static void check_preempt_curr_dl(struct rq *rq, struct task_struct *p,
+				  int flags)
+{
+	if (dl_time_before(p->dl.deadline, rq->curr->dl.deadline))
+		resched_task(rq->curr);
+}
+
+static struct task_struct *pick_next_task_dl(struct rq *rq)
+{
+	struct dl_rq *dl_rq = &rq->dl;
+	struct sched_dl_entity *dl_se;
+	struct task_struct *p;
+
+	if (!dl_rq->dl_nr_running)
+		return NULL;
+
+	dl_se = rb_entry(dl_rq->rb_leftmost, struct sched_dl_entity, rb_node);
+	p = dl_task_of(dl_se);
+	p->se.exec_start = rq->clock_task;
+
+	hrtick_start_dl(rq, p);
+
+	return p;
+}
+
+static void put_prev_task_dl(struct rq *rq, struct task_struct *p)
+{
+	update_curr_dl(rq);
+}
+
+static void task_tick_dl(struct rq *rq, struct task_struct *p, int queued)
+{
+	update_curr_dl(rq);
+
+	if (queued)
+		return;
+
+	if (rq->curr == p && on_dl_rq(&p->dl))
+		hrtick_start_dl(rq, p);
+}
+
+static void set_curr_task_dl(struct rq *rq)
+{
+	struct task_struct *p = rq->curr;
+
+	p->se.exec_start = rq->clock_task;
+}
+
+static void task_dead_dl(struct task_struct *p)
+{
+	hrtimer_cancel(&p->dl.dl_timer);
+	dl_bw_release(p);
+}
+
+#ifdef CONFIG_SMP
+static int select_task_rq_dl(struct task_struct *p, int sd_flag, int flags)
+{
+	int cpu = p->dl.dl_bw_cpu;
+
+	/* run where the bandwidth is reserved */
+	if (cpumask_test_cpu(cpu, tsk_cpus_allowed(p)) && cpu_active(cpu))
+		return cpu;
+
+	return task_cpu(p);
+}
+#endif
+
+static void switched_from_dl(struct rq *rq, struct task_struct *p)
+{
+	/* a pending replenishment is void, see dl_task_timer() */
+	hrtimer_try_to_cancel(&p->dl.dl_timer);
+	p->dl.dl_throttled = 0;
+}
+
+static void switched_to_dl(struct rq *rq, struct task_struct *p)
+{
+	if (!p->on_rq || rq->curr == p)
+		return;
+
+	if (dl_task(rq->curr))
+		check_preempt_curr_dl(rq, p, 0);
+	else
+		resched_task(rq->curr);
+}
+
+static void
+prio_changed_dl(struct rq *rq, struct task_struct *p, int oldprio)
+{
+	/* the priority of a deadline task is its deadline, nothing changed */
+}
+
+static unsigned int
+get_rr_interval_dl(struct rq *rq, struct task_struct *task)
+{
+	return 0;
+}
+
+static const struct sched_class dl_sched_class = {
+	.next			= &rt_sched_class,
+
+	.enqueue_task		= enqueue_task_dl,
+	.dequeue_task		= dequeue_task_dl,
+	.yield_task		= yield_task_dl,
+
+	.check_preempt_curr	= check_preempt_curr_dl,
+
+	.pick_next_task		= pick_next_task_dl,
+	.put_prev_task		= put_prev_task_dl,
+
+#ifdef CONFIG_SMP
+	.select_task_rq		= select_task_rq_dl,
+#endif
+
+	.set_curr_task		= set_curr_task_dl,
+	.task_tick		= task_tick_dl,
+	.task_dead		= task_dead_dl,
+
+	.get_rr_interval	= get_rr_interval_dl,
+
+	.prio_changed		= prio_changed_dl,
+	.switched_from		= switched_from_dl,
+	.switched_to		= switched_to_dl,
+};
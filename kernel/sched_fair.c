@@ -601,6 +601,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 		trace_sched_stat_runtime(curtask, delta_exec, curr->vruntime);
 		cpuacct_charge(curtask, delta_exec);
 		account_group_exec_runtime(curtask, delta_exec);
+		sched_boost_charge(rq_of(cfs_rq), curtask, delta_exec);
 	}
 }
 
@@ -1675,6 +1676,48 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	return target;
 }
 
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+/*
+ * A task of a latency sensitive group is woken on any idle cpu of the
+ * affine domain, not only on an idle cache sibling of the target.
+ */
+static int
+select_idle_cpu_latency(struct task_struct *p, struct sched_domain *sd,
+			int target)
+{
+	int i;
+
+	target = select_idle_sibling(p, target);
+	if (idle_cpu(target))
+		return target;
+
+	for_each_cpu_and(i, sched_domain_span(sd), &p->cpus_allowed) {
+		if (idle_cpu(i))
+			return i;
+	}
+
+	return target;
+}
+
+/*
+ * A boosted task is woken on the higher capacity of the waking and the
+ * previous cpu. Between equals it stays on the previous cpu only if that
+ * one is awake and not busier, so it neither waits for a cpu to leave its
+ * idle state nor for an idle cpu's frequency to ramp up.
+ */
+static int select_boosted_cpu(struct task_struct *p, int cpu, int prev_cpu)
+{
+	if (power_of(cpu) != power_of(prev_cpu))
+		return power_of(cpu) > power_of(prev_cpu) ? cpu : prev_cpu;
+
+	if (idle_cpu(prev_cpu) ||
+	    cpu_rq(prev_cpu)->nr_running > cpu_rq(cpu)->nr_running)
+		return cpu;
+
+	return prev_cpu;
+}
+#endif /* CONFIG_CGROUP_SCHED_BOOST */
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -1753,6 +1796,17 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 	}
 
 	if (affine_sd) {
+#ifdef CONFIG_CGROUP_SCHED_BOOST
+		if (task_latency_sensitive(p)) {
+			new_cpu = select_idle_cpu_latency(p, affine_sd, prev_cpu);
+			goto unlock;
+		}
+		if (task_boost(p)) {
+			new_cpu = select_boosted_cpu(p, cpu, prev_cpu);
+			goto unlock;
+		}
+#endif
+
 		if (cpu == prev_cpu || wake_affine(affine_sd, p, sync))
 			prev_cpu = cpu;
 
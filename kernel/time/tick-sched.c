@@ -410,6 +410,7 @@ void tick_nohz_stop_sched_tick(int inidle)
 			ts->tick_stopped = 1;
 			ts->idle_jiffies = last_jiffies;
 			rcu_enter_nohz();
+			timer_wakeup_idle_enter();
 		}
 
 		ts->idle_sleeps++;
@@ -520,6 +521,7 @@ void tick_nohz_restart_sched_tick(void)
 	ts->inidle = 0;
 
 	rcu_exit_nohz();
+	timer_wakeup_idle_exit();
 
 	/* Update jiffies first */
 	select_nohz_load_balancer(0);
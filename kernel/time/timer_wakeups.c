@@ -0,0 +1,159 @@
+/*
+ * kernel/time/timer_wakeups.c
+ *
+ * Per cpu accounting of the timers which wake a cpu out of tickless idle
+ *
+ * When a cpu stops its tick for idle, the first non-deferrable timer
+ * (timer wheel or hrtimer) which expires on it afterwards is charged
+ * with the wakeup. The results are exported in /proc/timer_wakeups,
+ * writing anything to the file resets the counters.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/proc_fs.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/hrtimer.h>
+#include <linux/seq_file.h>
+#include <linux/kallsyms.h>
+#include <linux/tick.h>
+#include <linux/capability.h>
+
+#define TIMER_WAKEUP_SLOTS	16
+
+struct timer_wakeup_entry {
+	void			*fn;
+	unsigned long		count;
+};
+
+struct timer_wakeup_stats {
+	int			idle;
+	unsigned long		wakeups;
+	unsigned long		coalesced;
+	unsigned long		overflow;
+	struct timer_wakeup_entry entry[TIMER_WAKEUP_SLOTS];
+};
+
+static DEFINE_PER_CPU(struct timer_wakeup_stats, timer_wakeup_stats);
+
+/*
+ * Called with interrupts disabled when the tick is stopped for idle.
+ */
+void timer_wakeup_idle_enter(void)
+{
+	__get_cpu_var(timer_wakeup_stats).idle = 1;
+}
+
+/*
+ * Called with interrupts disabled when the tick is restarted.
+ */
+void timer_wakeup_idle_exit(void)
+{
+	__get_cpu_var(timer_wakeup_stats).idle = 0;
+}
+
+/*
+ * Called with interrupts disabled before a timer callback is run.
+ */
+void timer_wakeup_account(void *fn)
+{
+	struct timer_wakeup_stats *st = &__get_cpu_var(timer_wakeup_stats);
+	int i;
+
+	if (!st->idle)
+		return;
+	st->idle = 0;
+	st->wakeups++;
+
+	for (i = 0; i < TIMER_WAKEUP_SLOTS; i++) {
+		if (!st->entry[i].fn)
+			st->entry[i].fn = fn;
+		if (st->entry[i].fn == fn) {
+			st->entry[i].count++;
+			return;
+		}
+	}
+	st->overflow++;
+}
+
+void timer_wakeup_account_hrtimer(struct hrtimer *timer)
+{
+	struct tick_sched *ts = tick_get_tick_sched(smp_processor_id());
+
+	/*
+	 * The sched tick only fires in idle on behalf of a timer wheel
+	 * timer, leave the wakeup to that one.
+	 */
+	if (timer == &ts->sched_timer)
+		return;
+	timer_wakeup_account(timer->function);
+}
+
+void timer_wakeup_coalesced(void)
+{
+	this_cpu_inc(timer_wakeup_stats.coalesced);
+}
+
+static int timer_wakeups_show(struct seq_file *m, void *v)
+{
+	struct timer_wakeup_stats *st;
+	int cpu, i;
+
+	for_each_online_cpu(cpu) {
+		st = &per_cpu(timer_wakeup_stats, cpu);
+
+		seq_printf(m, "cpu%d: wakeups %lu coalesced %lu overflow %lu\n",
+			   cpu, st->wakeups, st->coalesced, st->overflow);
+		for (i = 0; i < TIMER_WAKEUP_SLOTS && st->entry[i].fn; i++)
+			seq_printf(m, "  %10lu  %pF\n", st->entry[i].count,
+				   st->entry[i].fn);
+	}
+	return 0;
+}
+
+static ssize_t timer_wakeups_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *offs)
+{
+	struct timer_wakeup_stats *st;
+	int cpu;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	/* Racy against the accounting, but these are statistics only */
+	for_each_possible_cpu(cpu) {
+		st = &per_cpu(timer_wakeup_stats, cpu);
+		st->wakeups = 0;
+		st->coalesced = 0;
+		st->overflow = 0;
+		memset(st->entry, 0, sizeof(st->entry));
+	}
+	return count;
+}
+
+static int timer_wakeups_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, timer_wakeups_show, NULL);
+}
+
+static const struct file_operations timer_wakeups_fops = {
+	.open		= timer_wakeups_open,
+	.read		= seq_read,
+	.write		= timer_wakeups_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init init_timer_wakeups_procfs(void)
+{
+	struct proc_dir_entry *pe;
+
+	pe = proc_create("timer_wakeups", 0644, NULL, &timer_wakeups_fops);
+	if (!pe)
+		return -ENOMEM;
+	return 0;
+}
+__initcall(init_timer_wakeups_procfs);
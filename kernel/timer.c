@@ -624,9 +624,106 @@ static struct tvec_base *lock_timer_base(struct timer_list *timer,
 	}
 }
 
+#if defined(CONFIG_NO_HZ) && defined(CONFIG_SMP)
+int sysctl_timer_housekeeping_cpu __read_mostly = -1;
+
+static int __init timer_housekeeping_setup(char *str)
+{
+	get_option(&str, &sysctl_timer_housekeeping_cpu);
+	return 1;
+}
+__setup("timer_housekeeping=", timer_housekeeping_setup);
+
+/**
+ * timer_housekeeping_target - cpu to queue non-latency critical timers on
+ * @cpu: the cpu which would be used otherwise
+ *
+ * Returns the housekeeping cpu if one is configured and online, @cpu
+ * otherwise.
+ */
+int timer_housekeeping_target(int cpu)
+{
+	int hk = ACCESS_ONCE(sysctl_timer_housekeeping_cpu);
+
+	if (hk >= 0 && hk < nr_cpu_ids && cpu_online(hk))
+		return hk;
+	return cpu;
+}
+#endif
+
+/*
+ * Decide where to put the timer while taking the slack into account
+ *
+ * Algorithm:
+ *   1) calculate the highest bit where the expires and the maximum
+ *      (absolute) time are different
+ *   2) use this bit to make a mask
+ *   3) use the bitmask to round down the maximum time, so that all last
+ *      bits are zeros
+ */
+static inline
+unsigned long apply_slack(unsigned long expires, unsigned long expires_limit)
+{
+	unsigned long mask;
+	int bit;
+
+	mask = expires ^ expires_limit;
+	if (mask == 0)
+		return expires;
+
+	bit = find_last_bit(&mask, BITS_PER_LONG);
+
+	mask = (1 << bit) - 1;
+
+	expires_limit = expires_limit & ~(mask);
+
+	return expires_limit;
+}
+
+/*
+ * The latest time a timer may expire at, by its slack
+ */
+static inline
+unsigned long slack_limit(struct timer_list *timer, unsigned long expires)
+{
+	long delta;
+
+	if (timer->slack >= 0)
+		return expires + timer->slack;
+
+	delta = expires - jiffies;
+	if (delta < 256)
+		return expires;
+
+	return expires + delta / 256;
+}
+
+/*
+ * If the cpu of @base already has a wakeup pending inside the slack
+ * window [expires, expires_limit], expire together with it, otherwise
+ * round by apply_slack().  Called with @base locked, and it must be the
+ * base the timer is queued on: the wakeup of another cpu saves nothing.
+ */
+static inline unsigned long
+coalesce_slack(struct tvec_base *base, struct timer_list *timer,
+	       unsigned long expires, unsigned long expires_limit)
+{
+	unsigned long next = base->next_timer;
+
+	if (expires_limit != expires && !tbase_get_deferrable(timer->base) &&
+	    time_after(next, base->timer_jiffies) &&
+	    time_after_eq(next, expires) &&
+	    time_before_eq(next, expires_limit)) {
+		timer_wakeup_coalesced();
+		return next;
+	}
+
+	return apply_slack(expires, expires_limit);
+}
+
 static inline int
 __mod_timer(struct timer_list *timer, unsigned long expires,
-						bool pending_only, int pinned)
+	    unsigned long expires_limit, bool pending_only, int pinned)
 {
 	struct tvec_base *base, *new_base;
 	unsigned long flags;
@@ -652,8 +749,18 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	cpu = smp_processor_id();
 
 #if defined(CONFIG_NO_HZ) && defined(CONFIG_SMP)
-	if (!pinned && get_sysctl_timer_migration() && idle_cpu(cpu))
-		cpu = get_nohz_timer_target();
+	if (!pinned && get_sysctl_timer_migration()) {
+		/*
+		 * Deferrable timers never wake a cpu up, but they still
+		 * run whenever their cpu leaves idle. Park them on the
+		 * housekeeping cpu so they do not prolong the busy
+		 * periods of the other cpus.
+		 */
+		if (tbase_get_deferrable(timer->base))
+			cpu = timer_housekeeping_target(cpu);
+		else if (idle_cpu(cpu))
+			cpu = get_nohz_timer_target();
+	}
 #endif
 	new_base = per_cpu(tvec_bases, cpu);
 
@@ -671,11 +778,23 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 			spin_unlock(&base->lock);
 			base = new_base;
 			spin_lock(&base->lock);
+			/*
+			 * The target was picked without holding off cpu
+			 * hotplug.  With its base locked, a cpu still online
+			 * has yet to have its timers migrated and takes this
+			 * one along, but one gone offline may have had them
+			 * migrated already: stay on this cpu then.
+			 */
+			if (unlikely(!cpu_online(cpu))) {
+				spin_unlock(&base->lock);
+				base = per_cpu(tvec_bases, smp_processor_id());
+				spin_lock(&base->lock);
+			}
 			timer_set_base(timer, base);
 		}
 	}
 
-	timer->expires = expires;
+	timer->expires = coalesce_slack(base, timer, expires, expires_limit);
 	if (time_before(timer->expires, base->next_timer) &&
 	    !tbase_get_deferrable(timer->base))
 		base->next_timer = timer->expires;
@@ -699,49 +818,10 @@ out_unlock:
  */
 int mod_timer_pending(struct timer_list *timer, unsigned long expires)
 {
-	return __mod_timer(timer, expires, true, TIMER_NOT_PINNED);
+	return __mod_timer(timer, expires, expires, true, TIMER_NOT_PINNED);
 }
 EXPORT_SYMBOL(mod_timer_pending);
 
-/*
- * Decide where to put the timer while taking the slack into account
- *
- * Algorithm:
- *   1) calculate the maximum (absolute) time
- *   2) calculate the highest bit where the expires and new max are different
- *   3) use this bit to make a mask
- *   4) use the bitmask to round down the maximum time, so that all last
- *      bits are zeros
- */
-static inline
-unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
-{
-	unsigned long expires_limit, mask;
-	int bit;
-
-	if (timer->slack >= 0) {
-		expires_limit = expires + timer->slack;
-	} else {
-		long delta = expires - jiffies;
-
-		if (delta < 256)
-			return expires;
-
-		expires_limit = expires + delta / 256;
-	}
-	mask = expires ^ expires_limit;
-	if (mask == 0)
-		return expires;
-
-	bit = find_last_bit(&mask, BITS_PER_LONG);
-
-	mask = (1 << bit) - 1;
-
-	expires_limit = expires_limit & ~(mask);
-
-	return expires_limit;
-}
-
 /**
  * mod_timer - modify a timer's timeout
  * @timer: the timer to be modified
@@ -764,17 +844,19 @@ unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
  */
 int mod_timer(struct timer_list *timer, unsigned long expires)
 {
-	expires = apply_slack(timer, expires);
+	unsigned long expires_limit = slack_limit(timer, expires);
 
 	/*
 	 * This is a common optimization triggered by the
 	 * networking code - if the timer is re-modified
 	 * to be the same thing then just return:
 	 */
-	if (timer_pending(timer) && timer->expires == expires)
+	if (timer_pending(timer) &&
+	    timer->expires == apply_slack(expires, expires_limit))
 		return 1;
 
-	return __mod_timer(timer, expires, false, TIMER_NOT_PINNED);
+	return __mod_timer(timer, expires, expires_limit, false,
+			   TIMER_NOT_PINNED);
 }
 EXPORT_SYMBOL(mod_timer);
 
@@ -796,7 +878,7 @@ int mod_timer_pinned(struct timer_list *timer, unsigned long expires)
 	if (timer->expires == expires && timer_pending(timer))
 		return 1;
 
-	return __mod_timer(timer, expires, false, TIMER_PINNED);
+	return __mod_timer(timer, expires, expires, false, TIMER_PINNED);
 }
 EXPORT_SYMBOL(mod_timer_pinned);
 
@@ -1085,6 +1167,8 @@ static inline void __run_timers(struct tvec_base *base)
 			data = timer->data;
 
 			base->running_timer = timer;
+			if (!tbase_get_deferrable(timer->base))
+				timer_wakeup_account(fn);
 			detach_timer(timer, 1);
 
 			spin_unlock_irq(&base->lock);
@@ -1433,7 +1517,7 @@ signed long __sched schedule_timeout(signed long timeout)
 	expire = timeout + jiffies;
 
 	setup_timer_on_stack(&timer, process_timeout, (unsigned long)current);
-	__mod_timer(&timer, expire, false, TIMER_NOT_PINNED);
+	__mod_timer(&timer, expire, expire, false, TIMER_NOT_PINNED);
 	schedule();
 	del_singleshot_timer_sync(&timer);
 
@@ -41,6 +41,8 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_sched.h"
 
@@ -259,6 +261,34 @@ EXPORT_SYMBOL_GPL(system_nrt_wq);
 EXPORT_SYMBOL_GPL(system_unbound_wq);
 EXPORT_SYMBOL_GPL(system_freezable_wq);
 EXPORT_SYMBOL_GPL(system_nrt_freezable_wq);
+struct workqueue_struct *system_power_efficient_wq __read_mostly;
+EXPORT_SYMBOL_GPL(system_power_efficient_wq);
+struct workqueue_struct *system_freezable_power_efficient_wq __read_mostly;
+EXPORT_SYMBOL_GPL(system_freezable_power_efficient_wq);
+
+/* see the comment above the definition of WQ_POWER_EFFICIENT */
+#ifdef CONFIG_WQ_POWER_EFFICIENT_DEFAULT
+static bool wq_power_efficient = true;
+#else
+static bool wq_power_efficient;
+#endif
+
+module_param_named(power_efficient, wq_power_efficient, bool, 0444);
+
+/* works redirected by WQ_POWER_EFFICIENT, reported in debugfs */
+struct wq_power_efficient_stats {
+	unsigned long		queued;		/* works queued unbound */
+	unsigned long		wakeups_saved;	/* idle target cpu not woken */
+	unsigned long		timers_offloaded; /* delayed work timers moved */
+};
+
+static DEFINE_PER_CPU(struct wq_power_efficient_stats, wq_pe_stats);
+
+static inline bool wq_is_power_efficient(struct workqueue_struct *wq)
+{
+	return (wq->flags & (WQ_POWER_EFFICIENT | WQ_UNBOUND)) ==
+		(WQ_POWER_EFFICIENT | WQ_UNBOUND);
+}
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/workqueue.h>
@@ -996,6 +1026,17 @@ static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 	    WARN_ON_ONCE(!is_chained_work(wq)))
 		return;
 
+	/*
+	 * A bound workqueue would have kicked @cpu, which is a wakeup
+	 * saved if that cpu is idle and not the one we are running on.
+	 */
+	if (wq_is_power_efficient(wq)) {
+		this_cpu_inc(wq_pe_stats.queued);
+		if (cpu != WORK_CPU_UNBOUND && cpu != raw_smp_processor_id() &&
+		    idle_cpu(cpu))
+			this_cpu_inc(wq_pe_stats.wakeups_saved);
+	}
+
 	/* determine gcwq to use */
 	if (!(wq->flags & WQ_UNBOUND)) {
 		struct global_cwq *last_gcwq;
@@ -1169,6 +1210,17 @@ int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
 		timer->data = (unsigned long)dwork;
 		timer->function = delayed_work_timer_fn;
 
+		/*
+		 * Unbound work doesn't care where its timer fires, so
+		 * keep it off cpus which would rather stay idle.
+		 */
+		if (unlikely(cpu < 0) && (wq->flags & WQ_UNBOUND)) {
+			cpu = timer_housekeeping_target(-1);
+			if (wq_is_power_efficient(wq) && cpu >= 0 &&
+			    cpu != raw_smp_processor_id())
+				this_cpu_inc(wq_pe_stats.timers_offloaded);
+		}
+
 		if (unlikely(cpu >= 0))
 			add_timer_on(timer, cpu);
 		else
@@ -2925,6 +2977,9 @@ struct workqueue_struct *__alloc_workqueue_key(const char *name,
 	if (flags & WQ_MEM_RECLAIM)
 		flags |= WQ_RESCUER;
 
+	if ((flags & WQ_POWER_EFFICIENT) && wq_power_efficient)
+		flags |= WQ_UNBOUND;
+
 	/*
 	 * Unbound workqueues aren't concurrency managed and should be
 	 * dispatched to workers immediately.
@@ -3837,9 +3892,57 @@ static int __init init_workqueues(void)
 					      WQ_FREEZABLE, 0);
 	system_nrt_freezable_wq = alloc_workqueue("events_nrt_freezable",
 			WQ_NON_REENTRANT | WQ_FREEZABLE, 0);
+	system_power_efficient_wq = alloc_workqueue("events_power_efficient",
+						    WQ_POWER_EFFICIENT, 0);
+	system_freezable_power_efficient_wq =
+		alloc_workqueue("events_freezable_power_efficient",
+				WQ_FREEZABLE | WQ_POWER_EFFICIENT, 0);
 	BUG_ON(!system_wq || !system_long_wq || !system_nrt_wq ||
 	       !system_unbound_wq || !system_freezable_wq ||
-		!system_nrt_freezable_wq);
+		!system_nrt_freezable_wq || !system_power_efficient_wq ||
+		!system_freezable_power_efficient_wq);
 	return 0;
 }
 early_initcall(init_workqueues);
+
+#ifdef CONFIG_DEBUG_FS
+static int wq_power_efficient_show(struct seq_file *m, void *unused)
+{
+	unsigned long queued = 0, saved = 0, offloaded = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct wq_power_efficient_stats *st = &per_cpu(wq_pe_stats, cpu);
+
+		queued += st->queued;
+		saved += st->wakeups_saved;
+		offloaded += st->timers_offloaded;
+	}
+
+	seq_printf(m, "enabled: %d\n", wq_power_efficient);
+	seq_printf(m, "queued: %lu\n", queued);
+	seq_printf(m, "wakeups_saved: %lu\n", saved);
+	seq_printf(m, "timers_offloaded: %lu\n", offloaded);
+	return 0;
+}
+
+static int wq_power_efficient_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_power_efficient_show, NULL);
+}
+
+static const struct file_operations wq_power_efficient_fops = {
+	.open		= wq_power_efficient_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_power_efficient_debugfs_init(void)
+{
+	debugfs_create_file("workqueue_power_efficient", S_IRUGO, NULL, NULL,
+			    &wq_power_efficient_fops);
+	return 0;
+}
+late_initcall(wq_power_efficient_debugfs_init);
+#endif
@@ -204,12 +204,33 @@ static ssize_t max_ratio_store(struct device *dev,
 }
 BDI_SHOW(max_ratio, bdi->max_ratio)
 
+/*
+ * Pages read ahead, how many of them were used and how many dropped
+ * unused, and the reads that missed the page cache
+ */
+static ssize_t readahead_stats_show(struct device *dev,
+				    struct device_attribute *attr, char *page)
+{
+	struct backing_dev_info *bdi = dev_get_drvdata(dev);
+
+	return snprintf(page, PAGE_SIZE-1,
+			"pages  %lld\n"
+			"hits   %lld\n"
+			"wasted %lld\n"
+			"misses %lld\n",
+			(long long)bdi_stat_sum(bdi, BDI_RA_PAGES),
+			(long long)bdi_stat_sum(bdi, BDI_RA_HIT),
+			(long long)bdi_stat_sum(bdi, BDI_RA_WASTED),
+			(long long)bdi_stat_sum(bdi, BDI_RA_MISS));
+}
+
 #define __ATTR_RW(attr) __ATTR(attr, 0644, attr##_show, attr##_store)
 
 static struct device_attribute bdi_dev_attrs[] = {
 	__ATTR_RW(read_ahead_kb),
 	__ATTR_RW(min_ratio),
 	__ATTR_RW(max_ratio),
+	__ATTR(readahead_stats, 0444, readahead_stats_show, NULL),
 	__ATTR_NULL,
 };
 
@@ -129,6 +129,17 @@ void __delete_from_page_cache(struct page *page)
 	else
 		cleancache_flush_page(mapping, page);
 
+	/*
+	 * Read ahead and never used, see __do_page_cache_readahead().
+	 * PG_readahead is PG_reclaim as well, which reclaim also sets on
+	 * dirty pages and pages under writeback, so only a clean, uptodate
+	 * page is counted.  One that reclaim marked while dirty and that
+	 * is truncated before its writeback still is: an upper bound.
+	 */
+	if (PageReadahead(page) && !PageWriteback(page) &&
+	    !PageDirty(page) && PageUptodate(page))
+		__inc_bdi_stat(mapping->backing_dev_info, BDI_RA_WASTED);
+
 	radix_tree_delete(&mapping->page_tree, page->index);
 	page->mapping = NULL;
 	mapping->nrpages--;
@@ -1579,6 +1590,7 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 	/*
 	 * mmap read-around
 	 */
+	inc_bdi_stat(mapping->backing_dev_info, BDI_RA_MISS);
 	ra_pages = max_sane_readahead(ra->ra_pages);
 	ra->start = max_t(long, 0, offset - ra_pages / 2);
 	ra->size = ra_pages;
@@ -211,6 +211,11 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 			break;
 		page->index = page_offset;
 
+		/*
+		 * Every page read ahead is marked, and its first use
+		 * clears the mark: one freed still marked was read ahead
+		 * for nothing, see __delete_from_page_cache().
+		 */
 		page->flags |= (1L << PG_readahead);
 
 		list_add(&page->lru, &page_pool);
@@ -224,8 +229,10 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	 * uptodate then the caller will launch readpage again, and
 	 * will then handle the error.
 	 */
-	if (ret)
+	if (ret) {
 		read_pages(mapping, filp, &page_pool, ret);
+		add_bdi_stat(mapping->backing_dev_info, BDI_RA_PAGES, ret);
+	}
 	BUG_ON(!list_empty(&page_pool));
 out:
 	return ret;
@@ -361,10 +368,132 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  * read is about to happen and the window is immediately set to the initial size
  * based on I/O request size and the max_readahead.
  *
+ * A file read as several interleaved sequential streams, like an archive
+ * whose members are read at once, would have them replace each other's
+ * window. So the windows of the RA_STREAMS streams used last are kept in
+ * ra->streams[], and a read where one of them expects its next readahead
+ * switches to it and pushes it forward as if it had never been replaced.
+ *
+ * Reads of a few pages at a constant distance from each other, like the
+ * records of an index read in order, are neither sequential nor random.
+ * Once a few of them are seen the next RA_STRIDE_CHUNKS chunks are read
+ * ahead, each marked on its first page to read further ones when it is used.
+ *
  * The code ramps up the readahead size aggressively at first, but slow down as
  * it approaches max_readhead.
  */
 
+/*
+ * Keep the window of the current stream, before that of a new stream
+ * at @offset replaces it.  The least recently used stream is dropped.
+ */
+static void ra_stream_save(struct file_ra_state *ra, pgoff_t offset)
+{
+	if (!ra->size ||
+	    (offset >= ra->start && offset <= ra->start + ra->size))
+		return;
+
+	memmove(&ra->streams[1], &ra->streams[0],
+		(RA_STREAMS - 1) * sizeof(ra->streams[0]));
+	ra->streams[0].start = ra->start;
+	ra->streams[0].size = ra->size;
+	ra->streams[0].async_size = ra->async_size;
+}
+
+/*
+ * Is @offset where one of the other streams expects its next readahead?
+ * Then swap its window with the current one, which goes first among the
+ * others.
+ */
+static bool ra_stream_switch(struct file_ra_state *ra, pgoff_t offset)
+{
+	struct file_ra_stream s;
+	int i;
+
+	for (i = 0; i < RA_STREAMS; i++) {
+		s = ra->streams[i];
+		if (!s.size || (offset != s.start + s.size - s.async_size &&
+				offset != s.start + s.size))
+			continue;
+
+		memmove(&ra->streams[1], &ra->streams[0],
+			i * sizeof(ra->streams[0]));
+		ra->streams[0].start = ra->start;
+		ra->streams[0].size = ra->size;
+		ra->streams[0].async_size = ra->async_size;
+
+		ra->start = s.start;
+		ra->size = s.size;
+		ra->async_size = s.async_size;
+		return true;
+	}
+
+	return false;
+}
+
+#define RA_STRIDE_MIN		3	/* reads at a stride to trust it */
+#define RA_STRIDE_CHUNKS	8	/* chunks read ahead at most */
+
+/*
+ * Detect strided reads, and read ahead the chunks after @offset if it
+ * continues such a pattern.  Returns false to leave @offset to the
+ * sequential and random read logic.
+ */
+static bool stride_readahead(struct address_space *mapping,
+			     struct file_ra_state *ra, struct file *filp,
+			     pgoff_t offset, unsigned long req_size,
+			     unsigned long max)
+{
+	pgoff_t delta = offset - ra->stride_prev;
+	unsigned long nr, i;
+
+	/* the rest of the last chunk */
+	if (offset >= ra->stride_prev &&
+	    offset < ra->stride_prev + ra->stride_len)
+		return ra->stride_count >= RA_STRIDE_MIN;
+
+	/*
+	 * The next chunk, or a later one already read ahead: the chunks
+	 * in between were found in the page cache without a call here.
+	 */
+	if (offset > ra->stride_prev && ra->stride &&
+	    delta % ra->stride == 0 &&
+	    offset <= max_t(pgoff_t, ra->stride_ahead,
+			    ra->stride_prev + ra->stride)) {
+		if (ra->stride_count < RA_STRIDE_MIN)
+			ra->stride_count++;
+	} else {
+		if (offset > ra->stride_prev && delta > ra->stride_len &&
+		    delta <= UINT_MAX) {
+			ra->stride = delta;
+			ra->stride_count = 1;
+		} else {
+			ra->stride = 0;
+			ra->stride_count = 0;
+		}
+		ra->stride_len = min(req_size, max);
+		ra->stride_ahead = 0;
+	}
+	ra->stride_prev = offset;
+
+	if (ra->stride_count < RA_STRIDE_MIN || !ra->stride_len)
+		return false;
+
+	nr = min_t(unsigned long, RA_STRIDE_CHUNKS, max / ra->stride_len);
+	for (i = 0; i <= nr; i++) {
+		pgoff_t index = offset + i * ra->stride;
+
+		if (i && index < ra->stride_ahead)
+			continue;
+		__do_page_cache_readahead(mapping, filp, index,
+					  i ? ra->stride_len : req_size,
+					  i ? ra->stride_len : 0);
+	}
+	ra->stride_ahead = offset + (nr + 1) * ra->stride;
+
+	return true;
+}
+
 /*
  * Count contiguously cached pages from @offset-1 to @offset-@max,
  * this count is a conservative estimation of
@@ -411,6 +540,7 @@ static int try_context_readahead(struct address_space *mapping,
 	if (size >= offset)
 		size *= 2;
 
+	ra_stream_save(ra, offset);
 	ra->start = offset;
 	ra->size = get_init_ra_size(size + req_size, max);
 	ra->async_size = ra->size;
@@ -436,11 +566,19 @@ ondemand_readahead(struct address_space *mapping,
 		goto initial_readahead;
 
 	/*
-	 * It's the expected callback offset, assume sequential access.
+	 * Strided reads are read ahead chunk by chunk
+	 */
+	if (stride_readahead(mapping, ra, filp, offset, req_size, max))
+		return 0;
+
+	/*
+	 * It's the expected callback offset, assume sequential access,
+	 * of the current stream or of another one interleaved with it.
 	 * Ramp up sizes, and push forward the readahead window.
 	 */
-	if ((offset == (ra->start + ra->size - ra->async_size) ||
-	     offset == (ra->start + ra->size))) {
+	if (offset == (ra->start + ra->size - ra->async_size) ||
+	    offset == (ra->start + ra->size) ||
+	    ra_stream_switch(ra, offset)) {
 		ra->start += ra->size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
@@ -463,6 +601,7 @@ ondemand_readahead(struct address_space *mapping,
 		if (!start || start - offset > max)
 			return 0;
 
+		ra_stream_save(ra, offset);
 		ra->start = start;
 		ra->size = start - offset;	/* old async_size */
 		ra->size += req_size;
@@ -497,6 +636,7 @@ ondemand_readahead(struct address_space *mapping,
 	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
 
 initial_readahead:
+	ra_stream_save(ra, offset);
 	ra->start = offset;
 	ra->size = get_init_ra_size(req_size, max);
 	ra->async_size = ra->size > req_size ? ra->size - req_size : ra->size;
@@ -533,6 +673,8 @@ void page_cache_sync_readahead(struct address_space *mapping,
 			       struct file_ra_state *ra, struct file *filp,
 			       pgoff_t offset, unsigned long req_size)
 {
+	inc_bdi_stat(mapping->backing_dev_info, BDI_RA_MISS);
+
 	/* no read-ahead */
 	if (!ra->ra_pages)
 		return;
@@ -569,10 +711,6 @@ page_cache_async_readahead(struct address_space *mapping,
 			   struct page *page, pgoff_t offset,
 			   unsigned long req_size)
 {
-	/* no read-ahead */
-	if (!ra->ra_pages)
-		return;
-
 	/*
 	 * Same bit is used for PG_readahead and PG_reclaim.
 	 */
@@ -580,6 +718,11 @@ page_cache_async_readahead(struct address_space *mapping,
 		return;
 
 	ClearPageReadahead(page);
+	inc_bdi_stat(mapping->backing_dev_info, BDI_RA_HIT);
+
+	/* no read-ahead */
+	if (!ra->ra_pages)
+		return;
 
 	/*
 	 * Defer asynchronous read-ahead on IO congestion.